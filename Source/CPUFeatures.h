@@ -0,0 +1,91 @@
+// ==========================================================
+// CPU feature detection for runtime dispatched kernels
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef FREEIMAGE_CPUFEATURES_H
+#define FREEIMAGE_CPUFEATURES_H
+
+#include "FreeImage.h"
+
+// ----------------------------------------------------------
+//   instruction sets the kernels can be compiled for
+// ----------------------------------------------------------
+
+#ifndef FREEIMAGE_BIGENDIAN
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define FI_SIMD_X86
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define FI_SIMD_NEON
+#endif
+#endif // FREEIMAGE_BIGENDIAN
+
+/// Marks a function as compiled for an instruction set that is only used after a runtime check
+#if defined(FI_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define FI_TARGET(isa) __attribute__((target(isa)))
+#else
+#define FI_TARGET(isa)
+#endif
+
+/// Forces inlining, so that a generic kernel body is compiled for the instruction set of its FI_TARGET caller
+#if defined(__GNUC__) || defined(__clang__)
+#define FI_ALWAYS_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define FI_ALWAYS_INLINE __forceinline
+#else
+#define FI_ALWAYS_INLINE inline
+#endif
+
+// ----------------------------------------------------------
+
+/**
+Returns the FI_CPU_* features detected on this machine, restricted by FreeImage_SetCPUFeatureMask.
+Kernels check this on every call, so changing the mask takes effect immediately.
+*/
+unsigned FreeImage_GetActiveCPUFeatures();
+
+/**
+Runs Kernel_::Run compiled for AVX2 when it is enabled, or for the baseline instruction set otherwise.
+Kernel_::Run must be FI_ALWAYS_INLINE so that its body is compiled for both.
+*/
+template <typename Kernel_>
+struct KernelDispatch
+{
+	template <typename... Args_>
+	static void Baseline(Args_... args) {
+		Kernel_::Run(args...);
+	}
+
+#if defined(FI_SIMD_X86)
+	template <typename... Args_>
+	FI_TARGET("avx2") static void Avx2(Args_... args) {
+		Kernel_::Run(args...);
+	}
+#endif
+
+	template <typename... Args_>
+	static void Run(Args_... args) {
+#if defined(FI_SIMD_X86)
+		if (FreeImage_GetActiveCPUFeatures() & FI_CPU_AVX2) {
+			Avx2(args...);
+			return;
+		}
+#endif
+		Baseline(args...);
+	}
+};
+
+#endif // FREEIMAGE_CPUFEATURES_H
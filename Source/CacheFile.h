@@ -29,41 +29,81 @@
 
 // ----------------------------------------------------------
 
-static const int CACHE_SIZE = 32;
-static const int BLOCK_SIZE = (64 * 1024) - 8;
+/// Default amount of page data kept in memory before extents are spilled to the cache file
+static const size_t CACHE_DEFAULT_MEMORY_BUDGET = 64 * 1024 * 1024;
 
 // ----------------------------------------------------------
 
-#ifdef _WIN32
-#pragma pack(push, 1)
-#else
-#pragma pack(1)
-#endif // _WIN32
+/**
+Memory mapped backing store of the page cache.
+The file is created when the cache is opened and grows geometrically; it is deleted when closed.
+*/
+class CacheMapping {
+public :
+	CacheMapping() = default;
+	~CacheMapping();
 
-struct Block {
-     unsigned nr;
-     unsigned next;
-     uint8_t *data;
-};
+	CacheMapping(const CacheMapping&) = delete;
+	CacheMapping& operator=(const CacheMapping&) = delete;
+
+	FIBOOL open(const std::string& filename);
+	void close();
+
+	/// Makes sure the mapping covers at least 'size' bytes. Can move the view, which is kept on failure.
+	FIBOOL reserve(uint64_t size);
+
+	FIBOOL isOpen() const {
+		return m_view != nullptr;
+	}
 
+	uint8_t *data() const {
+		return m_view;
+	}
+
+private :
+	FIBOOL remap(uint64_t capacity);
+
+private :
+	std::string m_filename;
+	uint8_t *m_view{};
+	uint64_t m_capacity{};
 #ifdef _WIN32
-#pragma pack(pop)
+	void *m_file{};
+	void *m_mapping{};
 #else
-#pragma pack()
+	int m_file{-1};
 #endif // _WIN32
+};
 
 // ----------------------------------------------------------
 
+/**
+Page cache used by the multipage functions.
+
+Every stored file is a single variable-size extent. Extents stay in memory
+until the memory budget is exceeded, after which the least recently used ones
+are moved to a memory mapped spill file. The LRU list is intrusive (linked by
+extent index), so touching or evicting an extent is O(1).
+When the cache is kept in memory nothing is ever spilled. writeFile fails
+when the spill file can't grow to hold the extents over the budget.
+*/
 class CacheFile {
-	typedef std::list<Block *> PageCache;
-	typedef std::list<Block *>::iterator PageCacheIt;
-	typedef std::map<int, PageCacheIt> PageMap;
-	typedef std::map<int, PageCacheIt>::iterator PageMapIt;
+public :
+	struct Statistics {
+		uint64_t hits{};           //! reads served from memory
+		uint64_t misses{};         //! reads served from the spill file
+		uint64_t spills{};         //! extents moved from memory to the spill file
+		uint64_t memory_bytes{};   //! bytes currently held in memory
+		uint64_t spilled_bytes{};  //! bytes currently held in the spill file
+	};
 
 public :
 	CacheFile();
 	~CacheFile();
-	
+
+	CacheFile(const CacheFile&) = delete;
+	CacheFile& operator=(const CacheFile&) = delete;
+
 	FIBOOL open(const std::string& filename = "", FIBOOL keep_in_memory = TRUE);
 	void close();
 
@@ -71,23 +111,70 @@ public :
 	int writeFile(uint8_t *data, int size);
 	void deleteFile(int nr);
 
+	/// Returns the stored size of a file, 0 for an invalid reference
+	int getFileSize(int nr) const;
+
+	void setMemoryBudget(size_t budget);
+
+	size_t getMemoryBudget() const {
+		return m_budget;
+	}
+
+	const Statistics& getStatistics() const {
+		return m_stats;
+	}
+
 private :
-	void cleanupMemCache();
-	int allocateBlock();
-	Block *lockBlock(int nr);
-	FIBOOL unlockBlock(int nr);
-	FIBOOL deleteBlock(int nr);
+	struct Extent {
+		uint8_t *data{};       // resident copy, nullptr when spilled
+		uint64_t offset{};     // position in the spill file
+		int size{};
+		int prev{-1};          // LRU links, valid while resident
+		int next{-1};
+		bool used{};
+	};
+
+	Extent *getExtent(int nr);
+	const Extent *getExtent(int nr) const;
+
+	void linkFront(int index);
+	void unlink(int index);
+
+	FIBOOL enforceBudget();
+	FIBOOL spill(int index);
+
+	uint64_t allocateSpace(uint64_t size);
+	void releaseSpace(uint64_t offset, uint64_t size);
 
 private :
-	FILE *m_file;
 	std::string m_filename;
-	std::list<int> m_free_pages;
-	PageCache m_page_cache_mem;
-	PageCache m_page_cache_disk;
-	PageMap m_page_map;
-	int m_page_count;
-	Block *m_current_block;
 	FIBOOL m_keep_in_memory;
+	size_t m_budget;
+
+	std::vector<Extent> m_extents;
+	std::vector<int> m_free_extents;
+	int m_lru_head;
+	int m_lru_tail;
+
+	CacheMapping m_mapping;
+	std::map<uint64_t, uint64_t> m_free_space;	// offset -> size, adjacent ranges are merged
+	uint64_t m_file_end;
+
+	Statistics m_stats;
 };
 
+// ----------------------------------------------------------
+
+/**
+Serializes a page into the raw spool format used by the page cache.
+The payload keeps pixels, palette, transparency, ICC profile, metadata and thumbnail;
+when compress is TRUE it is deflated at the fastest level.
+*/
+FIBOOL FreeImage_SpoolPage(FIBITMAP *dib, FIBOOL compress, std::vector<uint8_t>& buffer);
+
+/**
+Rebuilds a page written by FreeImage_SpoolPage. Returns nullptr on a malformed buffer.
+*/
+FIBITMAP *FreeImage_UnspoolPage(const uint8_t *data, size_t size);
+
 #endif // FREEIMAGE_CACHEFILE_H
@@ -729,10 +729,32 @@ FI_STRUCT (FIDEPENDENCY) {
 	FREE_IMAGE_DEPENDENCY_TYPE type	FI_DEFAULT(FIDEP_STATIC);
 };
 
+/**
+ * Statistics of the page cache of a multipage bitmap
+ */
+FI_STRUCT (FIPAGECACHESTATS) {
+	uint64_t hits			FI_DEFAULT(0);	//! cached page reads served from memory
+	uint64_t misses			FI_DEFAULT(0);	//! cached page reads served from the cache file
+	uint64_t spills			FI_DEFAULT(0);	//! pages moved from memory to the cache file
+	uint64_t memory_bytes	FI_DEFAULT(0);	//! bytes currently held in memory
+	uint64_t spilled_bytes	FI_DEFAULT(0);	//! bytes currently held in the cache file
+};
+
+/**
+ * Statistics of the page read-ahead of a multipage bitmap
+ */
+FI_STRUCT (FIPAGEPREFETCHSTATS) {
+	uint64_t hits			FI_DEFAULT(0);	//! locked pages that were decoded ahead of time
+	uint64_t waits			FI_DEFAULT(0);	//! hits that had to wait for a worker to finish the page
+	uint64_t misses			FI_DEFAULT(0);	//! locked pages decoded on the calling thread
+	uint64_t discarded		FI_DEFAULT(0);	//! pages dropped from the read-ahead window unused
+};
+
 
 // Load / Save flag constants -----------------------------------------------
 
 #define FIF_LOAD_NOPIXELS 0x8000	//! loading: load the image header only (not supported by all plugins, default to full loading)
+#define FIF_LOAD_TOPDOWN  0x4000	//! loading: store the scanlines top-down when the codec decodes them in this order (see FreeImage_IsTopDown)
 
 #define BMP_DEFAULT         0
 #define BMP_SAVE_RLE        1
@@ -846,12 +868,91 @@ FI_STRUCT (FIDEPENDENCY) {
 #define FI_RESCALE_TRUE_COLOR		0x01	//! for non-transparent greyscale images, convert to 24-bit if src bitdepth <= 8 (default is a 8-bit greyscale image). 
 #define FI_RESCALE_OMIT_METADATA	0x02	//! do not copy metadata to the rescaled image
 
+// CPU feature flags ---------------------------------------------------------
+// Constants used in FreeImage_GetCPUFeatures and FreeImage_SetCPUFeatureMask
+
+#define FI_CPU_SSE2					0x0001	//! x86 SSE2
+#define FI_CPU_SSSE3				0x0002	//! x86 SSSE3
+#define FI_CPU_SSE41				0x0004	//! x86 SSE4.1
+#define FI_CPU_AVX2					0x0008	//! x86 AVX2
+#define FI_CPU_NEON					0x0100	//! ARM NEON
+
 // Color conversion parameters
 FI_ENUM(FREE_IMAGE_CVT_COLOR_PARAM) {
 	FICPARAM_YUV_STANDARD_DEFAULT = 0,
-	FICPARAM_YUV_STANDARD_JPEG = FICPARAM_YUV_STANDARD_DEFAULT
+	FICPARAM_YUV_STANDARD_JPEG = FICPARAM_YUV_STANDARD_DEFAULT,	//! JPEG (T.871), full range
+	FICPARAM_YUV_STANDARD_BT601 = 1,	//! ITU-R BT.601, video range for integer samples
+	FICPARAM_YUV_STANDARD_BT709 = 2,	//! ITU-R BT.709, video range for integer samples
+	FICPARAM_YUV_STANDARD_BT2020 = 3	//! ITU-R BT.2020 non-constant luminance, video range for integer samples
 };
 
+// Planar and packed YUV buffer layouts
+FI_ENUM(FREE_IMAGE_YUV_LAYOUT) {
+	FIYUV_I420 = 0,	//! 8-bit Y, U and V planes, chroma subsampled 2x2
+	FIYUV_NV12 = 1,	//! 8-bit Y plane and interleaved UV plane, chroma subsampled 2x2
+	FIYUV_YUY2 = 2,	//! 8-bit packed Y0 U Y1 V, chroma subsampled 2x1
+	FIYUV_P010 = 3	//! 16-bit Y plane and interleaved UV plane, chroma subsampled 2x2, samples in the upper 10 bits
+};
+
+// Conversions done by FreeImage_ConvertInPlace
+FI_ENUM(FREE_IMAGE_INPLACE_CONVERSION) {
+	FIINPLACE_DROP_ALPHA = 0,		//! 32-bit FIT_BITMAP to 24-bit, FIT_RGBA16 to FIT_RGB16, FIT_RGBAF to FIT_RGBF (clamped to [0, 1]), FIT_RGBA32 to FIT_RGB32
+	FIINPLACE_GREYSCALE = 1,		//! 24- and 32-bit FIT_BITMAP to 8-bit greyscale, FIT_RGB16 and FIT_RGBA16 to FIT_UINT16
+	FIINPLACE_FLOAT = 2,			//! To FIT_FLOAT from FIT_DOUBLE, FIT_UINT32, FIT_INT32 and the RGB[A] 16-bit, 32-bit and float types, scaled as FreeImage_ConvertToFloat does; FIT_FLOAT is left unchanged
+	FIINPLACE_SWAP_RED_BLUE = 3		//! Swaps the red and blue channels of 24- and 32-bit FIT_BITMAP and of the RGB[A] 16-bit, 32-bit and float types
+};
+
+/**
+ * Planes of a YUV frame, rows are stored top-down
+ */
+FI_STRUCT (FIYUVPLANES) {
+	uint8_t *data[3];	//! Y (or packed YUY2), U (or interleaved UV) and V planes
+	unsigned pitch[3];	//! bytes between the starts of two rows of each plane
+};
+
+/**
+ * A tile of a bitmap, handed to the callback of FreeImage_ForEachTile
+ */
+FI_STRUCT (FITILE) {
+	FIBITMAP *view;		//! view of the pixels of the tile (see FreeImage_CreateView), valid during the callback only
+	unsigned index;		//! tile number, row by row from the top left tile
+	unsigned left;		//! position of the top left pixel of the tile in the bitmap
+	unsigned top;
+	unsigned width;		//! size of the tile, smaller than requested for the last column and row
+	unsigned height;
+};
+
+typedef FIBOOL (DLL_CALLCONV *FI_TileProc)(const FITILE *tile, void *user);
+
+/**
+ * Statistics of one channel, see FreeImage_GetStatistics.
+ * NaN samples are skipped by all the fields
+ */
+FI_STRUCT (FICHANNELSTATS) {
+	double min;			//! smallest sample
+	double max;			//! largest sample
+	double mean;
+	double variance;	//! population variance: mean of the squared deviations from the mean
+};
+
+/**
+ * Statistics of an image, see FreeImage_GetStatistics
+ */
+FI_STRUCT (FISTATISTICS) {
+	unsigned channels;			//! 1 for single sample images, 3 for RGB and 4 for RGBA images
+	FICHANNELSTATS channel[4];	//! red, green, blue and alpha, or the only channel in channel[0]
+	uint64_t pixels;			//! width * height
+	uint64_t transparent;		//! pixels whose alpha is 0 or less; 0 for images without alpha
+	uint64_t opaque;			//! pixels whose alpha is the maximal sample value (1 for floats); all the pixels of images without alpha
+	double histogram_min;		//! lowest sample value of the first histogram bin, 0 without histograms
+	double histogram_max;		//! highest sample value of the last histogram bin, 0 without histograms
+};
+
+/**
+ * A recorded sequence of point operations, see FreeImage_CreatePointOps
+ */
+FI_STRUCT (FIPOINTOPS) { void *data; };
+
 // Alpha blending operation type
 FI_ENUM(FREE_IMAGE_ALPHA_OPERATION) {
 	FIAO_SrcAlpha		///< Use only src alpha, ignore dst alpha
@@ -909,6 +1010,15 @@ DLL_API FIBOOL DLL_CALLCONV FreeImage_HasPixels(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Load(FREE_IMAGE_FORMAT fif, const char *filename, int flags FI_DEFAULT(0));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, int flags FI_DEFAULT(0));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags FI_DEFAULT(0));
+/**
+ * Loads an image straight into a requested layout, with the pixels FreeImage_ConvertTo32Bits, ConvertTo24Bits,
+ * ConvertToGreyscale (8 bpp) or the FreeImage_ConvertTo* function of the requested type would give after a plain load.
+ * PNG and JPEG decode common cases directly into the layout, EXR into FIT_RGBAF; other results are converted in place when possible.
+ * @param type Requested image type
+ * @param bpp 8, 24 or 32 for FIT_BITMAP, ignored otherwise
+ */
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadAs(FREE_IMAGE_FORMAT fif, const char *filename, FREE_IMAGE_TYPE type, unsigned bpp, int flags FI_DEFAULT(0));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadAsFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, FREE_IMAGE_TYPE type, unsigned bpp, int flags FI_DEFAULT(0));
 DLL_API FIBOOL DLL_CALLCONV FreeImage_Save(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const char *filename, int flags FI_DEFAULT(0));
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SaveU(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, const wchar_t *filename, int flags FI_DEFAULT(0));
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SaveToHandle(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FreeImageIO *io, fi_handle handle, int flags FI_DEFAULT(0));
@@ -918,6 +1028,7 @@ DLL_API FIBOOL DLL_CALLCONV FreeImage_SaveToHandle(FREE_IMAGE_FORMAT fif, FIBITM
 DLL_API FIMEMORY *DLL_CALLCONV FreeImage_OpenMemory(uint8_t *data FI_DEFAULT(0), uint32_t size_in_bytes FI_DEFAULT(0));
 DLL_API void DLL_CALLCONV FreeImage_CloseMemory(FIMEMORY *stream);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadFromMemory(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, int flags FI_DEFAULT(0));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_LoadAsFromMemory(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, FREE_IMAGE_TYPE type, unsigned bpp, int flags FI_DEFAULT(0));
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SaveToMemory(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FIMEMORY *stream, int flags FI_DEFAULT(0));
 DLL_API long DLL_CALLCONV FreeImage_TellMemory(FIMEMORY *stream);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SeekMemory(FIMEMORY *stream, long offset, int origin);
@@ -996,6 +1107,19 @@ DLL_API FIBITMAP * DLL_CALLCONV FreeImage_LockPage(FIMULTIBITMAP *bitmap, int pa
 DLL_API void DLL_CALLCONV FreeImage_UnlockPage(FIMULTIBITMAP *bitmap, FIBITMAP *data, FIBOOL changed);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_MovePage(FIMULTIBITMAP *bitmap, int target, int source);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_GetLockedPageNumbers(FIMULTIBITMAP *bitmap, int *pages, int *count);
+/**
+ * Sets how many bytes of modified pages are kept in memory before the least recently used ones are moved to the cache file.
+ * Has no effect on the spilling if the bitmap was opened with keep_cache_in_memory = TRUE.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SetPageCacheBudget(FIMULTIBITMAP *bitmap, uint64_t max_memory_bytes);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SetPageCacheCompression(FIMULTIBITMAP *bitmap, FIBOOL compress FI_DEFAULT(TRUE));
+DLL_API FIBOOL DLL_CALLCONV FreeImage_GetPageCacheStats(FIMULTIBITMAP *bitmap, FIPAGECACHESTATS *stats);
+/**
+ * Enables decoding of the next 'depth' pages on worker threads each time a page is locked; 0 disables the read-ahead.
+ * Only available for bitmaps opened from a file or from memory, in a format whose pages can be loaded concurrently (GIF, ICO, TIFF).
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SetPagePrefetch(FIMULTIBITMAP *bitmap, int depth);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_GetPagePrefetchStats(FIMULTIBITMAP *bitmap, FIPAGEPREFETCHSTATS *stats);
 
 // File type request routines ------------------------------------------------
 
@@ -1017,6 +1141,15 @@ DLL_API FREE_IMAGE_TYPE DLL_CALLCONV FreeImage_GetImageType(FIBITMAP *dib);
 // FreeImage helper routines ------------------------------------------------
 
 DLL_API FIBOOL DLL_CALLCONV FreeImage_IsLittleEndian(void);
+/**
+ * Returns the FI_CPU_* instruction sets used by the vectorized kernels of the library.
+ */
+DLL_API unsigned DLL_CALLCONV FreeImage_GetCPUFeatures(void);
+/**
+ * Restricts the instruction sets used by the vectorized kernels, e.g. 0 forces the scalar code.
+ * All kernels give bit-exact results whatever the mask.
+ */
+DLL_API void DLL_CALLCONV FreeImage_SetCPUFeatureMask(unsigned mask);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_LookupX11Color(const char *szColor, uint8_t *nRed, uint8_t *nGreen, uint8_t *nBlue);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_LookupSVGColor(const char *szColor, uint8_t *nRed, uint8_t *nGreen, uint8_t *nBlue);
 
@@ -1024,6 +1157,21 @@ DLL_API FIBOOL DLL_CALLCONV FreeImage_LookupSVGColor(const char *szColor, uint8_
 
 DLL_API uint8_t *DLL_CALLCONV FreeImage_GetBits(FIBITMAP *dib);
 DLL_API uint8_t *DLL_CALLCONV FreeImage_GetScanLine(FIBITMAP *dib, int scanline);
+/**
+ * Returns TRUE if the scanlines are stored top-down in memory. FreeImage_GetBits always returns the lowest address
+ * of the pixel buffer (the top scanline of a top-down bitmap) while FreeImage_GetScanLine always counts from the bottom line.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_IsTopDown(FIBITMAP *dib);
+/**
+ * Declares the memory order of the scanlines. The pixels are not moved: use it on bitmaps whose pixels are written
+ * afterwards or that wrap an external buffer, and call FreeImage_FlipVertical first to reorder an existing image.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_SetTopDown(FIBITMAP *dib, FIBOOL top_down);
+/**
+ * Returns the signed distance in bytes from FreeImage_GetScanLine(dib, y) to FreeImage_GetScanLine(dib, y + 1),
+ * i.e. the pitch for a bottom-up bitmap and minus the pitch for a top-down bitmap.
+ */
+DLL_API int DLL_CALLCONV FreeImage_GetScanLineStride(FIBITMAP *dib);
 
 DLL_API FIBOOL DLL_CALLCONV FreeImage_GetPixelIndex(FIBITMAP *dib, unsigned x, unsigned y, uint8_t *value);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_GetPixelColor(FIBITMAP *dib, unsigned x, unsigned y, FIRGBA8 *value);
@@ -1141,6 +1289,12 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ColorQuantize(FIBITMAP *dib, FREE_IMAGE
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ColorQuantizeEx(FIBITMAP *dib, FREE_IMAGE_QUANTIZE quantize FI_DEFAULT(FIQ_WUQUANT), int PaletteSize FI_DEFAULT(256), int ReserveSize FI_DEFAULT(0), FIRGBA8 *ReservePalette FI_DEFAULT(NULL));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Threshold(FIBITMAP *dib, uint8_t T);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Dither(FIBITMAP *dib, FREE_IMAGE_DITHER algorithm);
+/**
+Maps an image onto a fixed palette of 1 to 256 entries and returns an 8-bit palettized image.
+The inverse color map of the palette is cached, so that mapping many images onto one palette is cheap.
+With dither, algorithm selects Floyd & Steinberg error diffusion (FID_FS) or Bayer ordered dithering (FID_BAYER*).
+*/
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ApplyPalette(FIBITMAP *dib, const FIRGBA8 *palette, unsigned count, FIBOOL dither FI_DEFAULT(FALSE), FREE_IMAGE_DITHER algorithm FI_DEFAULT(FID_FS));
 
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertFromRawBits(uint8_t *bits, int width, int height, int pitch, unsigned bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask, FIBOOL topdown FI_DEFAULT(FALSE));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertFromRawBitsEx(FIBOOL copySource, uint8_t *bits, FREE_IMAGE_TYPE type, int width, int height, int pitch, unsigned bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask, FIBOOL topdown FI_DEFAULT(FALSE));
@@ -1163,6 +1317,27 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToStandardType(FIBITMAP *src, FI
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_linear FI_DEFAULT(TRUE));
 
 DLL_API FIBITMAP* DLL_CALLCONV FreeImage_ConvertToColor(FIBITMAP* dib, FREE_IMAGE_COLOR_TYPE dst_color, int64_t fisrt_param FI_DEFAULT(0), int64_t second_param FI_DEFAULT(0));
+/**
+ * Converts a top-down YUV frame to RGB in one pass, upsampling the chroma planes.
+ * 8-bit layouts produce a 24-bit FIT_BITMAP, FIYUV_P010 produces a FIT_RGB16 image.
+ * @param planes Y plane first, then U (or interleaved UV) and V. Planes a layout doesn't use are ignored
+ * @param standard One of FICPARAM_YUV_STANDARD_*
+ */
+DLL_API FIBITMAP* DLL_CALLCONV FreeImage_ConvertFromYUVPlanes(const FIYUVPLANES* planes, FREE_IMAGE_YUV_LAYOUT layout, unsigned width, unsigned height, FREE_IMAGE_CVT_COLOR_PARAM standard FI_DEFAULT(FICPARAM_YUV_STANDARD_DEFAULT));
+/**
+ * Converts an image to a top-down YUV frame in caller provided planes, downsampling the chroma in the same pass.
+ * 8-bit layouts accept 24- and 32-bit FIT_BITMAP images, FIYUV_P010 accepts FIT_RGB16 and FIT_RGBA16 images.
+ * Subsampled planes are (width + 1) / 2 samples wide, and (height + 1) / 2 rows high for 2x2 subsampling.
+ * @return Returns FALSE if the image or the layout is not supported
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_ConvertToYUVPlanes(FIBITMAP* dib, const FIYUVPLANES* planes, FREE_IMAGE_YUV_LAYOUT layout, FREE_IMAGE_CVT_COLOR_PARAM standard FI_DEFAULT(FICPARAM_YUV_STANDARD_DEFAULT));
+/**
+ * Converts an image without allocating a new one, when the result fits in the image's own buffer.
+ * Rows are compacted in place and the header and pitch are updated; metadata, ICC profile and thumbnail are kept.
+ * Results are the same as with the matching FreeImage_ConvertTo* function (FreeImage_ConvertToFloat with scale_linear for FIINPLACE_FLOAT).
+ * @return Returns FALSE, leaving the image untouched, if the conversion is not supported for this image type or does not fit
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_ConvertInPlace(FIBITMAP* dib, FREE_IMAGE_INPLACE_CONVERSION target);
 
 // Tone mapping operators ---------------------------------------------------
 
@@ -1267,6 +1442,7 @@ DLL_API FIBOOL DLL_CALLCONV FreeImage_FlipVertical(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Rescale(FIBITMAP *dib, int dst_width, int dst_height, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, FIBOOL convert FI_DEFAULT(TRUE));
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_RescaleRect(FIBITMAP *dib, int dst_width, int dst_height, int left, int top, int right, int bottom, FREE_IMAGE_FILTER filter FI_DEFAULT(FILTER_CATMULLROM), unsigned flags FI_DEFAULT(0));
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_RescaleBilevel(FIBITMAP *dib, int dst_width, int dst_height);
 
 // color manipulation routines (point operations)
 DLL_API FIBOOL DLL_CALLCONV FreeImage_AdjustCurve(FIBITMAP *dib, uint8_t *LUT, FREE_IMAGE_COLOR_CHANNEL channel);
@@ -1286,6 +1462,30 @@ DLL_API FIBOOL DLL_CALLCONV FreeImage_MakeHistogram(FIBITMAP* dib, uint32_t bins
 
 DLL_API int DLL_CALLCONV FreeImage_GetAdjustColorsLookupTable(uint8_t *LUT, double brightness, double contrast, double gamma, FIBOOL invert);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_AdjustColors(FIBITMAP *dib, double brightness, double contrast, double gamma, FIBOOL invert FI_DEFAULT(FALSE));
+
+/**
+ * Creates an empty sequence of point operations. Brightness, contrast, gamma, curves and inversion
+ * are recorded by the FreeImage_PointOpsAdd* functions, restricted to FICC_RGB, FICC_RED, FICC_GREEN,
+ * FICC_BLUE or FICC_ALPHA, and applied in the recorded order by FreeImage_ApplyPointOps in a single pass.
+ * Release it with FreeImage_DeletePointOps.
+ */
+DLL_API FIPOINTOPS *DLL_CALLCONV FreeImage_CreatePointOps(void);
+DLL_API void DLL_CALLCONV FreeImage_DeletePointOps(FIPOINTOPS *ops);
+DLL_API FIBOOL DLL_CALLCONV FreeImage_PointOpsAddBrightness(FIPOINTOPS *ops, double percentage, FREE_IMAGE_COLOR_CHANNEL channel FI_DEFAULT(FICC_RGB));
+DLL_API FIBOOL DLL_CALLCONV FreeImage_PointOpsAddContrast(FIPOINTOPS *ops, double percentage, FREE_IMAGE_COLOR_CHANNEL channel FI_DEFAULT(FICC_RGB));
+DLL_API FIBOOL DLL_CALLCONV FreeImage_PointOpsAddGamma(FIPOINTOPS *ops, double gamma, FREE_IMAGE_COLOR_CHANNEL channel FI_DEFAULT(FICC_RGB));
+/** The 256 entries of LUT are copied; 16-bit and float samples interpolate between them */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_PointOpsAddCurve(FIPOINTOPS *ops, const uint8_t *LUT, FREE_IMAGE_COLOR_CHANNEL channel FI_DEFAULT(FICC_RGB));
+DLL_API FIBOOL DLL_CALLCONV FreeImage_PointOpsAddInvert(FIPOINTOPS *ops, FREE_IMAGE_COLOR_CHANNEL channel FI_DEFAULT(FICC_RGB));
+/**
+ * Applies the recorded point operations in one row-parallel pass. 8-bit samples give the same result as
+ * the successive FreeImage_Adjust* calls, through one composed LUT per channel. 16-bit and float samples
+ * are processed normalized to [0, 1]; 16-bit samples are clamped after every operation, float samples are not.
+ * Supports 1-, 4- and 8-bit palettized images (the palette is modified), 8-bit greyscale images and
+ * single channel types (every operation applies, whatever its channel), 24- and 32-bit images,
+ * FIT_UINT16, FIT_RGB16, FIT_RGBA16, FIT_FLOAT, FIT_RGBF and FIT_RGBAF.
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_ApplyPointOps(FIBITMAP *dib, const FIPOINTOPS *ops);
 DLL_API unsigned DLL_CALLCONV FreeImage_ApplyColorMapping(FIBITMAP *dib, FIRGBA8 *srccolors, FIRGBA8 *dstcolors, unsigned count, FIBOOL ignore_alpha, FIBOOL swap);
 DLL_API unsigned DLL_CALLCONV FreeImage_SwapColors(FIBITMAP *dib, FIRGBA8 *color_a, FIRGBA8 *color_b, FIBOOL ignore_alpha);
 DLL_API unsigned DLL_CALLCONV FreeImage_ApplyPaletteIndexMapping(FIBITMAP *dib, uint8_t *srcindices,	uint8_t *dstindices, unsigned count, FIBOOL swap);
@@ -1296,11 +1496,34 @@ DLL_API FIBITMAP *DLL_CALLCONV FreeImage_GetChannel(FIBITMAP *dib, FREE_IMAGE_CO
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SetChannel(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL channel);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_GetComplexChannel(FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL channel);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_SetComplexChannel(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_COLOR_CHANNEL channel);
+/**
+Splits a RGB[A] or complex image into one greyscale plane per channel in a single pass.
+channels receives 4 entries: red, green, blue and alpha, or the real and imaginary parts (unused entries are NULL).
+Returns the number of planes, 0 on failure.
+*/
+DLL_API unsigned DLL_CALLCONV FreeImage_SplitChannels(FIBITMAP *dib, FIBITMAP **channels);
+/**
+Interleaves count planes, as given by FreeImage_SplitChannels, into a new image of the given type in a single pass.
+FIT_BITMAP accepts 3 or 4 8-bit planes and builds a 24- or 32-bit image.
+*/
+DLL_API FIBITMAP *DLL_CALLCONV FreeImage_MergeChannels(FIBITMAP **channels, unsigned count, FREE_IMAGE_TYPE type);
 
 // copy / paste / composite routines
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Copy(FIBITMAP *dib, int left, int top, int right, int bottom);
 DLL_API FIBOOL DLL_CALLCONV FreeImage_Paste(FIBITMAP *dst, FIBITMAP *src, int left, int top, int alpha);
+/**
+ * Creates a bitmap sharing a rectangle of the pixels of dib. Writes through the view are visible in dib and the
+ * other views; the pixels of library allocated bitmaps are kept alive until dib and all its views are unloaded.
+ */
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right, unsigned bottom);
+/**
+ * Splits dib into tiles of tile_width x tile_height pixels and calls proc for each of them on the library thread pool.
+ * A tile_width of 0 makes row bands of the full width, a tile_height of 0 lets the library choose the height of the tiles.
+ * The width of the tiles of 1-, 2- and 4-bit bitmaps is rounded up to a byte boundary. proc is called concurrently for
+ * different tiles, in no particular order, and may return FALSE to skip the tiles that were not started yet.
+ * @return Returns FALSE if proc returned FALSE or a tile could not be created
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_ForEachTile(FIBITMAP *dib, unsigned tile_width, unsigned tile_height, FI_TileProc proc, void *user FI_DEFAULT(NULL));
 
 DLL_API FIBOOL DLL_CALLCONV FreeImage_PreMultiplyWithAlpha(FIBITMAP *dib);
 DLL_API FIBITMAP *DLL_CALLCONV FreeImage_Composite(FIBITMAP *fg, FIBOOL useFileBkg FI_DEFAULT(FALSE), FIRGBA8 *appBkColor FI_DEFAULT(NULL), FIBITMAP *bg FI_DEFAULT(NULL));
@@ -1331,6 +1554,21 @@ DLL_API FIBOOL DLL_CALLCONV FreeImage_FindMinMax(FIBITMAP* dib, double* min_brig
  */
 DLL_API FIBOOL DLL_CALLCONV FreeImage_FindMinMaxValue(FIBITMAP* dib, void* min_value, void* max_value);
 
+/**
+ * Gathers the min, max, mean and variance of every channel, the alpha coverage and optionally
+ * the histogram of every channel in a single pass, which runs in row bands on the library thread pool.
+ * Supports 8-, 24- and 32-bit FIT_BITMAP images (8-bit samples are taken as they are, palette indices included),
+ * FIT_UINT16, FIT_INT16, FIT_UINT32, FIT_INT32, FIT_FLOAT, FIT_DOUBLE and the RGB(A) 16-bit, 32-bit and float types.
+ * @param stats Receives the statistics; channels are listed in the red, green, blue, alpha order for every image type
+ * @param histograms Optional, receives stats->channels histograms of 'bins' counters each, one after another
+ * @param bins Number of bins of each histogram
+ * @param range_min, range_max Sample values mapped to the histogram. When range_min >= range_max, integer samples
+ * are binned over the whole range of their type and floating point samples over the min and max of the color channels,
+ * found by an extra pass. Samples out of the range are counted in the first or the last bin, NaN samples are not counted
+ * @return Returns FALSE if the image type is not supported
+ */
+DLL_API FIBOOL DLL_CALLCONV FreeImage_GetStatistics(FIBITMAP *dib, FISTATISTICS *stats, uint32_t *histograms FI_DEFAULT(NULL), uint32_t bins FI_DEFAULT(256), double range_min FI_DEFAULT(0), double range_max FI_DEFAULT(0));
+
 /**
  * Sets all image pixels to 'value'. The value must be of valid type.
  */
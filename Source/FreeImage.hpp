@@ -11,9 +11,11 @@
 #define FREEIMAGE_HPP
 
 #include <cassert>
+#include <exception>
 #include <filesystem>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
 #include <string>
@@ -179,7 +181,26 @@ namespace fi
     enum class CvtColorParameter
     {
         eYuvStandardDefault = FICPARAM_YUV_STANDARD_DEFAULT,
-        eYuvStandardJpeg    = FICPARAM_YUV_STANDARD_JPEG
+        eYuvStandardJpeg    = FICPARAM_YUV_STANDARD_JPEG,
+        eYuvStandardBt601   = FICPARAM_YUV_STANDARD_BT601,
+        eYuvStandardBt709   = FICPARAM_YUV_STANDARD_BT709,
+        eYuvStandardBt2020  = FICPARAM_YUV_STANDARD_BT2020
+    };
+
+    enum class YuvLayout
+    {
+        eI420 = FIYUV_I420,
+        eNV12 = FIYUV_NV12,
+        eYUY2 = FIYUV_YUY2,
+        eP010 = FIYUV_P010
+    };
+
+    enum class InPlaceConversion
+    {
+        eDropAlpha   = FIINPLACE_DROP_ALPHA,
+        eGreyscale   = FIINPLACE_GREYSCALE,
+        eFloat       = FIINPLACE_FLOAT,
+        eSwapRedBlue = FIINPLACE_SWAP_RED_BLUE
     };
 
     enum class MetadataModel
@@ -577,6 +598,57 @@ namespace fi
 
 
 
+    /**
+     * Point operations recorded in order and applied in one pass by Bitmap::ApplyPointOps
+     */
+    class PointOps
+    {
+    public:
+        PointOps()
+            : mHandlePtr(FREEIMAGERE_CHECKED_CALL(FreeImage_CreatePointOps), &::FreeImage_DeletePointOps)
+        { }
+
+        PointOps& Brightness(double percentage, ColorChannel channel = ColorChannel::eRgb)
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_PointOpsAddBrightness, mHandlePtr.get(), percentage, static_cast<FREE_IMAGE_COLOR_CHANNEL>(channel));
+            return *this;
+        }
+
+        PointOps& Contrast(double percentage, ColorChannel channel = ColorChannel::eRgb)
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_PointOpsAddContrast, mHandlePtr.get(), percentage, static_cast<FREE_IMAGE_COLOR_CHANNEL>(channel));
+            return *this;
+        }
+
+        PointOps& Gamma(double gamma, ColorChannel channel = ColorChannel::eRgb)
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_PointOpsAddGamma, mHandlePtr.get(), gamma, static_cast<FREE_IMAGE_COLOR_CHANNEL>(channel));
+            return *this;
+        }
+
+        PointOps& Curve(const uint8_t* lut, ColorChannel channel = ColorChannel::eRgb)
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_PointOpsAddCurve, mHandlePtr.get(), lut, static_cast<FREE_IMAGE_COLOR_CHANNEL>(channel));
+            return *this;
+        }
+
+        PointOps& Invert(ColorChannel channel = ColorChannel::eRgb)
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_PointOpsAddInvert, mHandlePtr.get(), static_cast<FREE_IMAGE_COLOR_CHANNEL>(channel));
+            return *this;
+        }
+
+        const FIPOINTOPS* NativeHandle() const
+        {
+            return mHandlePtr.get();
+        }
+
+    private:
+        std::unique_ptr<FIPOINTOPS, decltype(&::FreeImage_DeletePointOps)> mHandlePtr;
+    };
+
+
+
     class Bitmap
     {
         class BitmapDeleter;
@@ -596,6 +668,24 @@ namespace fi
             return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_ConvertFromRawBitsEx, copySource, bits, static_cast<FREE_IMAGE_TYPE>(RequireKnownType(type)), details::narrow_cast<int32_t>(width), details::narrow_cast<int32_t>(height), details::narrow_cast<int32_t>(pitch), bpp, redMask, greenMask, blueMask, topdown));
         }
 
+        static
+        Bitmap FromYuvPlanes(const FIYUVPLANES& planes, YuvLayout layout, uint32_t width, uint32_t height, CvtColorParameter standard = CvtColorParameter::eYuvStandardDefault)
+        {
+            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_ConvertFromYUVPlanes, &planes, static_cast<FREE_IMAGE_YUV_LAYOUT>(layout), width, height, static_cast<FREE_IMAGE_CVT_COLOR_PARAM>(standard)));
+        }
+
+        static
+        Bitmap LoadAs(ImageFormat fif, const char* filename, ImageType type, uint32_t bpp, int flags = 0)
+        {
+            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_LoadAs, static_cast<FREE_IMAGE_FORMAT>(RequireKnownFormat(fif)), filename, static_cast<FREE_IMAGE_TYPE>(RequireKnownType(type)), bpp, flags));
+        }
+
+        static
+        Bitmap LoadAs(ImageFormat fif, FreeImageIO* io, fi_handle handle, ImageType type, uint32_t bpp, int flags = 0)
+        {
+            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_LoadAsFromHandle, static_cast<FREE_IMAGE_FORMAT>(RequireKnownFormat(fif)), io, handle, static_cast<FREE_IMAGE_TYPE>(RequireKnownType(type)), bpp, flags));
+        }
+
         Bitmap(uint32_t width, uint32_t height, uint32_t bpp, uint16_t = 0, uint32_t redMask = 0, uint32_t greenMask = 0, uint32_t blueMask = 0)
             : Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_Allocate, details::narrow_cast<int32_t>(width), details::narrow_cast<int32_t>(height), details::narrow_cast<int32_t>(bpp), redMask, greenMask, blueMask))
         { }
@@ -743,6 +833,22 @@ namespace fi
             return FreeImage_GetScanLine(NativeHandle_(), details::narrow_cast<int>(scanline));
         }
 
+        int32_t GetScanLineStride() const
+        {
+            return FreeImage_GetScanLineStride(NativeHandle_());
+        }
+
+        bool IsTopDown() const
+        {
+            return FreeImage_IsTopDown(NativeHandle_());
+        }
+
+        Bitmap& SetTopDown(bool topDown)
+        {
+            FREEIMAGERE_CHECKED_CALL(FreeImage_SetTopDown, NativeHandle_(), topDown);
+            return *this;
+        }
+
         template <typename Ty_>
         Ty_* GetScanLineAs(uint32_t scanline)
         {
@@ -850,6 +956,28 @@ namespace fi
             return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_ConvertToColor, NativeHandle_(), static_cast<FREE_IMAGE_COLOR_TYPE>(dstColor), firstParam, secondParam));
         }
 
+        bool ConvertToYuvPlanes(const FIYUVPLANES& planes, YuvLayout layout, CvtColorParameter standard = CvtColorParameter::eYuvStandardDefault) const
+        {
+            return FreeImage_ConvertToYUVPlanes(NativeHandle_(), &planes, static_cast<FREE_IMAGE_YUV_LAYOUT>(layout), static_cast<FREE_IMAGE_CVT_COLOR_PARAM>(standard));
+        }
+
+        bool ConvertInPlace(InPlaceConversion target)
+        {
+            return FreeImage_ConvertInPlace(NativeHandle_(), static_cast<FREE_IMAGE_INPLACE_CONVERSION>(target));
+        }
+
+        bool ApplyPointOps(const PointOps& ops)
+        {
+            return FreeImage_ApplyPointOps(NativeHandle_(), ops.NativeHandle());
+        }
+
+        FISTATISTICS GetStatistics(uint32_t* histograms = nullptr, uint32_t bins = 256u, double rangeMin = 0.0, double rangeMax = 0.0) const
+        {
+            FISTATISTICS stats{};
+            FREEIMAGERE_CHECKED_CALL(FreeImage_GetStatistics, NativeHandle_(), &stats, histograms, bins, rangeMin, rangeMax);
+            return stats;
+        }
+
         Bitmap ColorQuantize(QuantizationAlgorithm quantize = QuantizationAlgorithm::eWu, uint32_t paletteSize = 256u, uint32_t reserveSize = 0u, FIRGBA8* reservePalette = nullptr)
         {
             return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_ColorQuantizeEx, NativeHandle_(), static_cast<FREE_IMAGE_QUANTIZE>(quantize), details::narrow_cast<int>(paletteSize), details::narrow_cast<int>(reserveSize), reservePalette));
@@ -865,6 +993,14 @@ namespace fi
             return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_Dither, NativeHandle_(), static_cast<FREE_IMAGE_DITHER>(algorithm)));
         }
 
+        /**
+         * Maps the image onto a fixed palette, optionally dithered (FS or Bayer algorithms)
+         */
+        Bitmap ApplyPalette(const FIRGBA8* palette, uint32_t count, std::optional<DitherAlgorithm> dither = std::nullopt) const
+        {
+            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_ApplyPalette, NativeHandle_(), palette, count, dither.has_value(), static_cast<FREE_IMAGE_DITHER>(dither.value_or(DitherAlgorithm::eFS))));
+        }
+
         Bitmap ToneMapping(ToneMappingAlgorithm tmo, double firstParam = 0.0, double secondParam = 0.0) const
         {
             return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_ToneMapping, NativeHandle_(), static_cast<FREE_IMAGE_TMO>(tmo), firstParam, secondParam));
@@ -1003,6 +1139,14 @@ namespace fi
                 details::narrow_cast<int>(left), details::narrow_cast<int>(top), details::narrow_cast<int>(right), details::narrow_cast<int>(bottom), static_cast<FREE_IMAGE_FILTER>(filter), flags));
         }
 
+        /**
+         * Downscales a 1-bit image to an 8-bit greyscale image, each pixel averaging the source pixels it covers
+         */
+        Bitmap RescaleBilevel(uint32_t dstWidth, uint32_t dstHeight) const
+        {
+            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_RescaleBilevel, NativeHandle_(), details::narrow_cast<int>(dstWidth), details::narrow_cast<int>(dstHeight)));
+        }
+
         Bitmap MakeThumbnail(uint32_t maxPixelSize, bool convert = true) const
         {
             return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_MakeThumbnail, NativeHandle_(), maxPixelSize, convert));
@@ -1089,6 +1233,31 @@ namespace fi
             return FreeImage_SetComplexChannel(NativeHandle_(), src.NativeHandle_(), static_cast<FREE_IMAGE_COLOR_CHANNEL>(channel));
         }
 
+        /**
+         * Splits the image into one plane per channel: red, green, blue and alpha, or the real and imaginary parts
+         */
+        std::vector<Bitmap> SplitChannels() const
+        {
+            FIBITMAP* planes[4] = {};
+            const uint32_t count = FREEIMAGERE_CHECKED_CALL(FreeImage_SplitChannels, NativeHandle_(), planes);
+            std::vector<Bitmap> channels;
+            channels.reserve(count);
+            for (uint32_t c = 0; c < count; ++c) {
+                channels.emplace_back(planes[c]);
+            }
+            return channels;
+        }
+
+        static
+        Bitmap MergeChannels(const std::vector<Bitmap>& channels, ImageType type)
+        {
+            FIBITMAP* planes[4] = {};
+            for (size_t c = 0; c < channels.size() && c < 4; ++c) {
+                planes[c] = channels[c].NativeHandle_();
+            }
+            return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_MergeChannels, planes, details::narrow_cast<uint32_t>(channels.size()), static_cast<FREE_IMAGE_TYPE>(RequireKnownType(type))));
+        }
+
         Bitmap Copy(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom) const
         {
             return Bitmap(FREEIMAGERE_CHECKED_CALL(FreeImage_Copy, NativeHandle_(), details::narrow_cast<int>(left), details::narrow_cast<int>(top), details::narrow_cast<int>(right), details::narrow_cast<int>(bottom)));
@@ -1213,6 +1382,158 @@ namespace fi
 
 
 
+    namespace details
+    {
+        // image type and bpp of the bitmaps whose pixels are Pixel_
+        template <typename Pixel_>
+        struct PixelTypeTraits {};
+
+        template <> struct PixelTypeTraits<uint8_t>    { static constexpr ImageType type = ImageType::eBitmap;   static constexpr uint32_t bpp = 8;   };
+        template <> struct PixelTypeTraits<FIRGB8>     { static constexpr ImageType type = ImageType::eBitmap;   static constexpr uint32_t bpp = 24;  };
+        template <> struct PixelTypeTraits<FIRGBA8>    { static constexpr ImageType type = ImageType::eBitmap;   static constexpr uint32_t bpp = 32;  };
+        template <> struct PixelTypeTraits<uint16_t>   { static constexpr ImageType type = ImageType::eUInt16;   static constexpr uint32_t bpp = 16;  };
+        template <> struct PixelTypeTraits<int16_t>    { static constexpr ImageType type = ImageType::eInt16;    static constexpr uint32_t bpp = 16;  };
+        template <> struct PixelTypeTraits<uint32_t>   { static constexpr ImageType type = ImageType::eUint32;   static constexpr uint32_t bpp = 32;  };
+        template <> struct PixelTypeTraits<int32_t>    { static constexpr ImageType type = ImageType::eInt32;    static constexpr uint32_t bpp = 32;  };
+        template <> struct PixelTypeTraits<float>      { static constexpr ImageType type = ImageType::eFloat;    static constexpr uint32_t bpp = 32;  };
+        template <> struct PixelTypeTraits<double>     { static constexpr ImageType type = ImageType::eDouble;   static constexpr uint32_t bpp = 64;  };
+        template <> struct PixelTypeTraits<FICOMPLEXF> { static constexpr ImageType type = ImageType::eComplexF; static constexpr uint32_t bpp = 64;  };
+        template <> struct PixelTypeTraits<FICOMPLEX>  { static constexpr ImageType type = ImageType::eComplex;  static constexpr uint32_t bpp = 128; };
+        template <> struct PixelTypeTraits<FIRGB16>    { static constexpr ImageType type = ImageType::eRgb16;    static constexpr uint32_t bpp = 48;  };
+        template <> struct PixelTypeTraits<FIRGBA16>   { static constexpr ImageType type = ImageType::eRgba16;   static constexpr uint32_t bpp = 64;  };
+        template <> struct PixelTypeTraits<FIRGBF>     { static constexpr ImageType type = ImageType::eRgbF;     static constexpr uint32_t bpp = 96;  };
+        template <> struct PixelTypeTraits<FIRGBAF>    { static constexpr ImageType type = ImageType::eRgbaF;    static constexpr uint32_t bpp = 128; };
+        template <> struct PixelTypeTraits<FIRGB32>    { static constexpr ImageType type = ImageType::eRgb32;    static constexpr uint32_t bpp = 96;  };
+        template <> struct PixelTypeTraits<FIRGBA32>   { static constexpr ImageType type = ImageType::eRgba32;   static constexpr uint32_t bpp = 128; };
+
+    } // namespace details
+
+
+    /**
+     * Typed pixels of a tile handed to the function of ForEachTile.
+     * Scanlines are counted from the bottom of the tile, as in Bitmap::GetScanLine.
+     */
+    template <typename Pixel_>
+    class Tile
+    {
+    public:
+        explicit
+        Tile(const FITILE& tile)
+            : mTile(tile)
+        { }
+
+        uint32_t GetIndex() const
+        {
+            return mTile.index;
+        }
+
+        uint32_t GetLeft() const
+        {
+            return mTile.left;
+        }
+
+        uint32_t GetTop() const
+        {
+            return mTile.top;
+        }
+
+        uint32_t GetWidth() const
+        {
+            return mTile.width;
+        }
+
+        uint32_t GetHeight() const
+        {
+            return mTile.height;
+        }
+
+        int32_t GetScanLineStride() const
+        {
+            return FreeImage_GetScanLineStride(mTile.view);
+        }
+
+        Pixel_* GetScanLine(uint32_t scanline) const
+        {
+            return static_cast<Pixel_*>(static_cast<void*>(FreeImage_GetScanLine(mTile.view, details::narrow_cast<int>(scanline))));
+        }
+
+        // view of the tile, valid during the call only
+        FIBITMAP* NativeHandle() const
+        {
+            return mTile.view;
+        }
+
+    private:
+        const FITILE& mTile;
+    };
+
+    namespace details
+    {
+        template <typename Pixel_, typename Fn_>
+        struct TileCall
+        {
+            Fn_& fn;
+            std::exception_ptr error{};
+            std::mutex errorMutex{};
+
+            static
+            FIBOOL DLL_CALLCONV Run(const FITILE* tile, void* user)
+            {
+                auto* self = static_cast<TileCall*>(user);
+                try {
+                    Tile<Pixel_> typed(*tile);
+                    if constexpr (std::is_void_v<std::invoke_result_t<Fn_&, Tile<Pixel_>&>>) {
+                        self->fn(typed);
+                        return TRUE;
+                    }
+                    else {
+                        return static_cast<bool>(self->fn(typed));
+                    }
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(self->errorMutex);
+                    if (!self->error) {
+                        self->error = std::current_exception();
+                    }
+                    return FALSE;
+                }
+            }
+        };
+
+    } // namespace details
+
+    /**
+     * Calls fn(Tile<Pixel_>&) for the tiles of bitmap on the library thread pool, see FreeImage_ForEachTile.
+     * Pixel_ must match the image type and bpp of the bitmap. fn may return false to stop processing;
+     * the first exception thrown by fn stops processing and is rethrown.
+     * @return Returns false if fn returned false
+     */
+    template <typename Pixel_, typename Fn_>
+    bool ForEachTile(Bitmap& bitmap, uint32_t tileWidth, uint32_t tileHeight, Fn_&& fn)
+    {
+        using Traits = details::PixelTypeTraits<std::remove_cv_t<Pixel_>>;
+        if ((bitmap.GetImageType() != Traits::type) || (bitmap.GetBPP() != Traits::bpp)) {
+            throw ImageError("ForEachTile: Pixel type doesn't match the bitmap");
+        }
+        details::TileCall<Pixel_, std::remove_reference_t<Fn_>> call{ fn };
+        const bool done = FreeImage_ForEachTile(static_cast<FIBITMAP*>(bitmap), tileWidth, tileHeight, &decltype(call)::Run, &call);
+        if (call.error) {
+            std::rethrow_exception(call.error);
+        }
+        return done;
+    }
+
+    /**
+     * Calls fn(Tile<Pixel_>&) for bands of full rows of bitmap on the library thread pool.
+     */
+    template <typename Pixel_, typename Fn_>
+    bool ForEachBand(Bitmap& bitmap, Fn_&& fn)
+    {
+        return ForEachTile<Pixel_>(bitmap, 0, 0, std::forward<Fn_>(fn));
+    }
+
+
+
     class MultiBitmap
     {
         class MultiBitmapDeleter;
@@ -1325,6 +1646,35 @@ namespace fi
             return res;
         }
 
+        bool SetPageCacheBudget(uint64_t maxMemoryBytes)
+        {
+            return FreeImage_SetPageCacheBudget(NativeHandle_(), maxMemoryBytes);
+        }
+
+        bool SetPageCacheCompression(bool compress = true)
+        {
+            return FreeImage_SetPageCacheCompression(NativeHandle_(), compress);
+        }
+
+        FIPAGECACHESTATS GetPageCacheStats() const
+        {
+            FIPAGECACHESTATS stats{};
+            FreeImage_GetPageCacheStats(NativeHandle_(), &stats);
+            return stats;
+        }
+
+        bool SetPagePrefetch(int depth)
+        {
+            return FreeImage_SetPagePrefetch(NativeHandle_(), depth);
+        }
+
+        FIPAGEPREFETCHSTATS GetPagePrefetchStats() const
+        {
+            FIPAGEPREFETCHSTATS stats{};
+            FreeImage_GetPagePrefetchStats(NativeHandle_(), &stats);
+            return stats;
+        }
+
         bool Save(ImageFormat fif, FreeImageIO* io, fi_handle handle, int flags = 0) const
         {
             return FreeImage_SaveMultiBitmapToHandle(static_cast<FREE_IMAGE_FORMAT>(fif), NativeHandle_(), io, handle, flags);
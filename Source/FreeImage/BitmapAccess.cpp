@@ -29,6 +29,8 @@
 #endif 
 
 #include <stdlib.h>
+#include <atomic>
+#include <mutex>
 #if defined(_WIN32) || defined(_WIN64) || defined(__MINGW32__)
 #include <malloc.h>
 #endif // _WIN32 || _WIN64 || __MINGW32__
@@ -69,6 +71,24 @@ FI_STRUCT (METADATAHEADER) {
 	TAGMAP *tagmap;	//! pointer to the tag map
 };
 
+// ----------------------------------------------------------
+//  Shared pixels definition
+// ----------------------------------------------------------
+
+/**
+Reference counted allocation of a bitmap whose pixels are viewed by other bitmaps (see FreeImage_CreateView).
+The allocation holds the header and the pixels of the viewed bitmap and is released with the last of these bitmaps.
+*/
+FI_STRUCT (FIPIXELBLOCK) {
+	/** number of bitmaps using the pixels */
+	std::atomic<unsigned> refs;
+	/** FreeImage_Aligned_Malloc allocation holding the pixels */
+	void *data;
+};
+
+/** serializes the creation of the shared pixel blocks */
+static std::mutex s_pixel_block_mutex;
+
 // ----------------------------------------------------------
 //  FIBITMAP definition
 // ----------------------------------------------------------
@@ -118,6 +138,12 @@ FI_STRUCT (FREEIMAGEHEADER) {
 	unsigned external_pitch;
 	//@}
 
+	/** TRUE if the scanlines are stored top-down in memory */
+	FIBOOL top_down;
+
+	/** block holding the pixels when they are shared with views, NULL otherwise */
+	FIPIXELBLOCK *pixel_block;
+
 	//uint8_t filler[1];			 // fill to 32-bit alignment
 };
 
@@ -511,10 +537,73 @@ FreeImage_AllocateT(FREE_IMAGE_TYPE type, int width, int height, int bpp, unsign
 	return FreeImage_AllocateBitmap(FALSE, nullptr, 0, type, width, height, bpp, red_mask, green_mask, blue_mask);
 }
 
+// ----------------------------------------------------------
+//  Shared pixels management
+// ----------------------------------------------------------
+
+/**
+Drops a reference to a pixel block, releasing the block with its last reference.
+*/
+static void
+FreeImage_ReleasePixelBlock(FIPIXELBLOCK *block) {
+	if (block->refs.fetch_sub(1) == 1) {
+		FreeImage_Aligned_Free(block->data);
+		delete block;
+	}
+}
+
+/**
+Returns the block holding the pixels of dib with a new reference for a view.
+The allocation of dib becomes the block: neither the header nor the pixels of dib move.
+The caller must hold s_pixel_block_mutex.
+@return Returns NULL on a memory error
+*/
+static FIPIXELBLOCK *
+FreeImage_AcquirePixelBlock(FIBITMAP *dib) {
+	auto *fih = (FREEIMAGEHEADER *)dib->data;
+
+	if (FIPIXELBLOCK *block = fih->pixel_block) {
+		block->refs++;
+		return block;
+	}
+
+	auto *block = new(std::nothrow) FIPIXELBLOCK;
+	if (!block) {
+		return nullptr;
+	}
+	block->refs = 2;
+	block->data = dib->data;
+	fih->pixel_block = block;
+
+	return block;
+}
+
+FIBOOL
+FreeImage_SharePixelsWithView(FIBITMAP *view, FIBITMAP *dib) {
+	std::lock_guard<std::mutex> lock(s_pixel_block_mutex);
+
+	const auto *fih = (FREEIMAGEHEADER *)dib->data;
+	if (fih->external_bits && !fih->pixel_block) {
+		// the lifetime of a user provided buffer is not ours
+		return TRUE;
+	}
+
+	FIPIXELBLOCK *block = FreeImage_AcquirePixelBlock(dib);
+	if (!block) {
+		return FALSE;
+	}
+	((FREEIMAGEHEADER *)view->data)->pixel_block = block;
+	return TRUE;
+}
+
+// ----------------------------------------------------------
+
 void DLL_CALLCONV
 FreeImage_Unload(FIBITMAP *dib) {
 	if (dib) {	
 		if (dib->data) {
+			FIPIXELBLOCK *block = ((FREEIMAGEHEADER *)dib->data)->pixel_block;
+
 			// delete possible icc profile ...
 			if (FreeImage_GetICCProfile(dib)->data) {
 				free(FreeImage_GetICCProfile(dib)->data);
@@ -538,8 +627,15 @@ FreeImage_Unload(FIBITMAP *dib) {
 			// delete embedded thumbnail
 			FreeImage_Unload(FreeImage_GetThumbnail(dib));
 
-			// delete bitmap ...
-			FreeImage_Aligned_Free(dib->data);
+			// delete bitmap, unless its allocation holds pixels still viewed by other bitmaps ...
+			if (!block || (block->data != dib->data)) {
+				FreeImage_Aligned_Free(dib->data);
+			}
+
+			// ... release shared pixels ...
+			if (block) {
+				FreeImage_ReleasePixelBlock(block);
+			}
 		}
 
 		free(dib);		// ... and the wrapper
@@ -606,6 +702,9 @@ FreeImage_Clone(FIBITMAP *dib) {
 		((FREEIMAGEHEADER *)new_dib->data)->external_bits = nullptr;
 		((FREEIMAGEHEADER *)new_dib->data)->external_pitch = 0;
 
+		// the pixels of new_dib are its own, even when those of dib are viewed
+		((FREEIMAGEHEADER *)new_dib->data)->pixel_block = nullptr;
+
 		// copy possible ICC profile
 		FreeImage_CreateICCProfile(new_dib, src_iccProfile->data, src_iccProfile->size);
 		dst_iccProfile->flags = src_iccProfile->flags;
@@ -635,13 +734,16 @@ FreeImage_Clone(FIBITMAP *dib) {
 		// copy the thumbnail
 		FreeImage_SetThumbnail(new_dib, FreeImage_GetThumbnail(dib));
 
-		// copy user provided pixel buffer (if any)
+		// copy user provided pixel buffer (if any), in memory order
 		if (ext_bits) {
 			const unsigned pitch = FreeImage_GetPitch(dib);
+			const unsigned new_pitch = FreeImage_GetPitch(new_dib);
 			const unsigned linesize = FreeImage_GetLine(dib);
+			uint8_t *new_bits = FreeImage_GetBits(new_dib);
 			for (unsigned y = 0; y < height; y++) {
-				memcpy(FreeImage_GetScanLine(new_dib, y), ext_bits, linesize);
+				memcpy(new_bits, ext_bits, linesize);
 				ext_bits += pitch;
+				new_bits += new_pitch;
 			}
 		}
 
@@ -651,6 +753,72 @@ FreeImage_Clone(FIBITMAP *dib) {
 	return nullptr;
 }
 
+// ----------------------------------------------------------
+//  In-place layout changes
+// ----------------------------------------------------------
+
+uint8_t *
+FreeImage_GetInternalLayoutBits(FIBITMAP *dib, FREE_IMAGE_TYPE type, unsigned bpp, unsigned *pitch) {
+	if (!FreeImage_HasPixels(dib)) {
+		return nullptr;
+	}
+
+	const FREEIMAGEHEADER *fih = (FREEIMAGEHEADER *)dib->data;
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const FIBOOL need_masks = ((type == FIT_BITMAP) && (bpp == 16)) ? TRUE : FALSE;
+
+	// the header part (header + palette + masks) must still fit in front of the pixels
+	const size_t header_size = FreeImage_GetInternalImageSize(TRUE, width, height, bpp, need_masks);
+
+	if (fih->external_bits) {
+		// only the header is ours, the rows keep the user provided pitch
+		if ((header_size > FreeImage_GetInternalImageSize(TRUE, width, height, FreeImage_GetBPP(dib), FreeImage_HasRGBMasks(dib))) || (CalculateLine(width, bpp) > fih->external_pitch)) {
+			return nullptr;
+		}
+		*pitch = fih->external_pitch;
+		return fih->external_bits;
+	}
+
+	const size_t image_size = FreeImage_GetInternalImageSize(FALSE, width, height, bpp, need_masks);
+	if ((image_size == 0) || (image_size > FreeImage_GetInternalImageSize(FALSE, width, height, FreeImage_GetBPP(dib), FreeImage_HasRGBMasks(dib)))) {
+		return nullptr;
+	}
+	*pitch = CalculatePitch(CalculateLine(width, bpp));
+	return (uint8_t *)dib->data + header_size;
+}
+
+void
+FreeImage_SetInternalLayout(FIBITMAP *dib, FREE_IMAGE_TYPE type, unsigned bpp) {
+	auto *fih = (FREEIMAGEHEADER *)dib->data;
+	auto *bih = FreeImage_GetInfoHeader(dib);
+
+	assert((type != FIT_BITMAP) || (bpp == 8) || (bpp == 24) || (bpp == 32));
+
+	fih->type = type;
+
+	// transparency only applies to the former pixel format
+	fih->transparent = FALSE;
+	fih->transparency_count = 0;
+	memset(fih->transparent_table, 0xff, 256);
+
+	bih->biCompression	= BI_RGB;
+	bih->biBitCount		= (uint16_t)bpp;
+	bih->biClrUsed		= CalculateUsedPaletteEntries(bpp);
+	bih->biClrImportant	= bih->biClrUsed;
+
+	if (bpp == 8) {
+		// the palette may overwrite former pixels, so it is written last
+		auto *pal = FreeImage_GetPalette(dib);
+		for (int i = 0; i < 256; i++) {
+			pal[i].red		= (uint8_t)i;
+			pal[i].green	= (uint8_t)i;
+			pal[i].blue		= (uint8_t)i;
+			pal[i].alpha	= 0;
+		}
+	}
+}
+
 // ----------------------------------------------------------
 
 uint8_t * DLL_CALLCONV
@@ -1169,6 +1337,26 @@ FreeImage_GetPitch(FIBITMAP *dib) {
 	return 0;
 }
 
+FIBOOL DLL_CALLCONV
+FreeImage_IsTopDown(FIBITMAP *dib) {
+	return dib ? ((FREEIMAGEHEADER *)dib->data)->top_down : FALSE;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_SetTopDown(FIBITMAP *dib, FIBOOL top_down) {
+	if (!dib) {
+		return FALSE;
+	}
+	((FREEIMAGEHEADER *)dib->data)->top_down = top_down ? TRUE : FALSE;
+	return TRUE;
+}
+
+int DLL_CALLCONV
+FreeImage_GetScanLineStride(FIBITMAP *dib) {
+	const int pitch = (int)FreeImage_GetPitch(dib);
+	return FreeImage_IsTopDown(dib) ? -pitch : pitch;
+}
+
 unsigned DLL_CALLCONV
 FreeImage_GetColorsUsed(FIBITMAP *dib) {
 	return dib ? FreeImage_GetInfoHeader(dib)->biClrUsed : 0;
@@ -0,0 +1,100 @@
+// ==========================================================
+// CPU feature detection for runtime dispatched kernels
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include <atomic>
+
+#include "CPUFeatures.h"
+
+#if defined(FI_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+// ----------------------------------------------------------
+
+static unsigned
+DetectCPUFeatures() {
+	unsigned features = 0;
+
+#if defined(FI_SIMD_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4] = {};
+	__cpuid(info, 0);
+	const int max_leaf = info[0];
+
+	__cpuid(info, 1);
+	if (info[3] & (1 << 26)) {
+		features |= FI_CPU_SSE2;
+	}
+	if (info[2] & (1 << 9)) {
+		features |= FI_CPU_SSSE3;
+	}
+	if (info[2] & (1 << 19)) {
+		features |= FI_CPU_SSE41;
+	}
+
+	// AVX2 also needs the OS to save the YMM registers
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (osxsave && (max_leaf >= 7) && ((_xgetbv(0) & 0x6) == 0x6)) {
+		__cpuidex(info, 7, 0);
+		if (info[1] & (1 << 5)) {
+			features |= FI_CPU_AVX2;
+		}
+	}
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) {
+		features |= FI_CPU_SSE2;
+	}
+	if (__builtin_cpu_supports("ssse3")) {
+		features |= FI_CPU_SSSE3;
+	}
+	if (__builtin_cpu_supports("sse4.1")) {
+		features |= FI_CPU_SSE41;
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		features |= FI_CPU_AVX2;
+	}
+#endif
+#elif defined(FI_SIMD_NEON)
+	// NEON is part of the baseline of the targets it is compiled for
+	features |= FI_CPU_NEON;
+#endif
+
+	return features;
+}
+
+static std::atomic<unsigned> s_feature_mask{ ~0U };
+
+unsigned
+FreeImage_GetActiveCPUFeatures() {
+	static const unsigned detected = DetectCPUFeatures();
+	return detected & s_feature_mask.load(std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------
+
+unsigned DLL_CALLCONV
+FreeImage_GetCPUFeatures() {
+	return FreeImage_GetActiveCPUFeatures();
+}
+
+void DLL_CALLCONV
+FreeImage_SetCPUFeatureMask(unsigned mask) {
+	s_feature_mask.store(mask, std::memory_order_relaxed);
+}
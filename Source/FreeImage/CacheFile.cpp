@@ -21,200 +21,385 @@
 // Use at your own risk!
 // ==========================================================
 
-#ifdef _MSC_VER 
+#ifdef _MSC_VER
 #pragma warning (disable : 4786) // identifier was truncated to 'number' characters
-#endif 
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif // _WIN32
 
 #include "CacheFile.h"
 
 // ----------------------------------------------------------
 
-CacheFile::CacheFile() :
-m_file{},
-m_free_pages(),
-m_page_cache_mem(),
-m_page_cache_disk(),
-m_page_map(),
-m_page_count(0),
-m_current_block{},
-m_keep_in_memory(TRUE) {
-}
+static const uint64_t CACHE_MAPPING_GRANULARITY = 1024 * 1024;
 
-CacheFile::~CacheFile() {
-  close();
+// ----------------------------------------------------------
+//   CacheMapping
+// ----------------------------------------------------------
+
+CacheMapping::~CacheMapping() {
+	close();
 }
 
 FIBOOL
-CacheFile::open(const std::string& filename, FIBOOL keep_in_memory) {
-
-  assert(!m_file);
+CacheMapping::open(const std::string& filename) {
+	assert(!isOpen());
 
-  m_filename = filename;
-  m_keep_in_memory = keep_in_memory;
+	m_filename = filename;
 
-	if ((!m_filename.empty()) && (!m_keep_in_memory)) {
-		m_file = fopen(m_filename.c_str(), "w+b"); 
-		return (m_file != nullptr);
+#ifdef _WIN32
+	HANDLE file = CreateFileA(m_filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return FALSE;
 	}
+	m_file = file;
+#else
+	m_file = ::open(m_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (m_file < 0) {
+		return FALSE;
+	}
+#endif // _WIN32
 
-	return (m_keep_in_memory == TRUE);
+	if (!remap(CACHE_MAPPING_GRANULARITY)) {
+		close();
+		return FALSE;
+	}
+	return TRUE;
 }
 
 void
-CacheFile::close() {
-	// dispose the cache entries
-
-	while (!m_page_cache_disk.empty()) {
-		Block *block = *m_page_cache_disk.begin();
-		m_page_cache_disk.pop_front();
-		delete [] block->data;
-		delete block;
+CacheMapping::close() {
+#ifdef _WIN32
+	if (m_view) {
+		UnmapViewOfFile(m_view);
+	}
+	if (m_mapping) {
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
 	}
-	while (!m_page_cache_mem.empty()) { 
-		Block *block = *m_page_cache_mem.begin(); 
-		m_page_cache_mem.pop_front(); 
-		delete [] block->data; 
-		delete block; 
-	} 
-
 	if (m_file) {
-		// close the file
-		fclose(m_file);
+		// FILE_FLAG_DELETE_ON_CLOSE removes the file
+		CloseHandle(m_file);
 		m_file = nullptr;
-		
-		// delete the file
+	}
+#else
+	if (m_view) {
+		munmap(m_view, (size_t)m_capacity);
+	}
+	if (m_file >= 0) {
+		::close(m_file);
+		m_file = -1;
 		remove(m_filename.c_str());
 	}
+#endif // _WIN32
+	m_view = nullptr;
+	m_capacity = 0;
 }
 
-void
-CacheFile::cleanupMemCache() {
-	if (!m_keep_in_memory) {
-		if (m_page_cache_mem.size() > CACHE_SIZE) {
-			// flush the least used block to file
+FIBOOL
+CacheMapping::reserve(uint64_t size) {
+	if (size <= m_capacity) {
+		return TRUE;
+	}
+	uint64_t capacity = std::max(size, 2 * m_capacity);
+	capacity = (capacity + CACHE_MAPPING_GRANULARITY - 1) / CACHE_MAPPING_GRANULARITY * CACHE_MAPPING_GRANULARITY;
+	return remap(capacity);
+}
+
+FIBOOL
+CacheMapping::remap(uint64_t capacity) {
+	if (capacity > (uint64_t)std::numeric_limits<size_t>::max()) {
+		return FALSE;
+	}
+
+	// the larger view is mapped before the current one is released, so that
+	// a failure leaves the spilled extents readable through the current view
+
+#ifdef _WIN32
+	// a mapping larger than the file extends the file
+	HANDLE mapping = CreateFileMappingA((HANDLE)m_file, nullptr, PAGE_READWRITE, (DWORD)(capacity >> 32), (DWORD)(capacity & 0xFFFFFFFF), nullptr);
+	if (!mapping) {
+		return FALSE;
+	}
+	auto *view = (uint8_t *)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)capacity);
+	if (!view) {
+		CloseHandle(mapping);
+		return FALSE;
+	}
+	if (m_view) {
+		UnmapViewOfFile(m_view);
+	}
+	if (m_mapping) {
+		CloseHandle(m_mapping);
+	}
+	m_mapping = mapping;
+	m_view = view;
+#else
+	// growing the file keeps the current view valid; the blocks are allocated
+	// up front, since a write through the view into a hole of a full disk
+	// raises SIGBUS instead of returning an error
+#ifdef __APPLE__
+	fstore_t store = { F_ALLOCATEALL, F_PEOFPOSMODE, 0, (off_t)(capacity - m_capacity), 0 };
+	if (fcntl(m_file, F_PREALLOCATE, &store) == -1) {
+		return FALSE;
+	}
+	if (ftruncate(m_file, (off_t)capacity) != 0) {
+		return FALSE;
+	}
+#else
+	if (posix_fallocate(m_file, (off_t)m_capacity, (off_t)(capacity - m_capacity)) != 0) {
+		return FALSE;
+	}
+#endif // __APPLE__
+	void *view = mmap(nullptr, (size_t)capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+	if (view == MAP_FAILED) {
+		return FALSE;
+	}
+	if (m_view) {
+		munmap(m_view, (size_t)m_capacity);
+	}
+	m_view = (uint8_t *)view;
+#endif // _WIN32
 
-			Block *old_block = m_page_cache_mem.back();
-			fseek(m_file, old_block->nr * BLOCK_SIZE, SEEK_SET);
-			fwrite(old_block->data, BLOCK_SIZE, 1, m_file);
+	m_capacity = capacity;
+	return TRUE;
+}
 
-			// remove the data
+// ----------------------------------------------------------
+//   CacheFile
+// ----------------------------------------------------------
 
-			delete [] old_block->data;
-			old_block->data = nullptr;
+CacheFile::CacheFile() :
+m_keep_in_memory(TRUE),
+m_budget(CACHE_DEFAULT_MEMORY_BUDGET),
+m_lru_head(-1),
+m_lru_tail(-1),
+m_file_end(0) {
+}
 
-			// move the block to another list
+CacheFile::~CacheFile() {
+	close();
+}
 
-			m_page_cache_disk.splice(m_page_cache_disk.begin(), m_page_cache_mem, --m_page_cache_mem.end());
-			m_page_map[old_block->nr] = m_page_cache_disk.begin();
-		}
+FIBOOL
+CacheFile::open(const std::string& filename, FIBOOL keep_in_memory) {
+	m_filename = filename;
+	m_keep_in_memory = keep_in_memory || m_filename.empty();
+
+	// create the spill file now, so that an unusable cache location is reported here
+
+	if (!m_keep_in_memory && !m_mapping.isOpen()) {
+		return m_mapping.open(m_filename);
 	}
+
+	return TRUE;
 }
 
-int
-CacheFile::allocateBlock() {
-	Block *block = new Block;
-	block->data = new uint8_t[BLOCK_SIZE];
-	block->next = 0;
-
-	if (!m_free_pages.empty()) {
-		block->nr = *m_free_pages.begin();
-		m_free_pages.pop_front();
-	} else {
-		block->nr = m_page_count++;
+void
+CacheFile::close() {
+	// dispose the cache entries
+
+	for (auto& extent : m_extents) {
+		free(extent.data);
 	}
+	m_extents.clear();
+	m_free_extents.clear();
+	m_lru_head = m_lru_tail = -1;
 
-	m_page_cache_mem.push_front(block);
-	m_page_map[block->nr] = m_page_cache_mem.begin();
+	// close and delete the spill file
 
-	cleanupMemCache();
+	m_mapping.close();
+	m_free_space.clear();
+	m_file_end = 0;
 
-	return block->nr;
+	m_stats.memory_bytes = 0;
+	m_stats.spilled_bytes = 0;
 }
 
-Block *
-CacheFile::lockBlock(int nr) {
-	if (!m_current_block) {
-		PageMapIt it = m_page_map.find(nr);
+void
+CacheFile::setMemoryBudget(size_t budget) {
+	m_budget = budget;
+	enforceBudget();
+}
 
-		if (it != m_page_map.end()) {
-			m_current_block = *(it->second);
+CacheFile::Extent *
+CacheFile::getExtent(int nr) {
+	if ((nr > 0) && ((size_t)nr <= m_extents.size()) && m_extents[nr - 1].used) {
+		return &m_extents[nr - 1];
+	}
+	return nullptr;
+}
 
-			// the block is swapped out to disc. load it back
-			// and remove the block from the cache. it might get cached
-			// again as soon as the memory buffer fills up
+const CacheFile::Extent *
+CacheFile::getExtent(int nr) const {
+	if ((nr > 0) && ((size_t)nr <= m_extents.size()) && m_extents[nr - 1].used) {
+		return &m_extents[nr - 1];
+	}
+	return nullptr;
+}
 
-			if (!m_current_block->data) {
-				m_current_block->data = new uint8_t[BLOCK_SIZE];
+void
+CacheFile::linkFront(int index) {
+	Extent& extent = m_extents[index];
+	extent.prev = -1;
+	extent.next = m_lru_head;
+	if (m_lru_head != -1) {
+		m_extents[m_lru_head].prev = index;
+	} else {
+		m_lru_tail = index;
+	}
+	m_lru_head = index;
+}
 
-				fseek(m_file, m_current_block->nr * BLOCK_SIZE, SEEK_SET);
-				fread(m_current_block->data, BLOCK_SIZE, 1, m_file);
+void
+CacheFile::unlink(int index) {
+	Extent& extent = m_extents[index];
+	if (extent.prev != -1) {
+		m_extents[extent.prev].next = extent.next;
+	} else {
+		m_lru_head = extent.next;
+	}
+	if (extent.next != -1) {
+		m_extents[extent.next].prev = extent.prev;
+	} else {
+		m_lru_tail = extent.prev;
+	}
+	extent.prev = extent.next = -1;
+}
 
-				m_page_cache_mem.splice(m_page_cache_mem.begin(), m_page_cache_disk, it->second);
-				m_page_map[nr] = m_page_cache_mem.begin();
+uint64_t
+CacheFile::allocateSpace(uint64_t size) {
+	// first fit in the released ranges, otherwise append
+
+	for (auto it = m_free_space.begin(); it != m_free_space.end(); ++it) {
+		if (it->second >= size) {
+			const uint64_t offset = it->first;
+			const uint64_t remaining = it->second - size;
+			m_free_space.erase(it);
+			if (remaining > 0) {
+				m_free_space[offset + size] = remaining;
 			}
+			return offset;
+		}
+	}
 
-			// if the memory cache size is too large, swap an item to disc
+	const uint64_t offset = m_file_end;
+	m_file_end += size;
+	return offset;
+}
 
-			cleanupMemCache();
+void
+CacheFile::releaseSpace(uint64_t offset, uint64_t size) {
+	auto it = m_free_space.emplace(offset, size).first;
+
+	// merge with the following range
+
+	auto next = std::next(it);
+	if ((next != m_free_space.end()) && (it->first + it->second == next->first)) {
+		it->second += next->second;
+		m_free_space.erase(next);
+	}
 
-			// return the current block
+	// merge with the preceding range
 
-			return m_current_block;
+	if (it != m_free_space.begin()) {
+		auto prev = std::prev(it);
+		if (prev->first + prev->second == it->first) {
+			prev->second += it->second;
+			m_free_space.erase(it);
+			it = prev;
 		}
 	}
 
-	return nullptr;
-}
+	// give the tail of the file back
 
-FIBOOL
-CacheFile::unlockBlock(int nr) {
-	if (m_current_block) {
-		m_current_block = nullptr;
-		return TRUE;
+	if (it->first + it->second == m_file_end) {
+		m_file_end = it->first;
+		m_free_space.erase(it);
 	}
-	return FALSE;
 }
 
 FIBOOL
-CacheFile::deleteBlock(int nr) {
-	if (!m_current_block) {
-		PageMapIt it = m_page_map.find(nr);
-
-		// remove block from cache
+CacheFile::spill(int index) {
+	Extent& extent = m_extents[index];
+	assert(extent.data);
 
-		if (it != m_page_map.end()) {
-			m_page_map.erase(nr);
+	if (!m_mapping.isOpen()) {
+		if (!m_mapping.open(m_filename)) {
+			return FALSE;
 		}
+	}
 
-		// add block to free page list
+	const uint64_t offset = allocateSpace(extent.size);
+	if (!m_mapping.reserve(offset + extent.size)) {
+		releaseSpace(offset, extent.size);
+		return FALSE;
+	}
+	memcpy(m_mapping.data() + offset, extent.data, extent.size);
+
+	unlink(index);
+	free(extent.data);
+	extent.data = nullptr;
+	extent.offset = offset;
 
-		m_free_pages.push_back(nr);
+	m_stats.spills++;
+	m_stats.memory_bytes -= extent.size;
+	m_stats.spilled_bytes += extent.size;
+
+	return TRUE;
+}
 
+FIBOOL
+CacheFile::enforceBudget() {
+	if (m_keep_in_memory) {
 		return TRUE;
 	}
-
-	return FALSE;
+	while ((m_stats.memory_bytes > m_budget) && (m_lru_tail != -1)) {
+		if (!spill(m_lru_tail)) {
+			// the extents that could not be spilled stay in memory
+			return FALSE;
+		}
+	}
+	return TRUE;
 }
 
 FIBOOL
 CacheFile::readFile(uint8_t *data, int nr, int size) {
 	if ((data) && (size > 0)) {
-		int s = 0;
-		int block_nr = nr;
-
-		do {
-			int copy_nr = block_nr;
+		const int index = nr - 1;
+		Extent *extent = getExtent(nr);
+		if (!extent) {
+			return FALSE;
+		}
 
-			Block *block = lockBlock(copy_nr);
+		const int count = std::min(size, extent->size);
 
-			block_nr = block->next;
+		if (extent->data) {
+			memcpy(data, extent->data, count);
 
-			memcpy(data + s, block->data, (s + BLOCK_SIZE > size) ? size - s : BLOCK_SIZE);
+			// move to the front of the LRU list
 
-			unlockBlock(copy_nr);
+			if (m_lru_head != index) {
+				unlink(index);
+				linkFront(index);
+			}
+			m_stats.hits++;
+		} else {
+			// read straight from the mapping: the extent is usually read once
+			// (on save), so bringing it back would only evict another one
 
-			s += BLOCK_SIZE;
-		} while (block_nr != 0);
+			memcpy(data, m_mapping.data() + extent->offset, count);
+			m_stats.misses++;
+		}
 
 		return TRUE;
 	}
@@ -225,32 +410,42 @@ CacheFile::readFile(uint8_t *data, int nr, int size) {
 int
 CacheFile::writeFile(uint8_t *data, int size) {
 	if ((data) && (size > 0)) {
-		int nr_blocks_required = 1 + (size / BLOCK_SIZE);
-		int count = 0;
-		int s = 0;
-		int stored_alloc;
-		int alloc;
-		
-		stored_alloc = alloc = allocateBlock();
-
-		do {
-			int copy_alloc = alloc;
-
-			Block *block = lockBlock(copy_alloc);
-
-			block->next = 0;
-
-			memcpy(block->data, data + s, (s + BLOCK_SIZE > size) ? size - s : BLOCK_SIZE);
+		auto *buffer = (uint8_t *)malloc(size);
+		if (!buffer) {
+			return 0;
+		}
+		memcpy(buffer, data, size);
+
+		int index;
+		if (!m_free_extents.empty()) {
+			index = m_free_extents.back();
+			m_free_extents.pop_back();
+		} else {
+			try {
+				m_extents.emplace_back();
+			} catch (std::bad_alloc &) {
+				free(buffer);
+				return 0;
+			}
+			index = (int)m_extents.size() - 1;
+		}
 
-			if (count + 1 < nr_blocks_required)
-				alloc = block->next = allocateBlock();
+		Extent& extent = m_extents[index];
+		extent.data = buffer;
+		extent.offset = 0;
+		extent.size = size;
+		extent.used = true;
+		linkFront(index);
 
-			unlockBlock(copy_alloc);
+		m_stats.memory_bytes += size;
 
-			s += BLOCK_SIZE;			
-		} while (++count < nr_blocks_required);
+		if (!enforceBudget()) {
+			// the spill file can't grow: refuse the extent rather than exceeding the budget
+			deleteFile(index + 1);
+			return 0;
+		}
 
-		return stored_alloc;
+		return index + 1;
 	}
 
 	return 0;
@@ -258,19 +453,27 @@ CacheFile::writeFile(uint8_t *data, int size) {
 
 void
 CacheFile::deleteFile(int nr) {
-	do {
-		Block *block = lockBlock(nr);
-
-		if (!block)
-			break;
-
-		int next = block->next;
-
-		unlockBlock(nr);
-
-		deleteBlock(nr);
+	if (Extent *extent = getExtent(nr)) {
+		const int index = nr - 1;
+
+		if (extent->data) {
+			unlink(index);
+			free(extent->data);
+			extent->data = nullptr;
+			m_stats.memory_bytes -= extent->size;
+		} else {
+			releaseSpace(extent->offset, extent->size);
+			m_stats.spilled_bytes -= extent->size;
+		}
 
-		nr = next;
-	} while (nr != 0);
+		extent->used = false;
+		extent->size = 0;
+		m_free_extents.push_back(index);
+	}
 }
 
+int
+CacheFile::getFileSize(int nr) const {
+	const Extent *extent = getExtent(nr);
+	return extent ? extent->size : 0;
+}
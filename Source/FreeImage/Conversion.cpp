@@ -447,17 +447,13 @@ FreeImage_ConvertFromRawBitsEx(FIBOOL copySource, uint8_t *bits, FREE_IMAGE_TYPE
 		if (!dib) {
 			return nullptr;
 		}
-		// copy user provided pixel buffer into the dib
+		// copy user provided pixel buffer into the dib, placing each line at its final scanline
 		const unsigned linesize = FreeImage_GetLine(dib);
 		for (int y = 0; y < height; y++) {
-			memcpy(FreeImage_GetScanLine(dib, y), bits, linesize);
+			memcpy(FreeImage_GetScanLine(dib, topdown ? (height - 1 - y) : y), bits, linesize);
 			// next line in user's buffer
 			bits += pitch;
 		}
-		// flip pixels vertically if needed
-		if (topdown) {
-			FreeImage_FlipVertical(dib);
-		}
 	}
 	else {
 		// allocate a FIBITMAP using a wrapper to user provided pixel buffer
@@ -465,10 +461,8 @@ FreeImage_ConvertFromRawBitsEx(FIBOOL copySource, uint8_t *bits, FREE_IMAGE_TYPE
 		if (!dib) {
 			return nullptr;
 		}
-		// flip pixels vertically if needed
-		if (topdown) {
-			FreeImage_FlipVertical(dib);
-		}
+		// the user's buffer is used as is: declare its scanline order
+		FreeImage_SetTopDown(dib, topdown);
 	}
 
 	return dib;
@@ -482,6 +476,11 @@ FreeImage_ConvertFromRawBits(uint8_t *bits, int width, int height, int pitch, un
 void DLL_CALLCONV
 FreeImage_ConvertToRawBits(uint8_t *bits, FIBITMAP *dib, int pitch, unsigned bpp, unsigned red_mask, unsigned green_mask, unsigned blue_mask, FIBOOL topdown) {
 	if (FreeImage_HasPixels(dib) && bits) {
+		if ((FreeImage_GetBPP(dib) == bpp) && (bpp != 16) && (pitch == (int)FreeImage_GetPitch(dib)) && (!topdown == !FreeImage_IsTopDown(dib))) {
+			// same layout: copy the whole pixel buffer
+			memcpy(bits, FreeImage_GetBits(dib), (size_t)pitch * FreeImage_GetHeight(dib));
+			return;
+		}
 		for (unsigned i = 0; i < FreeImage_GetHeight(dib); ++i) {
 			uint8_t *scanline = FreeImage_GetScanLine(dib, topdown ? (FreeImage_GetHeight(dib) - i - 1) : i);
 
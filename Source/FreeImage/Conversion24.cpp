@@ -24,6 +24,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ConversionSIMD.h"
 
 // ----------------------------------------------------------
 //  internal conversions X to 24 bits
@@ -68,7 +69,12 @@ FreeImage_ConvertLine4To24(uint8_t *target, uint8_t *source, int width_in_pixels
 
 void DLL_CALLCONV
 FreeImage_ConvertLine8To24(uint8_t *target, uint8_t *source, int width_in_pixels, FIRGBA8 *palette) {
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	int cols = 0;
+	if (const auto kernel = FreeImage_GetLineConversionKernels().line8To24) {
+		cols = kernel(target, source, width_in_pixels, palette);
+		target += 3 * cols;
+	}
+	for (; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_BLUE] = palette[source[cols]].blue;
 		target[FI_RGBA_GREEN] = palette[source[cols]].green;
 		target[FI_RGBA_RED] = palette[source[cols]].red;
@@ -81,7 +87,12 @@ void DLL_CALLCONV
 FreeImage_ConvertLine16To24_555(uint8_t *target, uint8_t *source, int width_in_pixels) {
 	uint16_t *bits = (uint16_t *)source;
 
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	int cols = 0;
+	if (const auto kernel = FreeImage_GetLineConversionKernels().line16To24_555) {
+		cols = kernel(target, source, width_in_pixels);
+		target += 3 * cols;
+	}
+	for (; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_RED]   = (uint8_t)((((bits[cols] & FI16_555_RED_MASK) >> FI16_555_RED_SHIFT) * 0xFF) / 0x1F);
 		target[FI_RGBA_GREEN] = (uint8_t)((((bits[cols] & FI16_555_GREEN_MASK) >> FI16_555_GREEN_SHIFT) * 0xFF) / 0x1F);
 		target[FI_RGBA_BLUE]  = (uint8_t)((((bits[cols] & FI16_555_BLUE_MASK) >> FI16_555_BLUE_SHIFT) * 0xFF) / 0x1F);
@@ -94,7 +105,12 @@ void DLL_CALLCONV
 FreeImage_ConvertLine16To24_565(uint8_t *target, uint8_t *source, int width_in_pixels) {
 	uint16_t *bits = (uint16_t *)source;
 
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	int cols = 0;
+	if (const auto kernel = FreeImage_GetLineConversionKernels().line16To24_565) {
+		cols = kernel(target, source, width_in_pixels);
+		target += 3 * cols;
+	}
+	for (; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_RED]   = (uint8_t)((((bits[cols] & FI16_565_RED_MASK) >> FI16_565_RED_SHIFT) * 0xFF) / 0x1F);
 		target[FI_RGBA_GREEN] = (uint8_t)((((bits[cols] & FI16_565_GREEN_MASK) >> FI16_565_GREEN_SHIFT) * 0xFF) / 0x3F);
 		target[FI_RGBA_BLUE]  = (uint8_t)((((bits[cols] & FI16_565_BLUE_MASK) >> FI16_565_BLUE_SHIFT) * 0xFF) / 0x1F);
@@ -105,7 +121,13 @@ FreeImage_ConvertLine16To24_565(uint8_t *target, uint8_t *source, int width_in_p
 
 void DLL_CALLCONV
 FreeImage_ConvertLine32To24(uint8_t *target, uint8_t *source, int width_in_pixels) {
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	int cols = 0;
+	if (const auto kernel = FreeImage_GetLineConversionKernels().line32To24) {
+		cols = kernel(target, source, width_in_pixels);
+		target += 3 * cols;
+		source += 4 * cols;
+	}
+	for (; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_BLUE] = source[FI_RGBA_BLUE];
 		target[FI_RGBA_GREEN] = source[FI_RGBA_GREEN];
 		target[FI_RGBA_RED] = source[FI_RGBA_RED];
@@ -202,9 +224,9 @@ FreeImage_ConvertTo24Bits(FIBITMAP *dib) {
 		// copy metadata from src to dst
 		FreeImage_CloneMetadata(new_dib, dib);
 
-		const unsigned src_pitch = FreeImage_GetPitch(dib);
+		const int src_stride = FreeImage_GetScanLineStride(dib);
 		const unsigned dst_pitch = FreeImage_GetPitch(new_dib);
-		const uint8_t *src_bits = FreeImage_GetBits(dib);
+		const uint8_t *src_bits = FreeImage_GetScanLine(dib, 0);
 		uint8_t *dst_bits = FreeImage_GetBits(new_dib);
 		for (int rows = 0; rows < height; rows++) {
 			const FIRGB16 *src_pixel = (FIRGB16*)src_bits;
@@ -214,7 +236,7 @@ FreeImage_ConvertTo24Bits(FIBITMAP *dib) {
 				dst_pixel[cols].green = (uint8_t)(src_pixel[cols].green >> 8);
 				dst_pixel[cols].blue  = (uint8_t)(src_pixel[cols].blue  >> 8);
 			}
-			src_bits += src_pitch;
+			src_bits += src_stride;
 			dst_bits += dst_pitch;
 		}
 
@@ -229,9 +251,9 @@ FreeImage_ConvertTo24Bits(FIBITMAP *dib) {
 		// copy metadata from src to dst
 		FreeImage_CloneMetadata(new_dib, dib);
 
-		const unsigned src_pitch = FreeImage_GetPitch(dib);
+		const int src_stride = FreeImage_GetScanLineStride(dib);
 		const unsigned dst_pitch = FreeImage_GetPitch(new_dib);
-		const uint8_t *src_bits = FreeImage_GetBits(dib);
+		const uint8_t *src_bits = FreeImage_GetScanLine(dib, 0);
 		uint8_t *dst_bits = FreeImage_GetBits(new_dib);
 		for (int rows = 0; rows < height; rows++) {
 			const FIRGBA16 *src_pixel = (FIRGBA16*)src_bits;
@@ -241,7 +263,7 @@ FreeImage_ConvertTo24Bits(FIBITMAP *dib) {
 				dst_pixel[cols].green = (uint8_t)(src_pixel[cols].green >> 8);
 				dst_pixel[cols].blue  = (uint8_t)(src_pixel[cols].blue  >> 8);
 			}
-			src_bits += src_pitch;
+			src_bits += src_stride;
 			dst_bits += dst_pitch;
 		}
 
@@ -24,6 +24,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ConversionSIMD.h"
 
 // ----------------------------------------------------------
 //  internal conversions X to 32 bits
@@ -54,7 +55,12 @@ FreeImage_ConvertLine4To32(uint8_t *target, uint8_t *source, int width_in_pixels
 
 void DLL_CALLCONV
 FreeImage_ConvertLine8To32(uint8_t *target, uint8_t *source, int width_in_pixels, FIRGBA8 *palette) {
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	int cols = 0;
+	if (const auto kernel = FreeImage_GetLineConversionKernels().line8To32) {
+		cols = kernel(target, source, width_in_pixels, palette);
+		target += 4 * cols;
+	}
+	for (; cols < width_in_pixels; cols++) {
 		const uint8_t idx = source[cols];
 
 		target[FI_RGBA_BLUE]	= palette[idx].blue;
@@ -69,7 +75,12 @@ void DLL_CALLCONV
 FreeImage_ConvertLine16To32_555(uint8_t *target, uint8_t *source, int width_in_pixels) {
 	uint16_t *bits = (uint16_t *)source;
 
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	int cols = 0;
+	if (const auto kernel = FreeImage_GetLineConversionKernels().line16To32_555) {
+		cols = kernel(target, source, width_in_pixels);
+		target += 4 * cols;
+	}
+	for (; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_RED]   = (uint8_t)((((bits[cols] & FI16_555_RED_MASK) >> FI16_555_RED_SHIFT) * 0xFF) / 0x1F);
 		target[FI_RGBA_GREEN] = (uint8_t)((((bits[cols] & FI16_555_GREEN_MASK) >> FI16_555_GREEN_SHIFT) * 0xFF) / 0x1F);
 		target[FI_RGBA_BLUE]  = (uint8_t)((((bits[cols] & FI16_555_BLUE_MASK) >> FI16_555_BLUE_SHIFT) * 0xFF) / 0x1F);
@@ -82,7 +93,12 @@ void DLL_CALLCONV
 FreeImage_ConvertLine16To32_565(uint8_t *target, uint8_t *source, int width_in_pixels) {
 	uint16_t *bits = (uint16_t *)source;
 
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	int cols = 0;
+	if (const auto kernel = FreeImage_GetLineConversionKernels().line16To32_565) {
+		cols = kernel(target, source, width_in_pixels);
+		target += 4 * cols;
+	}
+	for (; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_RED]   = (uint8_t)((((bits[cols] & FI16_565_RED_MASK) >> FI16_565_RED_SHIFT) * 0xFF) / 0x1F);
 		target[FI_RGBA_GREEN] = (uint8_t)((((bits[cols] & FI16_565_GREEN_MASK) >> FI16_565_GREEN_SHIFT) * 0xFF) / 0x3F);
 		target[FI_RGBA_BLUE]  = (uint8_t)((((bits[cols] & FI16_565_BLUE_MASK) >> FI16_565_BLUE_SHIFT) * 0xFF) / 0x1F);
@@ -107,7 +123,13 @@ The bug occurs in release mode only, when the image height is equal to 537
 */
 void DLL_CALLCONV
 FreeImage_ConvertLine24To32(uint8_t *target, uint8_t *source, int width_in_pixels) {
-	for (int cols = 0; cols < width_in_pixels; cols++) {
+	int cols = 0;
+	if (const auto kernel = FreeImage_GetLineConversionKernels().line24To32) {
+		cols = kernel(target, source, width_in_pixels);
+		target += 4 * cols;
+		source += 3 * cols;
+	}
+	for (; cols < width_in_pixels; cols++) {
 		target[FI_RGBA_RED]   = source[FI_RGBA_RED];
 		target[FI_RGBA_GREEN] = source[FI_RGBA_GREEN];
 		target[FI_RGBA_BLUE]  = source[FI_RGBA_BLUE];
@@ -298,9 +320,9 @@ FreeImage_ConvertTo32Bits(FIBITMAP *dib) {
 		// copy metadata from src to dst
 		FreeImage_CloneMetadata(new_dib, dib);
 
-		const unsigned src_pitch = FreeImage_GetPitch(dib);
+		const int src_stride = FreeImage_GetScanLineStride(dib);
 		const unsigned dst_pitch = FreeImage_GetPitch(new_dib);
-		const uint8_t *src_bits = FreeImage_GetBits(dib);
+		const uint8_t *src_bits = FreeImage_GetScanLine(dib, 0);
 		uint8_t *dst_bits = FreeImage_GetBits(new_dib);
 		for (int rows = 0; rows < height; rows++) {
 			const FIRGB16 *src_pixel = (FIRGB16*)src_bits;
@@ -311,7 +333,7 @@ FreeImage_ConvertTo32Bits(FIBITMAP *dib) {
 				dst_pixel[cols].blue		= (uint8_t)(src_pixel[cols].blue  >> 8);
 				dst_pixel[cols].alpha = (uint8_t)0xFF;
 			}
-			src_bits += src_pitch;
+			src_bits += src_stride;
 			dst_bits += dst_pitch;
 		}
 
@@ -326,9 +348,9 @@ FreeImage_ConvertTo32Bits(FIBITMAP *dib) {
 		// copy metadata from src to dst
 		FreeImage_CloneMetadata(new_dib, dib);
 
-		const unsigned src_pitch = FreeImage_GetPitch(dib);
+		const int src_stride = FreeImage_GetScanLineStride(dib);
 		const unsigned dst_pitch = FreeImage_GetPitch(new_dib);
-		const uint8_t *src_bits = FreeImage_GetBits(dib);
+		const uint8_t *src_bits = FreeImage_GetScanLine(dib, 0);
 		uint8_t *dst_bits = FreeImage_GetBits(new_dib);
 		for (int rows = 0; rows < height; rows++) {
 			const FIRGBA16 *src_pixel = (FIRGBA16*)src_bits;
@@ -339,7 +361,7 @@ FreeImage_ConvertTo32Bits(FIBITMAP *dib) {
 				dst_pixel[cols].blue		= (uint8_t)(src_pixel[cols].blue  >> 8);
 				dst_pixel[cols].alpha = (uint8_t)(src_pixel[cols].alpha >> 8);
 			}
-			src_bits += src_pitch;
+			src_bits += src_stride;
 			dst_bits += dst_pitch;
 		}
 
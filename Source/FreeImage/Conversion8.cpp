@@ -25,6 +25,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ConversionSIMD.h"
 
 // ----------------------------------------------------------
 //  internal conversions X to 8 bits
@@ -32,7 +33,11 @@
 
 void DLL_CALLCONV
 FreeImage_ConvertLine1To8(uint8_t *target, uint8_t *source, int width_in_pixels) {
-	for (unsigned cols = 0; cols < (unsigned)width_in_pixels; cols++)
+	unsigned cols = 0;
+	if (const auto kernel = FreeImage_GetLineConversionKernels().line1To8) {
+		cols = (unsigned)kernel(target, source, width_in_pixels);
+	}
+	for (; cols < (unsigned)width_in_pixels; cols++)
 		target[cols] = (source[cols >> 3] & (0x80 >> (cols & 0x07))) != 0 ? 255 : 0;	
 }
 
@@ -199,9 +204,9 @@ FreeImage_ConvertTo8Bits(FIBITMAP *dib) {
 
 		} else if (image_type == FIT_UINT16) {
 
-			const unsigned src_pitch = FreeImage_GetPitch(dib);
+			const int src_stride = FreeImage_GetScanLineStride(dib);
 			const unsigned dst_pitch = FreeImage_GetPitch(new_dib);
-			const uint8_t *src_bits = FreeImage_GetBits(dib);
+			const uint8_t *src_bits = FreeImage_GetScanLine(dib, 0);
 			uint8_t *dst_bits = FreeImage_GetBits(new_dib);
 
 			for (unsigned rows = 0; rows < height; rows++) {
@@ -210,7 +215,7 @@ FreeImage_ConvertTo8Bits(FIBITMAP *dib) {
 				for (unsigned cols = 0; cols < width; cols++) {
 					dst_pixel[cols] = (uint8_t)(src_pixel[cols] >> 8);
 				}
-				src_bits += src_pitch;
+				src_bits += src_stride;
 				dst_bits += dst_pitch;
 			}
 			return new_dib;
@@ -252,10 +257,10 @@ FreeImage_ConvertToGreyscale(FIBITMAP *dib) {
 			pal++;
 		}
 
-		const uint8_t *src_bits = FreeImage_GetBits(dib);
+		const uint8_t *src_bits = FreeImage_GetScanLine(dib, 0);
 		uint8_t *dst_bits = FreeImage_GetBits(new_dib);
 
-		const unsigned src_pitch = FreeImage_GetPitch(dib);
+		const int src_stride = FreeImage_GetScanLineStride(dib);
 		const unsigned dst_pitch = FreeImage_GetPitch(new_dib);
 
 		switch (bpp) {
@@ -266,7 +271,7 @@ FreeImage_ConvertToGreyscale(FIBITMAP *dib) {
 						const unsigned pixel = (src_bits[x >> 3] & (0x80 >> (x & 0x07))) != 0;
 						dst_bits[x] = grey_pal[pixel];
 					}
-					src_bits += src_pitch;
+					src_bits += src_stride;
 					dst_bits += dst_pitch;
 				}
 			}
@@ -279,7 +284,7 @@ FreeImage_ConvertToGreyscale(FIBITMAP *dib) {
 						const unsigned pixel = x & 0x01 ? src_bits[x >> 1] & 0x0F : src_bits[x >> 1] >> 4;
 						dst_bits[x] = grey_pal[pixel];
 					}
-					src_bits += src_pitch;
+					src_bits += src_stride;
 					dst_bits += dst_pitch;
 				}
 			}
@@ -291,7 +296,7 @@ FreeImage_ConvertToGreyscale(FIBITMAP *dib) {
 					for (unsigned x = 0; x < width; x++) {
 						dst_bits[x] = grey_pal[src_bits[x]];
 					}
-					src_bits += src_pitch;
+					src_bits += src_stride;
 					dst_bits += dst_pitch;
 				}
 			}
@@ -90,122 +90,122 @@ FreeImage_ConvertToFloat(FIBITMAP *dib, FIBOOL scale_linear) {
 	switch (src_type) {
 		case FIT_BITMAP:
 			if (scale_linear) {
-				BitmapTransform<float, uint8_t>(dst, src, [](uint8_t v) { 
+				BitmapTransformParallel<float, uint8_t, kTransformGrainPixels, true>(dst, src, [](uint8_t v) { 
 					return static_cast<float>(v) / static_cast<float>(std::numeric_limits<uint8_t>::max()); });
 			}
 			else {
-				BitmapTransform<float, uint8_t>(dst, src, [](uint8_t v) { return static_cast<float>(v); });
+				BitmapTransformParallel<float, uint8_t, kTransformGrainPixels, true>(dst, src, [](uint8_t v) { return static_cast<float>(v); });
 			}
 			break;
 
 		case FIT_UINT16:
 			if (scale_linear) {
-				BitmapTransform<float, uint16_t>(dst, src, [](uint16_t v) { 
+				BitmapTransformParallel<float, uint16_t, kTransformGrainPixels, true>(dst, src, [](uint16_t v) { 
 					return static_cast<float>(v) / static_cast<float>(std::numeric_limits<uint16_t>::max()); });
 			}
 			else {
-				BitmapTransform<float, uint16_t>(dst, src, [](uint16_t v) { return static_cast<float>(v); });
+				BitmapTransformParallel<float, uint16_t, kTransformGrainPixels, true>(dst, src, [](uint16_t v) { return static_cast<float>(v); });
 			}
 			break;
 
 		case FIT_INT16:
 			if (scale_linear) {
-				BitmapTransform<float, int16_t>(dst, src, [](int16_t v) {
+				BitmapTransformParallel<float, int16_t, kTransformGrainPixels, true>(dst, src, [](int16_t v) {
 					return static_cast<float>(v) / static_cast<float>(std::numeric_limits<int16_t>::max()); });
 			}
 			else {
-				BitmapTransform<float, int16_t>(dst, src, [](int16_t v) { return static_cast<float>(v); });
+				BitmapTransformParallel<float, int16_t, kTransformGrainPixels, true>(dst, src, [](int16_t v) { return static_cast<float>(v); });
 			}
 			break;
 
 		case FIT_UINT32:
 			if (scale_linear) {
-				BitmapTransform<float, uint32_t>(dst, src, [](uint32_t v) {
+				BitmapTransformParallel<float, uint32_t, kTransformGrainPixels, true>(dst, src, [](uint32_t v) {
 					return static_cast<float>(static_cast<double>(v) / static_cast<double>(std::numeric_limits<uint32_t>::max())); });
 			}
 			else {
-				BitmapTransform<float, uint32_t>(dst, src, [](uint32_t v) { return static_cast<float>(v); });
+				BitmapTransformParallel<float, uint32_t, kTransformGrainPixels, true>(dst, src, [](uint32_t v) { return static_cast<float>(v); });
 			}
 			break;
 
 		case FIT_INT32:
 			if (scale_linear) {
-				BitmapTransform<float, int32_t>(dst, src, [](int32_t v) { 
+				BitmapTransformParallel<float, int32_t, kTransformGrainPixels, true>(dst, src, [](int32_t v) { 
 					return static_cast<float>(static_cast<double>(v) / static_cast<double>(std::numeric_limits<int32_t>::max())); });
 			}
 			else {
-				BitmapTransform<float, int32_t>(dst, src, [](int32_t v) { return static_cast<float>(v); });
+				BitmapTransformParallel<float, int32_t, kTransformGrainPixels, true>(dst, src, [](int32_t v) { return static_cast<float>(v); });
 			}
 			break;
 
 		case FIT_RGB32:
 			if (scale_linear) {
-				BitmapTransform<float, FIRGB32>(dst, src, [](const FIRGB32& p) {
+				BitmapTransformParallel<float, FIRGB32>(dst, src, [](const FIRGB32& p) {
 					return static_cast<float>(LUMA_REC709(p.red, p.green, p.blue) / static_cast<double>(std::numeric_limits<uint32_t>::max())); });
 			}
 			else {
-				BitmapTransform<float, FIRGB32>(dst, src, [](const FIRGB32& p) {
+				BitmapTransformParallel<float, FIRGB32>(dst, src, [](const FIRGB32& p) {
 					return LUMA_REC709(p.red, p.green, p.blue); });
 			}
 			break;
 
 		case FIT_RGBA32:
 			if (scale_linear) {
-				BitmapTransform<float, FIRGBA32>(dst, src, [](const FIRGBA32& p) {
+				BitmapTransformParallel<float, FIRGBA32>(dst, src, [](const FIRGBA32& p) {
 					return static_cast<float>(LUMA_REC709(p.red, p.green, p.blue) / static_cast<double>(std::numeric_limits<uint32_t>::max())); });
 			}
 			else {
-				BitmapTransform<float, FIRGBA32>(dst, src, [](const FIRGBA32& p) {
+				BitmapTransformParallel<float, FIRGBA32>(dst, src, [](const FIRGBA32& p) {
 					return LUMA_REC709(p.red, p.green, p.blue); });
 			}
 			break;
 
 		case FIT_RGB16:
 			if (scale_linear) {
-				BitmapTransform<float, FIRGB16>(dst, src, [](const FIRGB16& p) {
+				BitmapTransformParallel<float, FIRGB16>(dst, src, [](const FIRGB16& p) {
 					return LUMA_REC709(p.red, p.green, p.blue) / static_cast<float>(std::numeric_limits<uint16_t>::max()); });
 			}
 			else {
-				BitmapTransform<float, FIRGB16>(dst, src, [](const FIRGB16& p) {
+				BitmapTransformParallel<float, FIRGB16>(dst, src, [](const FIRGB16& p) {
 					return LUMA_REC709(p.red, p.green, p.blue); });
 			}
 			break;
 
 		case FIT_RGBA16:
 			if (scale_linear) {
-				BitmapTransform<float, FIRGBA16>(dst, src, [](const FIRGBA16& p) {
+				BitmapTransformParallel<float, FIRGBA16>(dst, src, [](const FIRGBA16& p) {
 					return LUMA_REC709(p.red, p.green, p.blue) / static_cast<float>(std::numeric_limits<uint16_t>::max()); });
 			}
 			else {
-				BitmapTransform<float, FIRGBA16>(dst, src, [](const FIRGBA16& p) {
+				BitmapTransformParallel<float, FIRGBA16>(dst, src, [](const FIRGBA16& p) {
 					return LUMA_REC709(p.red, p.green, p.blue); });
 			}
 			break;
 
 		case FIT_RGBF:
 			if (scale_linear) {
-				BitmapTransform<float, FIRGBF>(dst, src, [](const FIRGBF& p) {
+				BitmapTransformParallel<float, FIRGBF>(dst, src, [](const FIRGBF& p) {
 					return CLAMP(LUMA_REC709(p.red, p.green, p.blue), 0.0F, 1.0F); });
 			}
 			else {
-				BitmapTransform<float, FIRGBF>(dst, src, [](const FIRGBF& p) {
+				BitmapTransformParallel<float, FIRGBF>(dst, src, [](const FIRGBF& p) {
 					return LUMA_REC709(p.red, p.green, p.blue); });
 			}
 			break;
 
 		case FIT_RGBAF:
 			if (scale_linear) {
-				BitmapTransform<float, FIRGBAF>(dst, src, [](const FIRGBAF& p) {
+				BitmapTransformParallel<float, FIRGBAF>(dst, src, [](const FIRGBAF& p) {
 					return CLAMP(LUMA_REC709(p.red, p.green, p.blue), 0.0F, 1.0F); });
 			}
 			else {
-				BitmapTransform<float, FIRGBAF>(dst, src, [](const FIRGBAF& p) {
+				BitmapTransformParallel<float, FIRGBAF>(dst, src, [](const FIRGBAF& p) {
 					return LUMA_REC709(p.red, p.green, p.blue); });
 			}
 			break;
 
 		case FIT_DOUBLE:
-			BitmapTransform<float, double>(dst, src, [](double v) { return static_cast<float>(v); });
+			BitmapTransformParallel<float, double, kTransformGrainPixels, true>(dst, src, [](double v) { return static_cast<float>(v); });
 			break;
 	}
 
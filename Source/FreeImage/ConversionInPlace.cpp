@@ -0,0 +1,324 @@
+// ==========================================================
+// In-place bitmap conversion routines
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "SimpleTools.h"
+
+namespace {
+
+	/// Row converter built on a pixel operation. Source and target rows may start at the same address
+	template <typename DstPixel_, typename SrcPixel_, typename UnaryOperation_>
+	struct PixelRows
+	{
+		UnaryOperation_ op;
+
+		void operator()(uint8_t* dst, uint8_t* src, unsigned width) const {
+			UnaryOperation_ row_op = op;
+			KernelDispatch<BitmapTransformRow<DstPixel_, SrcPixel_, UnaryOperation_>>::Run(
+				static_cast<DstPixel_*>(static_cast<void*>(dst)), static_cast<const SrcPixel_*>(static_cast<const void*>(src)), width, &row_op);
+		}
+	};
+
+	template <typename DstPixel_, typename SrcPixel_, typename UnaryOperation_>
+	PixelRows<DstPixel_, SrcPixel_, UnaryOperation_> MakePixelRows(UnaryOperation_ op) {
+		static_assert(sizeof(DstPixel_) <= sizeof(SrcPixel_), "in-place conversions can't grow pixels");
+		return { op };
+	}
+
+	/// Row converter built on one of the FreeImage_ConvertLine* functions
+	struct LineRows
+	{
+		void (DLL_CALLCONV *convert)(uint8_t*, uint8_t*, int);
+
+		void operator()(uint8_t* dst, uint8_t* src, unsigned width) const {
+			convert(dst, src, static_cast<int>(width));
+		}
+	};
+
+
+	/**
+	Converts every row of dib with convert(dst, src, width) and switches dib to the (dst_type, dst_bpp) layout.
+	When the pixels shrink, a row may only be written once its target range ends before the first source row
+	not read yet. Rows are therefore converted in rounds, each round being parallel over rows whose target is
+	below the rows read by the previous rounds. The first rows, which may overlap their own source when the
+	pixels move forward to make room for a palette, are converted to a side buffer first.
+	@return Returns FALSE, leaving dib untouched, when the new layout doesn't fit
+	*/
+	template <typename RowConverter_>
+	FIBOOL ConvertRows(FIBITMAP* dib, FREE_IMAGE_TYPE dst_type, unsigned dst_bpp, RowConverter_ convert)
+	{
+		const unsigned width = FreeImage_GetWidth(dib);
+		const unsigned height = FreeImage_GetHeight(dib);
+		const size_t src_pitch = FreeImage_GetPitch(dib);
+		uint8_t* const src_bits = FreeImage_GetBits(dib);
+
+		unsigned pitch = 0;
+		uint8_t* const dst_bits = FreeImage_GetInternalLayoutBits(dib, dst_type, dst_bpp, &pitch);
+		if (!dst_bits) {
+			return FALSE;
+		}
+		const size_t dst_pitch = pitch;
+		const size_t dst_line = CalculateLine(width, dst_bpp);
+		const size_t grain_rows = std::max<size_t>(1, kTransformGrainPixels / std::max(width, 1U));
+
+		if ((dst_bits == src_bits) && (dst_pitch == src_pitch)) {
+			if (dst_line == FreeImage_GetLine(dib)) {
+				// same pixel size: every pixel is rewritten where it is
+				ThreadPool::Instance().parallelFor(0, height, grain_rows, [&](size_t first, size_t last) {
+					for (size_t y = first; y < last; ++y) {
+						convert(src_bits + y * src_pitch, src_bits + y * src_pitch, width);
+					}
+				});
+			}
+			else {
+				// user provided buffer, or rows shrinking within their padding: rows are shrunk through a line buffer
+				std::unique_ptr<uint8_t[]> line(new(std::nothrow) uint8_t[dst_line]);
+				if (!line) {
+					return FALSE;
+				}
+				for (size_t y = 0; y < height; ++y) {
+					convert(line.get(), src_bits + y * src_pitch, width);
+					memcpy(src_bits + y * src_pitch, line.get(), dst_line);
+				}
+			}
+			if ((dst_type != FreeImage_GetImageType(dib)) || (dst_bpp != FreeImage_GetBPP(dib))) {
+				FreeImage_SetInternalLayout(dib, dst_type, dst_bpp);
+			}
+			return TRUE;
+		}
+
+		if (dst_pitch >= src_pitch) {
+			return FALSE;
+		}
+
+		// rows [0, done) have been read; a round may convert rows [done, next) when
+		// shift + next * dst_pitch <= done * src_pitch, which makes progress once
+		// done * (src_pitch - dst_pitch) >= shift + dst_pitch
+		const ptrdiff_t shift = dst_bits - src_bits;
+
+		size_t held = 1;
+		while ((held < height) && (static_cast<ptrdiff_t>(held * (src_pitch - dst_pitch)) < shift + static_cast<ptrdiff_t>(dst_pitch))) {
+			++held;
+		}
+
+		std::unique_ptr<uint8_t[]> held_rows(new(std::nothrow) uint8_t[held * dst_line]);
+		if (!held_rows) {
+			return FALSE;
+		}
+		for (size_t y = 0; y < held; ++y) {
+			convert(held_rows.get() + y * dst_line, src_bits + y * src_pitch, width);
+		}
+		for (size_t y = 0; y < held; ++y) {
+			memcpy(dst_bits + y * dst_pitch, held_rows.get() + y * dst_line, dst_line);
+		}
+
+		for (size_t done = held; done < height; ) {
+			const size_t next = std::min<size_t>(height, static_cast<size_t>(static_cast<ptrdiff_t>(done * src_pitch) - shift) / dst_pitch);
+			assert(next > done);
+
+			ThreadPool::Instance().parallelFor(done, next, grain_rows, [&](size_t first, size_t last) {
+				for (size_t y = first; y < last; ++y) {
+					convert(dst_bits + y * dst_pitch, src_bits + y * src_pitch, width);
+				}
+			});
+			done = next;
+		}
+
+		FreeImage_SetInternalLayout(dib, dst_type, dst_bpp);
+		return TRUE;
+	}
+
+	template <typename DstPixel_, typename SrcPixel_, typename UnaryOperation_>
+	FIBOOL ConvertPixels(FIBITMAP* dib, FREE_IMAGE_TYPE dst_type, UnaryOperation_ op)
+	{
+		return ConvertRows(dib, dst_type, 8 * sizeof(DstPixel_), MakePixelRows<DstPixel_, SrcPixel_>(op));
+	}
+
+	template <typename Pixel_>
+	FIBOOL SwapPixels(FIBITMAP* dib)
+	{
+		return ConvertPixels<Pixel_, Pixel_>(dib, FreeImage_GetImageType(dib), [](const Pixel_& p) {
+			Pixel_ q = p;
+			q.red = p.blue;
+			q.blue = p.red;
+			return q;
+		});
+	}
+
+	template <typename Pixel_>
+	float Clamp01(Pixel_ v) {
+		return CLAMP(static_cast<float>(v), 0.0F, 1.0F);
+	}
+
+
+	FIBOOL DropAlpha(FIBITMAP* dib)
+	{
+		switch (FreeImage_GetImageType(dib)) {
+			case FIT_BITMAP:
+				if (FreeImage_GetBPP(dib) != 32) {
+					return FALSE;
+				}
+				return ConvertRows(dib, FIT_BITMAP, 24, LineRows{ FreeImage_ConvertLine32To24 });
+
+			case FIT_RGBA16:
+				return ConvertPixels<FIRGB16, FIRGBA16>(dib, FIT_RGB16, [](const FIRGBA16& p) {
+					return FIRGB16{ p.red, p.green, p.blue }; });
+
+			case FIT_RGBA32:
+				return ConvertPixels<FIRGB32, FIRGBA32>(dib, FIT_RGB32, [](const FIRGBA32& p) {
+					return FIRGB32{ p.red, p.green, p.blue }; });
+
+			case FIT_RGBAF:
+				// same clamping as FreeImage_ConvertToRGBF
+				return ConvertPixels<FIRGBF, FIRGBAF>(dib, FIT_RGBF, [](const FIRGBAF& p) {
+					return FIRGBF{ Clamp01(p.red), Clamp01(p.green), Clamp01(p.blue) }; });
+
+			default:
+				return FALSE;
+		}
+	}
+
+	FIBOOL ToGreyscale(FIBITMAP* dib)
+	{
+		switch (FreeImage_GetImageType(dib)) {
+			case FIT_BITMAP:
+				switch (FreeImage_GetBPP(dib)) {
+					case 24:
+						return ConvertRows(dib, FIT_BITMAP, 8, LineRows{ FreeImage_ConvertLine24To8 });
+					case 32:
+						return ConvertRows(dib, FIT_BITMAP, 8, LineRows{ FreeImage_ConvertLine32To8 });
+					default:
+						return FALSE;
+				}
+
+			case FIT_RGB16:
+				return ConvertPixels<uint16_t, FIRGB16>(dib, FIT_UINT16, [](const FIRGB16& p) {
+					return static_cast<uint16_t>(LUMA_REC709(p.red, p.green, p.blue)); });
+
+			case FIT_RGBA16:
+				return ConvertPixels<uint16_t, FIRGBA16>(dib, FIT_UINT16, [](const FIRGBA16& p) {
+					return static_cast<uint16_t>(LUMA_REC709(p.red, p.green, p.blue)); });
+
+			default:
+				return FALSE;
+		}
+	}
+
+	/// Same results as FreeImage_ConvertToFloat(dib, TRUE), FIT_FLOAT images are left unchanged
+	FIBOOL ToFloat(FIBITMAP* dib)
+	{
+		constexpr double max_uint32 = std::numeric_limits<uint32_t>::max();
+
+		switch (FreeImage_GetImageType(dib)) {
+			case FIT_FLOAT:
+				// already float: nothing to convert, as FreeImage_ConvertToFloat returns a plain clone
+				return TRUE;
+
+			case FIT_DOUBLE:
+				return ConvertPixels<float, double>(dib, FIT_FLOAT, [](double v) { return static_cast<float>(v); });
+
+			case FIT_UINT32:
+				return ConvertPixels<float, uint32_t>(dib, FIT_FLOAT, [](uint32_t v) {
+					return static_cast<float>(static_cast<double>(v) / max_uint32); });
+
+			case FIT_INT32:
+				return ConvertPixels<float, int32_t>(dib, FIT_FLOAT, [](int32_t v) {
+					return static_cast<float>(static_cast<double>(v) / static_cast<double>(std::numeric_limits<int32_t>::max())); });
+
+			case FIT_RGB16:
+				return ConvertPixels<float, FIRGB16>(dib, FIT_FLOAT, [](const FIRGB16& p) {
+					return LUMA_REC709(p.red, p.green, p.blue) / static_cast<float>(std::numeric_limits<uint16_t>::max()); });
+
+			case FIT_RGBA16:
+				return ConvertPixels<float, FIRGBA16>(dib, FIT_FLOAT, [](const FIRGBA16& p) {
+					return LUMA_REC709(p.red, p.green, p.blue) / static_cast<float>(std::numeric_limits<uint16_t>::max()); });
+
+			case FIT_RGB32:
+				return ConvertPixels<float, FIRGB32>(dib, FIT_FLOAT, [](const FIRGB32& p) {
+					return static_cast<float>(LUMA_REC709(p.red, p.green, p.blue) / max_uint32); });
+
+			case FIT_RGBA32:
+				return ConvertPixels<float, FIRGBA32>(dib, FIT_FLOAT, [](const FIRGBA32& p) {
+					return static_cast<float>(LUMA_REC709(p.red, p.green, p.blue) / max_uint32); });
+
+			case FIT_RGBF:
+				return ConvertPixels<float, FIRGBF>(dib, FIT_FLOAT, [](const FIRGBF& p) {
+					return Clamp01(LUMA_REC709(p.red, p.green, p.blue)); });
+
+			case FIT_RGBAF:
+				return ConvertPixels<float, FIRGBAF>(dib, FIT_FLOAT, [](const FIRGBAF& p) {
+					return Clamp01(LUMA_REC709(p.red, p.green, p.blue)); });
+
+			default:
+				return FALSE;
+		}
+	}
+
+	FIBOOL SwapRedBlue(FIBITMAP* dib)
+	{
+		switch (FreeImage_GetImageType(dib)) {
+			case FIT_BITMAP:
+				switch (FreeImage_GetBPP(dib)) {
+					case 24:
+						return SwapPixels<FIRGB8>(dib);
+					case 32:
+						return SwapPixels<FIRGBA8>(dib);
+					default:
+						return FALSE;
+				}
+			case FIT_RGB16:
+				return SwapPixels<FIRGB16>(dib);
+			case FIT_RGBA16:
+				return SwapPixels<FIRGBA16>(dib);
+			case FIT_RGB32:
+				return SwapPixels<FIRGB32>(dib);
+			case FIT_RGBA32:
+				return SwapPixels<FIRGBA32>(dib);
+			case FIT_RGBF:
+				return SwapPixels<FIRGBF>(dib);
+			case FIT_RGBAF:
+				return SwapPixels<FIRGBAF>(dib);
+			default:
+				return FALSE;
+		}
+	}
+
+} // namespace
+
+// ----------------------------------------------------------
+
+FIBOOL DLL_CALLCONV
+FreeImage_ConvertInPlace(FIBITMAP* dib, FREE_IMAGE_INPLACE_CONVERSION target) {
+	if (!FreeImage_HasPixels(dib)) {
+		return FALSE;
+	}
+
+	switch (target) {
+		case FIINPLACE_DROP_ALPHA:
+			return DropAlpha(dib);
+		case FIINPLACE_GREYSCALE:
+			return ToGreyscale(dib);
+		case FIINPLACE_FLOAT:
+			return ToFloat(dib);
+		case FIINPLACE_SWAP_RED_BLUE:
+			return SwapRedBlue(dib);
+		default:
+			return FALSE;
+	}
+}
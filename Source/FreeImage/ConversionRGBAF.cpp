@@ -102,6 +102,9 @@ FreeImage_ConvertToRGBAF(FIBITMAP *dib) {
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(dst, src);
 
+	// the pixels are converted in memory order: keep the scanline order of src
+	FreeImage_SetTopDown(dst, FreeImage_IsTopDown(src));
+
 	// convert from src type to RGBAF
 
 	const unsigned src_pitch = FreeImage_GetPitch(src);
@@ -21,6 +21,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "SimpleTools.h"
 
 // ----------------------------------------------------------
 //   smart convert X to RGBF
@@ -105,6 +106,9 @@ FreeImage_ConvertToRGBF(FIBITMAP *dib) {
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(dst, src);
 
+	// the pixels are converted in memory order: keep the scanline order of src
+	FreeImage_SetTopDown(dst, FreeImage_IsTopDown(src));
+
 	// convert from src type to RGBF
 
 	const unsigned src_pitch = FreeImage_GetPitch(src);
@@ -138,68 +142,26 @@ FreeImage_ConvertToRGBF(FIBITMAP *dib) {
 		break;
 
 		case FIT_UINT16:
-		{
-			auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
-			auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
-
-			for (unsigned y = 0; y < height; y++) {
-				auto *src_pixel = (const uint16_t*)src_bits;
-				auto *dst_pixel = (FIRGBF*)dst_bits;
-
-				for (unsigned x = 0; x < width; x++) {
-					// convert and scale to the range [0..1]
-					const float dst_value = (float)src_pixel[x] / 65535.0F;
-					dst_pixel[x].red   = dst_value;
-					dst_pixel[x].green = dst_value;
-					dst_pixel[x].blue  = dst_value;
-				}
-				src_bits += src_pitch;
-				dst_bits += dst_pitch;
-			}
-		}
-		break;
+			BitmapTransformParallel<FIRGBF, uint16_t, kTransformGrainPixels, true>(dst, src, [](uint16_t v) {
+				// convert and scale to the range [0..1]
+				const float dst_value = (float)v / 65535.0F;
+				return FIRGBF{ dst_value, dst_value, dst_value };
+			});
+			break;
 
 		case FIT_RGB16:
-		{
-			auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
-			auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
-
-			for (unsigned y = 0; y < height; y++) {
-				auto *src_pixel = (const FIRGB16*)src_bits;
-				auto *dst_pixel = (FIRGBF*)dst_bits;
-
-				for (unsigned x = 0; x < width; x++) {
-					// convert and scale to the range [0..1]
-					dst_pixel[x].red   = (float)(src_pixel[x].red)   / 65535.0F;
-					dst_pixel[x].green = (float)(src_pixel[x].green) / 65535.0F;
-					dst_pixel[x].blue  = (float)(src_pixel[x].blue)  / 65535.0F;
-				}
-				src_bits += src_pitch;
-				dst_bits += dst_pitch;
-			}
-		}
-		break;
+			BitmapTransformParallel<FIRGBF, FIRGB16, kTransformGrainPixels, true>(dst, src, [](const FIRGB16& p) {
+				// convert and scale to the range [0..1]
+				return FIRGBF{ (float)(p.red) / 65535.0F, (float)(p.green) / 65535.0F, (float)(p.blue) / 65535.0F };
+			});
+			break;
 
 		case FIT_RGBA16:
-		{
-			auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
-			auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
-
-			for (unsigned y = 0; y < height; y++) {
-				auto *src_pixel = (const FIRGBA16*)src_bits;
-				auto *dst_pixel = (FIRGBF*)dst_bits;
-
-				for (unsigned x = 0; x < width; x++) {
-					// convert and scale to the range [0..1]
-					dst_pixel[x].red   = (float)(src_pixel[x].red)   / 65535.0F;
-					dst_pixel[x].green = (float)(src_pixel[x].green) / 65535.0F;
-					dst_pixel[x].blue  = (float)(src_pixel[x].blue)  / 65535.0F;
-				}
-				src_bits += src_pitch;
-				dst_bits += dst_pitch;
-			}
-		}
-		break;
+			BitmapTransformParallel<FIRGBF, FIRGBA16, kTransformGrainPixels, true>(dst, src, [](const FIRGBA16& p) {
+				// convert and scale to the range [0..1]
+				return FIRGBF{ (float)(p.red) / 65535.0F, (float)(p.green) / 65535.0F, (float)(p.blue) / 65535.0F };
+			});
+			break;
 
 		case FIT_RGB32:
 		{
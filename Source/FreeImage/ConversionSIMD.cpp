@@ -0,0 +1,372 @@
+// ==========================================================
+// Vectorized line conversion kernels
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "CPUFeatures.h"
+#include "ConversionSIMD.h"
+
+#if defined(FI_SIMD_X86)
+#include <immintrin.h>
+#elif defined(FI_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+// ----------------------------------------------------------
+//   Notes
+//
+// The kernels only rely on the byte layout of the pixels: FI_RGBA_ALPHA is always
+// byte 3 on little endian machines, the other channels are copied as they are
+// except for the 16-bit formats which place them at FI_RGBA_RED / FI_RGBA_BLUE,
+// and for the palette lookups: FIRGBA8 entries are always stored red, green, blue,
+// so their bytes are shuffled to the FI_RGBA_* positions.
+//
+// 5 and 6-bit channels are expanded with (v * 255) / 31 and (v * 255) / 63 in the
+// scalar code. For every input value these equal (v * 1053) >> 7 and (v * 259 + 3) >> 6,
+// which fit in 16-bit lanes.
+// ----------------------------------------------------------
+
+#if defined(FI_SIMD_X86)
+
+namespace {
+
+// ----------------------------------------------------------
+//   SSE2
+// ----------------------------------------------------------
+
+FI_TARGET("sse2") int
+Line1To8_SSE2(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	const __m128i bits = _mm_setr_epi8((char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, (char)0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+	int cols = 0;
+	for (; cols + 16 <= width_in_pixels; cols += 16) {
+		const uint8_t *src = source + (cols >> 3);
+		__m128i v = _mm_cvtsi32_si128(src[0] | (src[1] << 8));
+		// spread each source byte over 8 lanes
+		v = _mm_unpacklo_epi8(v, v);
+		v = _mm_unpacklo_epi16(v, v);
+		v = _mm_unpacklo_epi32(v, v);
+		v = _mm_cmpeq_epi8(_mm_and_si128(v, bits), bits);
+		_mm_storeu_si128((__m128i *)(target + cols), v);
+	}
+	return cols;
+}
+
+/// Expands 8 16-bit pixels into 8 32-bit pixels with an opaque alpha
+template <bool is565>
+FI_TARGET("sse2") inline void
+Expand16To32(__m128i v, __m128i& lo, __m128i& hi) {
+	const __m128i mask5 = _mm_set1_epi16(0x1F);
+	const __m128i mul5 = _mm_set1_epi16(1053);
+
+	__m128i r, g;
+	if (is565) {
+		r = _mm_srli_epi16(v, FI16_565_RED_SHIFT);
+		g = _mm_and_si128(_mm_srli_epi16(v, FI16_565_GREEN_SHIFT), _mm_set1_epi16(0x3F));
+		g = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(g, _mm_set1_epi16(259)), _mm_set1_epi16(3)), 6);
+	} else {
+		r = _mm_and_si128(_mm_srli_epi16(v, FI16_555_RED_SHIFT), mask5);
+		g = _mm_and_si128(_mm_srli_epi16(v, FI16_555_GREEN_SHIFT), mask5);
+		g = _mm_srli_epi16(_mm_mullo_epi16(g, mul5), 7);
+	}
+	__m128i b = _mm_and_si128(v, mask5);
+	r = _mm_srli_epi16(_mm_mullo_epi16(r, mul5), 7);
+	b = _mm_srli_epi16(_mm_mullo_epi16(b, mul5), 7);
+
+	// bytes 0 and 2 of a pixel, green is byte 1 and alpha byte 3 in both color orders
+	const __m128i c0 = (FI_RGBA_BLUE == 0) ? b : r;
+	const __m128i c2 = (FI_RGBA_BLUE == 0) ? r : b;
+
+	const __m128i low = _mm_or_si128(c0, _mm_slli_epi16(g, 8));
+	const __m128i high = _mm_or_si128(c2, _mm_set1_epi16((short)0xFF00));
+	lo = _mm_unpacklo_epi16(low, high);
+	hi = _mm_unpackhi_epi16(low, high);
+}
+
+template <bool is565>
+FI_TARGET("sse2") int
+Line16To32_SSE2(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	int cols = 0;
+	for (; cols + 8 <= width_in_pixels; cols += 8) {
+		__m128i lo, hi;
+		Expand16To32<is565>(_mm_loadu_si128((const __m128i *)(source + 2 * cols)), lo, hi);
+		_mm_storeu_si128((__m128i *)(target + 4 * cols), lo);
+		_mm_storeu_si128((__m128i *)(target + 4 * cols + 16), hi);
+	}
+	return cols;
+}
+
+// ----------------------------------------------------------
+//   SSSE3
+// ----------------------------------------------------------
+
+/// pshufb mask expanding 4 packed 24-bit pixels to 32-bit ones (alpha byte left to zero)
+FI_TARGET("ssse3") inline __m128i
+Expand24Mask() {
+	return _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+}
+
+/// pshufb mask packing 4 32-bit pixels into the 12 low bytes
+FI_TARGET("ssse3") inline __m128i
+Pack24Mask() {
+	return _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+}
+
+FI_TARGET("ssse3") int
+Line24To32_SSSE3(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	const __m128i expand = Expand24Mask();
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+
+	int cols = 0;
+	for (; cols + 16 <= width_in_pixels; cols += 16) {
+		const uint8_t *src = source + 3 * cols;
+		uint8_t *dst = target + 4 * cols;
+
+		const __m128i a = _mm_loadu_si128((const __m128i *)src);
+		const __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+		const __m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+
+		const __m128i p0 = a;
+		const __m128i p1 = _mm_alignr_epi8(b, a, 12);
+		const __m128i p2 = _mm_alignr_epi8(c, b, 8);
+		const __m128i p3 = _mm_srli_si128(c, 4);
+
+		_mm_storeu_si128((__m128i *)dst, _mm_or_si128(_mm_shuffle_epi8(p0, expand), alpha));
+		_mm_storeu_si128((__m128i *)(dst + 16), _mm_or_si128(_mm_shuffle_epi8(p1, expand), alpha));
+		_mm_storeu_si128((__m128i *)(dst + 32), _mm_or_si128(_mm_shuffle_epi8(p2, expand), alpha));
+		_mm_storeu_si128((__m128i *)(dst + 48), _mm_or_si128(_mm_shuffle_epi8(p3, expand), alpha));
+	}
+	return cols;
+}
+
+FI_TARGET("ssse3") int
+Line32To24_SSSE3(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	const __m128i pack = Pack24Mask();
+
+	int cols = 0;
+	for (; cols + 16 <= width_in_pixels; cols += 16) {
+		const uint8_t *src = source + 4 * cols;
+		uint8_t *dst = target + 3 * cols;
+
+		const __m128i s0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src), pack);
+		const __m128i s1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 16)), pack);
+		const __m128i s2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 32)), pack);
+		const __m128i s3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 48)), pack);
+
+		_mm_storeu_si128((__m128i *)dst, _mm_or_si128(s0, _mm_slli_si128(s1, 12)));
+		_mm_storeu_si128((__m128i *)(dst + 16), _mm_or_si128(_mm_srli_si128(s1, 4), _mm_slli_si128(s2, 8)));
+		_mm_storeu_si128((__m128i *)(dst + 32), _mm_or_si128(_mm_srli_si128(s2, 8), _mm_slli_si128(s3, 4)));
+	}
+	return cols;
+}
+
+template <bool is565>
+FI_TARGET("ssse3") int
+Line16To24_SSSE3(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	const __m128i pack = Pack24Mask();
+
+	int cols = 0;
+	for (; cols + 8 <= width_in_pixels; cols += 8) {
+		__m128i lo, hi;
+		Expand16To32<is565>(_mm_loadu_si128((const __m128i *)(source + 2 * cols)), lo, hi);
+		lo = _mm_shuffle_epi8(lo, pack);
+		hi = _mm_shuffle_epi8(hi, pack);
+
+		uint8_t *dst = target + 3 * cols;
+		_mm_storeu_si128((__m128i *)dst, _mm_or_si128(lo, _mm_slli_si128(hi, 12)));
+		_mm_storel_epi64((__m128i *)(dst + 16), _mm_srli_si128(hi, 4));
+	}
+	return cols;
+}
+
+// ----------------------------------------------------------
+//   AVX2
+// ----------------------------------------------------------
+
+FI_TARGET("avx2") int
+Line24To32_AVX2(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	// pixels 0-3 go to the low lane, pixels 4-7 (starting at byte 12) to the high lane
+	const __m256i spread = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+	const __m256i expand = _mm256_setr_epi8(
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+
+	int cols = 0;
+	// a 32-byte load covers 10.67 pixels, stay inside the line
+	for (; cols + 11 <= width_in_pixels; cols += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(source + 3 * cols));
+		v = _mm256_permutevar8x32_epi32(v, spread);
+		v = _mm256_or_si256(_mm256_shuffle_epi8(v, expand), alpha);
+		_mm256_storeu_si256((__m256i *)(target + 4 * cols), v);
+	}
+	return cols;
+}
+
+/// Byte of a FIRGBA8 palette entry that goes to byte 'pos' of a pixel
+constexpr char
+PaletteByte(int pos) {
+	return (pos == FI_RGBA_RED) ? 0 : (pos == FI_RGBA_GREEN) ? 1 : (pos == FI_RGBA_BLUE) ? 2 : 3;
+}
+
+FI_TARGET("avx2") int
+Line8To32_AVX2(uint8_t *target, const uint8_t *source, int width_in_pixels, const FIRGBA8 *palette) {
+	const __m256i order = _mm256_setr_epi8(
+		PaletteByte(0), PaletteByte(1), PaletteByte(2), -1, 4 + PaletteByte(0), 4 + PaletteByte(1), 4 + PaletteByte(2), -1,
+		8 + PaletteByte(0), 8 + PaletteByte(1), 8 + PaletteByte(2), -1, 12 + PaletteByte(0), 12 + PaletteByte(1), 12 + PaletteByte(2), -1,
+		PaletteByte(0), PaletteByte(1), PaletteByte(2), -1, 4 + PaletteByte(0), 4 + PaletteByte(1), 4 + PaletteByte(2), -1,
+		8 + PaletteByte(0), 8 + PaletteByte(1), 8 + PaletteByte(2), -1, 12 + PaletteByte(0), 12 + PaletteByte(1), 12 + PaletteByte(2), -1);
+	const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+
+	int cols = 0;
+	for (; cols + 8 <= width_in_pixels; cols += 8) {
+		const __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(source + cols)));
+		const __m256i v = _mm256_shuffle_epi8(_mm256_i32gather_epi32((const int *)palette, index, 4), order);
+		_mm256_storeu_si256((__m256i *)(target + 4 * cols), _mm256_or_si256(v, alpha));
+	}
+	return cols;
+}
+
+FI_TARGET("avx2") int
+Line8To24_AVX2(uint8_t *target, const uint8_t *source, int width_in_pixels, const FIRGBA8 *palette) {
+	const __m256i pack = _mm256_setr_epi8(
+		PaletteByte(0), PaletteByte(1), PaletteByte(2), 4 + PaletteByte(0), 4 + PaletteByte(1), 4 + PaletteByte(2),
+		8 + PaletteByte(0), 8 + PaletteByte(1), 8 + PaletteByte(2), 12 + PaletteByte(0), 12 + PaletteByte(1), 12 + PaletteByte(2), -1, -1, -1, -1,
+		PaletteByte(0), PaletteByte(1), PaletteByte(2), 4 + PaletteByte(0), 4 + PaletteByte(1), 4 + PaletteByte(2),
+		8 + PaletteByte(0), 8 + PaletteByte(1), 8 + PaletteByte(2), 12 + PaletteByte(0), 12 + PaletteByte(1), 12 + PaletteByte(2), -1, -1, -1, -1);
+
+	int cols = 0;
+	// the second 16-byte store ends 4 bytes past the 8 pixels, stay inside the line
+	for (; cols + 10 <= width_in_pixels; cols += 8) {
+		const __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(source + cols)));
+		const __m256i v = _mm256_shuffle_epi8(_mm256_i32gather_epi32((const int *)palette, index, 4), pack);
+
+		uint8_t *dst = target + 3 * cols;
+		_mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(v));
+		_mm_storeu_si128((__m128i *)(dst + 12), _mm256_extracti128_si256(v, 1));
+	}
+	return cols;
+}
+
+} // namespace
+
+#elif defined(FI_SIMD_NEON)
+
+namespace {
+
+// ----------------------------------------------------------
+//   NEON
+// ----------------------------------------------------------
+
+int
+Line1To8_NEON(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	static const uint8_t bit_values[8] = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+	const uint8x8_t bits = vld1_u8(bit_values);
+
+	int cols = 0;
+	for (; cols + 8 <= width_in_pixels; cols += 8) {
+		vst1_u8(target + cols, vtst_u8(vdup_n_u8(source[cols >> 3]), bits));
+	}
+	return cols;
+}
+
+int
+Line24To32_NEON(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	int cols = 0;
+	for (; cols + 16 <= width_in_pixels; cols += 16) {
+		const uint8x16x3_t src = vld3q_u8(source + 3 * cols);
+		uint8x16x4_t dst;
+		dst.val[0] = src.val[0];
+		dst.val[1] = src.val[1];
+		dst.val[2] = src.val[2];
+		dst.val[3] = vdupq_n_u8(0xFF);
+		vst4q_u8(target + 4 * cols, dst);
+	}
+	return cols;
+}
+
+int
+Line32To24_NEON(uint8_t *target, const uint8_t *source, int width_in_pixels) {
+	int cols = 0;
+	for (; cols + 16 <= width_in_pixels; cols += 16) {
+		const uint8x16x4_t src = vld4q_u8(source + 4 * cols);
+		uint8x16x3_t dst;
+		dst.val[0] = src.val[0];
+		dst.val[1] = src.val[1];
+		dst.val[2] = src.val[2];
+		vst3q_u8(target + 3 * cols, dst);
+	}
+	return cols;
+}
+
+} // namespace
+
+#endif // FI_SIMD_X86
+
+// ----------------------------------------------------------
+
+const LineConversionKernels&
+FreeImage_GetLineConversionKernels() {
+	static const LineConversionKernels none{};
+
+#if defined(FI_SIMD_X86)
+	static const LineConversionKernels sse2 = []() {
+		LineConversionKernels k{};
+		k.line1To8 = Line1To8_SSE2;
+		k.line16To32_555 = Line16To32_SSE2<false>;
+		k.line16To32_565 = Line16To32_SSE2<true>;
+		return k;
+	}();
+	static const LineConversionKernels ssse3 = []() {
+		LineConversionKernels k = sse2;
+		k.line16To24_555 = Line16To24_SSSE3<false>;
+		k.line16To24_565 = Line16To24_SSSE3<true>;
+		k.line24To32 = Line24To32_SSSE3;
+		k.line32To24 = Line32To24_SSSE3;
+		return k;
+	}();
+	static const LineConversionKernels avx2 = []() {
+		LineConversionKernels k = ssse3;
+		k.line8To24 = Line8To24_AVX2;
+		k.line8To32 = Line8To32_AVX2;
+		k.line24To32 = Line24To32_AVX2;
+		return k;
+	}();
+
+	const unsigned features = FreeImage_GetActiveCPUFeatures();
+	if ((features & FI_CPU_SSE2) == 0) {
+		return none;
+	}
+	if ((features & FI_CPU_SSSE3) == 0) {
+		return sse2;
+	}
+	return (features & FI_CPU_AVX2) ? avx2 : ssse3;
+
+#elif defined(FI_SIMD_NEON)
+	static const LineConversionKernels neon = []() {
+		LineConversionKernels k{};
+		k.line1To8 = Line1To8_NEON;
+		k.line24To32 = Line24To32_NEON;
+		k.line32To24 = Line32To24_NEON;
+		return k;
+	}();
+
+	return (FreeImage_GetActiveCPUFeatures() & FI_CPU_NEON) ? neon : none;
+
+#else
+	return none;
+#endif
+}
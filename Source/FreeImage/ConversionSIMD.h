@@ -0,0 +1,44 @@
+// ==========================================================
+// Vectorized line conversion kernels
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef FREEIMAGE_CONVERSION_SIMD_H
+#define FREEIMAGE_CONVERSION_SIMD_H
+
+#include "FreeImage.h"
+
+/**
+Vectorized versions of the FreeImage_ConvertLine* functions for the best instruction set
+enabled on this machine. An entry is nullptr when there is no kernel for it.
+A kernel converts a prefix of the line and returns its length in pixels,
+the caller finishes the line with the scalar code. Output is bit-exact with the scalar code.
+*/
+struct LineConversionKernels {
+	int (*line1To8)(uint8_t *target, const uint8_t *source, int width_in_pixels);
+	int (*line8To24)(uint8_t *target, const uint8_t *source, int width_in_pixels, const FIRGBA8 *palette);
+	int (*line8To32)(uint8_t *target, const uint8_t *source, int width_in_pixels, const FIRGBA8 *palette);
+	int (*line16To24_555)(uint8_t *target, const uint8_t *source, int width_in_pixels);
+	int (*line16To24_565)(uint8_t *target, const uint8_t *source, int width_in_pixels);
+	int (*line16To32_555)(uint8_t *target, const uint8_t *source, int width_in_pixels);
+	int (*line16To32_565)(uint8_t *target, const uint8_t *source, int width_in_pixels);
+	int (*line24To32)(uint8_t *target, const uint8_t *source, int width_in_pixels);
+	int (*line32To24)(uint8_t *target, const uint8_t *source, int width_in_pixels);
+};
+
+const LineConversionKernels& FreeImage_GetLineConversionKernels();
+
+#endif // FREEIMAGE_CONVERSION_SIMD_H
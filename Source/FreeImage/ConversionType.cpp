@@ -20,8 +20,11 @@
 // Use at your own risk!
 // ==========================================================
 
+#include <mutex>
+
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "SimpleTools.h"
 
 // ----------------------------------------------------------
 
@@ -52,18 +55,55 @@ CONVERT_TYPE<Tdst, Tsrc>::convert(FIBITMAP *src, FREE_IMAGE_TYPE dst_type) {
 
 	// convert from src_type to dst_type
 	
-	for (unsigned y = 0; y < height; y++) {
-		const Tsrc *src_bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(src, y));
-		Tdst *dst_bits = reinterpret_cast<Tdst*>(FreeImage_GetScanLine(dst, y));
-
-		for (unsigned x = 0; x < width; x++) {
-			*dst_bits++ = static_cast<Tdst>(*src_bits++);
-		}
-	}
+	BitmapTransformParallel<Tdst, Tsrc, kTransformGrainPixels, true>(dst, src, [](Tsrc v) {
+		return static_cast<Tdst>(v);
+	});
 
 	return dst;
 }
 
+/** Find the min and max value of a greyscale image of type Tsrc, bands of rows are scanned in parallel.
+	min and max hold the initial values of the search.
+*/
+template<class Tsrc> static void
+FindMinMaxParallel(FIBITMAP *src, Tsrc &min, Tsrc &max) {
+	const unsigned width	= FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const Tsrc seed_min = min, seed_max = max;
+
+	std::mutex mutex;
+	ThreadPool::Instance().parallelFor(0, height, std::max(1U, kTransformGrainPixels / std::max(width, 1U)), [&](size_t first, size_t last) {
+		// independent lanes, so that the compiler keeps them in vector registers
+		constexpr unsigned kLanes = 16;
+		Tsrc l_min[kLanes], l_max[kLanes];
+		for (unsigned k = 0; k < kLanes; k++) {
+			l_min[k] = seed_min;
+			l_max[k] = seed_max;
+		}
+		for (size_t y = first; y < last; y++) {
+			const Tsrc *bits = reinterpret_cast<const Tsrc*>(FreeImage_GetScanLine(src, static_cast<int>(y)));
+			unsigned x = 0;
+			for (; x + kLanes <= width; x += kLanes) {
+				for (unsigned k = 0; k < kLanes; k++) {
+					const Tsrc v = bits[x + k];
+					l_min[k] = (v < l_min[k]) ? v : l_min[k];
+					l_max[k] = (v > l_max[k]) ? v : l_max[k];
+				}
+			}
+			for (; x < width; x++) {
+				const Tsrc v = bits[x];
+				l_min[0] = (v < l_min[0]) ? v : l_min[0];
+				l_max[0] = (v > l_max[0]) ? v : l_max[0];
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for (unsigned k = 0; k < kLanes; k++) {
+			if (l_min[k] < min) min = l_min[k];
+			if (l_max[k] > max) max = l_max[k];
+		}
+	});
+}
 
 /** Convert a greyscale image of type Tsrc to a 8-bit grayscale dib.
 	Conversion is done using either a linear scaling from [min, max] to [0, 255]
@@ -79,7 +119,6 @@ public:
 template<class Tsrc> FIBITMAP* 
 CONVERT_TO_BYTE<Tsrc>::convert(FIBITMAP *src, FIBOOL scale_linear) {
 	FIBITMAP *dst{};
-	unsigned x, y;
 
 	const unsigned width	= FreeImage_GetWidth(src);
 	const unsigned height = FreeImage_GetHeight(src);
@@ -100,48 +139,64 @@ CONVERT_TO_BYTE<Tsrc>::convert(FIBITMAP *src, FIBOOL scale_linear) {
 	// convert the src image to dst
 	// (FIBITMAP are stored upside down)
 	if (scale_linear) {
-		Tsrc max, min;
-		double scale;
-
 		// find the min and max value of the image
-		Tsrc l_min, l_max;
-		min = 255, max = 0;
-		for (y = 0; y < height; y++) {
-			Tsrc *bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(src, y));
-			MAXMIN(bits, width, l_max, l_min);
-			if (l_max > max) max = l_max;
-			if (l_min < min) min = l_min;
-		}
+		Tsrc min = 255, max = 0;
+		FindMinMaxParallel(src, min, max);
 		if (max == min) {
 			max = 255; min = 0;
 		}
 
 		// compute the scaling factor
-		scale = 255 / (double)(max - min);
+		const double scale = 255 / (double)(max - min);
 
 		// scale to 8-bit
-		for (y = 0; y < height; y++) {
-			Tsrc *src_bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(src, y));
-			uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
-			for (x = 0; x < width; x++) {
-				dst_bits[x] = (uint8_t)( scale * (src_bits[x] - min) + 0.5);
-			}
-		}
+		BitmapTransformParallel<uint8_t, Tsrc, kTransformGrainPixels, true>(dst, src, [scale, min](Tsrc v) {
+			return (uint8_t)( scale * (v - min) + 0.5);
+		});
 	} else {
-		for (y = 0; y < height; y++) {
-			Tsrc *src_bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(src, y));
-			uint8_t *dst_bits = FreeImage_GetScanLine(dst, y);
-			for (x = 0; x < width; x++) {
-				// rounding
-				int q = int(src_bits[x] + 0.5);
-				dst_bits[x] = (uint8_t) MIN(255, MAX(0, q));
-			}
-		}
+		BitmapTransformParallel<uint8_t, Tsrc, kTransformGrainPixels, true>(dst, src, [](Tsrc v) {
+			// rounding
+			const int q = int(v + 0.5);
+			return (uint8_t) MIN(255, MAX(0, q));
+		});
 	}
 
 	return dst;
 }
 
+/** Convert a greyscale floating point image of type Tsrc to a FIT_UINT16 dib.
+	With scale_linear, values in [0..1] are mapped to [0..65535], the inverse of FreeImage_ConvertToFloat.
+	Otherwise values are rounded. Both are clamped to [0..65535], NaN maps to 0.
+*/
+template<class Tsrc>
+class CONVERT_TO_UINT16
+{
+public:
+	FIBITMAP* convert(FIBITMAP *src, FIBOOL scale_linear);
+};
+
+template<class Tsrc> FIBITMAP* 
+CONVERT_TO_UINT16<Tsrc>::convert(FIBITMAP *src, FIBOOL scale_linear) {
+	FIBITMAP *dst{};
+
+	const unsigned width	= FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+
+	dst = FreeImage_AllocateT(FIT_UINT16, width, height);
+	if (!dst) return nullptr;
+
+	const Tsrc scale = scale_linear ? static_cast<Tsrc>(65535) : static_cast<Tsrc>(1);
+	BitmapTransformParallel<uint16_t, Tsrc, kTransformGrainPixels, true>(dst, src, [scale](Tsrc v) {
+		// NaN would pass through CLAMP unchanged
+		if (v != v) {
+			return static_cast<uint16_t>(0);
+		}
+		return static_cast<uint16_t>(CLAMP(v * scale + static_cast<Tsrc>(0.5), static_cast<Tsrc>(0), static_cast<Tsrc>(65535)));
+	});
+
+	return dst;
+}
+
 /** Convert a greyscale image of type Tsrc to a FICOMPLEX dib.
 */
 template<class Tsrc>
@@ -165,15 +220,9 @@ CONVERT_TO_COMPLEX<Tsrc>::convert(FIBITMAP *src) {
 
 	// convert from src_type to FIT_COMPLEX
 	
-	for (unsigned y = 0; y < height; y++) {
-		const Tsrc *src_bits = reinterpret_cast<Tsrc*>(FreeImage_GetScanLine(src, y));
-		FICOMPLEX *dst_bits = (FICOMPLEX *)FreeImage_GetScanLine(dst, y);
-
-		for (unsigned x = 0; x < width; x++) {
-			dst_bits[x].r = (double)src_bits[x];
-			dst_bits[x].i = 0;
-		}
-	}
+	BitmapTransformParallel<FICOMPLEX, Tsrc, kTransformGrainPixels, true>(dst, src, [](Tsrc v) {
+		return FICOMPLEX{ (double)v, 0 };
+	});
 
 	return dst;
 }
@@ -209,6 +258,9 @@ CONVERT_TYPE<double, uint32_t>				convertULongToDouble;
 CONVERT_TYPE<double, int32_t>				convertLongToDouble;
 CONVERT_TYPE<double, float>				convertFloatToDouble;
 
+// Convert from type X to type unsigned short
+CONVERT_TO_UINT16<float>			convertFloatToUShort;
+
 // Convert from type X to type FICOMPLEX
 CONVERT_TO_COMPLEX<uint8_t>			convertByteToComplex;
 CONVERT_TO_COMPLEX<unsigned short>	convertUShortToComplex;
@@ -487,6 +539,7 @@ FreeImage_ConvertToType(FIBITMAP *src, FREE_IMAGE_TYPE dst_type, FIBOOL scale_li
 					dst = FreeImage_ConvertToStandardType(src, scale_linear);
 					break;
 				case FIT_UINT16:
+					dst = convertFloatToUShort.convert(src, scale_linear);
 					break;
 				case FIT_INT16:
 					break;
@@ -7,7 +7,10 @@
 
 #include "ConversionYUV.h"
 
+#include <cmath>
 #include <memory>
+#include <vector>
+#include "CPUFeatures.h"
 #include "SimpleTools.h"
 
 
@@ -31,53 +34,472 @@ namespace {
 		}
 	};
 
-} // namespace
 
-template <typename Converter_>
-static std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> ConvertImpl(FIBITMAP* src, Converter_ cvt)
-{
-	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dst{
-		FreeImage_AllocateT(FreeImage_GetImageType(src), FreeImage_GetWidth(src), FreeImage_GetHeight(src), FreeImage_GetBPP(src)), &::FreeImage_Unload };
+	// ----------------------------------------------------------
+	//  fixed point kernels for integer samples
+	// ----------------------------------------------------------
 
-	switch (FreeImage_GetImageType(src)) {
-	case FIT_BITMAP: {
-			const auto bpp = FreeImage_GetBPP(src);
-			if (bpp == 32) {
-				BitmapTransform<FIRGBA8>(dst.get(), src, cvt);
+	/**
+	Fixed point form of a YUV standard for one sample depth.
+	JPEG keeps the full range, the BT.x standards use the video range (Y in [16, 235], U and V in [16, 240] for 8 bits).
+	*/
+	struct YuvFixedMatrix
+	{
+		static constexpr int kBits = 12;
+		static constexpr int32_t kRound = 1 << (kBits - 1);
+
+		int32_t y_offset;
+		int32_t c_offset;
+		int32_t max_value;
+
+		// RGB -> YUV
+		int32_t ry, gy, by;
+		int32_t ru, gu, bu;
+		int32_t rv, gv, bv;
+
+		// YUV -> RGB
+		int32_t yk, vr, ug, vg, ub;
+	};
+
+	int32_t ToFixed(double val)
+	{
+		return static_cast<int32_t>(std::lround(val * (1 << YuvFixedMatrix::kBits)));
+	}
+
+	bool MakeFixedMatrix(int64_t standard, unsigned sample_bits, YuvFixedMatrix& m)
+	{
+		const int32_t scale = 1 << (sample_bits - 8);
+		m.max_value = (1 << sample_bits) - 1;
+		m.c_offset = 128 * scale;
+
+		if (standard == FICPARAM_YUV_STANDARD_JPEG) {
+			// truncated like the YuvJPEG templates, both give the same samples
+			const auto fx = &YuvJPEG::MakeFxPoint<YuvFixedMatrix::kBits>;
+			m.y_offset = 0;
+			m.ry = fx(0.299);      m.gy = fx(0.587);       m.by = fx(0.114);
+			m.ru = -fx(0.168736);  m.gu = -fx(0.331264);   m.bu = fx(0.5);
+			m.rv = fx(0.5);        m.gv = -fx(0.418688);   m.bv = -fx(0.081312);
+			m.yk = fx(1.0);        m.vr = fx(1.402);       m.ug = -fx(0.344136);  m.vg = -fx(0.714136);  m.ub = fx(1.772);
+			return true;
+		}
+
+		double kr = 0, kb = 0;
+		switch (standard) {
+		case FICPARAM_YUV_STANDARD_BT601:
+			kr = YuvBT601::kR;
+			kb = YuvBT601::kB;
+			break;
+		case FICPARAM_YUV_STANDARD_BT709:
+			kr = YuvBT709::kR;
+			kb = YuvBT709::kB;
+			break;
+		case FICPARAM_YUV_STANDARD_BT2020:
+			kr = YuvBT2020::kR;
+			kb = YuvBT2020::kB;
+			break;
+		default:
+			return false;
+		}
+		const double kg = 1.0 - kr - kb;
+		const double ys = 219.0 * scale / m.max_value;
+		const double cs = 224.0 * scale / m.max_value;
+
+		m.y_offset = 16 * scale;
+		m.ry = ToFixed(kr * ys);
+		m.gy = ToFixed(kg * ys);
+		m.by = ToFixed(kb * ys);
+		m.ru = ToFixed(-0.5 * kr / (1.0 - kb) * cs);
+		m.gu = ToFixed(-0.5 * kg / (1.0 - kb) * cs);
+		m.bu = ToFixed(0.5 * cs);
+		m.rv = ToFixed(0.5 * cs);
+		m.gv = ToFixed(-0.5 * kg / (1.0 - kr) * cs);
+		m.bv = ToFixed(-0.5 * kb / (1.0 - kr) * cs);
+		m.yk = ToFixed(1.0 / ys);
+		m.vr = ToFixed(2.0 * (1.0 - kr) / cs);
+		m.ug = ToFixed(-2.0 * (1.0 - kb) * kb / kg / cs);
+		m.vg = ToFixed(-2.0 * (1.0 - kr) * kr / kg / cs);
+		m.ub = ToFixed(2.0 * (1.0 - kb) / cs);
+		return true;
+	}
+
+	/// Channel positions in a pixel; YUV bitmaps keep Y, U and V where RGB bitmaps keep red, green and blue
+	template <typename Ty_>
+	struct Channels
+	{
+		static constexpr unsigned kRed   = sizeof(Ty_) == 1 ? FI_RGBA_RED   : 0;
+		static constexpr unsigned kGreen = sizeof(Ty_) == 1 ? FI_RGBA_GREEN : 1;
+		static constexpr unsigned kBlue  = sizeof(Ty_) == 1 ? FI_RGBA_BLUE  : 2;
+		static constexpr unsigned kAlpha = sizeof(Ty_) == 1 ? FI_RGBA_ALPHA : 3;
+	};
+
+	/// Rounds a sample to its upper bits, as needed by the P010 layout
+	template <unsigned DropBits_>
+	FI_ALWAYS_INLINE int32_t DropLowBits(int32_t val, int32_t max_value)
+	{
+		if constexpr (DropBits_ == 0) {
+			return val;
+		}
+		else {
+			return std::min(val + (1 << (DropBits_ - 1)), max_value) & ~((1 << DropBits_) - 1);
+		}
+	}
+
+	/*
+	The kernels below are loops without dependencies between iterations on 32-bit fixed point values,
+	which the compiler vectorizes. KernelDispatch compiles each of them for the baseline instruction set and for AVX2.
+	*/
+
+	/// Converts a row of YUV samples read with strides to RGB; 4 channel rows also get the alpha samples
+	template <typename Ty_, unsigned DstStep_, unsigned YStep_, unsigned CStep_>
+	struct YuvToRgbRow
+	{
+		static FI_ALWAYS_INLINE void Run(Ty_* dst, const Ty_* y, const Ty_* u, const Ty_* v, const Ty_* alpha, unsigned width, const YuvFixedMatrix* m)
+		{
+			using Ch = Channels<Ty_>;
+			const int32_t y_offset = m->y_offset;
+			const int32_t c_offset = m->c_offset;
+			const int32_t max_value = m->max_value;
+			const int32_t yk = m->yk, vr = m->vr, ug = m->ug, vg = m->vg, ub = m->ub;
+
+			FI_VECTORIZE_LOOP
+			for (size_t x = 0; x < width; ++x) {
+				const int32_t luma = yk * (static_cast<int32_t>(y[x * YStep_]) - y_offset) + YuvFixedMatrix::kRound;
+				const int32_t cb = static_cast<int32_t>(u[x * CStep_]) - c_offset;
+				const int32_t cr = static_cast<int32_t>(v[x * CStep_]) - c_offset;
+				dst[x * DstStep_ + Ch::kRed]   = static_cast<Ty_>(std::clamp((luma + vr * cr) >> YuvFixedMatrix::kBits, 0, max_value));
+				dst[x * DstStep_ + Ch::kGreen] = static_cast<Ty_>(std::clamp((luma + ug * cb + vg * cr) >> YuvFixedMatrix::kBits, 0, max_value));
+				dst[x * DstStep_ + Ch::kBlue]  = static_cast<Ty_>(std::clamp((luma + ub * cb) >> YuvFixedMatrix::kBits, 0, max_value));
+				if constexpr (DstStep_ == 4) {
+					dst[x * DstStep_ + Ch::kAlpha] = alpha[x * YStep_];
+				}
 			}
-			else if (bpp == 24) {
-				BitmapTransform<FIRGB8>(dst.get(), src, cvt);
+		}
+	};
+
+	/// Upsamples a row of chroma subsampled by 2 into u_row and v_row, then converts the row to RGB
+	template <typename Ty_, unsigned YStep_, unsigned CStep_>
+	struct SubsampledYuvToRgbRow
+	{
+		static FI_ALWAYS_INLINE void Run(Ty_* dst, const Ty_* y, const Ty_* u, const Ty_* v, Ty_* u_row, Ty_* v_row, unsigned width, const YuvFixedMatrix* m)
+		{
+			for (size_t x = 0; x < width; ++x) {
+				u_row[x] = u[(x >> 1) * CStep_];
+				v_row[x] = v[(x >> 1) * CStep_];
 			}
-			else {
-				std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>{ nullptr, & ::FreeImage_Unload };
+			YuvToRgbRow<Ty_, 3, YStep_, 1>::Run(dst, y, u_row, v_row, nullptr, width, m);
+		}
+	};
+
+	/// Converts a row of RGB pixels to YUV pixels of the same layout
+	template <typename Ty_, unsigned Step_>
+	struct RgbToYuvRow
+	{
+		static FI_ALWAYS_INLINE void Run(Ty_* dst, const Ty_* src, unsigned width, const YuvFixedMatrix* m)
+		{
+			using Ch = Channels<Ty_>;
+			const int32_t y_offset = m->y_offset;
+			const int32_t c_offset = m->c_offset;
+			const int32_t max_value = m->max_value;
+			const int32_t ry = m->ry, gy = m->gy, by = m->by;
+			const int32_t ru = m->ru, gu = m->gu, bu = m->bu;
+			const int32_t rv = m->rv, gv = m->gv, bv = m->bv;
+
+			FI_VECTORIZE_LOOP
+			for (size_t x = 0; x < width; ++x) {
+				const int32_t r = src[x * Step_ + Ch::kRed];
+				const int32_t g = src[x * Step_ + Ch::kGreen];
+				const int32_t b = src[x * Step_ + Ch::kBlue];
+				dst[x * Step_ + Ch::kRed]   = static_cast<Ty_>(std::clamp(((ry * r + gy * g + by * b + YuvFixedMatrix::kRound) >> YuvFixedMatrix::kBits) + y_offset, 0, max_value));
+				dst[x * Step_ + Ch::kGreen] = static_cast<Ty_>(std::clamp(((ru * r + gu * g + bu * b + YuvFixedMatrix::kRound) >> YuvFixedMatrix::kBits) + c_offset, 0, max_value));
+				dst[x * Step_ + Ch::kBlue]  = static_cast<Ty_>(std::clamp(((rv * r + gv * g + bv * b + YuvFixedMatrix::kRound) >> YuvFixedMatrix::kBits) + c_offset, 0, max_value));
+				if constexpr (Step_ == 4) {
+					dst[x * Step_ + Ch::kAlpha] = src[x * Step_ + Ch::kAlpha];
+				}
+			}
+		}
+	};
+
+	/// Converts a row of RGB pixels to Y samples written with a stride, and to unscaled U and V sums for ChromaRow
+	template <typename Ty_, unsigned SrcStep_, unsigned YStep_, unsigned DropBits_>
+	struct RgbToLumaRow
+	{
+		static FI_ALWAYS_INLINE void Run(Ty_* y, int32_t* u_sum, int32_t* v_sum, const Ty_* src, unsigned width, const YuvFixedMatrix* m)
+		{
+			using Ch = Channels<Ty_>;
+			const int32_t y_offset = m->y_offset;
+			const int32_t max_value = m->max_value;
+			const int32_t ry = m->ry, gy = m->gy, by = m->by;
+			const int32_t ru = m->ru, gu = m->gu, bu = m->bu;
+			const int32_t rv = m->rv, gv = m->gv, bv = m->bv;
+
+			FI_VECTORIZE_LOOP
+			for (size_t x = 0; x < width; ++x) {
+				const int32_t r = src[x * SrcStep_ + Ch::kRed];
+				const int32_t g = src[x * SrcStep_ + Ch::kGreen];
+				const int32_t b = src[x * SrcStep_ + Ch::kBlue];
+				const int32_t luma = std::clamp(((ry * r + gy * g + by * b + YuvFixedMatrix::kRound) >> YuvFixedMatrix::kBits) + y_offset, 0, max_value);
+				y[x * YStep_] = static_cast<Ty_>(DropLowBits<DropBits_>(luma, max_value));
+				u_sum[x] = ru * r + gu * g + bu * b;
+				v_sum[x] = rv * r + gv * g + bv * b;
+			}
+		}
+	};
+
+	/// Averages the U and V sums of two rows over pairs of pixels and writes the samples with a stride
+	template <typename Ty_, unsigned CStep_, unsigned DropBits_>
+	struct ChromaRow
+	{
+		static FI_ALWAYS_INLINE void Run(Ty_* u, Ty_* v, const int32_t* u0, const int32_t* v0, const int32_t* u1, const int32_t* v1, unsigned width, const YuvFixedMatrix* m)
+		{
+			constexpr int kShift = YuvFixedMatrix::kBits + 2;
+			constexpr int32_t kRound = 1 << (kShift - 1);
+			const int32_t c_offset = m->c_offset;
+			const int32_t max_value = m->max_value;
+
+			const size_t pairs = width / 2;
+			FI_VECTORIZE_LOOP
+			for (size_t i = 0; i < pairs; ++i) {
+				const size_t x = 2 * i;
+				const int32_t cb = std::clamp(((u0[x] + u0[x + 1] + u1[x] + u1[x + 1] + kRound) >> kShift) + c_offset, 0, max_value);
+				const int32_t cr = std::clamp(((v0[x] + v0[x + 1] + v1[x] + v1[x + 1] + kRound) >> kShift) + c_offset, 0, max_value);
+				u[i * CStep_] = static_cast<Ty_>(DropLowBits<DropBits_>(cb, max_value));
+				v[i * CStep_] = static_cast<Ty_>(DropLowBits<DropBits_>(cr, max_value));
+			}
+			if (width & 1) {
+				// the last column is repeated
+				const size_t x = width - 1;
+				const int32_t cb = std::clamp(((2 * (u0[x] + u1[x]) + kRound) >> kShift) + c_offset, 0, max_value);
+				const int32_t cr = std::clamp(((2 * (v0[x] + v1[x]) + kRound) >> kShift) + c_offset, 0, max_value);
+				u[pairs * CStep_] = static_cast<Ty_>(DropLowBits<DropBits_>(cb, max_value));
+				v[pairs * CStep_] = static_cast<Ty_>(DropLowBits<DropBits_>(cr, max_value));
 			}
 		}
+	};
+
+	size_t RowGrain(unsigned width)
+	{
+		return std::max<size_t>(1, kTransformGrainPixels / std::max(width, 1U));
+	}
+
+	/// Converts a bitmap between RGB and YUV keeping its layout
+	template <bool ToYuv_, typename Ty_, unsigned Step_>
+	void ConvertFixedRows(FIBITMAP* dst, FIBITMAP* src, const YuvFixedMatrix& m)
+	{
+		using Ch = Channels<Ty_>;
+		const unsigned width = FreeImage_GetWidth(src);
+		const unsigned height = FreeImage_GetHeight(src);
+
+		ThreadPool::Instance().parallelFor(0, height, RowGrain(width), [&](size_t first, size_t last) {
+			for (size_t y = first; y < last; ++y) {
+				const auto src_line = reinterpret_cast<const Ty_*>(FreeImage_GetScanLine(src, static_cast<int>(y)));
+				const auto dst_line = reinterpret_cast<Ty_*>(FreeImage_GetScanLine(dst, static_cast<int>(y)));
+				if constexpr (ToYuv_) {
+					KernelDispatch<RgbToYuvRow<Ty_, Step_>>::Run(dst_line, src_line, width, &m);
+				}
+				else {
+					KernelDispatch<YuvToRgbRow<Ty_, Step_, Step_, Step_>>::Run(dst_line, src_line + Ch::kRed, src_line + Ch::kGreen, src_line + Ch::kBlue, src_line + Ch::kAlpha, width, &m);
+				}
+			}
+		});
+	}
+
+	/// Converts a top-down frame with chroma subsampled by 2 horizontally and by 2^c_rows_shift vertically to RGB
+	template <typename Ty_, unsigned YStep_, unsigned CStep_>
+	void SubsampledToRgb(FIBITMAP* dst, const uint8_t* y_plane, unsigned y_pitch, const uint8_t* u_plane, unsigned u_pitch, const uint8_t* v_plane, unsigned v_pitch, unsigned c_rows_shift, const YuvFixedMatrix& m)
+	{
+		const unsigned width = FreeImage_GetWidth(dst);
+		const unsigned height = FreeImage_GetHeight(dst);
+
+		ThreadPool::Instance().parallelFor(0, height, RowGrain(width), [&](size_t first, size_t last) {
+			std::vector<Ty_> u_row(width), v_row(width);
+			for (size_t row = first; row < last; ++row) {
+				const size_t c_row = row >> c_rows_shift;
+				KernelDispatch<SubsampledYuvToRgbRow<Ty_, YStep_, CStep_>>::Run(
+					reinterpret_cast<Ty_*>(FreeImage_GetScanLine(dst, static_cast<int>(height - 1 - row))),
+					reinterpret_cast<const Ty_*>(y_plane + row * y_pitch),
+					reinterpret_cast<const Ty_*>(u_plane + c_row * u_pitch),
+					reinterpret_cast<const Ty_*>(v_plane + c_row * v_pitch),
+					u_row.data(), v_row.data(), width, &m);
+			}
+		});
+	}
+
+	/// Converts a bitmap to a top-down frame with chroma subsampled by 2 horizontally and by 2^c_rows_shift vertically
+	template <typename Ty_, unsigned SrcStep_, unsigned YStep_, unsigned CStep_, unsigned DropBits_>
+	void RgbToSubsampled(FIBITMAP* src, uint8_t* y_plane, unsigned y_pitch, uint8_t* u_plane, unsigned u_pitch, uint8_t* v_plane, unsigned v_pitch, unsigned c_rows_shift, const YuvFixedMatrix& m)
+	{
+		const unsigned width = FreeImage_GetWidth(src);
+		const unsigned height = FreeImage_GetHeight(src);
+		const unsigned c_rows = (height + (1U << c_rows_shift) - 1) >> c_rows_shift;
+
+		ThreadPool::Instance().parallelFor(0, c_rows, std::max<size_t>(1, RowGrain(width) >> c_rows_shift), [&](size_t first, size_t last) {
+			std::vector<int32_t> sums(4 * static_cast<size_t>(width));
+			int32_t* u0 = sums.data();
+			int32_t* v0 = u0 + width;
+			int32_t* u1 = v0 + width;
+			int32_t* v1 = u1 + width;
+
+			auto luma_row = [&](size_t row, int32_t* u_sum, int32_t* v_sum) {
+				KernelDispatch<RgbToLumaRow<Ty_, SrcStep_, YStep_, DropBits_>>::Run(
+					reinterpret_cast<Ty_*>(y_plane + row * y_pitch), u_sum, v_sum,
+					reinterpret_cast<const Ty_*>(FreeImage_GetScanLine(src, static_cast<int>(height - 1 - row))), width, &m);
+			};
+
+			for (size_t c_row = first; c_row < last; ++c_row) {
+				const size_t row0 = c_row << c_rows_shift;
+				const size_t row1 = std::min<size_t>(row0 + (1U << c_rows_shift) - 1, height - 1);
+				luma_row(row0, u0, v0);
+				if (row1 != row0) {
+					luma_row(row1, u1, v1);
+				}
+				// a single row is averaged with itself
+				KernelDispatch<ChromaRow<Ty_, CStep_, DropBits_>>::Run(
+					reinterpret_cast<Ty_*>(u_plane + c_row * u_pitch), reinterpret_cast<Ty_*>(v_plane + c_row * v_pitch),
+					u0, v0, (row1 != row0) ? u1 : u0, (row1 != row0) ? v1 : v0, width, &m);
+			}
+		});
+	}
+
+	bool CheckPlanes(const FIYUVPLANES& planes, FREE_IMAGE_YUV_LAYOUT layout, unsigned width)
+	{
+		const unsigned c_width = (width + 1) / 2;
+		switch (layout) {
+		case FIYUV_I420:
+			return planes.data[0] && planes.data[1] && planes.data[2] && (planes.pitch[0] >= width) && (planes.pitch[1] >= c_width) && (planes.pitch[2] >= c_width);
+		case FIYUV_NV12:
+			return planes.data[0] && planes.data[1] && (planes.pitch[0] >= width) && (planes.pitch[1] >= 2 * c_width);
+		case FIYUV_YUY2:
+			return planes.data[0] && (planes.pitch[0] >= 4 * c_width);
+		case FIYUV_P010:
+			return planes.data[0] && planes.data[1] && (planes.pitch[0] >= 2 * width) && (planes.pitch[1] >= 4 * c_width);
+		default:
+			return false;
+		}
+	}
+
+	template <unsigned Step_>
+	void ConvertToPlanes(FIBITMAP* src, const FIYUVPLANES& planes, FREE_IMAGE_YUV_LAYOUT layout, const YuvFixedMatrix& m)
+	{
+		uint8_t* const* data = planes.data;
+		const unsigned* pitch = planes.pitch;
+		switch (layout) {
+		case FIYUV_I420:
+			RgbToSubsampled<uint8_t, Step_, 1, 1, 0>(src, data[0], pitch[0], data[1], pitch[1], data[2], pitch[2], 1, m);
+			break;
+		case FIYUV_NV12:
+			RgbToSubsampled<uint8_t, Step_, 1, 2, 0>(src, data[0], pitch[0], data[1], pitch[1], data[1] + 1, pitch[1], 1, m);
+			break;
+		case FIYUV_YUY2:
+			RgbToSubsampled<uint8_t, Step_, 2, 4, 0>(src, data[0], pitch[0], data[0] + 1, pitch[0], data[0] + 3, pitch[0], 0, m);
+			break;
+		case FIYUV_P010:
+			RgbToSubsampled<uint16_t, Step_, 1, 2, 6>(src, data[0], pitch[0], data[1], pitch[1], data[1] + sizeof(uint16_t), pitch[1], 1, m);
+			break;
+		default:
+			break;
+		}
+	}
+
+} // namespace
+
+using BitmapPtr = std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>;
+
+template <bool ToYuv_>
+static BitmapPtr ConvertFixed(FIBITMAP* src, int64_t standard_version)
+{
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
+	const unsigned bpp = FreeImage_GetBPP(src);
+
+	unsigned sample_bits = 0;
+	if ((image_type == FIT_BITMAP) && ((bpp == 24) || (bpp == 32))) {
+		sample_bits = 8;
+	}
+	else if ((image_type == FIT_RGB16) || (image_type == FIT_RGBA16)) {
+		sample_bits = 16;
+	}
+
+	YuvFixedMatrix m{};
+	if (!sample_bits || !MakeFixedMatrix(standard_version, sample_bits, m)) {
+		return BitmapPtr{ nullptr, &::FreeImage_Unload };
+	}
+
+	BitmapPtr dst{ FreeImage_AllocateT(image_type, FreeImage_GetWidth(src), FreeImage_GetHeight(src), bpp), &::FreeImage_Unload };
+	if (!dst) {
+		return dst;
+	}
+
+	switch (image_type) {
+	case FIT_BITMAP:
+		if (bpp == 32) {
+			ConvertFixedRows<ToYuv_, uint8_t, 4>(dst.get(), src, m);
+		}
+		else {
+			ConvertFixedRows<ToYuv_, uint8_t, 3>(dst.get(), src, m);
+		}
+		break;
+	case FIT_RGB16:
+		ConvertFixedRows<ToYuv_, uint16_t, 3>(dst.get(), src, m);
 		break;
+	case FIT_RGBA16:
+		ConvertFixedRows<ToYuv_, uint16_t, 4>(dst.get(), src, m);
+		break;
+	default:
+		break;
+	}
+
+	return dst;
+}
+
+
+template <typename Converter_>
+static BitmapPtr ConvertImpl(FIBITMAP* src, Converter_ cvt)
+{
+	BitmapPtr dst{ FreeImage_AllocateT(FreeImage_GetImageType(src), FreeImage_GetWidth(src), FreeImage_GetHeight(src), FreeImage_GetBPP(src)), &::FreeImage_Unload };
+	if (!dst) {
+		return dst;
+	}
+
+	switch (FreeImage_GetImageType(src)) {
 	case FIT_RGBF:
-		BitmapTransform<FIRGBF>(dst.get(), src, cvt);
+		BitmapTransformParallel<FIRGBF>(dst.get(), src, cvt);
 		break;
 	case FIT_RGBAF:
-		BitmapTransform<FIRGBAF>(dst.get(), src, cvt);
+		BitmapTransformParallel<FIRGBAF>(dst.get(), src, cvt);
 		break;
 	default:
 		// ToDo: Add all other types here...
-		return std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>{ nullptr, &::FreeImage_Unload };
+		return BitmapPtr{ nullptr, &::FreeImage_Unload };
 	}
 
 	return dst;
 }
 
-FIBITMAP* ConvertRgbToYuv(FIBITMAP* dib, int64_t standard_version)
+template <template <typename> class Converter_>
+static BitmapPtr ConvertFloat(FIBITMAP* src, int64_t standard_version)
 {
-	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> result{ nullptr,  &::FreeImage_Unload };
-
 	switch (standard_version) {
 	case FICPARAM_YUV_STANDARD_JPEG:
-		result = ConvertImpl(dib, RgbToYuvConverter<YuvJPEG>{});
-		break;
+		return ConvertImpl(src, Converter_<YuvJPEG>{});
+	case FICPARAM_YUV_STANDARD_BT601:
+		return ConvertImpl(src, Converter_<YuvBT601>{});
+	case FICPARAM_YUV_STANDARD_BT709:
+		return ConvertImpl(src, Converter_<YuvBT709>{});
+	case FICPARAM_YUV_STANDARD_BT2020:
+		return ConvertImpl(src, Converter_<YuvBT2020>{});
 	default:
-		return nullptr;
+		return BitmapPtr{ nullptr, &::FreeImage_Unload };
 	}
+}
+
+static bool IsFloatColor(FIBITMAP* dib)
+{
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	return (image_type == FIT_RGBF) || (image_type == FIT_RGBAF);
+}
+
+FIBITMAP* ConvertRgbToYuv(FIBITMAP* dib, int64_t standard_version)
+{
+	BitmapPtr result = IsFloatColor(dib) ? ConvertFloat<RgbToYuvConverter>(dib, standard_version) : ConvertFixed<true>(dib, standard_version);
 
 	if (result) {
 		auto icc = FreeImage_CreateICCProfile(result.get(), nullptr, 0u);
@@ -90,15 +512,82 @@ FIBITMAP* ConvertRgbToYuv(FIBITMAP* dib, int64_t standard_version)
 
 FIBITMAP* ConvertYuvToRgb(FIBITMAP* dib, int64_t standard_version)
 {
-	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> result{ nullptr,  &::FreeImage_Unload };
+	BitmapPtr result = IsFloatColor(dib) ? ConvertFloat<YuvToRgbConverter>(dib, standard_version) : ConvertFixed<false>(dib, standard_version);
 
-	switch (standard_version) {
-	case FICPARAM_YUV_STANDARD_JPEG:
-		result = ConvertImpl(dib, YuvToRgbConverter<YuvJPEG>{});
+	return result.release();
+}
+
+// ----------------------------------------------------------
+//  planar and packed frames
+// ----------------------------------------------------------
+
+FIBITMAP* DLL_CALLCONV
+FreeImage_ConvertFromYUVPlanes(const FIYUVPLANES* planes, FREE_IMAGE_YUV_LAYOUT layout, unsigned width, unsigned height, FREE_IMAGE_CVT_COLOR_PARAM standard)
+{
+	if (!planes || !width || !height || !CheckPlanes(*planes, layout, width)) {
+		return nullptr;
+	}
+
+	YuvFixedMatrix m{};
+	if (!MakeFixedMatrix(standard, (layout == FIYUV_P010) ? 16 : 8, m)) {
+		return nullptr;
+	}
+
+	BitmapPtr dst{ (layout == FIYUV_P010) ? FreeImage_AllocateT(FIT_RGB16, width, height) : FreeImage_Allocate(width, height, 24), &::FreeImage_Unload };
+	if (!dst) {
+		return nullptr;
+	}
+
+	const uint8_t* const* data = planes->data;
+	const unsigned* pitch = planes->pitch;
+	switch (layout) {
+	case FIYUV_I420:
+		SubsampledToRgb<uint8_t, 1, 1>(dst.get(), data[0], pitch[0], data[1], pitch[1], data[2], pitch[2], 1, m);
+		break;
+	case FIYUV_NV12:
+		SubsampledToRgb<uint8_t, 1, 2>(dst.get(), data[0], pitch[0], data[1], pitch[1], data[1] + 1, pitch[1], 1, m);
+		break;
+	case FIYUV_YUY2:
+		SubsampledToRgb<uint8_t, 2, 4>(dst.get(), data[0], pitch[0], data[0] + 1, pitch[0], data[0] + 3, pitch[0], 0, m);
+		break;
+	case FIYUV_P010:
+		SubsampledToRgb<uint16_t, 1, 2>(dst.get(), data[0], pitch[0], data[1], pitch[1], data[1] + sizeof(uint16_t), pitch[1], 1, m);
 		break;
 	default:
 		return nullptr;
 	}
 
-	return result.release();
+	return dst.release();
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_ConvertToYUVPlanes(FIBITMAP* dib, const FIYUVPLANES* planes, FREE_IMAGE_YUV_LAYOUT layout, FREE_IMAGE_CVT_COLOR_PARAM standard)
+{
+	if (!FreeImage_HasPixels(dib) || !planes || !CheckPlanes(*planes, layout, FreeImage_GetWidth(dib))) {
+		return FALSE;
+	}
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	const unsigned bpp = FreeImage_GetBPP(dib);
+
+	unsigned step = 0;
+	if (layout == FIYUV_P010) {
+		step = (image_type == FIT_RGB16) ? 3 : (image_type == FIT_RGBA16) ? 4 : 0;
+	}
+	else if (image_type == FIT_BITMAP) {
+		step = (bpp == 24) ? 3 : (bpp == 32) ? 4 : 0;
+	}
+
+	YuvFixedMatrix m{};
+	if (!step || !MakeFixedMatrix(standard, (layout == FIYUV_P010) ? 16 : 8, m)) {
+		return FALSE;
+	}
+
+	if (step == 4) {
+		ConvertToPlanes<4>(dib, *planes, layout, m);
+	}
+	else {
+		ConvertToPlanes<3>(dib, *planes, layout, m);
+	}
+	return TRUE;
 }
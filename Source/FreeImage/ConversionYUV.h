@@ -142,6 +142,71 @@ struct YuvJPEG
 };
 
 
+/**
+ * Conversion by the matrix of an ITU-R recommendation with luma weights Kr and Kb.
+ * Only floating point values are supported here, they use the full [0, 1] range.
+ * Integer samples are converted by the fixed point kernels of ConversionYUV.cpp in the video range.
+ */
+template <typename Weights_>
+struct YuvMatrix
+{
+	static constexpr double kR = Weights_::kR;
+	static constexpr double kB = Weights_::kB;
+	static constexpr double kG = 1.0 - kR - kB;
+
+	template <typename FTy_>
+	static constexpr FTy_ FloatClamp(FTy_ val)
+	{
+		return std::clamp(val, static_cast<FTy_>(0.0), static_cast<FTy_>(1.0));
+	}
+
+	template <typename FTy_>
+	static constexpr std::enable_if_t<std::is_floating_point_v<FTy_>, FTy_> R(FTy_ y, FTy_ u, FTy_ v)
+	{
+		return FloatClamp<FTy_>(y + static_cast<FTy_>(2.0 * (1.0 - kR)) * (v - static_cast<FTy_>(0.5)));
+	}
+
+	template <typename FTy_>
+	static constexpr std::enable_if_t<std::is_floating_point_v<FTy_>, FTy_> G(FTy_ y, FTy_ u, FTy_ v)
+	{
+		return FloatClamp<FTy_>(y - static_cast<FTy_>(2.0 * (1.0 - kB) * kB / kG) * (u - static_cast<FTy_>(0.5)) - static_cast<FTy_>(2.0 * (1.0 - kR) * kR / kG) * (v - static_cast<FTy_>(0.5)));
+	}
+
+	template <typename FTy_>
+	static constexpr std::enable_if_t<std::is_floating_point_v<FTy_>, FTy_> B(FTy_ y, FTy_ u, FTy_ v)
+	{
+		return FloatClamp<FTy_>(y + static_cast<FTy_>(2.0 * (1.0 - kB)) * (u - static_cast<FTy_>(0.5)));
+	}
+
+
+	template <typename FTy_>
+	static constexpr std::enable_if_t<std::is_floating_point_v<FTy_>, FTy_> Y(FTy_ r, FTy_ g, FTy_ b)
+	{
+		return FloatClamp<FTy_>(static_cast<FTy_>(kB) * b + static_cast<FTy_>(kG) * g + static_cast<FTy_>(kR) * r);
+	}
+
+	template <typename FTy_>
+	static constexpr std::enable_if_t<std::is_floating_point_v<FTy_>, FTy_> U(FTy_ r, FTy_ g, FTy_ b)
+	{
+		return FloatClamp<FTy_>(static_cast<FTy_>(0.5) * b - static_cast<FTy_>(0.5 * kG / (1.0 - kB)) * g - static_cast<FTy_>(0.5 * kR / (1.0 - kB)) * r + static_cast<FTy_>(0.5));
+	}
+
+	template <typename FTy_>
+	static constexpr std::enable_if_t<std::is_floating_point_v<FTy_>, FTy_> V(FTy_ r, FTy_ g, FTy_ b)
+	{
+		return FloatClamp<FTy_>(static_cast<FTy_>(0.5) * r - static_cast<FTy_>(0.5 * kG / (1.0 - kR)) * g - static_cast<FTy_>(0.5 * kB / (1.0 - kR)) * b + static_cast<FTy_>(0.5));
+	}
+};
+
+struct Bt601Weights { static constexpr double kR = 0.299;  static constexpr double kB = 0.114; };
+struct Bt709Weights { static constexpr double kR = 0.2126; static constexpr double kB = 0.0722; };
+struct Bt2020Weights { static constexpr double kR = 0.2627; static constexpr double kB = 0.0593; };
+
+using YuvBT601 = YuvMatrix<Bt601Weights>;
+using YuvBT709 = YuvMatrix<Bt709Weights>;
+using YuvBT2020 = YuvMatrix<Bt2020Weights>;
+
+
 template <typename YuvStandard_>
 constexpr FIRGBAF YuvToRgb(const FIRGBAF& p) {
 	FIRGBAF res{
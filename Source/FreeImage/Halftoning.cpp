@@ -25,14 +25,97 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "SimpleTools.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
 
 static const int WHITE = 255;
 static const int BLACK = 0;
 
+// ==========================================================
+// Packing of 8-bit samples into 1-bit pixels
+//
+
+/// Sets the 1-bit pixels of a row whose sample is >= its threshold, 8 pixels per output byte
+struct PackThresholdRow {
+	static FI_ALWAYS_INLINE void Run(uint8_t *dst, const uint8_t *src, const uint8_t *thresholds, unsigned width) {
+		const size_t bytes = width / 8;
+		FI_VECTORIZE_LOOP
+		for (size_t i = 0; i < bytes; ++i) {
+			const uint8_t *s = src + 8 * i;
+			const uint8_t *t = thresholds + 8 * i;
+			dst[i] = (uint8_t)(((s[0] >= t[0]) << 7) | ((s[1] >= t[1]) << 6) | ((s[2] >= t[2]) << 5) | ((s[3] >= t[3]) << 4) |
+			                   ((s[4] >= t[4]) << 3) | ((s[5] >= t[5]) << 2) | ((s[6] >= t[6]) << 1) | (s[7] >= t[7]));
+		}
+		if (width & 7) {
+			uint8_t last = 0;
+			for (unsigned x = 8 * (unsigned)bytes; x < width; ++x) {
+				last |= (uint8_t)((src[x] >= thresholds[x]) << (7 - (x & 7)));
+			}
+			dst[bytes] = last;
+		}
+	}
+};
+
+/**
+Converts a 8-bit image to a new 1-bit black and white image in row bands on the thread pool.
+thresholds holds 'period' rows of width thresholds, row y using the row y % period.
+*/
+static FIBITMAP* PackThresholds(FIBITMAP *dib8, const std::vector<uint8_t> &thresholds, unsigned period) {
+	const unsigned width = FreeImage_GetWidth(dib8);
+	const unsigned height = FreeImage_GetHeight(dib8);
+	FIBITMAP *new_dib = FreeImage_Allocate(width, height, 1);
+	if (!new_dib) return nullptr;
+
+	// Build a monochrome palette
+	FIRGBA8 *pal = FreeImage_GetPalette(new_dib);
+	pal[0].red = pal[0].green = pal[0].blue = 0;
+	pal[1].red = pal[1].green = pal[1].blue = 255;
+
+	const uint8_t *src_bits = FreeImage_GetScanLine(dib8, 0);
+	const ptrdiff_t src_stride = FreeImage_GetScanLineStride(dib8);
+	uint8_t *dst_bits = FreeImage_GetScanLine(new_dib, 0);
+	const ptrdiff_t dst_stride = FreeImage_GetScanLineStride(new_dib);
+
+	const size_t grain_rows = MAX((size_t)1, (size_t)(kTransformGrainPixels / MAX(width, 1U)));
+	ThreadPool::Instance().parallelFor(0, height, grain_rows, [&](size_t first, size_t last) {
+		for (size_t y = first; y < last; ++y) {
+			KernelDispatch<PackThresholdRow>::Run(dst_bits + (ptrdiff_t)y * dst_stride, src_bits + (ptrdiff_t)y * src_stride, &thresholds[(y % period) * width], width);
+		}
+	});
+
+	return new_dib;
+}
+
+/**
+Tiles a l x l threshold matrix over rows of width thresholds.
+The threshold of (x, y) is matrix[(x % l) * x_step + (y % l) * y_step].
+*/
+static std::vector<uint8_t> TileThresholds(const int *matrix, unsigned l, unsigned x_step, unsigned y_step, unsigned width) {
+	std::vector<uint8_t> thresholds((size_t)l * width);
+	for (unsigned y = 0; y < l; y++) {
+		uint8_t *row = &thresholds[(size_t)y * width];
+		for (unsigned x = 0; x < width; x++) {
+			row[x] = (uint8_t)matrix[(x % l) * x_step + y * y_step];
+		}
+	}
+	return thresholds;
+}
+
+// ==========================================================
 // Floyd & Steinberg error diffusion dithering
+//
+
 // This algorithm use the following filter
 //          *   7
 //      3   5   1     (1/16)
+//
+// Borders are dithered first with a random threshold. Interior rows then run as a wavefront:
+// rows are taken in order by the workers and pixel x of a row waits until the row above has
+// diffused its error up to x + 1. Error rows live in a ring with one row per worker and one for
+// the row being read, a row waiting for the reader of the ring slot it reuses to complete.
 static FIBITMAP* FloydSteinberg(FIBITMAP *dib) {
 
 #define RAND(RN) (((seed = 1103515245 * seed + 12345) >> 12) % (RN))
@@ -40,27 +123,39 @@ static FIBITMAP* FloydSteinberg(FIBITMAP *dib) {
 
 	int seed = 0;
 	int x, y, p, pixel, threshold, error;
-	uint8_t *bits, *new_bits;
+	const uint8_t *bits;
+	uint8_t *new_bits;
 	FIBITMAP *new_dib{};
 
 	// allocate a 8-bit DIB
 	const int width = FreeImage_GetWidth(dib);
 	const int height = FreeImage_GetHeight(dib);
-	const int pitch = FreeImage_GetPitch(dib);
 	new_dib = FreeImage_Allocate(width, height, 8);
 	if (!new_dib) return nullptr;
 
-	// allocate space for error arrays
-	int *lerr = (int*)malloc (width * sizeof(int));
-	int *cerr = (int*)malloc (width * sizeof(int));
-	memset(lerr, 0, width * sizeof(int));
-	memset(cerr, 0, width * sizeof(int));
+	const uint8_t *src_bits = FreeImage_GetScanLine(dib, 0);
+	const ptrdiff_t src_stride = FreeImage_GetScanLineStride(dib);
+	uint8_t *dst_bits = FreeImage_GetScanLine(new_dib, 0);
+	const ptrdiff_t dst_stride = FreeImage_GetScanLineStride(new_dib);
+
+	// large images run on every pool thread, progress being published every kStep pixels
+	static const int kStep = 64;
+	const unsigned workers = ((width >= 4 * kStep) && (height > 2)) ? ThreadPool::Instance().getThreadCount() + 1 : 1;
+	const unsigned slots = workers + 1;
+	std::vector<int> errors((size_t)slots * width);
+	const auto ErrorRow = [&](int row) {
+		return &errors[(size_t)(row % slots) * width];
+	};
+	std::unique_ptr<std::atomic<int>[]> progress(new std::atomic<int>[height]);
+	for (y = 0; y < height; y++) {
+		progress[y].store(0, std::memory_order_relaxed);
+	}
 
 	// left border
 	error = 0;
 	for (y = 0; y < height; y++) {
-		bits = FreeImage_GetScanLine(dib, y);
-		new_bits = FreeImage_GetScanLine(new_dib, y);
+		bits = src_bits + y * src_stride;
+		new_bits = dst_bits + y * dst_stride;
 
 		threshold = (WHITE / 2 + RAND(129) - 64);
 		pixel = bits[0] + error;
@@ -71,8 +166,8 @@ static FIBITMAP* FloydSteinberg(FIBITMAP *dib) {
 	// right border
 	error = 0;
 	for (y = 0; y < height; y++) {
-		bits = FreeImage_GetScanLine(dib, y);
-		new_bits = FreeImage_GetScanLine(new_dib, y);
+		bits = src_bits + y * src_stride;
+		new_bits = dst_bits + y * dst_stride;
 
 		threshold = (WHITE / 2 + RAND(129) - 64);
 		pixel = bits[width-1] + error;
@@ -81,8 +176,9 @@ static FIBITMAP* FloydSteinberg(FIBITMAP *dib) {
 		new_bits[width-1] = (uint8_t)p;
 	}
 	// top border
-	bits = FreeImage_GetBits(dib);
-	new_bits = FreeImage_GetBits(new_dib);
+	bits = src_bits;
+	new_bits = dst_bits;
+	int *lerr = ErrorRow(0);
 	error = 0;
 	for (x = 0; x < width; x++) {
 		threshold = (WHITE / 2 + RAND(129) - 64);
@@ -92,35 +188,56 @@ static FIBITMAP* FloydSteinberg(FIBITMAP *dib) {
 		new_bits[x] = (uint8_t)p;
 		lerr[x] = INITERR(bits[x], p);
 	}
+	progress[0].store(width, std::memory_order_release);
 
 	// interior bits
-	for (y = 1; y < height; y++) {
-		// scan left to right
-		bits = FreeImage_GetScanLine(dib, y);
-		new_bits = FreeImage_GetScanLine(new_dib, y);
-
-	    cerr[0] = INITERR(bits[0], new_bits[0]);
-		for (x = 1; x < width - 1; x++) {
-			error = (lerr[x-1] + 5 * lerr[x] + 3 * lerr[x+1] + 7 * cerr[x-1]) / 16;
-			pixel = bits[x] + error;
-			if (pixel > (WHITE / 2)) {
-				new_bits[x] = WHITE;
-				cerr[x] = pixel - WHITE; 
-			} else {
-				new_bits[x] = BLACK;
-				cerr[x] = pixel - BLACK; 
+	std::atomic<int> next_row{1};
+	ThreadPool::Instance().parallelFor(0, workers, 1, [&](size_t, size_t) {
+		for (int row = next_row++; row < height; row = next_row++) {
+			const uint8_t *row_bits = src_bits + row * src_stride;
+			uint8_t *row_new_bits = dst_bits + row * dst_stride;
+			const std::atomic<int> &above = progress[row - 1];
+
+			// the slot of this row was last read by row - slots + 1
+			const int reader = row - (int)slots + 1;
+			if (reader >= 1) {
+				while (progress[reader].load(std::memory_order_acquire) < width) {
+					std::this_thread::yield();
+				}
+			}
+			const int *last_err = ErrorRow(row - 1);
+			int *cur_err = ErrorRow(row);
+
+			// the errors of the ends of the row only depend on the borders
+			cur_err[0] = INITERR(row_bits[0], row_new_bits[0]);
+			cur_err[width - 1] = INITERR(row_bits[width - 1], row_new_bits[width - 1]);
+
+			int ready = 0;	// pixels of the row above whose error is final
+			for (int col = 1; col < width - 1; col++) {
+				if (ready < col + 2) {
+					while ((ready = above.load(std::memory_order_acquire)) < MIN(col + 2, width)) {
+						std::this_thread::yield();
+					}
+				}
+				const int err = (last_err[col-1] + 5 * last_err[col] + 3 * last_err[col+1] + 7 * cur_err[col-1]) / 16;
+				const int value = row_bits[col] + err;
+				if (value > (WHITE / 2)) {
+					row_new_bits[col] = WHITE;
+					cur_err[col] = value - WHITE;
+				} else {
+					row_new_bits[col] = BLACK;
+					cur_err[col] = value - BLACK;
+				}
+				if ((col % kStep) == 0) {
+					progress[row].store(col, std::memory_order_release);
+				}
 			}
+			progress[row].store(width, std::memory_order_release);
 		}
-		// set errors for ends of the row
-		cerr[0] = INITERR (bits[0], new_bits[0]);
-		cerr[width - 1] = INITERR (bits[width - 1], new_bits[width - 1]);
+	});
 
-		// swap error buffers
-		int *terr = lerr; lerr = cerr; cerr = terr;
-	}
-
-	free(lerr);
-	free(cerr);
+#undef RAND
+#undef INITERR
 
 	return new_dib;
 }
@@ -129,71 +246,20 @@ static FIBITMAP* FloydSteinberg(FIBITMAP *dib) {
 // Bayer ordered dispersed dot dithering
 //
 
-// Function taken from "Ordered Dithering, Stephen Hawley, Graphics Gems, Academic Press, 1990"
-// This function is used to generate a Bayer dithering matrice whose dimension are 2^size by 2^size
-//
-static int dithervalue(int x, int y, int size) {
-	int d = 0;
-	/*
-	 * calculate the dither value at a particular
-	 * (x, y) over the size of the matrix.
-	 */
-	while (size-->0)	{
-		/* Think of d as the density. At every iteration,
-		 * d is shifted left one and a new bit is put in the
-		 * low bit based on x and y. If x is odd and y is even,
-		 * or x is even and y is odd, a bit is put in. This
-		 * generates the checkerboard seen in dithering.
-		 * This quantity is shifted left again and the low bit of
-		 * y is added in.
-		 * This whole thing interleaves a checkerboard bit pattern
-		 * and y's bits, which is the value you want.
-		 */
-		d = (d <<1 | (x&1 ^ y&1))<<1 | y&1;
-		x >>= 1;
-		y >>= 1;
-	}
-	return d;
-}
-
 // Ordered dithering with a Bayer matrix of size 2^order by 2^order
-//
+// Returns a 1-bit image
 static FIBITMAP* OrderedDispersedDot(FIBITMAP *dib, int order) {
-	int x, y;
-	uint8_t *bits, *new_bits;
-	FIBITMAP *new_dib{};
-
-	// allocate a 8-bit DIB
-	const int width = FreeImage_GetWidth(dib);
-	const int height = FreeImage_GetHeight(dib);
-	new_dib = FreeImage_Allocate(width, height, 8);
-	if (!new_dib) return nullptr;
-
 	// build the dithering matrix
 	int l = (1 << order);	// square of dither matrix order; the dimensions of the matrix
-	auto *matrix = (uint8_t*)malloc(l*l * sizeof(uint8_t));
+	std::vector<int> matrix(l * l);
 	for (int i = 0; i < l*l; i++) {
 		// according to "Purdue University: Digital Image Processing Laboratory: Image Halftoning, April 30th, 2006
-		matrix[i] = (uint8_t)( 255 * (((double)dithervalue(i / l, i % l, order) + 0.5) / (l*l)) );
-	}
-
-	// perform the dithering
-	for (y = 0; y < height; y++) {
-		// scan left to right
-		bits = FreeImage_GetScanLine(dib, y);
-		new_bits = FreeImage_GetScanLine(new_dib, y);
-		for (x = 0; x < width; x++) {
-			if (bits[x] > matrix[(x % l) + l * (y % l)]) {
-				new_bits[x] = WHITE;
-			} else {
-				new_bits[x] = BLACK;
-			}
-		}
+		// a pixel is white when it is above its matrix value, i.e. >= value + 1 (the values are below 255)
+		matrix[i] = 1 + (uint8_t)( 255 * (((double)dithervalue(i / l, i % l, order) + 0.5) / (l*l)) );
 	}
 
-	free(matrix);
-
-	return new_dib;
+	// perform the dithering: pixel (x, y) uses matrix[(x % l) + l * (y % l)]
+	return PackThresholds(dib, TileThresholds(matrix.data(), l, 1, l, FreeImage_GetWidth(dib)), l);
 }
 
 // ==========================================================
@@ -205,9 +271,10 @@ static FIBITMAP* OrderedDispersedDot(FIBITMAP *dib, int order) {
 // See also : The newsprint web site at http://www.cl.cam.ac.uk/~and1000/newsprint/
 // for more technical info on this dithering technique
 //
+// Returns a 1-bit image
 static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 	// Order-3 clustered dithering matrix.
-	int cluster3[] = {
+	static const int cluster3[] = {
 	  9,11,10, 8, 6, 7,
 	  12,17,16, 5, 0, 1,
 	  13,14,15, 4, 3, 2,
@@ -217,7 +284,7 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 	};
 
 	// Order-4 clustered dithering matrix. 
-	int cluster4[] = {
+	static const int cluster4[] = {
 	  18,20,19,16,13,11,12,15,
 	  27,28,29,22, 4, 3, 2, 9,
 	  26,31,30,21, 5, 0, 1,10,
@@ -229,7 +296,7 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 	};
 
 	// Order-8 clustered dithering matrix. 
-	int cluster8[] = {
+	static const int cluster8[] = {
 	   64, 69, 77, 87, 86, 76, 68, 67, 63, 58, 50, 40, 41, 51, 59, 60,
 	   70, 94,100,109,108, 99, 93, 75, 57, 33, 27, 18, 19, 28, 34, 52,
 	   78,101,114,116,115,112, 98, 83, 49, 26, 13, 11, 12, 15, 29, 44,
@@ -248,57 +315,32 @@ static FIBITMAP* OrderedClusteredDot(FIBITMAP *dib, int order) {
 	   62, 55, 47, 37, 36, 46, 54, 61, 65, 72, 80, 90, 91, 81, 73, 66
 	};
 
-	int x, y, pixel;
-	uint8_t *bits, *new_bits;
-	FIBITMAP *new_dib{};
-
-	// allocate a 8-bit DIB
-	const int width = FreeImage_GetWidth(dib);
-	const int height = FreeImage_GetHeight(dib);
-	new_dib = FreeImage_Allocate(width, height, 8);
-	if (!new_dib) return nullptr;
-
 	// select the dithering matrix
-	int *matrix{};
+	const int *cluster{};
 	switch (order) {
 		case 3:
-			matrix = &cluster3[0];
+			cluster = cluster3;
 			break;
 		case 4:
-			matrix = &cluster4[0];
+			cluster = cluster4;
 			break;
 		case 8:
-			matrix = &cluster8[0];
+			cluster = cluster8;
 			break;
 		default:
 			return nullptr;
 	}
 
-	// scale the dithering matrix
+	// scale the dithering matrix (the largest value stays below 256)
 	int l = 2 * order;
 	int scale = 256 / (l * order);
-	for (y = 0; y < l; y++) {
-		for (x = 0; x < l; x++) {
-			matrix[y*l + x] *= scale;
-		}
+	std::vector<int> matrix(l * l);
+	for (int i = 0; i < l * l; i++) {
+		matrix[i] = cluster[i] * scale;
 	}
 
-	// perform the dithering
-	for (y = 0; y < height; y++) {
-		// scan left to right
-		bits = FreeImage_GetScanLine(dib, y);
-		new_bits = FreeImage_GetScanLine(new_dib, y);
-		for (x = 0; x < width; x++) {
-			pixel = bits[x];
-			if (pixel >= matrix[(y % l) + l * (x % l)]) {
-				new_bits[x] = WHITE;
-			} else {
-				new_bits[x] = BLACK;
-			}
-		}
-	}
-
-	return new_dib;
+	// perform the dithering: pixel (x, y) is white when >= matrix[(y % l) + l * (x % l)]
+	return PackThresholds(dib, TileThresholds(matrix.data(), l, l, 1, FreeImage_GetWidth(dib)), l);
 }
 
 
@@ -346,44 +388,42 @@ FreeImage_Dither(FIBITMAP *dib, FREE_IMAGE_DITHER algorithm) {
 	if (!input) return nullptr;
 
 	// Apply the dithering algorithm
+	// Ordered dithering gives 1-bit images, error diffusion a black and white 8-bit image
+	FIBITMAP *new_dib{};
 	switch (algorithm) {
 		case FID_FS:
 			dib8 = FloydSteinberg(input);
 			break;
 		case FID_BAYER4x4:
-			dib8 = OrderedDispersedDot(input, 2);
+			new_dib = OrderedDispersedDot(input, 2);
 			break;
 		case FID_BAYER8x8:
-			dib8 = OrderedDispersedDot(input, 3);
+			new_dib = OrderedDispersedDot(input, 3);
 			break;
 		case FID_BAYER16x16:
-			dib8 = OrderedDispersedDot(input, 4);
+			new_dib = OrderedDispersedDot(input, 4);
 			break;
 		case FID_CLUSTER6x6:
-			dib8 = OrderedClusteredDot(input, 3);
+			new_dib = OrderedClusteredDot(input, 3);
 			break;
 		case FID_CLUSTER8x8:
-			dib8 = OrderedClusteredDot(input, 4);
+			new_dib = OrderedClusteredDot(input, 4);
 			break;
 		case FID_CLUSTER16x16:
-			dib8 = OrderedClusteredDot(input, 8);
+			new_dib = OrderedClusteredDot(input, 8);
 			break;
 	}
 	if (input != dib) {
 		FreeImage_Unload(input);
 	}
 
-	// Build a greyscale palette (needed by threshold)
-	FIRGBA8 *grey_pal = FreeImage_GetPalette(dib8);
-	for (int i = 0; i < 256; i++) {
-		grey_pal[i].red	= (uint8_t)i;
-		grey_pal[i].green = (uint8_t)i;
-		grey_pal[i].blue	= (uint8_t)i;
+	if (dib8) {
+		// Convert to 1-bit
+		const std::vector<uint8_t> thresholds(FreeImage_GetWidth(dib8), 128);
+		new_dib = PackThresholds(dib8, thresholds, 1);
+		FreeImage_Unload(dib8);
 	}
-
-	// Convert to 1-bit
-	FIBITMAP *new_dib = FreeImage_Threshold(dib8, 128);
-	FreeImage_Unload(dib8);
+	if (!new_dib) return nullptr;
 
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(new_dib, dib);
@@ -434,34 +474,14 @@ FreeImage_Threshold(FIBITMAP *dib, uint8_t T) {
 	}
 	if (!dib8) return nullptr;
 
-	// Allocate a new 1-bit DIB
-	const int width = FreeImage_GetWidth(dib);
-	const int height = FreeImage_GetHeight(dib);
-	FIBITMAP *new_dib = FreeImage_Allocate(width, height, 1);
-	if (!new_dib) return nullptr;
-	// Build a monochrome palette
-	FIRGBA8 *pal = FreeImage_GetPalette(new_dib);
-	pal[0].red = pal[0].green = pal[0].blue = 0;
-	pal[1].red = pal[1].green = pal[1].blue = 255;
-
-	// Perform the thresholding
+	// Perform the thresholding in row bands
 	//
-	for (int y = 0; y < height; y++) {
-		const uint8_t *bits8 = FreeImage_GetScanLine(dib8, y);
-		uint8_t *bits1 = FreeImage_GetScanLine(new_dib, y);
-		for (int x = 0; x < width; x++) {
-			if (bits8[x] < T) {
-				// Set bit(x, y) to 0
-				bits1[x >> 3] &= (0xFF7F >> (x & 0x7));
-			} else {
-				// Set bit(x, y) to 1
-				bits1[x >> 3] |= (0x80 >> (x & 0x7));
-			}
-		}
-	}
+	const std::vector<uint8_t> thresholds(FreeImage_GetWidth(dib8), T);
+	FIBITMAP *new_dib = PackThresholds(dib8, thresholds, 1);
 	if (dib8 != dib) {
 		FreeImage_Unload(dib8);
 	}
+	if (!new_dib) return nullptr;
 
 	// copy metadata from src to dst
 	FreeImage_CloneMetadata(new_dib, dib);
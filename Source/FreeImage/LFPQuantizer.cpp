@@ -46,6 +46,8 @@ FIBITMAP* LFPQuantizer::Quantize(FIBITMAP *dib, int ReserveSize, FIRGBA8 *Reserv
 	if (!dib8) {
 		return nullptr;
 	}
+	// the pixels are mapped in memory order
+	FreeImage_SetTopDown(dib8, FreeImage_IsTopDown(dib));
 
 	const unsigned src_pitch = FreeImage_GetPitch(dib);
 	const unsigned dst_pitch = FreeImage_GetPitch(dib8);
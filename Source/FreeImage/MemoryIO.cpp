@@ -90,6 +90,18 @@ FreeImage_LoadFromMemory(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, int flags) {
 	return nullptr;
 }
 
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadAsFromMemory(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, FREE_IMAGE_TYPE type, unsigned bpp, int flags) {
+	if (stream && stream->data) {
+		FreeImageIO io;
+		SetMemoryIO(&io);
+
+		return FreeImage_LoadAsFromHandle(fif, &io, (fi_handle)stream, type, bpp, flags);
+	}
+
+	return nullptr;
+}
+
 
 FIBOOL DLL_CALLCONV
 FreeImage_SaveToMemory(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FIMEMORY *stream, int flags) {
@@ -34,6 +34,7 @@
 #include "CacheFile.h"
 #include "FreeImageIO.h"
 #include "Plugin.h"
+#include "ThreadPool.h"
 #include "Utilities.h"
 #include "FreeImage.h"
 
@@ -95,6 +96,219 @@ typedef BlockList::iterator BlockListIterator;
 
 // ----------------------------------------------------------
 
+/**
+Where worker threads read source pages from. Every decode opens its own
+reader, so workers never share the seek position of the bitmap's handle.
+*/
+struct PrefetchSource {
+	PluginNodeBase *node{};
+	int flags{};
+	std::string filename;		// set for bitmaps opened from a file
+	uint8_t *data{};			// otherwise, the buffer of a memory stream
+	uint32_t size{};
+};
+
+static FIBITMAP *
+DecodeSourcePage(const PrefetchSource& source, int page) {
+	FreeImageIO io;
+	fi_handle handle{};
+	FILE *file{};
+	FIMEMORY *stream{};
+
+	if (!source.filename.empty()) {
+		SetDefaultIO(&io);
+		handle = file = fopen(source.filename.c_str(), "rb");
+	} else {
+		SetMemoryIO(&io);
+		handle = stream = FreeImage_OpenMemory(source.data, source.size);
+	}
+	if (!handle) {
+		return nullptr;
+	}
+
+	FIBITMAP *dib{};
+	if (void *data = source.node->Open(&io, handle, true)) {
+		dib = source.node->Load(&io, handle, page, source.flags, data);
+		source.node->Close(&io, handle, data);
+	}
+
+	if (file) {
+		fclose(file);
+	}
+	if (stream) {
+		FreeImage_CloseMemory(stream);
+	}
+	return dib;
+}
+
+/**
+Read-ahead of source pages for FreeImage_LockPage.
+Pages are keyed by their index in the source file and decoded on the shared thread pool.
+At most 'depth' pages are queued or kept decoded at any time.
+*/
+class PagePrefetcher {
+public :
+	PagePrefetcher() : m_state(std::make_shared<State>()) {
+	}
+
+	~PagePrefetcher() {
+		shutdown();
+	}
+
+	PagePrefetcher(const PagePrefetcher&) = delete;
+	PagePrefetcher& operator=(const PagePrefetcher&) = delete;
+
+	int getDepth() const {
+		return m_depth;
+	}
+
+	void setDepth(int depth) {
+		m_depth = std::max(depth, 0);
+		if (m_depth == 0) {
+			schedule(PrefetchSource(), {});
+		}
+	}
+
+	/**
+	Hands out a prefetched page, waiting for it if a worker is decoding it right now.
+	Returns nullptr when the page has to be decoded by the caller.
+	*/
+	FIBITMAP *take(int page) {
+		std::unique_lock<std::mutex> lock(m_state->mutex);
+
+		auto i = m_slots.find(page);
+		if (i == m_slots.end()) {
+			m_state->stats.misses++;
+			return nullptr;
+		}
+		std::shared_ptr<Slot> slot = i->second;
+		m_slots.erase(i);
+
+		if (!slot->started) {
+			// still queued behind other work, decoding here is faster than waiting
+			slot->cancelled = true;
+			m_state->stats.misses++;
+			return nullptr;
+		}
+		if (!slot->done) {
+			m_state->stats.waits++;
+			m_state->condition.wait(lock, [&slot]() { return slot->done; });
+		}
+
+		FIBITMAP *dib = slot->dib;
+		slot->dib = nullptr;
+		if (dib) {
+			m_state->stats.hits++;
+		} else {
+			m_state->stats.misses++;
+		}
+		return dib;
+	}
+
+	/**
+	Makes the given source pages the read-ahead window: pages that fell out of it are discarded,
+	new ones are queued on the thread pool.
+	*/
+	void schedule(const PrefetchSource& source, const std::vector<int>& pages) {
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+
+		for (auto i = m_slots.begin(); i != m_slots.end(); ) {
+			if (std::find(pages.begin(), pages.end(), i->first) == pages.end()) {
+				discard(*i->second);
+				i = m_slots.erase(i);
+			} else {
+				++i;
+			}
+		}
+
+		for (int page : pages) {
+			if (m_slots.count(page)) {
+				continue;
+			}
+			auto slot = std::make_shared<Slot>();
+			m_slots[page] = slot;
+
+			ThreadPool::Instance().submit([state = m_state, slot, source, page]() {
+				{
+					std::lock_guard<std::mutex> lock(state->mutex);
+					if (state->closed || slot->cancelled) {
+						slot->done = true;
+						return;
+					}
+					slot->started = true;
+					state->running++;
+				}
+
+				FIBITMAP *dib = DecodeSourcePage(source, page);
+
+				{
+					std::lock_guard<std::mutex> lock(state->mutex);
+					state->running--;
+					if (state->closed || slot->cancelled) {
+						FreeImage_Unload(dib);
+					} else {
+						slot->dib = dib;
+					}
+					slot->done = true;
+				}
+				state->condition.notify_all();
+			});
+		}
+	}
+
+	/**
+	Drops every prefetched page and waits for the pages being decoded.
+	Queued pages that did not start yet are skipped by the workers.
+	*/
+	void shutdown() {
+		std::unique_lock<std::mutex> lock(m_state->mutex);
+		m_state->closed = true;
+		for (auto& slot : m_slots) {
+			discard(*slot.second);
+		}
+		m_slots.clear();
+		m_state->condition.wait(lock, [this]() { return m_state->running == 0; });
+	}
+
+	FIPAGEPREFETCHSTATS getStatistics() const {
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		return m_state->stats;
+	}
+
+private :
+	struct Slot {
+		bool started{};
+		bool done{};
+		bool cancelled{};
+		FIBITMAP *dib{};
+	};
+
+	struct State {
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool closed{};
+		int running{};
+		FIPAGEPREFETCHSTATS stats{};
+	};
+
+	// must be called with the state mutex held
+	void discard(Slot& slot) {
+		slot.cancelled = true;
+		if (slot.dib) {
+			FreeImage_Unload(slot.dib);
+			slot.dib = nullptr;
+		}
+		m_state->stats.discarded++;
+	}
+
+private :
+	std::shared_ptr<State> m_state;
+	std::map<int, std::shared_ptr<Slot>> m_slots;
+	int m_depth{};
+};
+
+// ----------------------------------------------------------
+
 struct MULTIBITMAPHEADER {
 
 	MULTIBITMAPHEADER()
@@ -104,7 +318,7 @@ struct MULTIBITMAPHEADER {
 		, changed(FALSE)
 		, page_count(0)
 		, read_only(TRUE)
-		, cache_fif(fif)
+		, compress_cache(FALSE)
 		, load_flags(0)
 	{
 		SetDefaultIO(&io);
@@ -121,8 +335,10 @@ struct MULTIBITMAPHEADER {
 	BlockList m_blocks;
 	std::string m_filename;
 	FIBOOL read_only;
-	FREE_IMAGE_FORMAT cache_fif;
+	FIBOOL compress_cache;
 	int load_flags;
+	FIMEMORY *memory_stream{};
+	std::unique_ptr<PagePrefetcher> prefetcher;
 };
 
 // =====================================================================
@@ -220,6 +436,73 @@ FreeImage_FindBlock(FIMULTIBITMAP *bitmap, int position) {
 	return header->m_blocks.end();
 }
 
+/**
+Describes how worker threads can read the source of the bitmap on their own.
+Returns FALSE for bitmaps opened from a user handle, which cannot be reopened,
+and for plugins that do not declare that their pages can be loaded concurrently.
+*/
+static FIBOOL
+FreeImage_GetPrefetchSource(MULTIBITMAPHEADER *header, PrefetchSource& source) {
+	const PluginPageCodec *codec = header->node->GetPageCodec();
+	if (!codec || !codec->concurrent_load) {
+		return FALSE;
+	}
+	source.node = header->node;
+	source.flags = header->load_flags;
+	if (!header->m_filename.empty()) {
+		source.filename = header->m_filename;
+		return TRUE;
+	}
+	return header->memory_stream && FreeImage_AcquireMemory(header->memory_stream, &source.data, &source.size);
+}
+
+/**
+Queues the source pages following 'position' for read-ahead.
+Pages that live in the cache are cheap to restore and are not prefetched.
+*/
+static void
+FreeImage_SchedulePrefetch(MULTIBITMAPHEADER *header, int position) {
+	PrefetchSource source;
+	if (!FreeImage_GetPrefetchSource(header, source)) {
+		return;
+	}
+
+	const int depth = header->prefetcher->getDepth();
+
+	std::vector<int> pages;
+	pages.reserve(depth);
+
+	int count = 0;
+	for (BlockListIterator i = header->m_blocks.begin(); (i != header->m_blocks.end()) && (count < position + depth); ++i) {
+		const int block_pages = i->getPageCount();
+		if (i->m_type == BLOCK_CONTINUEUS) {
+			const int first = std::max(position, count);
+			const int last = std::min(position + depth, count + block_pages);
+			for (int j = first; j < last; j++) {
+				pages.push_back(i->getStart() + (j - count));
+			}
+		}
+		count += block_pages;
+	}
+
+	header->prefetcher->schedule(source, pages);
+}
+
+/**
+Reads a page stored as a BLOCK_REFERENCE back from the cache
+*/
+static FIBITMAP *
+FreeImage_LoadPageFromCache(MULTIBITMAPHEADER *header, const PageBlock& block) {
+	assert(block.m_type == BLOCK_REFERENCE);
+
+	std::vector<uint8_t> spool(block.getSize());
+	if (!header->m_cachefile.readFile(spool.data(), block.getReference(), block.getSize())) {
+		return nullptr;
+	}
+
+	return FreeImage_UnspoolPage(spool.data(), spool.size());
+}
+
 int DLL_CALLCONV
 FreeImage_InternalGetPageCount(FIMULTIBITMAP *bitmap) {
 	if (bitmap) {
@@ -266,7 +549,6 @@ FreeImage_OpenMultiBitmap(FREE_IMAGE_FORMAT fif, const char *filename, FIBOOL cr
 				header->fif = fif;
 				header->handle = handle;
 				header->read_only = read_only;
-				header->cache_fif = fif;
 				header->load_flags = flags;
 
 				// store the MULTIBITMAPHEADER in the surrounding FIMULTIBITMAP structure
@@ -329,7 +611,6 @@ FreeImage_OpenMultiBitmapFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_h
 					header->fif = fif;
 					header->handle = handle;
 					header->read_only = read_only;
-					header->cache_fif = fif;
 					header->load_flags = flags;
 
 					// store the MULTIBITMAPHEADER in the surrounding FIMULTIBITMAP structure
@@ -357,6 +638,144 @@ FreeImage_OpenMultiBitmapFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_h
 	return nullptr;
 }
 
+/** A page ready for the writer: a bitmap to save, or a page encoded by the plugin page codec */
+struct PreparedPage {
+	FIBITMAP *dib{};
+	FIMEMORY *stream{};
+};
+
+/**
+Writes all pages of a multipage bitmap through 'node'.
+Pages are decoded on worker threads when 'source' is given, otherwise by the writer through the
+bitmap's own handle. Cached pages are restored on worker threads. When the plugin has a page codec,
+the pages are also encoded into memory on worker threads. The writer appends them in page order.
+*/
+static FIBOOL
+FreeImage_SavePagesInParallel(MULTIBITMAPHEADER *header, const PrefetchSource *source, PluginNodeBase *node, FreeImageIO *io, fi_handle handle, int flags) {
+	ThreadPool& pool = ThreadPool::Instance();
+
+	const PluginPageCodec *codec = node->GetPageCodec();
+	if (codec && !codec->encode_proc) {
+		codec = nullptr;
+	}
+
+	// one entry per page, in output order
+
+	std::vector<PageBlock> pages;
+	for (const PageBlock& block : header->m_blocks) {
+		if (block.m_type == BLOCK_CONTINUEUS) {
+			for (int j = block.getStart(); j <= block.getEnd(); j++) {
+				pages.push_back(PageBlock(BLOCK_CONTINUEUS, j, j));
+			}
+		} else {
+			pages.push_back(block);
+		}
+	}
+
+	// src data, when the workers cannot read the source on their own
+
+	void *data_read{};
+	if (!source && header->handle) {
+		header->io.seek_proc(header->handle, 0, SEEK_SET);
+		data_read = header->node->Open(&header->io, header->handle, true);
+	}
+
+	// bound the number of pages waiting for the writer
+
+	const size_t window = 2 * (size_t)pool.getThreadCount();
+	std::deque<std::future<PreparedPage>> pending;
+	size_t next = 0;
+
+	auto prepare = [codec, flags](FIBITMAP *dib, int page) {
+		PreparedPage prepared;
+		if (!codec || !dib) {
+			prepared.dib = dib;
+			return prepared;
+		}
+		prepared.stream = FreeImage_OpenMemory();
+		if (prepared.stream && !codec->encode_proc(dib, page, flags, prepared.stream)) {
+			FreeImage_CloseMemory(prepared.stream);
+			prepared.stream = nullptr;
+		}
+		FreeImage_Unload(dib);
+		return prepared;
+	};
+
+	auto submit = [&](const PageBlock& block, int page) {
+		if (block.m_type == BLOCK_CONTINUEUS) {
+			const int source_page = block.getStart();
+			if (source) {
+				return pool.submit([source, source_page, page, prepare]() { return prepare(DecodeSourcePage(*source, source_page), page); });
+			}
+			FIBITMAP *dib = header->node->Load(&header->io, header->handle, source_page, header->load_flags, data_read);
+			return pool.submit([dib, page, prepare]() { return prepare(dib, page); });
+		}
+		// the cache is not thread safe, read it here and rebuild the page on a worker
+		auto spool = std::make_shared<std::vector<uint8_t>>(block.getSize());
+		if (!header->m_cachefile.readFile(spool->data(), block.getReference(), block.getSize())) {
+			spool->clear();
+		}
+		return pool.submit([spool, page, prepare]() { return prepare(FreeImage_UnspoolPage(spool->data(), spool->size()), page); });
+	};
+
+	FIBOOL success = TRUE;
+
+	// dst data
+	void *data = codec ? codec->begin_proc(io, handle, (int)pages.size(), flags) : node->Open(io, handle, false);
+	if (codec && !data) {
+		success = FALSE;
+	}
+
+	try {
+		for (int count = 0; success && (count < (int)pages.size()); count++) {
+			while ((pending.size() < window) && (next < pages.size())) {
+				pending.push_back(submit(pages[next], (int)next));
+				next++;
+			}
+
+			PreparedPage page = pending.front().get();
+			pending.pop_front();
+
+			if (codec) {
+				success = page.stream ? codec->append_proc(io, handle, page.stream, data) : FALSE;
+				FreeImage_CloseMemory(page.stream);
+			} else {
+				success = page.dib ? node->Save(page.dib, io, handle, count, flags, data) : FALSE;
+				FreeImage_Unload(page.dib);
+			}
+		}
+	} catch (std::exception &) {
+		success = FALSE;
+	}
+
+	// pages already queued reference 'source', wait for them before returning
+
+	for (auto& pending_page : pending) {
+		try {
+			PreparedPage page = pending_page.get();
+			FreeImage_Unload(page.dib);
+			FreeImage_CloseMemory(page.stream);
+		} catch (std::exception &) {
+		}
+	}
+
+	// close the files
+
+	if (!source) {
+		header->node->Close(&header->io, header->handle, data_read);
+	}
+
+	if (codec) {
+		if (data) {
+			success = codec->end_proc(io, handle, success, data);
+		}
+	} else {
+		node->Close(io, handle, data);
+	}
+
+	return success;
+}
+
 FIBOOL DLL_CALLCONV
 FreeImage_SaveMultiBitmapToHandle(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap, FreeImageIO *io, fi_handle handle, int flags) {
 	if (!bitmap || !bitmap->data || !io || !handle) {
@@ -372,6 +791,17 @@ FreeImage_SaveMultiBitmapToHandle(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap,
 		if (auto node = plugins->FindFromFIF(fif)) {
 			auto *header = FreeImage_GetMultiBitmapHeader(bitmap);
 
+			// pages are decoded on worker threads when the source plugin allows it and the workers
+			// can read the source on their own, and encoded on worker threads when the destination
+			// plugin has a page codec; other plugins are saved serially
+
+			PrefetchSource source;
+			const FIBOOL concurrent_load = FreeImage_GetPrefetchSource(header, source);
+			const PluginPageCodec *codec = node->GetPageCodec();
+			if ((concurrent_load || (codec && codec->encode_proc)) && (FreeImage_GetPageCount(bitmap) > 0)) {
+				return FreeImage_SavePagesInParallel(header, concurrent_load ? &source : nullptr, node, io, handle, flags);
+			}
+
 			// dst data
 			void *data = node->Open(io, handle, false);
 			// src data
@@ -409,20 +839,13 @@ FreeImage_SaveMultiBitmapToHandle(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *bitmap,
 
 						case BLOCK_REFERENCE:
 						{
-							// read the compressed data
-
-							auto *compressed_data = (uint8_t*)malloc(i->getSize() * sizeof(uint8_t));
-							
-							header->m_cachefile.readFile((uint8_t *)compressed_data, i->getReference(), i->getSize());
-
-							// uncompress the data
+							// read the spooled page back from the cache
 
-							FIMEMORY *hmem = FreeImage_OpenMemory(compressed_data, i->getSize());
-							FIBITMAP *dib = FreeImage_LoadFromMemory(header->cache_fif, hmem, 0);
-							FreeImage_CloseMemory(hmem);
-
-							// get rid of the buffer
-							free(compressed_data);
+							FIBITMAP *dib = FreeImage_LoadPageFromCache(header, *i);
+							if (!dib) {
+								success = FALSE;
+								break;
+							}
 
 							// save the data
 
@@ -462,6 +885,10 @@ FreeImage_CloseMultiBitmap(FIMULTIBITMAP *bitmap, int flags) {
 
 		if (auto *header = FreeImage_GetMultiBitmapHeader(bitmap)) {
 
+			// stop the read-ahead before the source goes away
+
+			header->prefetcher.reset();
+
 			// saves changes only of images loaded directly from a file
 			if (header->changed && !header->m_filename.empty()) {
 				try {
@@ -562,34 +989,18 @@ FreeImage_SavePageToBlock(MULTIBITMAPHEADER *header, FIBITMAP *data) {
 		return res;
 	}
 
-	uint32_t compressed_size = 0;
-	uint8_t *compressed_data{};
+	// spool the bitmap data
 
-	// compress the bitmap data
-
-	// open a memory handle
-	FIMEMORY *hmem = FreeImage_OpenMemory();
-	if (!hmem) {
-		return res;
-	}
-	// save the file to memory
-	if (!FreeImage_SaveToMemory(header->cache_fif, data, hmem, 0)) {
-		FreeImage_CloseMemory(hmem);
+	std::vector<uint8_t> spool;
+	if (!FreeImage_SpoolPage(data, header->compress_cache, spool) || (spool.size() > (size_t)std::numeric_limits<int>::max())) {
 		return res;
 	}
-	// get the buffer from the memory stream
-	if (!FreeImage_AcquireMemory(hmem, &compressed_data, &compressed_size)) {
-		FreeImage_CloseMemory(hmem);
-		return res;
+
+	// write the spooled data to the cache
+	if (const int ref = header->m_cachefile.writeFile(spool.data(), (int)spool.size())) {
+		res = PageBlock(BLOCK_REFERENCE, ref, (int)spool.size());
 	}
 
-	// write the compressed data to the cache
-	int ref = header->m_cachefile.writeFile(compressed_data, compressed_size);
-	// get rid of the compressed data
-	FreeImage_CloseMemory(hmem);
-	
-	res = PageBlock(BLOCK_REFERENCE, ref, compressed_size);
-	
 	return res;
 }
 
@@ -676,30 +1087,57 @@ FreeImage_LockPage(FIMULTIBITMAP *bitmap, int page) {
 			}
 		}
 
-		// open the bitmap
+		if ((page < 0) || (page >= FreeImage_GetPageCount(bitmap))) {
+			return nullptr;
+		}
 
-		header->io.seek_proc(header->handle, 0, SEEK_SET);
+		// pages that were modified, inserted or appended live in the cache
 
-		void *data = header->node->Open(&header->io, header->handle, true);
+		BlockListIterator block = FreeImage_FindBlock(bitmap, page);
+		if (block == header->m_blocks.end()) {
+			return nullptr;
+		}
 
-		// load the bitmap data
+		if (block->m_type == BLOCK_REFERENCE) {
+			FIBITMAP *dib = FreeImage_LoadPageFromCache(header, *block);
+			if (dib) {
+				header->locked_pages[dib] = page;
+			}
+			return dib;
+		}
 
-		if (data) {
-			FIBITMAP* dib = header->node->Load(&header->io, header->handle, page, header->load_flags, data);
+		const int source_page = block->getStart();
 
-			// close the file
+		// the page may already have been decoded by the read-ahead
 
-			header->node->Close(&header->io, header->handle, data);
+		FIBITMAP *dib{};
+		if (header->prefetcher) {
+			dib = header->prefetcher->take(source_page);
+			FreeImage_SchedulePrefetch(header, page + 1);
+		}
 
-			// if there was still another bitmap open, get rid of it
+		if (!dib) {
+			// open the bitmap
 
-			if (dib) {
-				header->locked_pages[dib] = page;
+			header->io.seek_proc(header->handle, 0, SEEK_SET);
+
+			void *data = header->node->Open(&header->io, header->handle, true);
+
+			// load the bitmap data
 
-				return dib;
+			if (data) {
+				dib = header->node->Load(&header->io, header->handle, source_page, header->load_flags, data);
+
+				// close the file
+
+				header->node->Close(&header->io, header->handle, data);
 			}
+		}
 
-			return nullptr;
+		if (dib) {
+			header->locked_pages[dib] = page;
+
+			return dib;
 		}
 	}
 
@@ -723,31 +1161,21 @@ FreeImage_UnlockPage(FIMULTIBITMAP *bitmap, FIBITMAP *page, FIBOOL changed) {
 
 				BlockListIterator i = FreeImage_FindBlock(bitmap, header->locked_pages[page]);
 
-				// compress the data
+				// spool the data
 
-				uint32_t compressed_size = 0;
-				uint8_t *compressed_data{};
+				std::vector<uint8_t> spool;
+				if (FreeImage_SpoolPage(page, header->compress_cache, spool) && (spool.size() <= (size_t)std::numeric_limits<int>::max())) {
 
-				// open a memory handle
-				FIMEMORY *hmem = FreeImage_OpenMemory();
-				// save the page to memory
-				FreeImage_SaveToMemory(header->cache_fif, page, hmem, 0);
-				// get the buffer from the memory stream
-				FreeImage_AcquireMemory(hmem, &compressed_data, &compressed_size);
-
-				// write the data to the cache
-				
-				if (i->m_type == BLOCK_REFERENCE) {
-					header->m_cachefile.deleteFile(i->getReference());
-				}
+					// write the data to the cache
 
-				int iPage = header->m_cachefile.writeFile(compressed_data, compressed_size);
-				
-				*i = PageBlock(BLOCK_REFERENCE, iPage, compressed_size);
-				
-				// get rid of the compressed data
+					if (const int iPage = header->m_cachefile.writeFile(spool.data(), (int)spool.size())) {
+						if (i->m_type == BLOCK_REFERENCE) {
+							header->m_cachefile.deleteFile(i->getReference());
+						}
 
-				FreeImage_CloseMemory(hmem);
+						*i = PageBlock(BLOCK_REFERENCE, iPage, (int)spool.size());
+					}
+				}
 			}
 
 			// reset the locked page so that another page can be locked
@@ -809,6 +1237,92 @@ FreeImage_GetLockedPageNumbers(FIMULTIBITMAP *bitmap, int *pages, int *count) {
 	return FALSE;
 }
 
+FIBOOL DLL_CALLCONV
+FreeImage_SetPageCacheBudget(FIMULTIBITMAP *bitmap, uint64_t max_memory_bytes) {
+	if (bitmap) {
+		auto *header = FreeImage_GetMultiBitmapHeader(bitmap);
+
+		header->m_cachefile.setMemoryBudget((size_t)std::min<uint64_t>(max_memory_bytes, std::numeric_limits<size_t>::max()));
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_SetPageCacheCompression(FIMULTIBITMAP *bitmap, FIBOOL compress) {
+	if (bitmap) {
+		auto *header = FreeImage_GetMultiBitmapHeader(bitmap);
+
+		header->compress_cache = compress ? TRUE : FALSE;
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_SetPagePrefetch(FIMULTIBITMAP *bitmap, int depth) {
+	if (bitmap) {
+		auto *header = FreeImage_GetMultiBitmapHeader(bitmap);
+
+		// workers need a source they can open on their own, and a plugin that loads concurrently
+		PrefetchSource source;
+		if (!FreeImage_GetPrefetchSource(header, source)) {
+			return FALSE;
+		}
+
+		try {
+			if (!header->prefetcher) {
+				if (depth <= 0) {
+					return TRUE;
+				}
+				header->prefetcher = std::make_unique<PagePrefetcher>();
+			}
+			header->prefetcher->setDepth(depth);
+
+			return TRUE;
+		} catch (std::exception &) {
+			// std::bad_alloc or std::system_error when no thread could be started
+		}
+	}
+
+	return FALSE;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_GetPagePrefetchStats(FIMULTIBITMAP *bitmap, FIPAGEPREFETCHSTATS *stats) {
+	if ((bitmap) && (stats)) {
+		auto *header = FreeImage_GetMultiBitmapHeader(bitmap);
+
+		*stats = header->prefetcher ? header->prefetcher->getStatistics() : FIPAGEPREFETCHSTATS{};
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_GetPageCacheStats(FIMULTIBITMAP *bitmap, FIPAGECACHESTATS *stats) {
+	if ((bitmap) && (stats)) {
+		auto *header = FreeImage_GetMultiBitmapHeader(bitmap);
+
+		const CacheFile::Statistics& cache_stats = header->m_cachefile.getStatistics();
+		stats->hits = cache_stats.hits;
+		stats->misses = cache_stats.misses;
+		stats->spills = cache_stats.spills;
+		stats->memory_bytes = cache_stats.memory_bytes;
+		stats->spilled_bytes = cache_stats.spilled_bytes;
+
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
 // =====================================================================
 // Memory IO Multipage functions
 // =====================================================================
@@ -833,8 +1347,8 @@ FreeImage_LoadMultiBitmapFromMemory(FREE_IMAGE_FORMAT fif, FIMEMORY *stream, int
 					header->fif = fif;
 					SetMemoryIO(&header->io);
 					header->handle = (fi_handle)stream;
+					header->memory_stream = stream;
 					header->read_only = read_only;
-					header->cache_fif = fif;
 					header->load_flags = flags;
 
 					// store the MULTIBITMAPHEADER in the surrounding FIMULTIBITMAP structure
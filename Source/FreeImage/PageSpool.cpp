@@ -0,0 +1,425 @@
+// ==========================================================
+// Multi-Page functions : page spool format
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "zlib.h"
+#include "CacheFile.h"
+
+// ----------------------------------------------------------
+//
+// A spooled page is the FIBITMAP as it lives in memory, so that pages
+// of the multipage cache never go through the document codec:
+//
+//   SPOOLHEADER
+//   payload (optionally deflated at the fastest level) :
+//     type, width, height, bpp, masks, resolution, pixel flag,
+//     palette, transparency, background color,
+//     ICC profile, metadata of every model, thumbnail (nested page),
+//     pixel rows without padding
+//
+// The format is private to the running process: it is native endian
+// and has no compatibility guarantees.
+//
+// ----------------------------------------------------------
+
+static const uint32_t SPOOL_MAGIC = 0x50534946;	// "FISP"
+static const uint32_t SPOOL_COMPRESSED = 0x01;
+
+struct SPOOLHEADER {
+	uint32_t magic;
+	uint32_t flags;
+	uint64_t payload_size;	// uncompressed size of the payload
+};
+
+namespace {
+
+class SpoolWriter {
+public:
+	explicit SpoolWriter(std::vector<uint8_t>& buffer) : m_buffer(buffer) {
+	}
+
+	void write(const void *data, size_t size) {
+		const auto *bytes = static_cast<const uint8_t *>(data);
+		m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+	}
+
+	template <typename T>
+	void put(const T& value) {
+		write(&value, sizeof(T));
+	}
+
+	void putString(const char *str) {
+		const uint32_t length = str ? (uint32_t)strlen(str) : 0;
+		put(length);
+		write(str, length);
+	}
+
+private:
+	std::vector<uint8_t>& m_buffer;
+};
+
+class SpoolReader {
+public:
+	SpoolReader(const uint8_t *data, size_t size) : m_data(data), m_end(data + size) {
+	}
+
+	bool read(void *data, size_t size) {
+		if ((size_t)(m_end - m_data) < size) {
+			return false;
+		}
+		if (size) {
+			memcpy(data, m_data, size);
+			m_data += size;
+		}
+		return true;
+	}
+
+	template <typename T>
+	bool get(T& value) {
+		return read(&value, sizeof(T));
+	}
+
+	const uint8_t *skip(size_t size) {
+		if ((size_t)(m_end - m_data) < size) {
+			return nullptr;
+		}
+		const uint8_t *data = m_data;
+		m_data += size;
+		return data;
+	}
+
+	bool getString(std::string& str) {
+		uint32_t length = 0;
+		if (!get(length)) {
+			return false;
+		}
+		const uint8_t *data = skip(length);
+		if (!data) {
+			return false;
+		}
+		str.assign((const char *)data, length);
+		return true;
+	}
+
+private:
+	const uint8_t *m_data;
+	const uint8_t *m_end;
+};
+
+// ----------------------------------------------------------
+
+void
+WriteBitmap(SpoolWriter& writer, FIBITMAP *dib) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned line = FreeImage_GetLine(dib);
+
+	writer.put((int32_t)FreeImage_GetImageType(dib));
+	writer.put((uint32_t)width);
+	writer.put((uint32_t)height);
+	writer.put((uint32_t)FreeImage_GetBPP(dib));
+	writer.put((uint32_t)FreeImage_GetRedMask(dib));
+	writer.put((uint32_t)FreeImage_GetGreenMask(dib));
+	writer.put((uint32_t)FreeImage_GetBlueMask(dib));
+	writer.put((uint32_t)FreeImage_GetDotsPerMeterX(dib));
+	writer.put((uint32_t)FreeImage_GetDotsPerMeterY(dib));
+
+	const int32_t has_pixels = FreeImage_HasPixels(dib);
+	writer.put(has_pixels);
+
+	// palette
+
+	const uint32_t colors = FreeImage_GetColorsUsed(dib);
+	writer.put(colors);
+	writer.write(FreeImage_GetPalette(dib), colors * sizeof(FIRGBA8));
+
+	// transparency
+
+	const uint32_t transparency_count = FreeImage_GetTransparencyCount(dib);
+	writer.put((int32_t)FreeImage_IsTransparent(dib));
+	writer.put(transparency_count);
+	writer.write(FreeImage_GetTransparencyTable(dib), transparency_count);
+
+	// background color
+
+	FIRGBA8 bkcolor{};
+	const int32_t has_bkcolor = FreeImage_GetBackgroundColor(dib, &bkcolor);
+	writer.put(has_bkcolor);
+	writer.put(bkcolor);
+
+	// ICC profile
+
+	const FIICCPROFILE *icc = FreeImage_GetICCProfile(dib);
+	writer.put((uint16_t)icc->flags);
+	writer.put((uint32_t)icc->size);
+	writer.write(icc->data, icc->size);
+
+	// metadata
+
+	for (int model = FIMD_COMMENTS; model <= FIMD_EXIF_RAW; model++) {
+		const uint32_t count = FreeImage_GetMetadataCount((FREE_IMAGE_MDMODEL)model, dib);
+		writer.put(count);
+		if (count == 0) {
+			continue;
+		}
+		FITAG *tag{};
+		FIMETADATA *mdhandle = FreeImage_FindFirstMetadata((FREE_IMAGE_MDMODEL)model, dib, &tag);
+		if (mdhandle) {
+			do {
+				writer.putString(FreeImage_GetTagKey(tag));
+				writer.putString(FreeImage_GetTagDescription(tag));
+				writer.put((uint16_t)FreeImage_GetTagID(tag));
+				writer.put((uint16_t)FreeImage_GetTagType(tag));
+				writer.put((uint32_t)FreeImage_GetTagCount(tag));
+				writer.put((uint32_t)FreeImage_GetTagLength(tag));
+				writer.write(FreeImage_GetTagValue(tag), FreeImage_GetTagLength(tag));
+			} while (FreeImage_FindNextMetadata(mdhandle, &tag));
+
+			FreeImage_FindCloseMetadata(mdhandle);
+		}
+	}
+
+	// thumbnail
+
+	FIBITMAP *thumbnail = FreeImage_GetThumbnail(dib);
+	writer.put((int32_t)(thumbnail ? 1 : 0));
+	if (thumbnail) {
+		WriteBitmap(writer, thumbnail);
+	}
+
+	// pixels
+
+	if (has_pixels) {
+		for (unsigned y = 0; y < height; y++) {
+			writer.write(FreeImage_GetScanLine(dib, y), line);
+		}
+	}
+}
+
+FIBITMAP *
+ReadBitmap(SpoolReader& reader) {
+	int32_t type = 0;
+	uint32_t width = 0, height = 0, bpp = 0;
+	uint32_t red_mask = 0, green_mask = 0, blue_mask = 0;
+	uint32_t dpm_x = 0, dpm_y = 0;
+	int32_t has_pixels = 0;
+
+	if (!reader.get(type) || !reader.get(width) || !reader.get(height) || !reader.get(bpp)
+		|| !reader.get(red_mask) || !reader.get(green_mask) || !reader.get(blue_mask)
+		|| !reader.get(dpm_x) || !reader.get(dpm_y) || !reader.get(has_pixels)) {
+		return nullptr;
+	}
+
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> bitmap(FreeImage_AllocateHeaderT(!has_pixels, (FREE_IMAGE_TYPE)type, width, height, bpp, red_mask, green_mask, blue_mask), &FreeImage_Unload);
+	if (!bitmap) {
+		return nullptr;
+	}
+	FIBITMAP *dib = bitmap.get();
+
+	FreeImage_SetDotsPerMeterX(dib, dpm_x);
+	FreeImage_SetDotsPerMeterY(dib, dpm_y);
+
+	// palette
+
+	uint32_t colors = 0;
+	if (!reader.get(colors) || (colors != FreeImage_GetColorsUsed(dib))) {
+		return nullptr;
+	}
+	if (!reader.read(FreeImage_GetPalette(dib), colors * sizeof(FIRGBA8))) {
+		return nullptr;
+	}
+
+	// transparency
+
+	int32_t transparent = 0;
+	uint32_t transparency_count = 0;
+	uint8_t table[256];
+	if (!reader.get(transparent) || !reader.get(transparency_count) || (transparency_count > 256) || !reader.read(table, transparency_count)) {
+		return nullptr;
+	}
+	FreeImage_SetTransparencyTable(dib, table, (int)transparency_count);
+	FreeImage_SetTransparent(dib, transparent);
+
+	// background color
+
+	int32_t has_bkcolor = 0;
+	FIRGBA8 bkcolor{};
+	if (!reader.get(has_bkcolor) || !reader.get(bkcolor)) {
+		return nullptr;
+	}
+	if (has_bkcolor) {
+		FreeImage_SetBackgroundColor(dib, &bkcolor);
+	}
+
+	// ICC profile
+
+	uint16_t icc_flags = 0;
+	uint32_t icc_size = 0;
+	if (!reader.get(icc_flags) || !reader.get(icc_size)) {
+		return nullptr;
+	}
+	const uint8_t *icc_data = reader.skip(icc_size);
+	if (!icc_data) {
+		return nullptr;
+	}
+	FIICCPROFILE *icc = FreeImage_CreateICCProfile(dib, (void *)icc_data, (long)icc_size);
+	icc->flags = icc_flags;
+
+	// metadata
+
+	for (int model = FIMD_COMMENTS; model <= FIMD_EXIF_RAW; model++) {
+		uint32_t count = 0;
+		if (!reader.get(count)) {
+			return nullptr;
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			std::string key, description;
+			uint16_t id = 0, tag_type = 0;
+			uint32_t tag_count = 0, tag_length = 0;
+			if (!reader.getString(key) || !reader.getString(description)
+				|| !reader.get(id) || !reader.get(tag_type) || !reader.get(tag_count) || !reader.get(tag_length)) {
+				return nullptr;
+			}
+			const uint8_t *value = reader.skip(tag_length);
+			if (!value) {
+				return nullptr;
+			}
+			if (FITAG *tag = FreeImage_CreateTag()) {
+				FreeImage_SetTagKey(tag, key.c_str());
+				FreeImage_SetTagDescription(tag, description.c_str());
+				FreeImage_SetTagID(tag, id);
+				FreeImage_SetTagType(tag, (FREE_IMAGE_MDTYPE)tag_type);
+				FreeImage_SetTagCount(tag, tag_count);
+				FreeImage_SetTagLength(tag, tag_length);
+				FreeImage_SetTagValue(tag, value);
+				FreeImage_SetMetadata((FREE_IMAGE_MDMODEL)model, dib, key.c_str(), tag);
+				FreeImage_DeleteTag(tag);
+			}
+		}
+	}
+
+	// thumbnail
+
+	int32_t has_thumbnail = 0;
+	if (!reader.get(has_thumbnail)) {
+		return nullptr;
+	}
+	if (has_thumbnail) {
+		FIBITMAP *thumbnail = ReadBitmap(reader);
+		if (!thumbnail) {
+			return nullptr;
+		}
+		FreeImage_SetThumbnail(dib, thumbnail);
+		FreeImage_Unload(thumbnail);
+	}
+
+	// pixels
+
+	if (has_pixels) {
+		const unsigned line = FreeImage_GetLine(dib);
+		for (unsigned y = 0; y < height; y++) {
+			if (!reader.read(FreeImage_GetScanLine(dib, y), line)) {
+				return nullptr;
+			}
+		}
+	}
+
+	return bitmap.release();
+}
+
+} // namespace
+
+// ----------------------------------------------------------
+
+FIBOOL
+FreeImage_SpoolPage(FIBITMAP *dib, FIBOOL compress, std::vector<uint8_t>& buffer) {
+	buffer.clear();
+
+	if (!dib) {
+		return FALSE;
+	}
+
+	try {
+		std::vector<uint8_t> payload;
+		SpoolWriter payload_writer(payload);
+		WriteBitmap(payload_writer, dib);
+
+		SPOOLHEADER header{};
+		header.magic = SPOOL_MAGIC;
+		header.flags = 0;
+		header.payload_size = payload.size();
+
+		if (compress && (payload.size() <= std::numeric_limits<uLong>::max())) {
+			uLongf compressed_size = compressBound((uLong)payload.size());
+			buffer.resize(sizeof(SPOOLHEADER) + compressed_size);
+			if (compress2(buffer.data() + sizeof(SPOOLHEADER), &compressed_size, payload.data(), (uLong)payload.size(), Z_BEST_SPEED) == Z_OK) {
+				header.flags |= SPOOL_COMPRESSED;
+				buffer.resize(sizeof(SPOOLHEADER) + compressed_size);
+				memcpy(buffer.data(), &header, sizeof(SPOOLHEADER));
+				return TRUE;
+			}
+			// fall back to raw storage
+		}
+
+		buffer.resize(sizeof(SPOOLHEADER));
+		memcpy(buffer.data(), &header, sizeof(SPOOLHEADER));
+		buffer.insert(buffer.end(), payload.begin(), payload.end());
+		return TRUE;
+
+	} catch (std::bad_alloc &) {
+		buffer.clear();
+	}
+
+	return FALSE;
+}
+
+FIBITMAP *
+FreeImage_UnspoolPage(const uint8_t *data, size_t size) {
+	SPOOLHEADER header{};
+	if (!data || (size < sizeof(SPOOLHEADER))) {
+		return nullptr;
+	}
+	memcpy(&header, data, sizeof(SPOOLHEADER));
+	if (header.magic != SPOOL_MAGIC) {
+		return nullptr;
+	}
+
+	data += sizeof(SPOOLHEADER);
+	size -= sizeof(SPOOLHEADER);
+
+	try {
+		if (header.flags & SPOOL_COMPRESSED) {
+			if (header.payload_size > std::numeric_limits<uLong>::max()) {
+				return nullptr;
+			}
+			std::vector<uint8_t> payload((size_t)header.payload_size);
+			uLongf payload_size = (uLongf)header.payload_size;
+			if ((uncompress(payload.data(), &payload_size, data, (uLong)size) != Z_OK) || (payload_size != header.payload_size)) {
+				return nullptr;
+			}
+			SpoolReader reader(payload.data(), payload.size());
+			return ReadBitmap(reader);
+		}
+
+		SpoolReader reader(data, std::min<size_t>(size, (size_t)header.payload_size));
+		return ReadBitmap(reader);
+
+	} catch (std::bad_alloc &) {
+	}
+
+	return nullptr;
+}
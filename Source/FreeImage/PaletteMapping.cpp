@@ -0,0 +1,362 @@
+// ==========================================================
+// Mapping of images onto a fixed palette
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "SimpleTools.h"
+#include <climits>
+#include <cmath>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+/**
+Inverse color map of a palette.
+The RGB cube is split into 32x32x32 cells of 8x8x8 colors. Every cell lists the palette entries
+which may be the nearest entry of one of its colors: an entry whose smallest distance to the cell
+exceeds the largest distance of another entry to the cell can't be. The nearest entry of a color
+is then found exactly by comparing the few candidates of its cell.
+*/
+class InverseColorMap
+{
+public:
+	static constexpr unsigned kCells = 32 * 32 * 32;
+
+	InverseColorMap(const FIRGBA8 *palette, unsigned count)
+		: mColors(3 * count)
+		, mOffsets(kCells + 1)
+	{
+		for (unsigned i = 0; i < count; ++i) {
+			mColors[3 * i + 0] = palette[i].red;
+			mColors[3 * i + 1] = palette[i].green;
+			mColors[3 * i + 2] = palette[i].blue;
+		}
+
+		// every red slice of cells gathers its candidates on its own, the slices are then concatenated
+		std::vector<uint8_t> slices[32];
+		std::vector<uint32_t> counts(kCells);
+		ThreadPool::Instance().parallelFor(0, 32, 1, [&](size_t first, size_t last) {
+			std::vector<int> min_dist(count);
+			for (size_t r = first; r < last; ++r) {
+				for (unsigned g = 0; g < 32; ++g) {
+					for (unsigned b = 0; b < 32; ++b) {
+						const int lo[3] = { (int)r << 3, (int)g << 3, (int)b << 3 };
+						int bound = INT_MAX;
+						for (unsigned i = 0; i < count; ++i) {
+							int near_dist = 0, far_dist = 0;
+							for (unsigned c = 0; c < 3; ++c) {
+								const int v = mColors[3 * i + c];
+								const int below = lo[c] - v;		// > 0 when v is below the cell
+								const int above = v - (lo[c] + 7);	// > 0 when v is above the cell
+								const int near_c = MAX(0, MAX(below, above));
+								const int far_c = MAX(std::abs(below), std::abs(above));
+								near_dist += near_c * near_c;
+								far_dist += far_c * far_c;
+							}
+							min_dist[i] = near_dist;
+							bound = MIN(bound, far_dist);
+						}
+						const unsigned cell = ((unsigned)r << 10) | (g << 5) | b;
+						for (unsigned i = 0; i < count; ++i) {
+							if (min_dist[i] <= bound) {
+								slices[r].push_back((uint8_t)i);
+								counts[cell]++;
+							}
+						}
+					}
+				}
+			}
+		});
+
+		for (unsigned cell = 0; cell < kCells; ++cell) {
+			mOffsets[cell + 1] = mOffsets[cell] + counts[cell];
+		}
+		mCandidates.reserve(mOffsets[kCells]);
+		for (const std::vector<uint8_t> &slice : slices) {
+			mCandidates.insert(mCandidates.end(), slice.begin(), slice.end());
+		}
+	}
+
+	/// Returns TRUE when the map was built for these palette colors
+	bool Matches(const FIRGBA8 *palette, unsigned count) const {
+		if (mColors.size() != 3 * count) {
+			return false;
+		}
+		for (unsigned i = 0; i < count; ++i) {
+			if ((mColors[3 * i + 0] != palette[i].red) || (mColors[3 * i + 1] != palette[i].green) || (mColors[3 * i + 2] != palette[i].blue)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/// Index of the palette entry nearest to a color (squared RGB distance, lowest index on ties)
+	FI_ALWAYS_INLINE uint8_t Nearest(int r, int g, int b) const {
+		const unsigned cell = ((unsigned)(r >> 3) << 10) | ((unsigned)(g >> 3) << 5) | (unsigned)(b >> 3);
+		const uint32_t first = mOffsets[cell];
+		const uint32_t last = mOffsets[cell + 1];
+		uint8_t best = mCandidates[first];
+		if (last - first > 1) {
+			int best_dist = INT_MAX;
+			for (uint32_t k = first; k < last; ++k) {
+				const uint8_t *color = &mColors[3 * mCandidates[k]];
+				const int dr = r - color[0];
+				const int dg = g - color[1];
+				const int db = b - color[2];
+				const int dist = dr * dr + dg * dg + db * db;
+				if (dist < best_dist) {
+					best_dist = dist;
+					best = mCandidates[k];
+				}
+			}
+		}
+		return best;
+	}
+
+	const uint8_t* Color(uint8_t index) const {
+		return &mColors[3 * index];
+	}
+
+private:
+	std::vector<uint8_t> mColors;		// r, g, b of each entry
+	std::vector<uint32_t> mOffsets;		// first candidate of each cell
+	std::vector<uint8_t> mCandidates;	// candidates of each cell, in index order
+};
+
+/// Returns the inverse color map of a palette, from the cache of the most recently used palettes
+std::shared_ptr<const InverseColorMap>
+GetInverseColorMap(const FIRGBA8 *palette, unsigned count) {
+	static std::mutex cache_mutex;
+	static std::list<std::shared_ptr<const InverseColorMap>> cache;
+	static constexpr size_t kCacheSize = 8;
+
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		for (auto it = cache.begin(); it != cache.end(); ++it) {
+			if ((*it)->Matches(palette, count)) {
+				cache.splice(cache.begin(), cache, it);
+				return cache.front();
+			}
+		}
+	}
+
+	// build outside of the lock, two threads may build the same map
+	auto map = std::make_shared<const InverseColorMap>(palette, count);
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	cache.push_front(map);
+	if (cache.size() > kCacheSize) {
+		cache.pop_back();
+	}
+	return map;
+}
+
+// ----------------------------------------------------------
+
+template <unsigned Bytespp_>
+void
+MapToPalette(const InverseColorMap &map, FIBITMAP *src, FIBITMAP *dst) {
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const uint8_t *src_bits = FreeImage_GetScanLine(src, 0);
+	const ptrdiff_t src_stride = FreeImage_GetScanLineStride(src);
+	uint8_t *dst_bits = FreeImage_GetScanLine(dst, 0);
+	const ptrdiff_t dst_stride = FreeImage_GetScanLineStride(dst);
+
+	const size_t grain_rows = MAX((size_t)1, (size_t)(kTransformGrainPixels / MAX(width, 1U)));
+	ThreadPool::Instance().parallelFor(0, height, grain_rows, [&](size_t first, size_t last) {
+		for (size_t y = first; y < last; ++y) {
+			const uint8_t *pixel = src_bits + (ptrdiff_t)y * src_stride;
+			uint8_t *index = dst_bits + (ptrdiff_t)y * dst_stride;
+			for (unsigned x = 0; x < width; ++x, pixel += Bytespp_) {
+				index[x] = map.Nearest(pixel[FI_RGBA_RED], pixel[FI_RGBA_GREEN], pixel[FI_RGBA_BLUE]);
+			}
+		}
+	});
+}
+
+/**
+Ordered dithering: a Bayer threshold in [-spread / 2, spread / 2] is added to each color before its
+nearest entry is looked up. The spread is the step of a regular grid of as many colors as the palette.
+*/
+template <unsigned Bytespp_>
+void
+MapToPaletteOrdered(const InverseColorMap &map, unsigned count, int order, FIBITMAP *src, FIBITMAP *dst) {
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const uint8_t *src_bits = FreeImage_GetScanLine(src, 0);
+	const ptrdiff_t src_stride = FreeImage_GetScanLineStride(src);
+	uint8_t *dst_bits = FreeImage_GetScanLine(dst, 0);
+	const ptrdiff_t dst_stride = FreeImage_GetScanLineStride(dst);
+
+	const int l = 1 << order;
+	const double levels = std::cbrt((double)count);
+	const double spread = (levels > 2) ? 255 / (levels - 1) : 255;
+	std::vector<int> matrix(l * l);
+	for (int i = 0; i < l * l; ++i) {
+		matrix[i] = (int)std::lround(spread * ((dithervalue(i % l, i / l, order) + 0.5) / (l * l) - 0.5));
+	}
+
+	const size_t grain_rows = MAX((size_t)1, (size_t)(kTransformGrainPixels / MAX(width, 1U)));
+	ThreadPool::Instance().parallelFor(0, height, grain_rows, [&](size_t first, size_t last) {
+		for (size_t y = first; y < last; ++y) {
+			const uint8_t *pixel = src_bits + (ptrdiff_t)y * src_stride;
+			uint8_t *index = dst_bits + (ptrdiff_t)y * dst_stride;
+			const int *thresholds = &matrix[(y % l) * l];
+			for (unsigned x = 0; x < width; ++x, pixel += Bytespp_) {
+				const int t = thresholds[x & (l - 1)];
+				index[x] = map.Nearest(CLAMP(pixel[FI_RGBA_RED] + t, 0, 255), CLAMP(pixel[FI_RGBA_GREEN] + t, 0, 255), CLAMP(pixel[FI_RGBA_BLUE] + t, 0, 255));
+			}
+		}
+	});
+}
+
+/**
+Floyd & Steinberg error diffusion onto the palette, with the filter
+         *   7
+     3   5   1     (1/16)
+Each row needs the errors of the previous one, so that the rows are processed in order.
+*/
+template <unsigned Bytespp_>
+void
+MapToPaletteFloydSteinberg(const InverseColorMap &map, FIBITMAP *src, FIBITMAP *dst) {
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+
+	// errors * 16 of the current and next rows, with a pixel of padding on both sides
+	std::vector<int> cur_err(3 * (width + 2)), next_err(3 * (width + 2));
+
+	for (unsigned y = 0; y < height; ++y) {
+		const uint8_t *pixel = FreeImage_GetScanLine(src, y);
+		uint8_t *index = FreeImage_GetScanLine(dst, y);
+		std::fill(next_err.begin(), next_err.end(), 0);
+		for (unsigned x = 0; x < width; ++x, pixel += Bytespp_) {
+			int *err = &cur_err[3 * (x + 1)];
+			int *below = &next_err[3 * (x + 1)];
+			const int value[3] = {
+				CLAMP(pixel[FI_RGBA_RED] + err[0] / 16, 0, 255),
+				CLAMP(pixel[FI_RGBA_GREEN] + err[1] / 16, 0, 255),
+				CLAMP(pixel[FI_RGBA_BLUE] + err[2] / 16, 0, 255)
+			};
+			const uint8_t entry = map.Nearest(value[0], value[1], value[2]);
+			index[x] = entry;
+			const uint8_t *color = map.Color(entry);
+			for (int c = 0; c < 3; ++c) {
+				const int e = value[c] - color[c];
+				err[3 + c] += 7 * e;
+				below[c - 3] += 3 * e;
+				below[c] += 5 * e;
+				below[c + 3] += e;
+			}
+		}
+		std::swap(cur_err, next_err);
+	}
+}
+
+} // namespace
+
+// ----------------------------------------------------------
+
+/** @brief Maps an image onto a fixed palette.
+
+The nearest palette entry of each pixel is found with an inverse color map of the palette, which
+is cached for the most recently used palettes, so that mapping many images onto the same palette
+builds it once. Pixels are mapped in row bands on the thread pool, apart from Floyd & Steinberg
+error diffusion, which processes the rows in order.
+@param dib Input image. Images other than 24- or 32-bit are converted to 24-bit first.
+@param palette Palette entries; their alpha is copied to the result palette but not matched.
+@param count Number of palette entries, from 1 to 256.
+@param dither TRUE to dither the image with algorithm, FALSE to map every pixel to its nearest entry.
+@param algorithm FID_FS for error diffusion, FID_BAYER4x4, FID_BAYER8x8 or FID_BAYER16x16 for ordered dithering.
+@return Returns the 8-bit palettized image if successful, returns NULL otherwise.
+*/
+FIBITMAP * DLL_CALLCONV
+FreeImage_ApplyPalette(FIBITMAP *dib, const FIRGBA8 *palette, unsigned count, FIBOOL dither, FREE_IMAGE_DITHER algorithm) {
+	if (!FreeImage_HasPixels(dib) || !palette || (count < 1) || (count > 256)) {
+		return nullptr;
+	}
+
+	int order = 0;
+	if (dither) {
+		switch (algorithm) {
+			case FID_FS:
+				break;
+			case FID_BAYER4x4:
+				order = 2;
+				break;
+			case FID_BAYER8x8:
+				order = 3;
+				break;
+			case FID_BAYER16x16:
+				order = 4;
+				break;
+			default:
+				FreeImage_OutputMessageProc(FIF_UNKNOWN, "FreeImage_ApplyPalette: unsupported dithering algorithm");
+				return nullptr;
+		}
+	}
+
+	FIBITMAP *src = dib;
+	const unsigned bpp = FreeImage_GetBPP(dib);
+	if ((FreeImage_GetImageType(dib) != FIT_BITMAP) || ((bpp != 24) && (bpp != 32))) {
+		src = FreeImage_ConvertTo24Bits(dib);
+		if (!src) {
+			return nullptr;
+		}
+	}
+
+	FIBITMAP *dst = FreeImage_Allocate(FreeImage_GetWidth(src), FreeImage_GetHeight(src), 8);
+	if (dst) {
+		FIRGBA8 *dst_pal = FreeImage_GetPalette(dst);
+		memcpy(dst_pal, palette, count * sizeof(FIRGBA8));
+
+		const std::shared_ptr<const InverseColorMap> map = GetInverseColorMap(palette, count);
+		const bool is24 = (FreeImage_GetBPP(src) == 24);
+		if (!dither) {
+			if (is24) {
+				MapToPalette<3>(*map, src, dst);
+			} else {
+				MapToPalette<4>(*map, src, dst);
+			}
+		} else if (algorithm == FID_FS) {
+			if (is24) {
+				MapToPaletteFloydSteinberg<3>(*map, src, dst);
+			} else {
+				MapToPaletteFloydSteinberg<4>(*map, src, dst);
+			}
+		} else {
+			if (is24) {
+				MapToPaletteOrdered<3>(*map, count, order, src, dst);
+			} else {
+				MapToPaletteOrdered<4>(*map, count, order, src, dst);
+			}
+		}
+
+		// copy metadata from src to dst
+		FreeImage_CloneMetadata(dst, dib);
+	}
+
+	if (src != dib) {
+		FreeImage_Unload(src);
+	}
+
+	return dst;
+}
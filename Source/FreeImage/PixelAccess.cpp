@@ -32,6 +32,9 @@ FreeImage_GetScanLine(FIBITMAP *dib, int scanline) {
 	if (!FreeImage_HasPixels(dib)) {
 		return nullptr;
 	}
+	if (FreeImage_IsTopDown(dib)) {
+		scanline = (int)FreeImage_GetHeight(dib) - 1 - scanline;
+	}
 	return CalculateScanLine(FreeImage_GetBits(dib), FreeImage_GetPitch(dib), scanline);
 }
 
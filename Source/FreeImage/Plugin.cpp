@@ -416,6 +416,19 @@ PluginsRegistry::PluginsRegistry()
 	Put(FIF_AVIF, CreatepluginAVIF());
 #endif
 
+	// page codecs of the multipage plugins, replaced along with the plugin
+	if (auto* node = FindFromFIF(FIF_ICO)) {
+		node->SetPageCodec(GetPageCodecICO());
+	}
+#if FREEIMAGE_WITH_LIBTIFF
+	if (auto* node = FindFromFIF(FIF_TIFF)) {
+		node->SetPageCodec(GetPageCodecTIFF());
+	}
+#endif
+	if (auto* node = FindFromFIF(FIF_GIF)) {
+		node->SetPageCodec(GetPageCodecGIF());
+	}
+
 	mNextId = FIF_JXR + 1;
 }
 
@@ -686,8 +699,48 @@ FreeImage_DeInitialise() {
 // Plugin System Load/Save Functions
 // =====================================================================
 
+namespace {
+
+	/// Layout requested by a FreeImage_LoadAs* call
+	struct LoadTarget {
+		FREE_IMAGE_TYPE type;
+		unsigned bpp;
+	};
+
+	/// Layout requested by the FreeImage_LoadAs* call running on this thread, until FreeImage_LoadFromHandle takes it
+	thread_local const LoadTarget *s_load_request = nullptr;
+
+	/// Layout requested from the plugin running on this thread
+	thread_local const LoadTarget *s_load_target = nullptr;
+
+	/// Sets one of the thread local layouts for the lifetime of the scope
+	class LoadTargetScope {
+	public:
+		LoadTargetScope(const LoadTarget *&slot, const LoadTarget *target) : m_slot(slot), m_previous(slot) {
+			m_slot = target;
+		}
+
+		~LoadTargetScope() {
+			m_slot = m_previous;
+		}
+
+		LoadTargetScope(const LoadTargetScope&) = delete;
+		LoadTargetScope& operator=(const LoadTargetScope&) = delete;
+
+	private:
+		const LoadTarget *&m_slot;
+		const LoadTarget *m_previous;
+	};
+
+} // namespace
+
 FIBITMAP * DLL_CALLCONV
 FreeImage_LoadFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, int flags) {
+	// the requested layout only applies to this plugin, not to the images it loads itself (thumbnails, embedded images...)
+	const LoadTarget *target = s_load_request;
+	s_load_request = nullptr;
+	LoadTargetScope scope(s_load_target, target);
+
 	FIBITMAP *bitmap{};
 	if (auto& plugins = PluginsRegistrySingleton::Instance()) {
 		if (auto* node = plugins->FindFromFIF(fif)) {
@@ -730,6 +783,210 @@ FreeImage_LoadU(FREE_IMAGE_FORMAT fif, const wchar_t *filename, int flags) {
 	return bitmap;
 }
 
+// =====================================================================
+// Loading into a requested layout
+// =====================================================================
+
+namespace {
+
+	/// Bit depth of the non FIT_BITMAP types, 0 for unknown types
+	unsigned GetTypeBPP(FREE_IMAGE_TYPE type) {
+		switch (type) {
+			case FIT_UINT16:
+			case FIT_INT16:
+				return 16;
+			case FIT_UINT32:
+			case FIT_INT32:
+			case FIT_FLOAT:
+				return 32;
+			case FIT_DOUBLE:
+			case FIT_COMPLEXF:
+			case FIT_RGBA16:
+				return 64;
+			case FIT_RGB16:
+				return 48;
+			case FIT_COMPLEX:
+			case FIT_RGBA32:
+			case FIT_RGBAF:
+				return 128;
+			case FIT_RGB32:
+			case FIT_RGBF:
+				return 96;
+			default:
+				return 0;
+		}
+	}
+
+	bool IsValidLoadTarget(FREE_IMAGE_TYPE type, unsigned bpp) {
+		if (type == FIT_BITMAP) {
+			return (bpp == 8) || (bpp == 24) || (bpp == 32);
+		}
+		const unsigned type_bpp = GetTypeBPP(type);
+		return (type_bpp != 0) && ((bpp == 0) || (bpp == type_bpp));
+	}
+
+	bool HasLayout(FIBITMAP *dib, FREE_IMAGE_TYPE type, unsigned bpp) {
+		if (FreeImage_GetImageType(dib) != type) {
+			return false;
+		}
+		if (type != FIT_BITMAP) {
+			return true;
+		}
+		// 8-bit targets are greyscale, palettized images still need FreeImage_ConvertToGreyscale
+		return (FreeImage_GetBPP(dib) == bpp) && ((bpp != 8) || (FreeImage_GetColorType(dib) == FIC_MINISBLACK));
+	}
+
+	/**
+	Returns the FreeImage_ConvertInPlace conversion that gives the same pixels as the allocating
+	conversion to the target, or FALSE when there is none for this source
+	*/
+	FIBOOL GetInPlaceConversion(FIBITMAP *dib, FREE_IMAGE_TYPE type, unsigned bpp, FREE_IMAGE_INPLACE_CONVERSION *conversion) {
+		const FREE_IMAGE_TYPE src_type = FreeImage_GetImageType(dib);
+		const unsigned src_bpp = FreeImage_GetBPP(dib);
+
+		switch (type) {
+			case FIT_BITMAP:
+				if ((src_type == FIT_BITMAP) && (bpp == 24) && (src_bpp == 32)) {
+					*conversion = FIINPLACE_DROP_ALPHA;
+					return TRUE;
+				}
+				if ((src_type == FIT_BITMAP) && (bpp == 8) && ((src_bpp == 24) || (src_bpp == 32))) {
+					*conversion = FIINPLACE_GREYSCALE;
+					return TRUE;
+				}
+				return FALSE;
+			case FIT_RGB16:
+			case FIT_RGB32:
+			case FIT_RGBF:
+				*conversion = FIINPLACE_DROP_ALPHA;
+				return ((type == FIT_RGB16) && (src_type == FIT_RGBA16)) || ((type == FIT_RGB32) && (src_type == FIT_RGBA32)) || ((type == FIT_RGBF) && (src_type == FIT_RGBAF));
+			case FIT_UINT16:
+				*conversion = FIINPLACE_GREYSCALE;
+				return (src_type == FIT_RGB16) || (src_type == FIT_RGBA16);
+			case FIT_FLOAT:
+				*conversion = FIINPLACE_FLOAT;
+				return TRUE;
+			default:
+				return FALSE;
+		}
+	}
+
+	FIBITMAP* ConvertToLayout(FIBITMAP *dib, FREE_IMAGE_TYPE type, unsigned bpp) {
+		switch (type) {
+			case FIT_BITMAP:
+				switch (bpp) {
+					case 8:
+						return FreeImage_ConvertToGreyscale(dib);
+					case 24:
+						return FreeImage_ConvertTo24Bits(dib);
+					default:
+						return FreeImage_ConvertTo32Bits(dib);
+				}
+			case FIT_UINT16:
+				return FreeImage_ConvertToUINT16(dib);
+			case FIT_RGB16:
+				return FreeImage_ConvertToRGB16(dib);
+			case FIT_RGBA16:
+				return FreeImage_ConvertToRGBA16(dib);
+			case FIT_FLOAT:
+				return FreeImage_ConvertToFloat(dib, TRUE);
+			case FIT_RGBF:
+				return FreeImage_ConvertToRGBF(dib);
+			case FIT_RGBAF:
+				return FreeImage_ConvertToRGBAF(dib);
+			default:
+				return FreeImage_ConvertToType(dib, type, TRUE);
+		}
+	}
+
+	/**
+	Brings a loaded bitmap to the requested layout, in place when possible.
+	Takes ownership of dib.
+	*/
+	FIBITMAP* ConvertLoaded(FIBITMAP *dib, FREE_IMAGE_TYPE type, unsigned bpp) {
+		if (!dib || HasLayout(dib, type, bpp)) {
+			return dib;
+		}
+
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> src(dib, &FreeImage_Unload);
+
+		if (!FreeImage_HasPixels(dib)) {
+			// header only: describe the layout the pixels would have
+			FIBITMAP *header = FreeImage_AllocateHeaderT(TRUE, type, FreeImage_GetWidth(dib), FreeImage_GetHeight(dib), bpp);
+			if (header) {
+				FreeImage_CloneMetadata(header, dib);
+				const FIICCPROFILE *profile = FreeImage_GetICCProfile(dib);
+				if (profile->data) {
+					FreeImage_CreateICCProfile(header, profile->data, profile->size);
+				}
+			}
+			return header;
+		}
+
+		FREE_IMAGE_INPLACE_CONVERSION conversion{};
+		if (GetInPlaceConversion(dib, type, bpp, &conversion) && FreeImage_ConvertInPlace(dib, conversion)) {
+			assert(HasLayout(dib, type, bpp));
+			return src.release();
+		}
+
+		FIBITMAP *dst = ConvertToLayout(dib, type, bpp);
+		if (dst && !HasLayout(dst, type, bpp)) {
+			FreeImage_Unload(dst);
+			dst = nullptr;
+		}
+		if (!dst) {
+			FreeImage_OutputMessageProc(FIF_UNKNOWN, "FreeImage_LoadAs: cannot convert a %u-bit image of type %d to the requested layout", FreeImage_GetBPP(dib), (int)FreeImage_GetImageType(dib));
+		}
+		return dst;
+	}
+
+} // namespace
+
+FIBOOL
+FreeImage_GetLoadTarget(FREE_IMAGE_TYPE *type, unsigned *bpp) {
+	if (!s_load_target) {
+		return FALSE;
+	}
+	*type = s_load_target->type;
+	*bpp = s_load_target->bpp;
+	return TRUE;
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadAsFromHandle(FREE_IMAGE_FORMAT fif, FreeImageIO *io, fi_handle handle, FREE_IMAGE_TYPE type, unsigned bpp, int flags) {
+	if (!IsValidLoadTarget(type, bpp)) {
+		FreeImage_OutputMessageProc((int)fif, "FreeImage_LoadAs: unsupported target layout");
+		return nullptr;
+	}
+	if (type != FIT_BITMAP) {
+		bpp = GetTypeBPP(type);
+	}
+
+	const LoadTarget target{ type, bpp };
+	FIBITMAP *dib{};
+	{
+		LoadTargetScope scope(s_load_request, &target);
+		dib = FreeImage_LoadFromHandle(fif, io, handle, flags);
+	}
+	return ConvertLoaded(dib, type, bpp);
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_LoadAs(FREE_IMAGE_FORMAT fif, const char *filename, FREE_IMAGE_TYPE type, unsigned bpp, int flags) {
+	FreeImageIO io;
+	SetDefaultIO(&io);
+
+	FIBITMAP *bitmap{};
+	if (auto *handle = fopen(filename, "rb")) {
+		bitmap = FreeImage_LoadAsFromHandle(fif, &io, (fi_handle)handle, type, bpp, flags);
+		fclose(handle);
+	} else {
+		FreeImage_OutputMessageProc((int)fif, "FreeImage_LoadAs: failed to open file %s", filename);
+	}
+
+	return bitmap;
+}
+
 FIBOOL DLL_CALLCONV
 FreeImage_SaveToHandle(FREE_IMAGE_FORMAT fif, FIBITMAP *dib, FreeImageIO *io, fi_handle handle, int flags) {
 	// cannot save "header only" formats
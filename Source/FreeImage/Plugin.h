@@ -34,6 +34,27 @@
 #include "Utilities.h"
 
 
+// =====================================================================
+//  Page codec
+// =====================================================================
+
+/**
+Optional entry points of a multipage plugin, used by FreeImage_SaveMultiBitmapToHandle to
+decode and encode pages on worker threads.
+encode_proc writes a single page into a memory stream. It may run for several pages at once,
+every call owning its bitmap and its stream.
+begin_proc, append_proc and end_proc run on the writing thread: they write the container around
+the encoded pages, which are appended in page order.
+*/
+struct PluginPageCodec {
+	/** true if load_proc may run on several threads at once, each thread reading through its own handle */
+	bool concurrent_load;
+	FIBOOL (*encode_proc)(FIBITMAP *dib, int page, int flags, FIMEMORY *stream);
+	void *(*begin_proc)(FreeImageIO *io, fi_handle handle, int page_count, int flags);
+	FIBOOL (*append_proc)(FreeImageIO *io, fi_handle handle, FIMEMORY *stream, void *state);
+	FIBOOL (*end_proc)(FreeImageIO *io, fi_handle handle, FIBOOL success, void *state);
+};
+
 // =====================================================================
 //  Plugin Node
 // =====================================================================
@@ -168,6 +189,14 @@ public:
 		return DoSupportsNoPixels();
 	}
 
+	const PluginPageCodec* GetPageCodec() const {
+		return mPageCodec;
+	}
+
+	void SetPageCodec(const PluginPageCodec* codec) {
+		mPageCodec = codec;
+	}
+
 private:
 	virtual void* DoOpen(FreeImageIO* io, fi_handle handle, bool open_for_reading) = 0;
 
@@ -217,6 +246,8 @@ private:
 	const char* mExtension{ nullptr };
 	/** optional regular expression to help	software identifying a bitmap type */
 	const char* mRegexpr{ nullptr };
+	/** optional page codec of a multipage plugin (NULL if the plugin has none) */
+	const PluginPageCodec* mPageCodec{ nullptr };
 };
 
 
@@ -397,4 +428,8 @@ void DLL_CALLCONV InitJXR(Plugin *plugin, int format_id);
 std::unique_ptr<fi::Plugin2> CreatePluginHEIF();
 std::unique_ptr<fi::Plugin2> CreatepluginAVIF();
 
+const PluginPageCodec* GetPageCodecGIF();
+const PluginPageCodec* GetPageCodecICO();
+const PluginPageCodec* GetPageCodecTIFF();
+
 #endif //!PLUGIN_H
@@ -7,6 +7,8 @@
 #include "SimpleTools.h"
 #include <cstring>
 #include <algorithm>
+#include <limits>
+#include <vector>
 
 
 FIBOOL FreeImage_FindMinMax(FIBITMAP* dib, double* min_brightness, double* max_brightness, void** min_ptr, void** max_ptr)
@@ -136,32 +138,248 @@ FIBOOL FreeImage_FindMinMax(FIBITMAP* dib, double* min_brightness, double* max_b
 namespace
 {
 
+	/// Sums of samples and of their squares: exact integers for samples up to 16 bits, doubles otherwise
+	template <typename Ty_>
+	using StatisticsSum = std::conditional_t<std::is_integral_v<Ty_> && sizeof(Ty_) <= 2, int64_t, double>;
+
+	/**
+	Min, max and optionally the sums of a row of samples, dispatched by KernelDispatch.
+	The samples are reduced into kLanes independent lanes, lane l collecting channel l % Channels_,
+	so that the reductions vectorize without reordering the additions of a lane.
+	NaN samples are skipped; the sums then also count the samples of every lane.
+	*/
+	template <typename Ty_, unsigned Channels_, bool Sums_>
+	struct SampleStatsRow
+	{
+		using Sum = StatisticsSum<Ty_>;
+		static constexpr unsigned kLanes = 8 * Channels_;
+
+		static FI_ALWAYS_INLINE void Update(Ty_ v, Ty_& mn, Ty_& mx, Sum& sum, Sum& sq, Sum& count, Sum shift)
+		{
+			// comparisons with NaN are false, which keeps mn and mx
+			mn = v < mn ? v : mn;
+			mx = mx < v ? v : mx;
+			if constexpr (Sums_) {
+				if constexpr (std::is_floating_point_v<Ty_>) {
+					const bool valid = (v == v);
+					const Sum d = valid ? static_cast<Sum>(v) - shift : static_cast<Sum>(0);
+					sum += d;
+					sq  += d * d;
+					count += valid ? static_cast<Sum>(1) : static_cast<Sum>(0);
+				}
+				else {
+					const Sum d = static_cast<Sum>(v) - shift;
+					sum += d;
+					sq  += d * d;
+				}
+			}
+		}
+
+		static FI_ALWAYS_INLINE void Run(const Ty_* row, unsigned width, Ty_* laneMin, Ty_* laneMax, Sum* laneSum, Sum* laneSq, Sum* laneCount, const Sum* laneShift)
+		{
+			Ty_ mn[kLanes], mx[kLanes];
+			Sum sum[kLanes]{}, sq[kLanes]{}, count[kLanes]{}, shift[kLanes]{};
+			std::copy_n(laneMin, kLanes, mn);
+			std::copy_n(laneMax, kLanes, mx);
+			if constexpr (Sums_) {
+				std::copy_n(laneSum, kLanes, sum);
+				std::copy_n(laneSq, kLanes, sq);
+				std::copy_n(laneCount, kLanes, count);
+				std::copy_n(laneShift, kLanes, shift);
+			}
+
+			const size_t samples = static_cast<size_t>(width) * Channels_;
+			size_t i = 0;
+			for (; i + kLanes <= samples; i += kLanes) {
+				FI_VECTORIZE_LOOP
+				for (unsigned l = 0; l < kLanes; ++l) {
+					Update(row[i + l], mn[l], mx[l], sum[l], sq[l], count[l], shift[l]);
+				}
+			}
+			for (unsigned l = 0; i < samples; ++i, ++l) {
+				Update(row[i], mn[l], mx[l], sum[l], sq[l], count[l], shift[l]);
+			}
+
+			std::copy_n(mn, kLanes, laneMin);
+			std::copy_n(mx, kLanes, laneMax);
+			if constexpr (Sums_) {
+				std::copy_n(sum, kLanes, laneSum);
+				std::copy_n(sq, kLanes, laneSq);
+				std::copy_n(count, kLanes, laneCount);
+			}
+		}
+	};
+
+	/// What a statistics pass gathers besides the min and max of every channel
+	struct StatisticsOptions
+	{
+		bool sums = false;			// mean and variance
+		uint32_t bins = 0;			// bins of the histogram of every channel, 0 for none
+		bool fullRange = true;		// integer samples are binned over their whole range, others over [lo, hi]
+		double lo = 0.0;
+		double hi = 0.0;
+		bool alpha = false;			// the last channel is alpha: count the transparent and opaque pixels
+	};
+
+	/// Results of a statistics pass, channels in memory order
+	struct StatisticsResult
+	{
+		double min[4]{};
+		double max[4]{};
+		double mean[4]{};
+		double variance[4]{};
+		std::vector<uint32_t> hist;	// channels * bins
+		uint64_t transparent = 0;
+		uint64_t opaque = 0;
+	};
+
+	/// Private accumulators of a band of rows
+	template <typename Ty_, unsigned Channels_>
+	struct StatisticsBand
+	{
+		using Sum = StatisticsSum<Ty_>;
+		static constexpr unsigned kLanes = SampleStatsRow<Ty_, Channels_, false>::kLanes;
+
+		Ty_ min[kLanes];
+		Ty_ max[kLanes];
+		Sum sum[kLanes]{};
+		Sum sq[kLanes]{};
+		Sum count[kLanes]{};	// samples that are not NaN, floating point samples only
+		std::vector<uint32_t> hist;
+		uint64_t transparent = 0;
+		uint64_t opaque = 0;
+	};
+
+	/**
+	Gathers the statistics of all the channels in one parallel pass over the rows.
+	Every band of rows fills private lanes and histograms, which are merged when the band is done.
+	*/
+	template <typename Ty_, unsigned Channels_>
+	void GatherStatistics(FIBITMAP* dib, const StatisticsOptions& options, StatisticsResult& result)
+	{
+		using Band = StatisticsBand<Ty_, Channels_>;
+		using Sum = typename Band::Sum;
+		constexpr unsigned kLanes = Band::kLanes;
+
+		Band init;
+		std::fill_n(init.min, kLanes, std::numeric_limits<Ty_>::max());
+		std::fill_n(init.max, kLanes, std::numeric_limits<Ty_>::lowest());
+		init.hist.assign(static_cast<size_t>(Channels_) * options.bins, 0u);
+		Band total = init;
+
+		// floating point sums are taken around the first pixel, which keeps the variance of data far from 0 accurate
+		Sum shift[kLanes]{};
+		if constexpr (std::is_floating_point_v<Sum>) {
+			const auto first = static_cast<const Ty_*>(static_cast<const void*>(FreeImage_GetScanLine(dib, 0)));
+			for (unsigned l = 0; l < kLanes; ++l) {
+				const Ty_ v = first[l % Channels_];
+				shift[l] = (v == v) ? static_cast<Sum>(v) : static_cast<Sum>(0);
+			}
+		}
+
+		const uint32_t bins = options.bins;
+		const double scale = options.hi > options.lo ? bins / (options.hi - options.lo) : 0.0;
+		const auto BinIndex = [&](Ty_ v) -> uint32_t {
+			if constexpr (std::is_integral_v<Ty_>) {
+				if (options.fullRange) {
+					constexpr uint32_t bits = 8 * sizeof(Ty_);
+					const auto u = static_cast<uint64_t>(static_cast<int64_t>(v) - std::numeric_limits<Ty_>::min());
+					return static_cast<uint32_t>((u * bins) >> bits);
+				}
+			}
+			const double t = (static_cast<double>(v) - options.lo) * scale;
+			return t > 0.0 ? static_cast<uint32_t>(std::min(t, bins - 1.0)) : 0u;
+		};
+
+		const Ty_ alphaMax = std::is_floating_point_v<Ty_> ? static_cast<Ty_>(1) : std::numeric_limits<Ty_>::max();
+
+		BitmapReduceParallel<Ty_>(dib, init, [&](Band& band, const Ty_* row, unsigned width) {
+			if (options.sums) {
+				KernelDispatch<SampleStatsRow<Ty_, Channels_, true>>::Run(row, width, band.min, band.max, band.sum, band.sq, band.count, static_cast<const Sum*>(shift));
+			}
+			else {
+				KernelDispatch<SampleStatsRow<Ty_, Channels_, false>>::Run(row, width, band.min, band.max, band.sum, band.sq, band.count, static_cast<const Sum*>(shift));
+			}
+			if (bins > 0) {
+				uint32_t* hist = band.hist.data();
+				const Ty_* pixel = row;
+				for (unsigned x = 0; x < width; ++x, pixel += Channels_) {
+					for (unsigned c = 0; c < Channels_; ++c) {
+						if constexpr (std::is_floating_point_v<Ty_>) {
+							if (std::isnan(pixel[c])) {
+								continue;
+							}
+						}
+						++hist[c * bins + BinIndex(pixel[c])];
+					}
+				}
+			}
+			if (options.alpha) {
+				uint64_t transparent = 0, opaque = 0;
+				const Ty_* alpha = row + Channels_ - 1;
+				for (size_t x = 0; x < width; ++x) {
+					const Ty_ a = alpha[x * Channels_];
+					transparent += a <= 0 ? 1 : 0;
+					opaque += a >= alphaMax ? 1 : 0;
+				}
+				band.transparent += transparent;
+				band.opaque += opaque;
+			}
+		}, [&](const Band& band) {
+			for (unsigned l = 0; l < kLanes; ++l) {
+				total.min[l] = std::min(total.min[l], band.min[l]);
+				total.max[l] = std::max(total.max[l], band.max[l]);
+				total.sum[l] += band.sum[l];
+				total.sq[l] += band.sq[l];
+				total.count[l] += band.count[l];
+			}
+			for (size_t i = 0; i < total.hist.size(); ++i) {
+				total.hist[i] += band.hist[i];
+			}
+			total.transparent += band.transparent;
+			total.opaque += band.opaque;
+		});
+
+		const double pixels = static_cast<double>(FreeImage_GetWidth(dib)) * FreeImage_GetHeight(dib);
+		for (unsigned c = 0; c < Channels_; ++c) {
+			Ty_ mn = std::numeric_limits<Ty_>::max(), mx = std::numeric_limits<Ty_>::lowest();
+			Sum sum{}, sq{}, count{};
+			for (unsigned l = c; l < kLanes; l += Channels_) {
+				mn = std::min(mn, total.min[l]);
+				mx = std::max(mx, total.max[l]);
+				sum += total.sum[l];
+				sq += total.sq[l];
+				count += total.count[l];
+			}
+			result.min[c] = static_cast<double>(mn);
+			result.max[c] = static_cast<double>(mx);
+			const double n = std::is_floating_point_v<Ty_> ? static_cast<double>(count) : pixels;
+			if (options.sums && (n > 0)) {
+				const double s = static_cast<double>(sum) / n;
+				result.mean[c] = static_cast<double>(shift[c]) + s;
+				result.variance[c] = std::max(0.0, static_cast<double>(sq) / n - s * s);
+			}
+		}
+		result.hist = std::move(total.hist);
+		result.transparent = total.transparent;
+		result.opaque = total.opaque;
+	}
+
 	template <typename PixelType_>
 	void FindMinMaxValueImpl(FIBITMAP* src, void* out_min_value, void* out_max_value)
 	{
+		using ValueType = ToValueType<PixelType_>;
+		constexpr uint32_t channels = PixelChannelsNumber<PixelType_>::value;
+
+		StatisticsResult result;
+		GatherStatistics<ValueType, channels>(src, StatisticsOptions{}, result);
+
 		PixelType_ minVal, maxVal;
-		PixelFill(minVal, std::numeric_limits<ToValueType<PixelType_>>::max());
-		PixelFill(maxVal, std::numeric_limits<ToValueType<PixelType_>>::lowest());
-
-		const unsigned width = FreeImage_GetWidth(src);
-		const unsigned height = FreeImage_GetHeight(src);
-		const unsigned src_pitch = FreeImage_GetPitch(src);
-
-		uint8_t* src_bits = FreeImage_GetBits(src);
-		for (unsigned y = 0; y < height; ++y) {
-			auto src_pixel = static_cast<PixelType_*>(static_cast<void*>(src_bits));
-			for (unsigned x = 0; x < width; ++x) {
-				const PixelType_ val = src_pixel[x];
-				SetChannel<0>(minVal, std::min(GetChannel<0>(minVal), GetChannel<0>(val)));
-				SetChannel<1>(minVal, std::min(GetChannel<1>(minVal), GetChannel<1>(val)));
-				SetChannel<2>(minVal, std::min(GetChannel<2>(minVal), GetChannel<2>(val)));
-				SetChannel<3>(minVal, std::min(GetChannel<3>(minVal), GetChannel<3>(val)));
-				SetChannel<0>(maxVal, std::max(GetChannel<0>(maxVal), GetChannel<0>(val)));
-				SetChannel<1>(maxVal, std::max(GetChannel<1>(maxVal), GetChannel<1>(val)));
-				SetChannel<2>(maxVal, std::max(GetChannel<2>(maxVal), GetChannel<2>(val)));
-				SetChannel<3>(maxVal, std::max(GetChannel<3>(maxVal), GetChannel<3>(val)));
-			}
-			src_bits += src_pitch;
+		auto minSamples = static_cast<ValueType*>(static_cast<void*>(&minVal));
+		auto maxSamples = static_cast<ValueType*>(static_cast<void*>(&maxVal));
+		for (uint32_t c = 0; c < channels; ++c) {
+			minSamples[c] = static_cast<ValueType>(result.min[c]);
+			maxSamples[c] = static_cast<ValueType>(result.max[c]);
 		}
 
 		if (out_min_value) {
@@ -172,6 +390,56 @@ namespace
 		}
 	}
 
+	/**
+	Fills stats and the histograms of an image of Channels_ samples of type Ty_.
+	order maps the channels of FISTATISTICS (red, green, blue, alpha) to memory channels, NULL for the identity.
+	*/
+	template <typename Ty_, unsigned Channels_>
+	void GetStatisticsImpl(FIBITMAP* dib, FISTATISTICS* stats, uint32_t* histograms, uint32_t bins, double range_min, double range_max, bool alpha, const unsigned* order)
+	{
+		StatisticsOptions options;
+		options.sums = true;
+		options.bins = histograms ? bins : 0;
+		options.alpha = alpha;
+		if (range_min < range_max) {
+			options.fullRange = false;
+			options.lo = range_min;
+			options.hi = range_max;
+		}
+		else if (std::is_floating_point_v<Ty_> && histograms) {
+			// the range of floating point samples is unknown: bin over the bounds of the color channels
+			StatisticsResult bounds;
+			GatherStatistics<Ty_, Channels_>(dib, StatisticsOptions{}, bounds);
+			const unsigned colors = (alpha && Channels_ > 1) ? Channels_ - 1 : Channels_;
+			options.fullRange = false;
+			options.lo = *std::min_element(bounds.min, bounds.min + colors);
+			options.hi = *std::max_element(bounds.max, bounds.max + colors);
+		}
+
+		StatisticsResult result;
+		GatherStatistics<Ty_, Channels_>(dib, options, result);
+
+		*stats = FISTATISTICS{};
+		stats->channels = Channels_;
+		stats->pixels = static_cast<uint64_t>(FreeImage_GetWidth(dib)) * FreeImage_GetHeight(dib);
+		for (unsigned c = 0; c < Channels_; ++c) {
+			const unsigned m = order ? order[c] : c;
+			stats->channel[c].min = result.min[m];
+			stats->channel[c].max = result.max[m];
+			stats->channel[c].mean = result.mean[m];
+			stats->channel[c].variance = result.variance[m];
+			if (histograms) {
+				std::copy_n(result.hist.data() + static_cast<size_t>(m) * bins, bins, histograms + static_cast<size_t>(c) * bins);
+			}
+		}
+		stats->transparent = alpha ? result.transparent : 0;
+		stats->opaque = alpha ? result.opaque : stats->pixels;
+		if (histograms) {
+			stats->histogram_min = options.fullRange ? static_cast<double>(std::numeric_limits<Ty_>::lowest()) : options.lo;
+			stats->histogram_max = options.fullRange ? static_cast<double>(std::numeric_limits<Ty_>::max()) : options.hi;
+		}
+	}
+
 } // namespace
 
 FIBOOL FreeImage_FindMinMaxValue(FIBITMAP* dib, void* min_value, void* max_value)
@@ -247,7 +515,7 @@ FIBOOL FreeImage_FindMinMaxValue(FIBITMAP* dib, void* min_value, void* max_value
 		FindMinMaxValueImpl<uint16_t>(dib, min_value, max_value);
 		break;
 	case FIT_INT16:
-		FindMinMaxValueImpl<uint16_t>(dib, min_value, max_value);
+		FindMinMaxValueImpl<int16_t>(dib, min_value, max_value);
 		break;
 	case FIT_COMPLEX:
 		FindMinMaxValueImpl<FICOMPLEX>(dib, min_value, max_value);
@@ -263,6 +531,74 @@ FIBOOL FreeImage_FindMinMaxValue(FIBITMAP* dib, void* min_value, void* max_value
 }
 
 
+FIBOOL DLL_CALLCONV FreeImage_GetStatistics(FIBITMAP* dib, FISTATISTICS* stats, uint32_t* histograms, uint32_t bins, double range_min, double range_max)
+{
+	if (!FreeImage_HasPixels(dib) || !stats || (histograms && bins < 1)) {
+		return FALSE;
+	}
+
+	// FISTATISTICS lists red, green and blue first, FIT_BITMAP stores them in the FI_RGBA_* order
+	static const unsigned kBitmapOrder[4] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA };
+
+	switch (FreeImage_GetImageType(dib)) {
+	case FIT_BITMAP:
+		switch (FreeImage_GetBPP(dib)) {
+		case 8:
+			GetStatisticsImpl<uint8_t, 1>(dib, stats, histograms, bins, range_min, range_max, false, nullptr);
+			break;
+		case 24:
+			GetStatisticsImpl<uint8_t, 3>(dib, stats, histograms, bins, range_min, range_max, false, kBitmapOrder);
+			break;
+		case 32:
+			GetStatisticsImpl<uint8_t, 4>(dib, stats, histograms, bins, range_min, range_max, true, kBitmapOrder);
+			break;
+		default:
+			return FALSE;
+		}
+		break;
+	case FIT_UINT16:
+		GetStatisticsImpl<uint16_t, 1>(dib, stats, histograms, bins, range_min, range_max, false, nullptr);
+		break;
+	case FIT_INT16:
+		GetStatisticsImpl<int16_t, 1>(dib, stats, histograms, bins, range_min, range_max, false, nullptr);
+		break;
+	case FIT_UINT32:
+		GetStatisticsImpl<uint32_t, 1>(dib, stats, histograms, bins, range_min, range_max, false, nullptr);
+		break;
+	case FIT_INT32:
+		GetStatisticsImpl<int32_t, 1>(dib, stats, histograms, bins, range_min, range_max, false, nullptr);
+		break;
+	case FIT_FLOAT:
+		GetStatisticsImpl<float, 1>(dib, stats, histograms, bins, range_min, range_max, false, nullptr);
+		break;
+	case FIT_DOUBLE:
+		GetStatisticsImpl<double, 1>(dib, stats, histograms, bins, range_min, range_max, false, nullptr);
+		break;
+	case FIT_RGB16:
+		GetStatisticsImpl<uint16_t, 3>(dib, stats, histograms, bins, range_min, range_max, false, nullptr);
+		break;
+	case FIT_RGBA16:
+		GetStatisticsImpl<uint16_t, 4>(dib, stats, histograms, bins, range_min, range_max, true, nullptr);
+		break;
+	case FIT_RGB32:
+		GetStatisticsImpl<uint32_t, 3>(dib, stats, histograms, bins, range_min, range_max, false, nullptr);
+		break;
+	case FIT_RGBA32:
+		GetStatisticsImpl<uint32_t, 4>(dib, stats, histograms, bins, range_min, range_max, true, nullptr);
+		break;
+	case FIT_RGBF:
+		GetStatisticsImpl<float, 3>(dib, stats, histograms, bins, range_min, range_max, false, nullptr);
+		break;
+	case FIT_RGBAF:
+		GetStatisticsImpl<float, 4>(dib, stats, histograms, bins, range_min, range_max, true, nullptr);
+		break;
+	default:
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 FIBOOL FreeImage_Fill(FIBITMAP* dib, const void* value_ptr, size_t value_size)
 {
 	if (!FreeImage_HasPixels(dib)) {
@@ -8,9 +8,15 @@
 #define FREEIMAGE_SIMPLE_TOOLS_H_
 
 #include "ConversionYUV.h"
+#include "CPUFeatures.h"
+#include "ThreadPool.h"
+#include <algorithm>
 #include <cmath>
 #include <tuple>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 
 using UniqueBitmap = std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>;
@@ -21,15 +27,15 @@ void BitmapForEach(FIBITMAP* src, PixelVisitor_ vis)
 {
     const unsigned width = FreeImage_GetWidth(src);
     const unsigned height = FreeImage_GetHeight(src);
-    const unsigned src_pitch = FreeImage_GetPitch(src);
+    const int src_stride = FreeImage_GetScanLineStride(src);
 
-    const uint8_t* src_bits = FreeImage_GetBits(src);
+    const uint8_t* src_bits = FreeImage_GetScanLine(src, 0);
     for (unsigned y = 0; y < height; ++y) {
         auto src_pixel = static_cast<const SrcPixel_*>(static_cast<const void*>(src_bits));
         for (unsigned x = 0; x < width; ++x) {
             vis(src_pixel[x], x, y);
         }
-        src_bits += src_pitch;
+        src_bits += src_stride;
     }
 }
 
@@ -38,11 +44,11 @@ void BitmapTransform(FIBITMAP* dst, FIBITMAP* src, UnaryOperation_ unary_op)
 {
 	const unsigned width = FreeImage_GetWidth(src);
 	const unsigned height = FreeImage_GetHeight(src);
-	const unsigned src_pitch = FreeImage_GetPitch(src);
-	const unsigned dst_pitch = FreeImage_GetPitch(dst);
+	const int src_stride = FreeImage_GetScanLineStride(src);
+	const int dst_stride = FreeImage_GetScanLineStride(dst);
 
-	const uint8_t* src_bits = FreeImage_GetBits(src);
-	uint8_t* dst_bits = FreeImage_GetBits(dst);
+	const uint8_t* src_bits = FreeImage_GetScanLine(src, 0);
+	uint8_t* dst_bits = FreeImage_GetScanLine(dst, 0);
 
 	for (unsigned y = 0; y < height; ++y) {
 		auto src_pixel = static_cast<const SrcPixel_*>(static_cast<const void*>(src_bits));
@@ -50,11 +56,122 @@ void BitmapTransform(FIBITMAP* dst, FIBITMAP* src, UnaryOperation_ unary_op)
 		for (unsigned x = 0; x < width; ++x) {
 			dst_pixel[x] = unary_op(src_pixel[x]);
 		}
-		src_bits += src_pitch;
-		dst_bits += dst_pitch;
+		src_bits += src_stride;
+		dst_bits += dst_stride;
 	}
 }
 
+/// Lets the compiler vectorize the following loop, whose iterations must not depend on each other
+#if defined(__clang__)
+#define FI_VECTORIZE_LOOP _Pragma("clang loop vectorize(enable) interleave(enable)")
+#elif defined(__GNUC__)
+#define FI_VECTORIZE_LOOP _Pragma("GCC ivdep")
+#elif defined(_MSC_VER)
+#define FI_VECTORIZE_LOOP __pragma(loop(ivdep))
+#else
+#define FI_VECTORIZE_LOOP
+#endif
+
+/// Vectorized row of BitmapTransformParallel, dispatched by KernelDispatch
+template <typename DstPixel_, typename SrcPixel_, typename UnaryOperation_>
+struct BitmapTransformRow
+{
+	static FI_ALWAYS_INLINE void Run(DstPixel_* dst, const SrcPixel_* src, unsigned width, UnaryOperation_* op)
+	{
+		FI_VECTORIZE_LOOP
+		for (size_t x = 0; x < width; ++x) {
+			dst[x] = (*op)(src[x]);
+		}
+	}
+};
+
+/// Default number of pixels per task of BitmapTransformParallel
+inline constexpr unsigned kTransformGrainPixels = 16 * 1024;
+
+/// Maximum number of bands of BitmapReduceParallel
+inline constexpr size_t kReduceMaxBands = 64;
+
+/**
+Parallel BitmapTransform: bands of rows are transformed on the library thread pool.
+GrainPixels_ is the minimal amount of pixels handed to one task, small images run on the calling thread.
+With Vectorize_ the inner loop is marked free of loop-carried dependencies and is also compiled for AVX2,
+which requires dst and src not to overlap. unary_op is called concurrently and must not modify shared state.
+*/
+template <typename DstPixel_, typename SrcPixel_ = DstPixel_, unsigned GrainPixels_ = kTransformGrainPixels, bool Vectorize_ = false, typename UnaryOperation_>
+void BitmapTransformParallel(FIBITMAP* dst, FIBITMAP* src, UnaryOperation_ unary_op)
+{
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const ptrdiff_t src_stride = FreeImage_GetScanLineStride(src);
+	const ptrdiff_t dst_stride = FreeImage_GetScanLineStride(dst);
+
+	const uint8_t* src_bits = FreeImage_GetScanLine(src, 0);
+	uint8_t* dst_bits = FreeImage_GetScanLine(dst, 0);
+
+	const size_t grain_rows = std::max<size_t>(1, GrainPixels_ / std::max(width, 1U));
+
+	ThreadPool::Instance().parallelFor(0, height, grain_rows, [&](size_t first, size_t last) {
+		UnaryOperation_ op = unary_op;
+		for (size_t y = first; y < last; ++y) {
+			auto src_pixel = static_cast<const SrcPixel_*>(static_cast<const void*>(src_bits + (ptrdiff_t)y * src_stride));
+			auto dst_pixel = static_cast<DstPixel_*>(static_cast<void*>(dst_bits + (ptrdiff_t)y * dst_stride));
+			if constexpr (Vectorize_) {
+				KernelDispatch<BitmapTransformRow<DstPixel_, SrcPixel_, UnaryOperation_>>::Run(dst_pixel, src_pixel, width, &op);
+			}
+			else {
+				for (unsigned x = 0; x < width; ++x) {
+					dst_pixel[x] = op(src_pixel[x]);
+				}
+			}
+		}
+	});
+}
+
+/**
+Parallel reduction over the rows of src: the rows are split into bands, every band starts from a copy
+of init, visit(state, row, width) accumulates one row into it and merge(state) folds the finished band
+into the caller's result. merge is serialized and called in band order, and the bands only depend on the
+image size and grainPixels, so that floating-point sums are the same on every machine and every run.
+visit runs concurrently on different states.
+*/
+template <typename SrcPixel_, typename State_, typename RowVisitor_, typename Merge_>
+void BitmapReduceParallel(FIBITMAP* src, const State_& init, RowVisitor_ visit, Merge_ merge, unsigned grainPixels = kTransformGrainPixels)
+{
+	const unsigned width = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+	const ptrdiff_t src_stride = FreeImage_GetScanLineStride(src);
+	const uint8_t* src_bits = FreeImage_GetScanLine(src, 0);
+
+	if (height == 0) {
+		return;
+	}
+
+	ThreadPool& pool = ThreadPool::Instance();
+	const size_t grain_rows = std::max<size_t>(1, grainPixels / std::max(width, 1U));
+	const size_t bands = std::min<size_t>((height + grain_rows - 1) / grain_rows, kReduceMaxBands);
+
+	// finished bands wait here until all the bands before them are merged
+	std::vector<std::optional<State_>> done(bands);
+	size_t merged = 0;
+	std::mutex merge_mutex;
+
+	pool.parallelFor(0, bands, 1, [&](size_t first, size_t last) {
+		for (size_t band = first; band < last; ++band) {
+			State_ state = init;
+			const size_t y_end = height * (band + 1) / bands;
+			for (size_t y = height * band / bands; y < y_end; ++y) {
+				visit(state, static_cast<const SrcPixel_*>(static_cast<const void*>(src_bits + (ptrdiff_t)y * src_stride)), width);
+			}
+			std::lock_guard<std::mutex> lock(merge_mutex);
+			done[band].emplace(std::move(state));
+			for (; (merged < bands) && done[merged]; ++merged) {
+				merge(*done[merged]);
+				done[merged].reset();
+			}
+		}
+	});
+}
+
 template <typename Ty_>
 using IsIntPixelType = std::integral_constant<bool,
     std::is_same_v<Ty_, FIRGB8> ||
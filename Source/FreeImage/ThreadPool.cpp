@@ -0,0 +1,86 @@
+// ==========================================================
+// Internal worker thread pool
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include <algorithm>
+
+#include "ThreadPool.h"
+
+// ----------------------------------------------------------
+
+static thread_local bool s_worker_thread = false;
+
+ThreadPool::ThreadPool(unsigned threads) {
+	threads = std::max(threads, 1U);
+	m_threads.reserve(threads);
+	for (unsigned i = 0; i < threads; i++) {
+		m_threads.emplace_back([this]() { run(); });
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_condition.notify_all();
+	for (auto& thread : m_threads) {
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+}
+
+ThreadPool&
+ThreadPool::Instance() {
+	static ThreadPool pool(std::thread::hardware_concurrency());
+	return pool;
+}
+
+bool
+ThreadPool::isWorkerThread() {
+	return s_worker_thread;
+}
+
+void
+ThreadPool::enqueue(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_condition.notify_one();
+}
+
+void
+ThreadPool::run() {
+	s_worker_thread = true;
+
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+			if (m_tasks.empty()) {
+				// stopping and nothing left to do
+				return;
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+		task();
+	}
+}
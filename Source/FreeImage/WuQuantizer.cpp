@@ -33,6 +33,7 @@
 #include "Quantizers.h"
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "SimpleTools.h"
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -44,17 +45,103 @@
 
 #define MAXCOLOR	256
 
+namespace {
+
+/// Index of the histogram cell of a BGR[A] pixel
+inline int
+CellIndex(const uint8_t *pixel) {
+	const int inr = (pixel[FI_RGBA_RED] >> 3) + 1;
+	const int ing = (pixel[FI_RGBA_GREEN] >> 3) + 1;
+	const int inb = (pixel[FI_RGBA_BLUE] >> 3) + 1;
+	return INDEX(inr, ing, inb);
+}
+
+/// Histogram of the pixels of one row band
+struct WuHistogram {
+	std::vector<int32_t> wt, mr, mg, mb;
+	std::vector<int64_t> m2;	// exact sums of c^2, whatever the band size
+
+	WuHistogram() : wt(SIZE_3D), mr(SIZE_3D), mg(SIZE_3D), mb(SIZE_3D), m2(SIZE_3D) {
+	}
+};
+
+template <unsigned Bytespp_>
+void
+AddRowsToHistogram(WuHistogram &hist, const uint8_t *bits, ptrdiff_t stride, unsigned width, size_t first, size_t last) {
+	for (size_t y = first; y < last; ++y) {
+		const uint8_t *pixel = bits + (ptrdiff_t)y * stride;
+		for (unsigned x = 0; x < width; ++x, pixel += Bytespp_) {
+			const int ind = CellIndex(pixel);
+			const int32_t r = pixel[FI_RGBA_RED];
+			const int32_t g = pixel[FI_RGBA_GREEN];
+			const int32_t b = pixel[FI_RGBA_BLUE];
+			hist.wt[ind]++;
+			hist.mr[ind] += r;
+			hist.mg[ind] += g;
+			hist.mb[ind] += b;
+			hist.m2[ind] += r * r + g * g + b * b;
+		}
+	}
+}
+
+/// Turns a 33x33x33 histogram into cumulative moments, one axis after the other
+template <typename Ty_>
+void
+CumulateMoments(Ty_ *m) {
+	// along b, within each row
+	for (int r = 1; r <= 32; r++) {
+		for (int g = 1; g <= 32; g++) {
+			Ty_ *row = m + INDEX(r, g, 0);
+			for (int b = 2; b <= 32; b++) {
+				row[b] += row[b - 1];
+			}
+		}
+	}
+	// along g, 33 cells at a time
+	for (int r = 1; r <= 32; r++) {
+		for (int g = 2; g <= 32; g++) {
+			Ty_ *row = m + INDEX(r, g, 0);
+			const Ty_ *prev = row - 33;
+			FI_VECTORIZE_LOOP
+			for (int b = 0; b <= 32; b++) {
+				row[b] += prev[b];
+			}
+		}
+	}
+	// along r, 33 x 33 cells at a time
+	for (int r = 2; r <= 32; r++) {
+		Ty_ *plane = m + INDEX(r, 0, 0);
+		const Ty_ *prev = plane - 1089;
+		FI_VECTORIZE_LOOP
+		for (int i = 0; i < 1089; i++) {
+			plane[i] += prev[i];
+		}
+	}
+}
+
+template <unsigned Bytespp_>
+void
+MapRowsToPalette(const uint8_t *tag, const uint8_t *src_bits, ptrdiff_t src_stride, uint8_t *dst_bits, ptrdiff_t dst_stride, unsigned width, size_t first, size_t last) {
+	for (size_t y = first; y < last; ++y) {
+		const uint8_t *pixel = src_bits + (ptrdiff_t)y * src_stride;
+		uint8_t *index = dst_bits + (ptrdiff_t)y * dst_stride;
+		for (unsigned x = 0; x < width; ++x, pixel += Bytespp_) {
+			index[x] = tag[CellIndex(pixel)];
+		}
+	}
+}
+
+} // namespace
+
 // Constructor / Destructor
 
 WuQuantizer::WuQuantizer(FIBITMAP *dib) {
 	width = FreeImage_GetWidth(dib);
 	height = FreeImage_GetHeight(dib);
-	pitch = FreeImage_GetPitch(dib);
 	m_dib = dib;
 
 	gm2 = nullptr;
 	wt = mr = mg = mb = nullptr;
-	Qadd = nullptr;
 
 	// Allocate 3D arrays
 	gm2 = static_cast<float*>(calloc(SIZE_3D, sizeof(float)));
@@ -63,16 +150,12 @@ WuQuantizer::WuQuantizer(FIBITMAP *dib) {
 	mg = static_cast<int32_t*>(calloc(SIZE_3D, sizeof(int32_t)));
 	mb = static_cast<int32_t*>(calloc(SIZE_3D, sizeof(int32_t)));
 
-	// Allocate Qadd
-	Qadd = static_cast<uint16_t*>(calloc(static_cast<size_t>(width) * height, sizeof(uint16_t)));
-
-	if (!gm2 || !wt || !mr || !mg || !mb || !Qadd) {
+	if (!gm2 || !wt || !mr || !mg || !mb) {
 		if (gm2)	free(gm2);
 		if (wt)	free(wt);
 		if (mr)	free(mr);
 		if (mg)	free(mg);
 		if (mb)	free(mb);
-		if (Qadd)  free(Qadd);
 		throw FI_MSG_ERROR_MEMORY;
 	}
 }
@@ -83,7 +166,6 @@ WuQuantizer::~WuQuantizer() {
 	if (mr)	free(mr);
 	if (mg)	free(mg);
 	if (mb)	free(mb);
-	if (Qadd)  free(Qadd);
 }
 
 
@@ -92,59 +174,54 @@ WuQuantizer::~WuQuantizer() {
 // NB: these must start out 0!
 
 // Build 3-D color histogram of counts, r/g/b, c^2
+// Row bands are counted into private histograms on the thread pool, which are then summed cell by cell
 void 
 WuQuantizer::Hist3D(int32_t *vwt, int32_t *vmr, int32_t *vmg, int32_t *vmb, float *m2, int ReserveSize, FIRGBA8 *ReservePalette) {
 	int ind = 0;
 	int inr, ing, inb, table[256];
 	int i;
-	unsigned y, x;
 
 	for (i = 0; i < 256; i++)
 		table[i] = i * i;
 
-	if (FreeImage_GetBPP(m_dib) == 24) {
-		size_t rowOffset = 0;
-		for (y = 0; y < height; y++) {
-			uint8_t *bits = FreeImage_GetScanLine(m_dib, y);
-
-			for (x = 0; x < width; x++)	{
-				inr = (bits[FI_RGBA_RED] >> 3) + 1;
-				ing = (bits[FI_RGBA_GREEN] >> 3) + 1;
-				inb = (bits[FI_RGBA_BLUE] >> 3) + 1;
-				ind = INDEX(inr, ing, inb);
-				Qadd[rowOffset + x] = (uint16_t)ind;
-				// [inr][ing][inb]
-				vwt[ind]++;
-				vmr[ind] += bits[FI_RGBA_RED];
-				vmg[ind] += bits[FI_RGBA_GREEN];
-				vmb[ind] += bits[FI_RGBA_BLUE];
-				m2[ind] += (float)(table[bits[FI_RGBA_RED]] + table[bits[FI_RGBA_GREEN]] + table[bits[FI_RGBA_BLUE]]);
-				bits += 3;
+	// a band histogram takes about 1 MB, so that bands are worth it for large images only
+	const size_t pixels = (size_t)width * height;
+	const size_t bands = std::max<size_t>(1, std::min<size_t>(ThreadPool::Instance().getThreadCount() + 1, pixels / (16 * kTransformGrainPixels)));
+	std::vector<WuHistogram> hists(bands);
+
+	const uint8_t *bits = FreeImage_GetScanLine(m_dib, 0);
+	const ptrdiff_t stride = FreeImage_GetScanLineStride(m_dib);
+	const bool is24 = (FreeImage_GetBPP(m_dib) == 24);
+	ThreadPool::Instance().parallelFor(0, bands, 1, [&](size_t first, size_t last) {
+		for (size_t band = first; band < last; ++band) {
+			const size_t y0 = height * band / bands;
+			const size_t y1 = height * (band + 1) / bands;
+			if (is24) {
+				AddRowsToHistogram<3>(hists[band], bits, stride, width, y0, y1);
+			} else {
+				AddRowsToHistogram<4>(hists[band], bits, stride, width, y0, y1);
 			}
-			rowOffset += width;
 		}
-	} else {
-		size_t rowOffset = 0;
-		for (y = 0; y < height; y++) {
-			uint8_t *bits = FreeImage_GetScanLine(m_dib, y);
-
-			for (x = 0; x < width; x++)	{
-				inr = (bits[FI_RGBA_RED] >> 3) + 1;
-				ing = (bits[FI_RGBA_GREEN] >> 3) + 1;
-				inb = (bits[FI_RGBA_BLUE] >> 3) + 1;
-				ind = INDEX(inr, ing, inb);
-				Qadd[rowOffset + x] = (uint16_t)ind;
-				// [inr][ing][inb]
-				vwt[ind]++;
-				vmr[ind] += bits[FI_RGBA_RED];
-				vmg[ind] += bits[FI_RGBA_GREEN];
-				vmb[ind] += bits[FI_RGBA_BLUE];
-				m2[ind] += (float)(table[bits[FI_RGBA_RED]] + table[bits[FI_RGBA_GREEN]] + table[bits[FI_RGBA_BLUE]]);
-				bits += 4;
+	});
+
+	ThreadPool::Instance().parallelFor(0, SIZE_3D, 4096, [&](size_t first, size_t last) {
+		for (size_t cell = first; cell < last; ++cell) {
+			int32_t sum_wt = 0, sum_mr = 0, sum_mg = 0, sum_mb = 0;
+			int64_t sum_m2 = 0;
+			for (const WuHistogram &hist : hists) {
+				sum_wt += hist.wt[cell];
+				sum_mr += hist.mr[cell];
+				sum_mg += hist.mg[cell];
+				sum_mb += hist.mb[cell];
+				sum_m2 += hist.m2[cell];
 			}
-			rowOffset += width;
+			vwt[cell] = sum_wt;
+			vmr[cell] = sum_mr;
+			vmg[cell] = sum_mg;
+			vmb[cell] = sum_mb;
+			m2[cell] = (float)sum_m2;
 		}
-	}
+	});
 
 	if (ReserveSize > 0) {
 		int max = 0;
@@ -179,43 +256,17 @@ WuQuantizer::Hist3D(int32_t *vwt, int32_t *vmr, int32_t *vmg, int32_t *vmb, floa
 // the sums of the above quantities over any desired box.
 
 // Compute cumulative moments
+// The 3D prefix sum is separable: the cells are summed along b, then along g and r, whose
+// passes add whole rows and planes of cells and vectorize.
+// The float m2 sums are added in another order than the original line/area loop, so they
+// can round differently and, for some images, split a box differently
 void 
 WuQuantizer::M3D(int32_t *vwt, int32_t *vmr, int32_t *vmg, int32_t *vmb, float *m2) {
-	unsigned ind1, ind2;
-	uint8_t i, r, g, b;
-	int32_t line, line_r, line_g, line_b;
-	int32_t area[33], area_r[33], area_g[33], area_b[33];
-	float line2, area2[33];
-
-    for (r = 1; r <= 32; r++) {
-		for (i = 0; i <= 32; i++) {
-			area2[i] = 0;
-			area[i] = area_r[i] = area_g[i] = area_b[i] = 0;
-		}
-		for (g = 1; g <= 32; g++) {
-			line2 = 0;
-			line = line_r = line_g = line_b = 0;
-			for (b = 1; b <= 32; b++) {			 
-				ind1 = INDEX(r, g, b); // [r][g][b]
-				line += vwt[ind1];
-				line_r += vmr[ind1]; 
-				line_g += vmg[ind1]; 
-				line_b += vmb[ind1];
-				line2 += m2[ind1];
-				area[b] += line;
-				area_r[b] += line_r;
-				area_g[b] += line_g;
-				area_b[b] += line_b;
-				area2[b] += line2;
-				ind2 = ind1 - 1089; // [r-1][g][b]
-				vwt[ind1] = vwt[ind2] + area[b];
-				vmr[ind1] = vmr[ind2] + area_r[b];
-				vmg[ind1] = vmg[ind2] + area_g[b];
-				vmb[ind1] = vmb[ind2] + area_b[b];
-				m2[ind1] = m2[ind2] + area2[b];
-			}
-		}
-	}
+	CumulateMoments(vwt);
+	CumulateMoments(vmr);
+	CumulateMoments(vmg);
+	CumulateMoments(vmb);
+	CumulateMoments(m2);
 }
 
 // Compute sum over a box of any given statistic
@@ -533,17 +584,22 @@ WuQuantizer::Quantize(int PaletteSize, int ReserveSize, FIRGBA8 *ReservePalette)
 			}
 		}
 
-		int npitch = FreeImage_GetPitch(new_dib);
+		// map the pixels to their box, in row bands
 
-		size_t rowOffset = 0;
-		for (unsigned y = 0; y < height; y++) {
-			uint8_t *new_bits = FreeImage_GetBits(new_dib) + (y * npitch);
+		const uint8_t *src_bits = FreeImage_GetScanLine(m_dib, 0);
+		const ptrdiff_t src_stride = FreeImage_GetScanLineStride(m_dib);
+		uint8_t *dst_bits = FreeImage_GetScanLine(new_dib, 0);
+		const ptrdiff_t dst_stride = FreeImage_GetScanLineStride(new_dib);
+		const bool is24 = (FreeImage_GetBPP(m_dib) == 24);
 
-			for (unsigned x = 0; x < width; x++) {
-				new_bits[x] = tag[Qadd[rowOffset + x]];
+		const size_t grain_rows = MAX((size_t)1, (size_t)(kTransformGrainPixels / MAX(width, 1U)));
+		ThreadPool::Instance().parallelFor(0, height, grain_rows, [&](size_t first, size_t last) {
+			if (is24) {
+				MapRowsToPalette<3>(tag, src_bits, src_stride, dst_bits, dst_stride, width, first, last);
+			} else {
+				MapRowsToPalette<4>(tag, src_bits, src_stride, dst_bits, dst_stride, width, first, last);
 			}
-			rowOffset += width;
-		}
+		});
 
 		// output 'new_pal' as color look-up table contents,
 		// 'new_bits' as the quantized image (array of table addresses).
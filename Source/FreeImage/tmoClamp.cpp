@@ -83,52 +83,52 @@ FIBITMAP* FreeImage_TmoClamp(FIBITMAP* src, double max_value)
 
     switch (imageType) {
     case FIT_RGBAF:
-        BitmapTransform<FIRGBA8, FIRGBAF>(dst.get(), src, [&](const FIRGBAF& p) {
+        BitmapTransformParallel<FIRGBA8, FIRGBAF>(dst.get(), src, [&](const FIRGBAF& p) {
             return FIRGBA8{ ClampFloat(p.red), ClampFloat(p.green), ClampFloat(p.blue), ClampFloat(p.alpha) };
         });
         break;
     case FIT_RGBF:
-        BitmapTransform<FIRGB8, FIRGBF>(dst.get(), src, [&](const FIRGBF& p) {
+        BitmapTransformParallel<FIRGB8, FIRGBF>(dst.get(), src, [&](const FIRGBF& p) {
             return FIRGB8{ ClampFloat(p.red), ClampFloat(p.green), ClampFloat(p.blue) };
         });
         break;
     case FIT_RGBA32:
-        BitmapTransform<FIRGBA8, FIRGBA32>(dst.get(), src, [&](const FIRGBA32& p) {
+        BitmapTransformParallel<FIRGBA8, FIRGBA32>(dst.get(), src, [&](const FIRGBA32& p) {
             return FIRGBA8{ ClampInt(p.red), ClampInt(p.green), ClampInt(p.blue), ClampInt(p.alpha) };
         });
         break;
     case FIT_RGB32:
-        BitmapTransform<FIRGB8, FIRGB32>(dst.get(), src, [&](const FIRGB32& p) {
+        BitmapTransformParallel<FIRGB8, FIRGB32>(dst.get(), src, [&](const FIRGB32& p) {
             return FIRGB8{ ClampInt(p.red), ClampInt(p.green), ClampInt(p.blue) };
         });
         break;
     case FIT_RGBA16:
-        BitmapTransform<FIRGBA8, FIRGBA16>(dst.get(), src, [&](const FIRGBA16& p) {
+        BitmapTransformParallel<FIRGBA8, FIRGBA16>(dst.get(), src, [&](const FIRGBA16& p) {
             return FIRGBA8{ ClampInt(p.red), ClampInt(p.green), ClampInt(p.blue), ClampInt(p.alpha) };
         });
         break;
     case FIT_RGB16:
-        BitmapTransform<FIRGB8, FIRGB16>(dst.get(), src, [&](const FIRGB16& p) {
+        BitmapTransformParallel<FIRGB8, FIRGB16>(dst.get(), src, [&](const FIRGB16& p) {
             return FIRGB8{ ClampInt(p.red), ClampInt(p.green), ClampInt(p.blue) };
         });
         break;
     case FIT_DOUBLE:
-        BitmapTransform<uint8_t, double>(dst.get(), src, [&](const double& p) {
+        BitmapTransformParallel<uint8_t, double>(dst.get(), src, [&](const double& p) {
             return ClampFloat(p);
         });
         break;
     case FIT_FLOAT:
-        BitmapTransform<uint8_t, float>(dst.get(), src, [&](const float& p) {
+        BitmapTransformParallel<uint8_t, float>(dst.get(), src, [&](const float& p) {
             return ClampFloat(p);
         });
         break;
     case FIT_UINT32:
-        BitmapTransform<uint8_t, uint32_t>(dst.get(), src, [&](const uint32_t& p) {
+        BitmapTransformParallel<uint8_t, uint32_t>(dst.get(), src, [&](const uint32_t& p) {
             return ClampInt(p);
         });
         break;
     case FIT_UINT16:
-        BitmapTransform<uint8_t, uint16_t>(dst.get(), src, [&](const uint16_t& p) {
+        BitmapTransformParallel<uint8_t, uint16_t>(dst.get(), src, [&](const uint16_t& p) {
             return ClampInt(p);
         });
         break;
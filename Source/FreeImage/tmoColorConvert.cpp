@@ -23,242 +23,147 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "SimpleTools.h"
 #include <algorithm>
 
+static const float EPSILON = 1e-06F;
+static const float INF = 1e+10F;
+
 // ----------------------------------------------------------
-// Convert RGB to and from Yxy, same as in Reinhard et al. SIGGRAPH 2002
-// References : 
-// [1] Radiance Home Page [Online] http://radsite.lbl.gov/radiance/HOME.html
-// [2] E. Reinhard, M. Stark, P. Shirley, and J. Ferwerda,  
-//     Photographic Tone Reproduction for Digital Images, ACM Transactions on Graphics, 
-//     21(3):267-276, 2002 (Proceedings of SIGGRAPH 2002). 
-// [3] J. Tumblin and H.E. Rushmeier, 
-//     Tone Reproduction for Realistic Images. IEEE Computer Graphics and Applications, 
-//     13(6):42-48, 1993.
+//   Luminance statistics
 // ----------------------------------------------------------
 
-/**
-nominal CRT primaries 
-*/
-/*
-static const float CIE_x_r = 0.640F;
-static const float CIE_y_r = 0.330F;
-static const float CIE_x_g = 0.290F;
-static const float CIE_y_g = 0.600F;
-static const float CIE_x_b = 0.150F;
-static const float CIE_y_b = 0.060F;
-static const float CIE_x_w = 0.3333F;	// use true white
-static const float CIE_y_w = 0.3333F;
-*/
-/**
-sRGB primaries
-*/
-static const float CIE_x_r = 0.640F;
-static const float CIE_y_r = 0.330F;
-static const float CIE_x_g = 0.300F;
-static const float CIE_y_g = 0.600F;
-static const float CIE_x_b = 0.150F;
-static const float CIE_y_b = 0.060F;
-static const float CIE_x_w = 0.3127F;	// Illuminant D65
-static const float CIE_y_w = 0.3290F;
-
-static const float CIE_D = ( CIE_x_r*(CIE_y_g - CIE_y_b) + CIE_x_g*(CIE_y_b - CIE_y_r) + CIE_x_b*(CIE_y_r - CIE_y_g) );
-static const float CIE_C_rD = ( (1/CIE_y_w) * ( CIE_x_w*(CIE_y_g - CIE_y_b) - CIE_y_w*(CIE_x_g - CIE_x_b) + CIE_x_g*CIE_y_b - CIE_x_b*CIE_y_g) );
-static const float CIE_C_gD = ( (1/CIE_y_w) * ( CIE_x_w*(CIE_y_b - CIE_y_r) - CIE_y_w*(CIE_x_b - CIE_x_r) - CIE_x_r*CIE_y_b + CIE_x_b*CIE_y_r) );
-static const float CIE_C_bD = ( (1/CIE_y_w) * ( CIE_x_w*(CIE_y_r - CIE_y_g) - CIE_y_w*(CIE_x_r - CIE_x_g) + CIE_x_r*CIE_y_g - CIE_x_g*CIE_y_r) );
+namespace {
 
-/**
-RGB to XYZ (no white balance)
-*/
-static const float  RGB2XYZ[3][3] = {
-	{ CIE_x_r*CIE_C_rD / CIE_D, 
-	  CIE_x_g*CIE_C_gD / CIE_D, 
-	  CIE_x_b*CIE_C_bD / CIE_D 
-	},
-	{ CIE_y_r*CIE_C_rD / CIE_D, 
-	  CIE_y_g*CIE_C_gD / CIE_D, 
-	  CIE_y_b*CIE_C_bD / CIE_D 
-	},
-	{ (1 - CIE_x_r-CIE_y_r)*CIE_C_rD / CIE_D,
-	  (1 - CIE_x_g-CIE_y_g)*CIE_C_gD / CIE_D,
-	  (1 - CIE_x_b-CIE_y_b)*CIE_C_bD / CIE_D
-	}
+/// Private accumulators of a band of rows: 8 lanes of pixels, reduced without reordering the additions of a lane
+struct LuminanceLanes
+{
+	static constexpr unsigned kLanes = 8;
+
+	float max[kLanes];
+	float min[kLanes];
+	double sum[kLanes]{};
+	double logSum[kLanes]{};	// log2(2.3e-5 + L)
+	double channelSum[3][kLanes]{};
 };
 
-/**
-XYZ to RGB (no white balance)
-*/
-static const float  XYZ2RGB[3][3] = {
-	{(CIE_y_g - CIE_y_b - CIE_x_b*CIE_y_g + CIE_y_b*CIE_x_g) / CIE_C_rD,
-	 (CIE_x_b - CIE_x_g - CIE_x_b*CIE_y_g + CIE_x_g*CIE_y_b) / CIE_C_rD,
-	 (CIE_x_g*CIE_y_b - CIE_x_b*CIE_y_g) / CIE_C_rD
-	},
-	{(CIE_y_b - CIE_y_r - CIE_y_b*CIE_x_r + CIE_y_r*CIE_x_b) / CIE_C_gD,
-	 (CIE_x_r - CIE_x_b - CIE_x_r*CIE_y_b + CIE_x_b*CIE_y_r) / CIE_C_gD,
-	 (CIE_x_b*CIE_y_r - CIE_x_r*CIE_y_b) / CIE_C_gD
-	},
-	{(CIE_y_r - CIE_y_g - CIE_y_r*CIE_x_g + CIE_y_g*CIE_x_r) / CIE_C_bD,
-	 (CIE_x_g - CIE_x_r - CIE_x_g*CIE_y_r + CIE_x_r*CIE_y_g) / CIE_C_bD,
-	 (CIE_x_r*CIE_y_g - CIE_x_g*CIE_y_r) / CIE_C_bD
+/// Accumulates a row of RGBF pixels into the lanes, dispatched by KernelDispatch
+template <bool Channels_>
+struct LuminanceStatsRow
+{
+	static constexpr unsigned kLanes = LuminanceLanes::kLanes;
+
+	static FI_ALWAYS_INLINE void Update(const FIRGBF& pixel, float& mx, float& mn, double& sum, double& logSum, double& red, double& green, double& blue)
+	{
+		const float r = pixel.red;
+		const float g = pixel.green;
+		const float b = pixel.blue;
+		float L = LUMA_REC709(r, g, b);
+		L = MaskFloat(L > 0, L);
+		mx = (mx < L) ? L : mx;
+		mn = (L < mn) ? L : mn;
+		sum += L;
+		logSum += FastLog2(2.3e-5F + L);	// contrast constant in Tumblin paper
+		if constexpr (Channels_) {
+			red += r;
+			green += g;
+			blue += b;
+		}
 	}
-};
 
-/**
-This gives approximately the following matrices : 
+	static FI_ALWAYS_INLINE void Run(const FIRGBF* row, unsigned width, LuminanceLanes* lanes)
+	{
+		float mx[kLanes], mn[kLanes];
+		double sum[kLanes], logSum[kLanes], red[kLanes], green[kLanes], blue[kLanes];
+		std::copy_n(lanes->max, kLanes, mx);
+		std::copy_n(lanes->min, kLanes, mn);
+		std::copy_n(lanes->sum, kLanes, sum);
+		std::copy_n(lanes->logSum, kLanes, logSum);
+		std::copy_n(lanes->channelSum[0], kLanes, red);
+		std::copy_n(lanes->channelSum[1], kLanes, green);
+		std::copy_n(lanes->channelSum[2], kLanes, blue);
+
+		size_t x = 0;
+		for (; x + kLanes <= width; x += kLanes) {
+			FI_VECTORIZE_LOOP
+			for (unsigned l = 0; l < kLanes; ++l) {
+				Update(row[x + l], mx[l], mn[l], sum[l], logSum[l], red[l], green[l], blue[l]);
+			}
+		}
+		for (unsigned l = 0; x < width; ++x, ++l) {
+			Update(row[x], mx[l], mn[l], sum[l], logSum[l], red[l], green[l], blue[l]);
+		}
 
-static const float RGB2XYZ[3][3] = { 
-	{ 0.41239083F, 0.35758433F, 0.18048081F },
-	{ 0.21263903F, 0.71516865F, 0.072192319F },
-	{ 0.019330820F, 0.11919473F, 0.95053220F }
-};
-static const float XYZ2RGB[3][3] = { 
-	{ 3.2409699F, -1.5373832F, -0.49861079F },
-	{ -0.96924376F, 1.8759676F, 0.041555084F },
-	{ 0.055630036F, -0.20397687F, 1.0569715F }
+		std::copy_n(mx, kLanes, lanes->max);
+		std::copy_n(mn, kLanes, lanes->min);
+		std::copy_n(sum, kLanes, lanes->sum);
+		std::copy_n(logSum, kLanes, lanes->logSum);
+		std::copy_n(red, kLanes, lanes->channelSum[0]);
+		std::copy_n(green, kLanes, lanes->channelSum[1]);
+		std::copy_n(blue, kLanes, lanes->channelSum[2]);
+	}
 };
-*/
 
-// ----------------------------------------------------------
-
-static const float EPSILON = 1e-06F;
-static const float INF = 1e+10F;
+} // namespace
 
-/**
-Convert in-place floating point RGB data to Yxy.<br>
-On output, pixel->red == Y, pixel->green == x, pixel->blue == y
-@param dib Input RGBF / Output Yxy image
-@return Returns TRUE if successful, returns FALSE otherwise
-*/
 FIBOOL 
-ConvertInPlaceRGBFToYxy(FIBITMAP *dib) {
-	float result[3];
-
-	if (FreeImage_GetImageType(dib) != FIT_RGBF)
+GetLuminanceStats(FIBITMAP *dib, LuminanceStats *stats, FIBOOL channels) {
+	if ((FreeImage_GetImageType(dib) != FIT_RGBF) || !stats) {
 		return FALSE;
-
-	const unsigned width  = FreeImage_GetWidth(dib);
-	const unsigned height = FreeImage_GetHeight(dib);
-	const unsigned pitch  = FreeImage_GetPitch(dib);
-	
-	auto *bits = (uint8_t*)FreeImage_GetBits(dib);
-	for (unsigned y = 0; y < height; y++) {
-		auto *pixel = (FIRGBF*)bits;
-		for (unsigned x = 0; x < width; x++) {
-			result[0] = result[1] = result[2] = 0;
-			for (int i = 0; i < 3; i++) {
-				result[i] += RGB2XYZ[i][0] * pixel[x].red;
-				result[i] += RGB2XYZ[i][1] * pixel[x].green;
-				result[i] += RGB2XYZ[i][2] * pixel[x].blue;
-			}
-			const float W = result[0] + result[1] + result[2];
-			const float Y = result[1];
-			if (W > 0) { 
-				pixel[x].red   = Y;			    // Y 
-				pixel[x].green = result[0] / W;	// x 
-				pixel[x].blue  = result[1] / W;	// y 	
-			} else {
-				pixel[x].red = pixel[x].green = pixel[x].blue = 0;
-			}
-		}
-		// next line
-		bits += pitch;
 	}
 
-	return TRUE;
-}
+	constexpr unsigned kLanes = LuminanceLanes::kLanes;
 
-/**
-Convert in-place Yxy image to floating point RGB data.<br>
-On input, pixel->red == Y, pixel->green == x, pixel->blue == y
-@param dib Input Yxy / Output RGBF image
-@return Returns TRUE if successful, returns FALSE otherwise
-*/
-FIBOOL 
-ConvertInPlaceYxyToRGBF(FIBITMAP *dib) {
-	float result[3];
-	float X, Y, Z;
-
-	if (FreeImage_GetImageType(dib) != FIT_RGBF)
-		return FALSE;
+	LuminanceLanes init;
+	std::fill_n(init.max, kLanes, -FLT_MAX);
+	std::fill_n(init.min, kLanes, FLT_MAX);
+	LuminanceLanes total = init;
 
-	const unsigned width  = FreeImage_GetWidth(dib);
-	const unsigned height = FreeImage_GetHeight(dib);
-	const unsigned pitch  = FreeImage_GetPitch(dib);
-
-	auto *bits = (uint8_t*)FreeImage_GetBits(dib);
-	for (unsigned y = 0; y < height; y++) {
-		auto *pixel = (FIRGBF*)bits;
-		for (unsigned x = 0; x < width; x++) {
-			Y = pixel[x].red;	        // Y 
-			result[1] = pixel[x].green;	// x 
-			result[2] = pixel[x].blue;	// y 
-			if ((Y > EPSILON) && (result[1] > EPSILON) && (result[2] > EPSILON)) {
-				X = (result[1] * Y) / result[2];
-				Z = (X / result[1]) - X - Y;
-			} else {
-				X = Z = EPSILON;
-			}
-			pixel[x].red   = X;
-			pixel[x].green = Y;
-			pixel[x].blue  = Z;
-			result[0] = result[1] = result[2] = 0;
-			for (int i = 0; i < 3; i++) {
-				result[i] += XYZ2RGB[i][0] * pixel[x].red;
-				result[i] += XYZ2RGB[i][1] * pixel[x].green;
-				result[i] += XYZ2RGB[i][2] * pixel[x].blue;
+	BitmapReduceParallel<FIRGBF>(dib, init, [&](LuminanceLanes& lanes, const FIRGBF* row, unsigned width) {
+		if (channels) {
+			KernelDispatch<LuminanceStatsRow<true>>::Run(row, width, &lanes);
+		}
+		else {
+			KernelDispatch<LuminanceStatsRow<false>>::Run(row, width, &lanes);
+		}
+	}, [&](const LuminanceLanes& lanes) {
+		for (unsigned l = 0; l < kLanes; ++l) {
+			total.max[l] = std::max(total.max[l], lanes.max[l]);
+			total.min[l] = std::min(total.min[l], lanes.min[l]);
+			total.sum[l] += lanes.sum[l];
+			total.logSum[l] += lanes.logSum[l];
+			for (unsigned c = 0; c < 3; ++c) {
+				total.channelSum[c][l] += lanes.channelSum[c][l];
 			}
-			pixel[x].red   = result[0];	// R
-			pixel[x].green = result[1];	// G
-			pixel[x].blue  = result[2];	// B
 		}
-		// next line
-		bits += pitch;
+	});
+
+	float max_lum = -FLT_MAX, min_lum = FLT_MAX;
+	double sum = 0, logSum = 0, channelSum[3] = { 0, 0, 0 };
+	for (unsigned l = 0; l < kLanes; ++l) {
+		max_lum = std::max(max_lum, total.max[l]);
+		min_lum = std::min(min_lum, total.min[l]);
+		sum += total.sum[l];
+		logSum += total.logSum[l];
+		for (unsigned c = 0; c < 3; ++c) {
+			channelSum[c] += total.channelSum[c][l];
+		}
 	}
 
-	return TRUE;
-}
-
-/**
-Get the maximum, minimum and average luminance.<br>
-On input, pixel->red == Y, pixel->green == x, pixel->blue == y
-@param Yxy Source Yxy image to analyze
-@param maxLum Maximum luminance
-@param minLum Minimum luminance
-@param worldLum Average luminance (world adaptation luminance)
-@return Returns TRUE if successful, returns FALSE otherwise
-*/
-FIBOOL 
-LuminanceFromYxy(FIBITMAP *Yxy, float *maxLum, float *minLum, float *worldLum) {
-	if (FreeImage_GetImageType(Yxy) != FIT_RGBF)
-		return FALSE;
+	const double size = static_cast<double>(FreeImage_GetWidth(dib)) * FreeImage_GetHeight(dib);
 
-	const unsigned width  = FreeImage_GetWidth(Yxy);
-	const unsigned height = FreeImage_GetHeight(Yxy);
-	const unsigned pitch  = FreeImage_GetPitch(Yxy);
-
-	float max_lum = 0, min_lum = 0;
-	double sum = 0;
-
-	auto *bits = (const uint8_t*)FreeImage_GetBits(Yxy);
-	for (unsigned y = 0; y < height; y++) {
-		auto *pixel = (const FIRGBF*)bits;
-		for (unsigned x = 0; x < width; x++) {
-			const float Y = MAX(0.0F, pixel[x].red);// avoid negative values
-			max_lum = (max_lum < Y) ? Y : max_lum;	// max Luminance in the scene
-			min_lum = (min_lum < Y) ? min_lum : Y;	// min Luminance in the scene
-			sum += log(2.3e-5F + Y);				// contrast constant in Tumblin paper
-		}
-		// next line
-		bits += pitch;
-	}
 	// maximum luminance
-	*maxLum = max_lum;
+	stats->maxLum = max_lum;
 	// minimum luminance
-	*minLum = min_lum;
-	// average log luminance
-	double avgLogLum = (sum / (static_cast<double>(width) * height));
-	// world adaptation luminance
-	*worldLum = (float)exp(avgLogLum);
+	stats->minLum = min_lum;
+	// average luminance
+	stats->Lav = (float)(sum / size);
+	// average log luminance, a.k.a. world adaptation luminance
+	stats->Llav = (float)exp(TMO_LN2 * logSum / size);
+	// channel averages
+	for (unsigned c = 0; c < 3; ++c) {
+		stats->Cav[c] = channels ? (float)(channelSum[c] / size) : 0;
+	}
 
 	return TRUE;
 }
@@ -278,28 +183,20 @@ ClampConvertRGBFTo24(FIBITMAP *src) {
 	FIBITMAP *dst = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
 	if (!dst) return nullptr;
 
-	const unsigned src_pitch  = FreeImage_GetPitch(src);
-	const unsigned dst_pitch  = FreeImage_GetPitch(dst);
-
-	auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
-	auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
-
-	for (unsigned y = 0; y < height; y++) {
-		auto *src_pixel = (const FIRGBF*)src_bits;
-		auto *dst_pixel = dst_bits;
-		for (unsigned x = 0; x < width; x++) {
-			const float red   = (src_pixel[x].red > 1)   ? 1 : src_pixel[x].red;
-			const float green = (src_pixel[x].green > 1) ? 1 : src_pixel[x].green;
-			const float blue  = (src_pixel[x].blue > 1)  ? 1 : src_pixel[x].blue;
-			
-			dst_pixel[FI_RGBA_RED]   = (uint8_t)(255.0F * red   + 0.5F);
-			dst_pixel[FI_RGBA_GREEN] = (uint8_t)(255.0F * green + 0.5F);
-			dst_pixel[FI_RGBA_BLUE]  = (uint8_t)(255.0F * blue  + 0.5F);
-			dst_pixel += 3;
-		}
-		src_bits += src_pitch;
-		dst_bits += dst_pitch;
-	}
+	// keep the scanline order of src, the pixels are converted in memory order
+	FreeImage_SetTopDown(dst, FreeImage_IsTopDown(src));
+
+	BitmapTransformParallel<FIRGB8, FIRGBF>(dst, src, [](const FIRGBF& pixel) {
+		const float red   = (pixel.red > 1)   ? 1 : pixel.red;
+		const float green = (pixel.green > 1) ? 1 : pixel.green;
+		const float blue  = (pixel.blue > 1)  ? 1 : pixel.blue;
+
+		FIRGB8 result;
+		result.red   = (uint8_t)(255.0F * red   + 0.5F);
+		result.green = (uint8_t)(255.0F * green + 0.5F);
+		result.blue  = (uint8_t)(255.0F * blue  + 0.5F);
+		return result;
+	});
 
 	return dst;
 }
@@ -324,75 +221,17 @@ ConvertRGBFToY(FIBITMAP *src) {
 	FIBITMAP *dst = FreeImage_AllocateT(FIT_FLOAT, width, height);
 	if (!dst) return nullptr;
 
-	const unsigned src_pitch  = FreeImage_GetPitch(src);
-	const unsigned dst_pitch  = FreeImage_GetPitch(dst);
+	// keep the scanline order of src, the pixels are converted in memory order
+	FreeImage_SetTopDown(dst, FreeImage_IsTopDown(src));
 
-	
-	auto *src_bits = (const uint8_t*)FreeImage_GetBits(src);
-	auto *dst_bits = (uint8_t*)FreeImage_GetBits(dst);
-
-	for (unsigned y = 0; y < height; y++) {
-		auto *src_pixel = (const FIRGBF*)src_bits;
-		auto *dst_pixel = (float*)dst_bits;
-		for (unsigned x = 0; x < width; x++) {
-			const float L = LUMA_REC709(src_pixel[x].red, src_pixel[x].green, src_pixel[x].blue);
-			dst_pixel[x] = (L > 0) ? L : 0;
-		}
-		// next line
-		src_bits += src_pitch;
-		dst_bits += dst_pitch;
-	}
+	BitmapTransformParallel<float, FIRGBF, kTransformGrainPixels, true>(dst, src, [](const FIRGBF& pixel) {
+		const float L = LUMA_REC709(pixel.red, pixel.green, pixel.blue);
+		return (L > 0) ? L : 0;
+	});
 
 	return dst;
 }
 
-/**
-Get the maximum, minimum, average luminance and log average luminance from a Y image
-@param dib Source Y image to analyze
-@param maxLum Maximum luminance
-@param minLum Minimum luminance
-@param Lav Average luminance
-@param Llav Log average luminance (also known as 'world adaptation luminance')
-@return Returns TRUE if successful, returns FALSE otherwise
-@see ConvertRGBFToY, FreeImage_TmoReinhard05Ex
-*/
-FIBOOL 
-LuminanceFromY(FIBITMAP *dib, float *maxLum, float *minLum, float *Lav, float *Llav) {
-	if (FreeImage_GetImageType(dib) != FIT_FLOAT)
-		return FALSE;
-
-	unsigned width  = FreeImage_GetWidth(dib);
-	unsigned height = FreeImage_GetHeight(dib);
-	unsigned pitch  = FreeImage_GetPitch(dib);
-
-	float max_lum = -1e20F, min_lum = 1e20F;
-	double sumLum = 0, sumLogLum = 0;
-
-	auto *bits = (const uint8_t*)FreeImage_GetBits(dib);
-	for (unsigned y = 0; y < height; y++) {
-		auto *pixel = (const float*)bits;
-		for (unsigned x = 0; x < width; x++) {
-			const float Y = pixel[x];
-			max_lum = (max_lum < Y) ? Y : max_lum;				// max Luminance in the scene
-			min_lum = ((Y > 0) && (min_lum < Y)) ? min_lum : Y;	// min Luminance in the scene
-			sumLum += Y;										// average luminance
-			sumLogLum += log(2.3e-5F + Y);						// contrast constant in Tumblin paper
-		}
-		// next line
-		bits += pitch;
-	}
-
-	// maximum luminance
-	*maxLum = max_lum;
-	// minimum luminance
-	*minLum = min_lum;
-	// average luminance
-	*Lav = (float)(sumLum / (static_cast<double>(width) * height));
-	// average log luminance, a.k.a. world adaptation luminance
-	*Llav = (float)exp(sumLogLum / (static_cast<double>(width) * height));
-
-	return TRUE;
-}
 // --------------------------------------------------------------------------
 
 static void findMaxMinPercentile(FIBITMAP *Y, float minPrct, float *minLum, float maxPrct, float *maxLum) {
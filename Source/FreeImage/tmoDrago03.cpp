@@ -22,6 +22,8 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "SimpleTools.h"
+#include <algorithm>
 
 // ----------------------------------------------------------
 // Logarithmic mapping operator
@@ -31,13 +33,22 @@
 // Eurographics 2003.
 // ----------------------------------------------------------
 
-/**
-Bias function
-*/
-static inline double 
-biasFunction(const double b, const double x) {
-	return pow (x, b);		// pow(x, log(bias)/log(0.5)
-}
+namespace {
+
+/// Parameters of the Drago03 row kernel
+struct Drago03Params
+{
+	float scale;		// exposure / world adaptation luminance
+	float invLmax;		// 1 / normalized maximum luminance
+	float biasP;		// log(bias) / log(0.5)
+	float invDivider;	// 1 / log10(Lmax + 1)
+	float fgamma;		// REC709 gamma correction
+	float start;
+	float slope;
+};
+
+/// Number of pixels of a row converted at once by Drago03Row
+constexpr unsigned kDrago03Chunk = 256;
 
 /**
 Pad approximation of log(x + 1)
@@ -45,202 +56,145 @@ x(6+x)/(6+4x) good if x < 1
 x*(6 + 0.7662x)/(5.9897 + 3.7658x) between 1 and 2
 See http://www.nezumi.demon.co.uk/consult/logx.htm
 */
-static inline double 
-pade_log(const double x) {
-	if (x < 1) {
-		return (x * (6 + x) / (6 + 4 * x));
-	} else if (x < 2) {
-		return (x * (6 + 0.7662 * x) / (5.9897 + 3.7658 * x));
-	}
-	return log(x + 1);
+FI_ALWAYS_INLINE float
+PadeLog(float x) {
+	const float low = x * (6 + x) / (6 + 4 * x);
+	const float mid = x * (6 + 0.7662F * x) / (5.9897F + 3.7658F * x);
+	const float high = TMO_LN2 * FastLog2(x + 1);
+	return MaskFloat(x < 1, low) + MaskFloat((x >= 1) & (x < 2), mid) + MaskFloat(x >= 2, high);
+}
+
+/**
+Custom gamma correction based on the ITU-R BT.709 standard
+*/
+FI_ALWAYS_INLINE float
+REC709Gamma(float v, const Drago03Params& p) {
+	const float curve = 1.099F * FastPow(v, p.fgamma) - 0.099F;
+	return MaskFloat(v <= p.start, v * p.slope) + MaskFloat(v > p.start, curve);
 }
 
 /**
-Log mapping operator
-@param dib Input / Output Yxy image
+Log mapping operator, gamma correction and clamping of a row of RGBF pixels into a 24-bit row.
+Drago03 maps the luminance Y of the Yxy color space and keeps the chromaticity x, y:
+converted back to RGB, this scales the color of a pixel by Y' / Y.
+Dispatched by KernelDispatch.
+*/
+template <bool Gamma_>
+struct Drago03Row
+{
+	static FI_ALWAYS_INLINE void Run(uint8_t* dst, const FIRGBF* src, unsigned width, const Drago03Params* params)
+	{
+		const Drago03Params p = *params;
+		float color[3 * kDrago03Chunk];
+
+		for (unsigned first = 0; first < width; first += kDrago03Chunk) {
+			const unsigned count = std::min(kDrago03Chunk, width - first);
+			const FIRGBF* pixel = src + first;
+
+			FI_VECTORIZE_LOOP
+			for (size_t x = 0; x < count; ++x) {
+				const float r = pixel[x].red;
+				const float g = pixel[x].green;
+				const float b = pixel[x].blue;
+				const float Y = LUMA_REC709(r, g, b);
+				const float Yw = MaskFloat(Y > 0, Y) * p.scale;
+				const float interpol = TMO_LN2 * FastLog2(2 + 8 * FastPow(Yw * p.invLmax, p.biasP));
+				const float mapped = PadeLog(Yw) / interpol * p.invDivider;
+				const float ratio = mapped / Y;
+				const float k = MaskFloat((Y > 0) & (mapped > 1e-06F), ratio);
+
+				float c[3] = { r * k, g * k, b * k };
+				for (unsigned i = 0; i < 3; ++i) {
+					if constexpr (Gamma_) {
+						c[i] = REC709Gamma(c[i], p);
+					}
+					c[i] = (c[i] > 1) ? 1 : ((c[i] < 0) ? 0 : c[i]);
+				}
+				color[3 * x + FI_RGBA_RED] = c[0];
+				color[3 * x + FI_RGBA_GREEN] = c[1];
+				color[3 * x + FI_RGBA_BLUE] = c[2];
+			}
+
+			uint8_t* out = dst + 3 * first;
+			FI_VECTORIZE_LOOP
+			for (size_t i = 0; i < 3 * count; ++i) {
+				out[i] = (uint8_t)(int32_t)(255.0F * color[i] + 0.5F);
+			}
+		}
+	}
+};
+
+} // namespace
+
+/**
+Apply the log mapping operator, the gamma correction and convert to 24-bit RGB, in row bands
+@param dib Input RGBF image
 @param maxLum Maximum luminance
 @param avgLum Average luminance (world adaptation luminance)
 @param biasParam Bias parameter (a zero value default to 0.85)
 @param exposure Exposure parameter (default to 0)
-@return Returns TRUE if successful, returns FALSE otherwise
+@param gammaval Gamma value (2.2 is a good default value, 1 means no correction)
+@return Returns a 24-bit RGB image if successful, returns NULL otherwise
 */
-static FIBOOL 
-ToneMappingDrago03(FIBITMAP *dib, const float maxLum, const float avgLum, float biasParam, const float exposure) {
+static FIBITMAP* 
+ToneMappingDrago03(FIBITMAP *dib, const float maxLum, const float avgLum, float biasParam, const float exposure, const float gammaval) {
 	const float LOG05 = -0.693147F;	// log(0.5) 
 
-	double Lmax, divider, interpol, biasP;
-	unsigned x, y;
-	double L;
-
 	if (FreeImage_GetImageType(dib) != FIT_RGBF)
-		return FALSE;
+		return nullptr;
 
 	const unsigned width  = FreeImage_GetWidth(dib);
 	const unsigned height = FreeImage_GetHeight(dib);
-	const unsigned pitch  = FreeImage_GetPitch(dib);
 
+	FIBITMAP *dst = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	if (!dst) return nullptr;
 
 	// arbitrary Bias Parameter 
 	if (biasParam == 0) 
 		biasParam = 0.85F;
 
 	// normalize maximum luminance by average luminance
-	Lmax = maxLum / avgLum;
-	
-	divider = log10(Lmax+1);
-	biasP = log(biasParam)/LOG05;
-
-#if !defined(DRAGO03_FAST)
-
-	/**
-	Normal tone mapping of every pixel
-	further acceleration is obtained by a Pad approximation of log(x + 1)
-	*/
-	auto *bits = (uint8_t*)FreeImage_GetBits(dib);
-	for (y = 0; y < height; y++) {
-		auto *pixel = (FIRGBF*)bits;
-		for (x = 0; x < width; x++) {
-			double Yw = pixel[x].red / avgLum;
-			Yw *= exposure;
-			interpol = log(2 + biasFunction(biasP, Yw / Lmax) * 8);
-			L = pade_log(Yw);// log(Yw + 1)
-			pixel[x].red = (float)((L / interpol) / divider);
-		}
-		// next line
-		bits += pitch;
-	}
-
-#else
-	unsigned index;
-	int i, j;
-
-	unsigned max_width  = width - (width % 3);
-	unsigned max_height = height - (height % 3); 
-	unsigned fpitch = pitch / sizeof(FIRGBF);
-
-	/**
-	fast tone mapping
-	split the image into 3x3 pixel tiles and perform the computation for each group of 9 pixels
-	further acceleration is obtained by a Pad approximation of log(x + 1)
-	=> produce artifacts and not so faster, so the code has been disabled
-	*/
-#define PIXEL(x, y)	image[y*fpitch + x].red
-
-	FIRGBF *image = (FIRGBF*)FreeImage_GetBits(dib);
-	for (y = 0; y < max_height; y += 3) {
-		for (x = 0; x < max_width; x += 3) {
-			double average = 0;
-			for (i = 0; i < 3; i++) {
-				for (j = 0; j < 3; j++) {
-					index = (y + i)*fpitch + (x + j);
-					image[index].red /= (float)avgLum;
-					image[index].red *= exposure; 
-					average += image[index].red;
-				}
-			}
-			average = average / 9 - PIXEL(x, y);
-			if (average > -1 && average < 1) {
-				interpol = log(2 + pow(PIXEL(x + 1, y + 1) / Lmax, biasP) * 8);
-				for (i = 0; i < 3; i++) {
-					for (j = 0; j < 3; j++) {
-						index = (y + i)*fpitch + (x + j);
-						L = pade_log(image[index].red);// log(image[index].red + 1)
-						image[index].red = (float)((L / interpol) / divider);
-					}
-				}
-			}
-			else {
-				for (i = 0; i < 3; i++) {
-					for (j = 0; j < 3; j++) {
-						index = (y + i)*fpitch + (x + j);
-						interpol = log(2 + pow(image[index].red / Lmax, biasP) * 8);
-						L = pade_log(image[index].red);// log(image[index].red + 1)
-						image[index].red = (float)((L / interpol) / divider);
-					}
-				}
-			}
-		} //x
-	} // y
-
-	/**
-	Normal tone mapping of every pixel for the remaining right and bottom bands
-	*/
-	uint8_t *bits;
-
-	// right band
-	bits = (uint8_t*)FreeImage_GetBits(dib);
-	for (y = 0; y < height; y++) {
-		FIRGBF *pixel = (FIRGBF*)bits;
-		for (x = max_width; x < width; x++) {
-			double Yw = pixel[x].red / avgLum;
-			Yw *= exposure;
-			interpol = log(2 + biasFunction(biasP, Yw / Lmax) * 8);
-			L = pade_log(Yw);// log(Yw + 1)
-			pixel[x].red = (float)((L / interpol) / divider);
-		}
-		// next line
-		bits += pitch;
-	}
-	// bottom band
-	bits = (uint8_t*)FreeImage_GetBits(dib);
-	for (y = max_height; y < height; y++) {
-		FIRGBF *pixel = (FIRGBF*)bits;
-		for (x = 0; x < max_width; x++) {
-			double Yw = pixel[x].red / avgLum;
-			Yw *= exposure;
-			interpol = log(2 + biasFunction(biasP, Yw / Lmax) * 8);
-			L = pade_log(Yw);// log(Yw + 1)
-			pixel[x].red = (float)((L / interpol) / divider);
-		}
-		// next line
-		bits += pitch;
-	}
-
-#endif	// DRAGO03_FAST
-
-	return TRUE;
-}
-
-/**
-Custom gamma correction based on the ITU-R BT.709 standard
-@param dib RGBF image to be corrected
-@param gammaval Gamma value (2.2 is a good default value)
-@return Returns TRUE if successful, returns FALSE otherwise
-*/
-static FIBOOL 
-REC709GammaCorrection(FIBITMAP *dib, const float gammaval) {
-	if (FreeImage_GetImageType(dib) != FIT_RGBF)
-		return FALSE;
-
-	float slope = 4.5F;
-	float start = 0.018F;
-	
-	const float fgamma = (float)((0.45 / gammaval) * 2);
+	const double Lmax = maxLum / avgLum;
+
+	Drago03Params params;
+	params.scale = exposure / avgLum;
+	params.invLmax = (float)(1 / Lmax);
+	params.biasP = log(biasParam) / LOG05;
+	params.invDivider = (float)(1 / log10(Lmax + 1));
+
+	// gamma correction based on the ITU-R BT.709 standard
+	params.slope = 4.5F;
+	params.start = 0.018F;
+	params.fgamma = (float)((0.45 / gammaval) * 2);
 	if (gammaval >= 2.1F) {
-		start = (float)(0.018 / ((gammaval - 2) * 7.5));
-		slope = (float)(4.5 * ((gammaval - 2) * 7.5));
+		params.start = (float)(0.018 / ((gammaval - 2) * 7.5));
+		params.slope = (float)(4.5 * ((gammaval - 2) * 7.5));
 	} else if (gammaval <= 1.9F) {
-		start = (float)(0.018 * ((2 - gammaval) * 7.5));
-		slope = (float)(4.5 / ((2 - gammaval) * 7.5));
+		params.start = (float)(0.018 * ((2 - gammaval) * 7.5));
+		params.slope = (float)(4.5 / ((2 - gammaval) * 7.5));
 	}
 
-	const unsigned width  = FreeImage_GetWidth(dib);
-	const unsigned height = FreeImage_GetHeight(dib);
-	const unsigned pitch  = FreeImage_GetPitch(dib);
-
-	auto *bits = (uint8_t*)FreeImage_GetBits(dib);
-	for (unsigned y = 0; y < height; y++) {
-		auto *pixel = (float*)bits;
-		for (unsigned x = 0; x < width; x++) {
-			for (int i = 0; i < 3; i++) {
-				*pixel = (*pixel <= start) ? *pixel * slope : (1.099F * pow(*pixel, fgamma) - 0.099F);
-				pixel++;
+	const ptrdiff_t src_stride = FreeImage_GetScanLineStride(dib);
+	const ptrdiff_t dst_stride = FreeImage_GetScanLineStride(dst);
+	const uint8_t *src_bits = FreeImage_GetScanLine(dib, 0);
+	uint8_t *dst_bits = FreeImage_GetScanLine(dst, 0);
+
+	const size_t grain = std::max<size_t>(1, kTransformGrainPixels / std::max(width, 1U));
+
+	ThreadPool::Instance().parallelFor(0, height, grain, [&](size_t first, size_t last) {
+		for (size_t y = first; y < last; y++) {
+			const auto *src_line = (const FIRGBF*)(src_bits + (ptrdiff_t)y * src_stride);
+			uint8_t *dst_line = dst_bits + (ptrdiff_t)y * dst_stride;
+			if (gammaval != 1) {
+				KernelDispatch<Drago03Row<true>>::Run(dst_line, src_line, width, &params);
+			}
+			else {
+				KernelDispatch<Drago03Row<false>>::Run(dst_line, src_line, width, &params);
 			}
 		}
-		bits += pitch;
-	}
+	});
 
-	return TRUE;
+	return dst;
 }
 
 // ----------------------------------------------------------
@@ -256,8 +210,6 @@ Apply the Adaptive Logarithmic Mapping operator to a HDR image and convert to 24
 */
 FIBITMAP* DLL_CALLCONV 
 FreeImage_TmoDrago03(FIBITMAP *src, double gamma, double exposure) {
-	float maxLum, minLum, avgLum;
-
 	if (!FreeImage_HasPixels(src)) return nullptr;
 
 	// working RGBF variable
@@ -268,20 +220,11 @@ FreeImage_TmoDrago03(FIBITMAP *src, double gamma, double exposure) {
 	const float biasParam = 0.85F;
 	const float expoParam = (float)pow(2.0, exposure); //default exposure is 1, 2^0
 
-	// convert to Yxy
-	ConvertInPlaceRGBFToYxy(dib);
 	// get the luminance
-	LuminanceFromYxy(dib, &maxLum, &minLum, &avgLum);
-	// perform the tone mapping
-	ToneMappingDrago03(dib, maxLum, avgLum, biasParam, expoParam);
-	// convert back to RGBF
-	ConvertInPlaceYxyToRGBF(dib);
-	if (gamma != 1) {
-		// perform gamma correction
-		REC709GammaCorrection(dib, (float)gamma);
-	}
-	// clamp image highest values to display white, then convert to 24-bit RGB
-	FIBITMAP *dst = ClampConvertRGBFTo24(dib);
+	LuminanceStats stats;
+	GetLuminanceStats(dib, &stats, FALSE);
+	// perform the tone mapping and the gamma correction, then convert to 24-bit RGB
+	FIBITMAP *dst = ToneMappingDrago03(dib, stats.maxLum, stats.Llav, biasParam, expoParam, (float)gamma);
 
 	// clean-up and return
 	FreeImage_Unload(dib);
@@ -623,6 +623,12 @@ FreeImage_TmoFattal02(FIBITMAP *dib, double color_saturation, double attenuation
 		src = FreeImage_ConvertToRGBF(dib);
 		if (!src) throw(1);
 
+		// the gradient pyramid mixes src with bottom-up work images
+		if (FreeImage_IsTopDown(src)) {
+			FreeImage_FlipVertical(src);
+			FreeImage_SetTopDown(src, FALSE);
+		}
+
 		// get the luminance channel
 		Yin = ConvertRGBFToY(src);
 		if (!Yin) throw(1);
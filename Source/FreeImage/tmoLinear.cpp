@@ -37,58 +37,58 @@ FIBOOL TmoLinearImpl(FIBITMAP* dst, FIBITMAP* src, double maxValue, double minBr
 
     switch (FreeImage_GetImageType(src)) {
     case FIT_RGBAF:
-        BitmapTransform<FIRGBA8, FIRGBAF>(dst, src, [&](const FIRGBAF& p) {
+        BitmapTransformParallel<FIRGBA8, FIRGBAF>(dst, src, [&](const FIRGBAF& p) {
             const auto rgb = ProcessRgb(p);
             return FIRGBA8{ Clamp(rgb.red), Clamp(rgb.green), Clamp(rgb.blue), ProcessAlpha(p.alpha) };
         });
         break;
     case FIT_RGBF:
-        BitmapTransform<FIRGB8, FIRGBF>(dst, src, [&](const FIRGBF& p) {
+        BitmapTransformParallel<FIRGB8, FIRGBF>(dst, src, [&](const FIRGBF& p) {
             const auto rgb = ProcessRgb(p);
             return FIRGB8{ Clamp(rgb.red), Clamp(rgb.green), Clamp(rgb.blue) };
         });
         break;
     case FIT_RGBA32:
-        BitmapTransform<FIRGBA8, FIRGBA32>(dst, src, [&](const FIRGBA32& p) {
+        BitmapTransformParallel<FIRGBA8, FIRGBA32>(dst, src, [&](const FIRGBA32& p) {
             const auto rgb = ProcessRgb(p);
             return FIRGBA8{ Clamp(rgb.red), Clamp(rgb.green), Clamp(rgb.blue), ProcessAlpha(p.alpha) };
         });
         break;
     case FIT_RGB32:
-        BitmapTransform<FIRGB8, FIRGB32>(dst, src, [&](const FIRGB32& p) {
+        BitmapTransformParallel<FIRGB8, FIRGB32>(dst, src, [&](const FIRGB32& p) {
             const auto rgb = ProcessRgb(p);
             return FIRGB8{ Clamp(rgb.red), Clamp(rgb.green), Clamp(rgb.blue) };
         });
         break;
     case FIT_RGBA16:
-        BitmapTransform<FIRGBA8, FIRGBA16>(dst, src, [&](const FIRGBA16& p) {
+        BitmapTransformParallel<FIRGBA8, FIRGBA16>(dst, src, [&](const FIRGBA16& p) {
             const auto rgb = ProcessRgb(p);
             return FIRGBA8{ Clamp(rgb.red), Clamp(rgb.green), Clamp(rgb.blue), ProcessAlpha(p.alpha) };
         });
         break;
     case FIT_RGB16:
-        BitmapTransform<FIRGB8, FIRGB16>(dst, src, [&](const FIRGB16& p) {
+        BitmapTransformParallel<FIRGB8, FIRGB16>(dst, src, [&](const FIRGB16& p) {
             const auto rgb = ProcessRgb(p);
             return FIRGB8{ Clamp(rgb.red), Clamp(rgb.green), Clamp(rgb.blue) };
         });
         break;
     case FIT_DOUBLE:
-        BitmapTransform<uint8_t, double>(dst, src, [&](const double& p) {
+        BitmapTransformParallel<uint8_t, double>(dst, src, [&](const double& p) {
             return Clamp(ProcessGrey(p));
         });
         break;
     case FIT_FLOAT:
-        BitmapTransform<uint8_t, float>(dst, src, [&](const float& p) {
+        BitmapTransformParallel<uint8_t, float>(dst, src, [&](const float& p) {
             return Clamp(ProcessGrey(p));
         });
         break;
     case FIT_UINT32:
-        BitmapTransform<uint8_t, uint32_t>(dst, src, [&](const uint32_t& p) {
+        BitmapTransformParallel<uint8_t, uint32_t>(dst, src, [&](const uint32_t& p) {
             return Clamp(ProcessGrey(p));
         });
         break;
     case FIT_UINT16:
-        BitmapTransform<uint8_t, uint16_t>(dst, src, [&](const uint16_t& p) {
+        BitmapTransformParallel<uint8_t, uint16_t>(dst, src, [&](const uint16_t& p) {
             return Clamp(ProcessGrey(p));
         });
         break;
@@ -163,6 +163,15 @@ FIBITMAP* FreeImage_TmoLinear(FIBITMAP* src, double max_value, FREE_IMAGE_CVT_CO
     case FICPARAM_YUV_STANDARD_JPEG:
         status = TmoLinearImpl<YuvJPEG>(dst.get(), src, max_value, minBrightness, maxBrightness);
         break;
+    case FICPARAM_YUV_STANDARD_BT601:
+        status = TmoLinearImpl<YuvBT601>(dst.get(), src, max_value, minBrightness, maxBrightness);
+        break;
+    case FICPARAM_YUV_STANDARD_BT709:
+        status = TmoLinearImpl<YuvBT709>(dst.get(), src, max_value, minBrightness, maxBrightness);
+        break;
+    case FICPARAM_YUV_STANDARD_BT2020:
+        status = TmoLinearImpl<YuvBT2020>(dst.get(), src, max_value, minBrightness, maxBrightness);
+        break;
     default:
         break;
     };
@@ -23,7 +23,9 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 #include "ToneMapping.h"
+#include "SimpleTools.h"
 #include <algorithm>
+#include <mutex>
 
 // ----------------------------------------------------------
 // Global and/or local tone mapping operator
@@ -34,34 +36,116 @@
 //     Journal of Graphics Tools, vol. 7, no. 1, pp. 45-51, 2003.
 // ----------------------------------------------------------
 
+namespace {
+
+/// Parameters of the Reinhard05 row kernel
+struct Reinhard05Params
+{
+	float f;		// exp(-intensity)
+	float m;		// contrast
+	float a;		// adaptation
+	float c;		// color correction
+	float Ig[3];	// global light adaptation of every channel
+};
+
+/**
+Tone maps a row of RGBF pixels in place and updates the min and max color of 8 lanes of pixels.
+With Complete_ false, adaptation is 1 and color correction 0: the light adaptation of all the
+channels is the luminance of the pixel, raised to the power m once.
+Dispatched by KernelDispatch.
+*/
+template <bool Complete_>
+struct Reinhard05Row
+{
+	static constexpr unsigned kLanes = 8;
+
+	static FI_ALWAYS_INLINE void Update(FIRGBF& pixel, const Reinhard05Params& p, float& mn, float& mx)
+	{
+		float color[3] = { pixel.red, pixel.green, pixel.blue };
+		float L = LUMA_REC709(color[0], color[1], color[2]);
+		L = MaskFloat(L > 0, L);	// luminance(x, y)
+
+		const float global = FastPow(p.f * L, p.m);
+		for (unsigned i = 0; i < 3; ++i) {
+			if constexpr (Complete_) {
+				const float I_l = p.c * color[i] + (1 - p.c) * L;
+				const float I_a = p.a * I_l + (1 - p.a) * p.Ig[i];
+				color[i] /= (color[i] + FastPow(p.f * I_a, p.m));
+			}
+			else {
+				color[i] /= (color[i] + global);
+			}
+			mx = (color[i] > mx) ? color[i] : mx;
+			mn = (color[i] < mn) ? color[i] : mn;
+		}
+		pixel.red = color[0];
+		pixel.green = color[1];
+		pixel.blue = color[2];
+	}
+
+	static FI_ALWAYS_INLINE void Run(FIRGBF* row, unsigned width, const Reinhard05Params* params, float* laneMin, float* laneMax)
+	{
+		const Reinhard05Params p = *params;
+		float mn[kLanes], mx[kLanes];
+		std::copy_n(laneMin, kLanes, mn);
+		std::copy_n(laneMax, kLanes, mx);
+
+		size_t x = 0;
+		for (; x + kLanes <= width; x += kLanes) {
+			FI_VECTORIZE_LOOP
+			for (unsigned l = 0; l < kLanes; ++l) {
+				Update(row[x + l], p, mn[l], mx[l]);
+			}
+		}
+		for (unsigned l = 0; x < width; ++x, ++l) {
+			Update(row[x], p, mn[l], mx[l]);
+		}
+
+		std::copy_n(mn, kLanes, laneMin);
+		std::copy_n(mx, kLanes, laneMax);
+	}
+};
+
+/// Normalizes a row of RGBF pixels to [0, 1] and converts it to 24-bit RGB, dispatched by KernelDispatch
+struct NormalizeRGBFRow
+{
+	static FI_ALWAYS_INLINE void Run(uint8_t* dst, const FIRGBF* src, unsigned width, float offset, float range)
+	{
+		FI_VECTORIZE_LOOP
+		for (size_t x = 0; x < width; ++x) {
+			float color[3] = { src[x].red, src[x].green, src[x].blue };
+			for (unsigned i = 0; i < 3; ++i) {
+				const float v = (color[i] - offset) / range;
+				color[i] = MaskFloat((v > 0) & (v <= 1), v) + MaskFloat(v > 1, 1.0F);
+			}
+			dst[3 * x + FI_RGBA_RED] = (uint8_t)(int32_t)(255.0F * color[0] + 0.5F);
+			dst[3 * x + FI_RGBA_GREEN] = (uint8_t)(int32_t)(255.0F * color[1] + 0.5F);
+			dst[3 * x + FI_RGBA_BLUE] = (uint8_t)(int32_t)(255.0F * color[2] + 0.5F);
+		}
+	}
+};
+
+} // namespace
+
 /**
-Tone mapping operator
-@param dib Input / Output RGBF image
-@param Y Input luminance image version of dib
+Tone mapping operator, then conversion to 24-bit RGB
+@param dib Input RGBF image, tone mapped in place
 @param f Overall intensity in range [-8:8] : default to 0
 @param m Contrast in range [0.3:1) : default to 0
 @param a Adaptation in range [0:1] : default to 1
 @param c Color correction in range [0:1] : default to 0
-@return Returns TRUE if successful, returns FALSE otherwise
-@see LuminanceFromY
+@return Returns a 24-bit RGB image if successful, returns NULL otherwise
+@see GetLuminanceStats
 */
-static FIBOOL 
-ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *Y, float f, float m, float a, float c) {
-	float Cav[3];		// channel average
-	float Lav = 0;		// average luminance
-	float Llav = 0;		// log average luminance
-	float minLum = 1;	// min luminance
-	float maxLum = 1;	// max luminance
-
-	float L;		// pixel luminance
-	float I_g, I_l; // global and local light adaptation
-	float I_a;		// interpolated pixel light adaptation
-	float k;		// key (low-key means overall dark image, high-key means overall light image)
+static FIBITMAP* 
+ToneMappingReinhard05(FIBITMAP *dib, float f, float m, float a, float c) {
+	LuminanceStats stats{};	// average, log average, min and max luminance, channel averages
+	float k{};		// key (low-key means overall dark image, high-key means overall light image)
 
 	// check input parameters 
 
-	if ((FreeImage_GetImageType(dib) != FIT_RGBF) || (FreeImage_GetImageType(Y) != FIT_FLOAT)) {
-		return FALSE;
+	if (FreeImage_GetImageType(dib) != FIT_RGBF) {
+		return nullptr;
 	}
 
 	f = std::clamp(f, -8.f, 8.f);
@@ -72,132 +156,92 @@ ToneMappingReinhard05(FIBITMAP *dib, FIBITMAP *Y, float f, float m, float a, flo
 	const unsigned width  = FreeImage_GetWidth(dib);
 	const unsigned height = FreeImage_GetHeight(dib);
 
-	const unsigned dib_pitch  = FreeImage_GetPitch(dib);
-	const unsigned y_pitch    = FreeImage_GetPitch(Y);
-
-	int i;
-	unsigned x, y;
-	uint8_t *bits{}, *Ybits{};
+	FIBITMAP *dst = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	if (!dst) return nullptr;
 
 	// get statistics about the data (but only if its really needed)
 
 	f = exp(-f);
-	if ((m == 0) || (a != 1) && (c != 1)) {
+	if ((m == 0) || (a != 1)) {
 		// avoid these calculations if its not needed after ...
-		LuminanceFromY(Y, &maxLum, &minLum, &Lav, &Llav);
-		k = (log(maxLum) - Llav) / (log(maxLum) - log(minLum));
+		// channel averages are not needed when (a == 1) or (c == 0)
+		GetLuminanceStats(dib, &stats, (a != 1) && (c != 0));
+		const float maxLum = stats.maxLum;
+		const float minLum = stats.minLum;
+		k = (log(maxLum) - stats.Llav) / (log(maxLum) - log(minLum));
 		if (k < 0) {
 			// pow(k, 1.4F) is undefined ...
 			// there's an ambiguity about the calculation of Llav between Reinhard papers and the various implementations  ...
 			// try another world adaptation luminance formula using instead 'worldLum = log(Llav)'
-			k = (log(maxLum) - log(Llav)) / (log(maxLum) - log(minLum));
+			k = (log(maxLum) - log(stats.Llav)) / (log(maxLum) - log(minLum));
 			if (k < 0) m = 0.3F;
 		}
 	}
 	m = (m > 0) ? m : (float)(0.3 + 0.7 * pow(k, 1.4F));
 
-	float max_color = -1e6F;
-	float min_color = +1e6F;
-
-	// tone map image
-
-	bits  = (uint8_t*)FreeImage_GetBits(dib);
-	Ybits = (uint8_t*)FreeImage_GetBits(Y);
-
-	if ((a == 1) && (c == 0)) {
-		// when using default values, use a fastest code
-
-		for (y = 0; y < height; y++) {
-			float *Y     = (float*)Ybits;
-			float *color = (float*)bits;
-
-			for (x = 0; x < width; x++) {
-				I_a = Y[x];	// luminance(x, y)
-				for (i = 0; i < 3; i++) {
-					*color /= ( *color + pow(f * I_a, m) );
-					
-					max_color = (*color > max_color) ? *color : max_color;
-					min_color = (*color < min_color) ? *color : min_color;
+	Reinhard05Params params;
+	params.f = f;
+	params.m = m;
+	params.a = a;
+	params.c = c;
+	for (int i = 0; i < 3; i++) {
+		params.Ig[i] = c * stats.Cav[i] + (1 - c) * stats.Lav;
+	}
 
-					color++;
-				}
-			}
-			// next line
-			bits  += dib_pitch;
-			Ybits += y_pitch;
-		}
-	} else {
-		// complete algorithm
-
-		// channel averages
-
-		Cav[0] = Cav[1] = Cav[2] = 0;
-		if ((a != 1) && (c != 0)) {
-			// channel averages are not needed when (a == 1) or (c == 0)
-			bits = (uint8_t*)FreeImage_GetBits(dib);
-			for (y = 0; y < height; y++) {
-				auto *color = (const float*)bits;
-				for (x = 0; x < width; x++) {
-					for (i = 0; i < 3; i++) {
-						Cav[i] += *color;
-						color++;
-					}
-				}
-				// next line
-				bits += dib_pitch;
+	// tone map image, when using default values, use a fastest code
+
+	constexpr unsigned kLanes = Reinhard05Row<true>::kLanes;
+	float max_color[kLanes], min_color[kLanes];
+	std::fill_n(max_color, kLanes, -1e6F);
+	std::fill_n(min_color, kLanes, +1e6F);
+
+	const ptrdiff_t dib_stride = FreeImage_GetScanLineStride(dib);
+	const ptrdiff_t dst_stride = FreeImage_GetScanLineStride(dst);
+	uint8_t *bits = FreeImage_GetScanLine(dib, 0);
+	uint8_t *dst_bits = FreeImage_GetScanLine(dst, 0);
+
+	const size_t grain = std::max<size_t>(1, kTransformGrainPixels / std::max(width, 1U));
+	const bool complete = (a != 1) || (c != 0);
+
+	std::mutex merge_mutex;
+	ThreadPool::Instance().parallelFor(0, height, grain, [&](size_t first, size_t last) {
+		float mx[kLanes], mn[kLanes];
+		std::fill_n(mx, kLanes, -1e6F);
+		std::fill_n(mn, kLanes, +1e6F);
+		for (size_t y = first; y < last; y++) {
+			auto *color = (FIRGBF*)(bits + (ptrdiff_t)y * dib_stride);
+			if (complete) {
+				KernelDispatch<Reinhard05Row<true>>::Run(color, width, &params, mn, mx);
 			}
-			const float image_size = (float)width * height;
-			for (i = 0; i < 3; i++) {
-				Cav[i] /= image_size;
+			else {
+				KernelDispatch<Reinhard05Row<false>>::Run(color, width, &params, mn, mx);
 			}
 		}
-
-		// perform tone mapping
-
-		bits = (uint8_t*)FreeImage_GetBits(dib);
-		for (y = 0; y < height; y++) {
-			const float *Y     = (float*)Ybits;
-			auto *color = (float*)bits;
-
-			for (x = 0; x < width; x++) {
-				L = Y[x];	// luminance(x, y)
-				for (i = 0; i < 3; i++) {
-					I_l = c * *color + (1-c) * L;
-					I_g = c * Cav[i] + (1-c) * Lav;
-					I_a = a * I_l + (1-a) * I_g;
-					*color /= ( *color + pow(f * I_a, m) );
-					
-					max_color = (*color > max_color) ? *color : max_color;
-					min_color = (*color < min_color) ? *color : min_color;
-
-					color++;
-				}
-			}
-			// next line
-			bits  += dib_pitch;
-			Ybits += y_pitch;
+		std::lock_guard<std::mutex> lock(merge_mutex);
+		for (unsigned l = 0; l < kLanes; l++) {
+			max_color[l] = std::max(max_color[l], mx[l]);
+			min_color[l] = std::min(min_color[l], mn[l]);
 		}
+	});
+
+	// normalize intensities, clamp highest values to display white and convert to 24-bit RGB
+
+	float offset = 0, range = 1;
+	const float max_value = *std::max_element(max_color, max_color + kLanes);
+	const float min_value = *std::min_element(min_color, min_color + kLanes);
+	if (max_value != min_value) {
+		offset = min_value;
+		range = max_value - min_value;
 	}
 
-	// normalize intensities
-
-	if (max_color != min_color) {
-		bits = (uint8_t*)FreeImage_GetBits(dib);
-		const float range = max_color - min_color;
-		for (y = 0; y < height; y++) {
-			auto *color = (float*)bits;
-			for(x = 0; x < width; x++) {
-				for (i = 0; i < 3; i++) {
-					*color = (*color - min_color) / range;
-					color++;
-				}
-			}
-			// next line
-			bits += dib_pitch;
+	ThreadPool::Instance().parallelFor(0, height, grain, [&](size_t first, size_t last) {
+		for (size_t y = first; y < last; y++) {
+			const auto *color = (const FIRGBF*)(bits + (ptrdiff_t)y * dib_stride);
+			KernelDispatch<NormalizeRGBFRow>::Run(dst_bits + (ptrdiff_t)y * dst_stride, color, width, offset, range);
 		}
-	}
+	});
 
-	return TRUE;
+	return dst;
 }
 
 // ----------------------------------------------------------
@@ -221,19 +265,8 @@ FreeImage_TmoReinhard05Ex(FIBITMAP *src, double intensity, double contrast, doub
 	auto *dib = FreeImage_ConvertToRGBF(src);
 	if (!dib) return nullptr;
 
-	// get the Luminance channel
-	auto *Y = ConvertRGBFToY(dib);
-	if (!Y) {
-		FreeImage_Unload(dib);
-		return nullptr;
-	}
-
-	// perform the tone mapping
-	ToneMappingReinhard05(dib, Y, (float)intensity, (float)contrast, (float)adaptation, (float)color_correction);
-	// not needed anymore
-	FreeImage_Unload(Y);
-	// clamp image highest values to display white, then convert to 24-bit RGB
-	FIBITMAP *dst = ClampConvertRGBFTo24(dib);
+	// perform the tone mapping, then convert to 24-bit RGB
+	FIBITMAP *dst = ToneMappingReinhard05(dib, (float)intensity, (float)contrast, (float)adaptation, (float)color_correction);
 
 	// clean-up and return
 	FreeImage_Unload(dib);
@@ -0,0 +1,182 @@
+// ==========================================================
+// Vectorized alpha blending kernels
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef FREEIMAGE_ALPHA_BLEND_H
+#define FREEIMAGE_ALPHA_BLEND_H
+
+#include "FreeImage.h"
+#include "../FreeImage/SimpleTools.h"
+
+// ----------------------------------------------------------
+//   Notes
+//
+// Row kernels work on samples: 4-channel pixels have their alpha as 4th sample
+// (FI_RGBA_ALPHA is 3 in both color orders, FIRGBA16 and FIRGBAF end with alpha)
+// and the three color samples are processed alike, whatever their order.
+//
+// The loops are branch free so that they vectorize. Divisions by the maximal
+// sample value are replaced by shifts that give the same result for every input:
+//   (v + 127) / 255     == (t + (t >> 8)) >> 8    with t = v + 128,   v <= 255 * 255
+//   v / 255             == (v + 1 + (v >> 8)) >> 8                    v <= 255 * 255
+//   (v + 32767) / 65535 == (t + (t >> 16)) >> 16  with t = v + 32768, v <= 65535 * 65535
+// ----------------------------------------------------------
+
+/// Rounded v / max for products of two samples
+template <typename Ty_>
+struct AlphaMath {};
+
+template <>
+struct AlphaMath<uint8_t>
+{
+	using Wide = uint32_t;
+	static constexpr Wide kMax = 255;
+
+	static FI_ALWAYS_INLINE Wide Div(Wide v) {
+		const Wide t = v + 128;
+		return (t + (t >> 8)) >> 8;
+	}
+
+	static FI_ALWAYS_INLINE uint8_t FromColor(uint8_t c) {
+		return c;
+	}
+};
+
+template <>
+struct AlphaMath<uint16_t>
+{
+	using Wide = uint32_t;
+	static constexpr Wide kMax = 65535;
+
+	static FI_ALWAYS_INLINE Wide Div(Wide v) {
+		const Wide t = v + 32768;
+		return (t + (t >> 16)) >> 16;
+	}
+
+	static FI_ALWAYS_INLINE uint16_t FromColor(uint8_t c) {
+		return static_cast<uint16_t>(c * 257);
+	}
+};
+
+template <>
+struct AlphaMath<float>
+{
+	static FI_ALWAYS_INLINE float FromColor(uint8_t c) {
+		return c / 255.0F;
+	}
+};
+
+/// Multiplies the color samples of a row of 4-channel pixels with their alpha
+template <typename Ty_>
+struct PreMultiplyRow
+{
+	static FI_ALWAYS_INLINE void Run(Ty_* bits, unsigned width)
+	{
+		FI_VECTORIZE_LOOP
+		for (size_t x = 0; x < width; ++x) {
+			Ty_* pixel = bits + 4 * x;
+			if constexpr (std::is_floating_point_v<Ty_>) {
+				const Ty_ a = pixel[3];
+				pixel[0] *= a;
+				pixel[1] *= a;
+				pixel[2] *= a;
+			}
+			else {
+				using Math = AlphaMath<Ty_>;
+				const typename Math::Wide a = pixel[3];
+				pixel[0] = static_cast<Ty_>(Math::Div(pixel[0] * a));
+				pixel[1] = static_cast<Ty_>(Math::Div(pixel[1] * a));
+				pixel[2] = static_cast<Ty_>(Math::Div(pixel[2] * a));
+			}
+		}
+	}
+};
+
+/**
+Composites a row of 4-channel pixels onto 3-channel background pixels read every BgStep_ samples,
+so that a BgStep_ of 0 composites onto a solid color. Float alpha is clamped to [0, 1].
+*/
+template <typename Ty_, unsigned BgStep_>
+struct CompositeRow
+{
+	static FI_ALWAYS_INLINE void Run(Ty_* dst, const Ty_* fg, const Ty_* bg, unsigned width)
+	{
+		FI_VECTORIZE_LOOP
+		for (size_t x = 0; x < width; ++x) {
+			const Ty_* f = fg + 4 * x;
+			const Ty_* b = bg + BgStep_ * x;
+			Ty_* d = dst + 3 * x;
+			if constexpr (std::is_floating_point_v<Ty_>) {
+				const Ty_ a = std::clamp<Ty_>(f[3], 0, 1);
+				d[0] = b[0] + a * (f[0] - b[0]);
+				d[1] = b[1] + a * (f[1] - b[1]);
+				d[2] = b[2] + a * (f[2] - b[2]);
+			}
+			else {
+				using Math = AlphaMath<Ty_>;
+				const typename Math::Wide a = f[3];
+				const typename Math::Wide na = Math::kMax - a;
+				d[0] = static_cast<Ty_>(Math::Div(a * f[0] + na * b[0]));
+				d[1] = static_cast<Ty_>(Math::Div(a * f[1] + na * b[1]));
+				d[2] = static_cast<Ty_>(Math::Div(a * f[2] + na * b[2]));
+			}
+		}
+	}
+};
+
+/// Blends count bytes of src over dst with a constant alpha in [0, 255], alpha 256 copying src
+struct ConstantAlphaRow
+{
+	static FI_ALWAYS_INLINE void Run(uint8_t* dst, const uint8_t* src, unsigned count, unsigned alpha)
+	{
+		const int32_t a = static_cast<int32_t>(alpha);
+		FI_VECTORIZE_LOOP
+		for (size_t i = 0; i < count; ++i) {
+			const int32_t d = dst[i];
+			dst[i] = static_cast<uint8_t>(((src[i] - d) * a + (d << 8)) >> 8);
+		}
+	}
+};
+
+/// Draws a row of 32-bit pixels over another one with the source alpha, keeping the alpha of dst; color / 255 is truncated
+struct SrcAlphaRow
+{
+	static FI_ALWAYS_INLINE void Run(uint8_t* dst, const uint8_t* src, unsigned width)
+	{
+		FI_VECTORIZE_LOOP
+		for (size_t x = 0; x < width; ++x) {
+			const uint8_t* s = src + 4 * x;
+			uint8_t* d = dst + 4 * x;
+			const uint32_t a = s[3];
+			const uint32_t na = 255 - a;
+			const uint32_t v0 = a * s[0] + na * d[0];
+			const uint32_t v1 = a * s[1] + na * d[1];
+			const uint32_t v2 = a * s[2] + na * d[2];
+			d[0] = static_cast<uint8_t>((v0 + 1 + (v0 >> 8)) >> 8);
+			d[1] = static_cast<uint8_t>((v1 + 1 + (v1 >> 8)) >> 8);
+			d[2] = static_cast<uint8_t>((v2 + 1 + (v2 >> 8)) >> 8);
+		}
+	}
+};
+
+/// Rows handed to one task by the alpha blending loops
+inline size_t AlphaBlendRowGrain(unsigned width)
+{
+	return std::max<size_t>(1, kTransformGrainPixels / std::max(width, 1U));
+}
+
+#endif // FREEIMAGE_ALPHA_BLEND_H
@@ -21,6 +21,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "../FreeImage/SimpleTools.h"
 
 
 /** @brief Retrieves the red, green, blue or alpha channel of a BGR[A] image. 
@@ -486,3 +487,299 @@ FreeImage_SetComplexChannel(FIBITMAP *dst, FIBITMAP *src, FREE_IMAGE_COLOR_CHANN
 
 	return TRUE;
 }
+
+// ----------------------------------------------------------
+//   Split / merge all channels in one pass
+// ----------------------------------------------------------
+
+namespace {
+
+/// Copies the samples of a row of Channels_-sample pixels to one plane per sample
+template <typename Ty_, unsigned Channels_>
+struct DeinterleaveRow {
+	static FI_ALWAYS_INLINE void Run(const Ty_ *src, Ty_ *p0, Ty_ *p1, Ty_ *p2, Ty_ *p3, unsigned width) {
+		FI_VECTORIZE_LOOP
+		for (size_t x = 0; x < width; ++x) {
+			const Ty_ *s = src + Channels_ * x;
+			p0[x] = s[0];
+			p1[x] = s[1];
+			if constexpr (Channels_ > 2) {
+				p2[x] = s[2];
+			}
+			if constexpr (Channels_ > 3) {
+				p3[x] = s[3];
+			}
+		}
+	}
+};
+
+/// Fills a row of Channels_-sample pixels from one plane per sample
+template <typename Ty_, unsigned Channels_>
+struct InterleaveRow {
+	static FI_ALWAYS_INLINE void Run(Ty_ *dst, const Ty_ *p0, const Ty_ *p1, const Ty_ *p2, const Ty_ *p3, unsigned width) {
+		FI_VECTORIZE_LOOP
+		for (size_t x = 0; x < width; ++x) {
+			Ty_ *d = dst + Channels_ * x;
+			d[0] = p0[x];
+			d[1] = p1[x];
+			if constexpr (Channels_ > 2) {
+				d[2] = p2[x];
+			}
+			if constexpr (Channels_ > 3) {
+				d[3] = p3[x];
+			}
+		}
+	}
+};
+
+/// Layout of a multi-channel image type
+struct ChannelLayout {
+	FREE_IMAGE_TYPE plane_type;	// type of the planes
+	unsigned channels;			// number of samples per pixel
+	unsigned sample_size;		// bytes per sample
+	int order[4];				// sample index of red, green, blue and alpha (or real and imaginary part)
+};
+
+FIBOOL
+GetChannelLayout(FREE_IMAGE_TYPE type, unsigned bpp, ChannelLayout &layout) {
+	layout.order[0] = 0;
+	layout.order[1] = 1;
+	layout.order[2] = 2;
+	layout.order[3] = 3;
+	switch (type) {
+		case FIT_BITMAP:
+			if ((bpp != 24) && (bpp != 32)) {
+				return FALSE;
+			}
+			layout = { FIT_BITMAP, bpp / 8, 1, { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA } };
+			return TRUE;
+		case FIT_RGB16:
+			layout.plane_type = FIT_UINT16;
+			layout.channels = 3;
+			layout.sample_size = 2;
+			return TRUE;
+		case FIT_RGBA16:
+			layout.plane_type = FIT_UINT16;
+			layout.channels = 4;
+			layout.sample_size = 2;
+			return TRUE;
+		case FIT_RGB32:
+			layout.plane_type = FIT_UINT32;
+			layout.channels = 3;
+			layout.sample_size = 4;
+			return TRUE;
+		case FIT_RGBA32:
+			layout.plane_type = FIT_UINT32;
+			layout.channels = 4;
+			layout.sample_size = 4;
+			return TRUE;
+		case FIT_RGBF:
+			layout.plane_type = FIT_FLOAT;
+			layout.channels = 3;
+			layout.sample_size = 4;
+			return TRUE;
+		case FIT_RGBAF:
+			layout.plane_type = FIT_FLOAT;
+			layout.channels = 4;
+			layout.sample_size = 4;
+			return TRUE;
+		case FIT_COMPLEXF:
+			layout.plane_type = FIT_FLOAT;
+			layout.channels = 2;
+			layout.sample_size = 4;
+			return TRUE;
+		case FIT_COMPLEX:
+			layout.plane_type = FIT_DOUBLE;
+			layout.channels = 2;
+			layout.sample_size = 8;
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+/// Rows of an image and of its planes, the planes being listed in sample order
+struct PlaneRows {
+	uint8_t *image;
+	ptrdiff_t image_stride;
+	uint8_t *planes[4];
+	ptrdiff_t plane_strides[4];
+};
+
+template <typename Ty_, unsigned Channels_, bool Split_>
+void
+CopyPlanes(const PlaneRows &rows, unsigned width, unsigned height) {
+	const size_t grain_rows = MAX((size_t)1, (size_t)(kTransformGrainPixels / MAX(width, 1U)));
+	ThreadPool::Instance().parallelFor(0, height, grain_rows, [&](size_t first, size_t last) {
+		for (size_t y = first; y < last; ++y) {
+			Ty_ *pixels = (Ty_ *)(rows.image + (ptrdiff_t)y * rows.image_stride);
+			Ty_ *planes[4] = {};
+			for (unsigned c = 0; c < Channels_; ++c) {
+				planes[c] = (Ty_ *)(rows.planes[c] + (ptrdiff_t)y * rows.plane_strides[c]);
+			}
+			if constexpr (Split_) {
+				KernelDispatch<DeinterleaveRow<Ty_, Channels_>>::Run((const Ty_ *)pixels, planes[0], planes[1], planes[2], planes[3], width);
+			} else {
+				KernelDispatch<InterleaveRow<Ty_, Channels_>>::Run(pixels, (const Ty_ *)planes[0], (const Ty_ *)planes[1], (const Ty_ *)planes[2], (const Ty_ *)planes[3], width);
+			}
+		}
+	});
+}
+
+template <typename Ty_, bool Split_>
+void
+CopyPlanes(const PlaneRows &rows, unsigned channels, unsigned width, unsigned height) {
+	switch (channels) {
+		case 2:
+			CopyPlanes<Ty_, 2, Split_>(rows, width, height);
+			break;
+		case 3:
+			CopyPlanes<Ty_, 3, Split_>(rows, width, height);
+			break;
+		case 4:
+			CopyPlanes<Ty_, 4, Split_>(rows, width, height);
+			break;
+	}
+}
+
+template <bool Split_>
+void
+CopyPlanes(const PlaneRows &rows, const ChannelLayout &layout, unsigned width, unsigned height) {
+	switch (layout.sample_size) {
+		case 1:
+			CopyPlanes<uint8_t, Split_>(rows, layout.channels, width, height);
+			break;
+		case 2:
+			CopyPlanes<uint16_t, Split_>(rows, layout.channels, width, height);
+			break;
+		case 4:
+			CopyPlanes<uint32_t, Split_>(rows, layout.channels, width, height);
+			break;
+		case 8:
+			CopyPlanes<uint64_t, Split_>(rows, layout.channels, width, height);
+			break;
+	}
+}
+
+FIBITMAP *
+AllocatePlane(FREE_IMAGE_TYPE plane_type, unsigned width, unsigned height) {
+	if (plane_type != FIT_BITMAP) {
+		return FreeImage_AllocateT(plane_type, width, height);
+	}
+	FIBITMAP *plane = FreeImage_Allocate(width, height, 8);
+	if (plane) {
+		// build a greyscale palette
+		FIRGBA8 *pal = FreeImage_GetPalette(plane);
+		for (int i = 0; i < 256; i++) {
+			pal[i].blue = pal[i].green = pal[i].red = (uint8_t)i;
+		}
+	}
+	return plane;
+}
+
+} // namespace
+
+/** @brief Splits a multi-channel image into one greyscale image per channel, in a single pass.
+
+24- and 32-bit images give 8-bit greyscale planes, FIT_RGB[A]16 images FIT_UINT16 planes,
+FIT_RGB[A]32 images FIT_UINT32 planes and FIT_RGB[A]F images FIT_FLOAT planes. Complex images
+give their real and imaginary parts as FIT_DOUBLE (FIT_COMPLEX) or FIT_FLOAT (FIT_COMPLEXF) planes.
+@param src Input image to be processed.
+@param channels Array of 4 entries receiving the red, green, blue and alpha planes, or the real and imaginary parts.
+Unused entries are set to NULL.
+@return Returns the number of planes written to channels, returns 0 otherwise.
+@see FreeImage_MergeChannels
+*/
+unsigned DLL_CALLCONV
+FreeImage_SplitChannels(FIBITMAP *src, FIBITMAP **channels) {
+	if (!channels) return 0;
+	channels[0] = channels[1] = channels[2] = channels[3] = nullptr;
+
+	if (!FreeImage_HasPixels(src)) return 0;
+
+	ChannelLayout layout;
+	if (!GetChannelLayout(FreeImage_GetImageType(src), FreeImage_GetBPP(src), layout)) {
+		return 0;
+	}
+
+	const unsigned width  = FreeImage_GetWidth(src);
+	const unsigned height = FreeImage_GetHeight(src);
+
+	PlaneRows rows;
+	rows.image = FreeImage_GetScanLine(src, 0);
+	rows.image_stride = FreeImage_GetScanLineStride(src);
+	for (unsigned c = 0; c < layout.channels; ++c) {
+		channels[c] = AllocatePlane(layout.plane_type, width, height);
+		if (!channels[c]) {
+			for (unsigned k = 0; k < c; ++k) {
+				FreeImage_Unload(channels[k]);
+				channels[k] = nullptr;
+			}
+			return 0;
+		}
+		rows.planes[layout.order[c]] = FreeImage_GetScanLine(channels[c], 0);
+		rows.plane_strides[layout.order[c]] = FreeImage_GetScanLineStride(channels[c]);
+	}
+
+	CopyPlanes<true>(rows, layout, width, height);
+
+	// copy metadata from src to the planes
+	for (unsigned c = 0; c < layout.channels; ++c) {
+		FreeImage_CloneMetadata(channels[c], src);
+	}
+
+	return layout.channels;
+}
+
+/** @brief Builds a multi-channel image from greyscale planes, in a single pass.
+
+This is the inverse of FreeImage_SplitChannels: the planes must have the same size and the
+plane type FreeImage_SplitChannels gives for the requested image type.
+@param channels Red, green, blue and alpha planes, or the real and imaginary parts.
+@param count Number of planes: 3 or 4 for FIT_BITMAP (24- or 32-bit result), the number of channels of type otherwise.
+@param type Type of the image to build.
+@return Returns the merged image if successful, returns NULL otherwise.
+@see FreeImage_SplitChannels
+*/
+FIBITMAP * DLL_CALLCONV
+FreeImage_MergeChannels(FIBITMAP **channels, unsigned count, FREE_IMAGE_TYPE type) {
+	if (!channels || (count < 2) || (count > 4)) return nullptr;
+
+	ChannelLayout layout;
+	if (!GetChannelLayout(type, 8 * count, layout) || (layout.channels != count)) {
+		return nullptr;
+	}
+
+	// the planes should have the same size and the plane type
+	for (unsigned c = 0; c < count; ++c) {
+		if (!FreeImage_HasPixels(channels[c]) || (FreeImage_GetImageType(channels[c]) != layout.plane_type)) {
+			return nullptr;
+		}
+		if ((layout.plane_type == FIT_BITMAP) && ((FreeImage_GetBPP(channels[c]) != 8) || (FreeImage_GetColorType(channels[c]) != FIC_MINISBLACK))) {
+			return nullptr;
+		}
+		if ((FreeImage_GetWidth(channels[c]) != FreeImage_GetWidth(channels[0])) || (FreeImage_GetHeight(channels[c]) != FreeImage_GetHeight(channels[0]))) {
+			return nullptr;
+		}
+	}
+
+	const unsigned width  = FreeImage_GetWidth(channels[0]);
+	const unsigned height = FreeImage_GetHeight(channels[0]);
+	FIBITMAP *dst = (type == FIT_BITMAP) ? FreeImage_Allocate(width, height, 8 * count) : FreeImage_AllocateT(type, width, height);
+	if (!dst) return nullptr;
+
+	PlaneRows rows;
+	rows.image = FreeImage_GetScanLine(dst, 0);
+	rows.image_stride = FreeImage_GetScanLineStride(dst);
+	for (unsigned c = 0; c < count; ++c) {
+		rows.planes[layout.order[c]] = FreeImage_GetScanLine(channels[c], 0);
+		rows.plane_strides[layout.order[c]] = FreeImage_GetScanLineStride(channels[c]);
+	}
+
+	CopyPlanes<false>(rows, layout, width, height);
+
+	// copy metadata from the first plane to dst
+	FreeImage_CloneMetadata(dst, channels[0]);
+
+	return dst;
+}
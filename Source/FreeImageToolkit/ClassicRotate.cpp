@@ -35,8 +35,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
-
-#define RBLOCK		64	// image blocks of RBLOCK*RBLOCK pixels
+#include "Transpose.h"
 
 // --------------------------------------------------------------------------
 
@@ -312,124 +311,18 @@ VerticalSkew(FIBITMAP *src, FIBITMAP *dst, int col, int iOffset, double dWeight,
 
 /**
 Rotates an image by 90 degrees (counter clockwise). 
-Precise rotation, no filters required.<br>
-Code adapted from CxImage (http://www.xdp.it/cximage.htm)
+Precise rotation, no filters required.
 @param src Pointer to source image to rotate
 @return Returns a pointer to a newly allocated rotated image if successful, returns NULL otherwise
+@see RotateQuarterTurn
 */
 static FIBITMAP* 
 Rotate90(FIBITMAP *src) {
-
-	const unsigned bpp = FreeImage_GetBPP(src);
-
-	const unsigned src_width  = FreeImage_GetWidth(src);
-	const unsigned src_height = FreeImage_GetHeight(src);	
-	const unsigned dst_width  = src_height;
-	const unsigned dst_height = src_width;
-
-	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
-
-	// allocate and clear dst image
-	FIBITMAP *dst = FreeImage_AllocateT(image_type, dst_width, dst_height, bpp);
+	// allocate dst image
+	FIBITMAP *dst = FreeImage_AllocateT(FreeImage_GetImageType(src), FreeImage_GetHeight(src), FreeImage_GetWidth(src), FreeImage_GetBPP(src));
 	if (!dst) return nullptr;
 
-	// get src and dst scan width
-	const unsigned src_pitch  = FreeImage_GetPitch(src);
-	const unsigned dst_pitch  = FreeImage_GetPitch(dst);
-
-	switch (image_type) {
-		case FIT_BITMAP:
-			if (bpp == 1) {
-				// speedy rotate for BW images
-
-				const uint8_t *bsrc  = FreeImage_GetBits(src);
-				uint8_t *bdest = FreeImage_GetBits(dst);
-
-				const uint8_t *dbitsmax = bdest + dst_height * dst_pitch - 1;
-
-				for (unsigned y = 0; y < src_height; y++) {
-					// figure out the column we are going to be copying to
-					const div_t div_r = div(y, 8);
-					// set bit pos of src column byte
-					const uint8_t bitpos = (uint8_t)(128 >> div_r.rem);
-					const uint8_t *srcdisp = bsrc + y * src_pitch;
-					for (unsigned x = 0; x < src_pitch; x++) {
-						// get source bits
-						const uint8_t *sbits = srcdisp + x;
-						// get destination column
-						uint8_t *nrow = bdest + (dst_height - 1 - (x * 8)) * dst_pitch + div_r.quot;
-						for (int z = 0; z < 8; z++) {
-						   // get destination byte
-							uint8_t *dbits = nrow - z * dst_pitch;
-							if ((dbits < bdest) || (dbits > dbitsmax)) break;
-							if (*sbits & (128 >> z)) *dbits |= bitpos;
-						}
-					}
-				}
-			}
-			else if ((bpp == 8) || (bpp == 24) || (bpp == 32)) {
-				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				const uint8_t *bsrc  = FreeImage_GetBits(src);  // source pixels
-				uint8_t *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
-				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-				
-				// for all image blocks of RBLOCK*RBLOCK pixels
-				
-				// x-segment
-				for (unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for (unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for (unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {    // do rotation
-							const unsigned y2 = dst_height - y - 1;
-							// point to src pixel at (y2, xs)
-							const uint8_t *src_bits = bsrc + (xs * src_pitch) + (y2 * bytespp);
-							// point to dst pixel at (xs, y)
-							uint8_t *dst_bits = bdest + (y * dst_pitch) + (xs * bytespp);
-							for (unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {
-								// dst.SetPixel(x, y, src.GetPixel(y2, x));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								dst_bits += bytespp;
-								src_bits += src_pitch;
-							}
-						}
-					}
-				}
-			}
-			break;
-		case FIT_UINT16:
-		case FIT_RGB16:
-		case FIT_RGBA16:
-		case FIT_FLOAT:
-		case FIT_RGBF:
-		case FIT_RGBAF:
-		{
-			const uint8_t *bsrc  = FreeImage_GetBits(src);  // source pixels
-			uint8_t *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-			// calculate the number of bytes per pixel
-			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			for (unsigned y = 0; y < dst_height; y++) {
-				const uint8_t *src_bits = bsrc + (src_width - 1 - y) * bytespp;
-				uint8_t *dst_bits = bdest + (y * dst_pitch);
-				for (unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits += src_pitch;
-					dst_bits += bytespp;
-				}
-			}
-		}
-		break;
-	}
+	RotateQuarterTurn(dst, src, QUARTER_TURN_CCW);
 
 	return dst;
 }
@@ -442,7 +335,7 @@ Precise rotation, no filters required.
 */
 static FIBITMAP* 
 Rotate180(FIBITMAP *src) {
-	int x, y, k, pos;
+	int x, y;
 
 	const int bpp = FreeImage_GetBPP(src);
 
@@ -460,15 +353,8 @@ Rotate180(FIBITMAP *src) {
 		case FIT_BITMAP:
 			if (bpp == 1) {
 				for (int y = 0; y < src_height; y++) {
-					const uint8_t *src_bits = FreeImage_GetScanLine(src, y);
-					uint8_t *dst_bits = FreeImage_GetScanLine(dst, dst_height - y - 1);
-					for (int x = 0; x < src_width; x++) {
-						// get bit at (x, y)
-						k = (src_bits[x >> 3] & (0x80 >> (x & 0x07))) != 0;
-						// set bit at (dst_width - x - 1, dst_height - y - 1)
-						pos = dst_width - x - 1;
-						k ? dst_bits[pos >> 3] |= (0x80 >> (pos & 0x7)) : dst_bits[pos >> 3] &= (0xFF7F >> (pos & 0x7));
-					}
+					// mirror line y into line (dst_height - y - 1)
+					MirrorBits(FreeImage_GetScanLine(dst, dst_height - y - 1), FreeImage_GetScanLine(src, y), src_width);
 				}
 				break;
 			}
@@ -503,125 +389,18 @@ Rotate180(FIBITMAP *src) {
 
 /**
 Rotates an image by 270 degrees (counter clockwise). 
-Precise rotation, no filters required.<br>
-Code adapted from CxImage (http://www.xdp.it/cximage.htm)
+Precise rotation, no filters required.
 @param src Pointer to source image to rotate
 @return Returns a pointer to a newly allocated rotated image if successful, returns NULL otherwise
+@see RotateQuarterTurn
 */
 static FIBITMAP* 
 Rotate270(FIBITMAP *src) {
-	int x2, dlineup;
-
-	const unsigned bpp = FreeImage_GetBPP(src);
-
-	const unsigned src_width  = FreeImage_GetWidth(src);
-	const unsigned src_height = FreeImage_GetHeight(src);	
-	const unsigned dst_width  = src_height;
-	const unsigned dst_height = src_width;
-
-	FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(src);
-
-	// allocate and clear dst image
-	FIBITMAP *dst = FreeImage_AllocateT(image_type, dst_width, dst_height, bpp);
+	// allocate dst image
+	FIBITMAP *dst = FreeImage_AllocateT(FreeImage_GetImageType(src), FreeImage_GetHeight(src), FreeImage_GetWidth(src), FreeImage_GetBPP(src));
 	if (!dst) return nullptr;
 
-	// get src and dst scan width
-	const unsigned src_pitch  = FreeImage_GetPitch(src);
-	const unsigned dst_pitch  = FreeImage_GetPitch(dst);
-	
-	switch (image_type) {
-		case FIT_BITMAP:
-			if (bpp == 1) {
-				// speedy rotate for BW images
-				
-				const uint8_t *bsrc  = FreeImage_GetBits(src);
-				uint8_t *bdest = FreeImage_GetBits(dst);
-				const uint8_t *dbitsmax = bdest + dst_height * dst_pitch - 1;
-				dlineup = 8 * dst_pitch - dst_width;
-
-				for (unsigned y = 0; y < src_height; y++) {
-					// figure out the column we are going to be copying to
-					const div_t div_r = div(y + dlineup, 8);
-					// set bit pos of src column byte
-					const uint8_t bitpos = (uint8_t)(1 << div_r.rem);
-					const uint8_t *srcdisp = bsrc + y * src_pitch;
-					for (unsigned x = 0; x < src_pitch; x++) {
-						// get source bits
-						const uint8_t *sbits = srcdisp + x;
-						// get destination column
-						uint8_t *nrow = bdest + (x * 8) * dst_pitch + dst_pitch - 1 - div_r.quot;
-						for (unsigned z = 0; z < 8; z++) {
-						   // get destination byte
-							uint8_t *dbits = nrow + z * dst_pitch;
-							if ((dbits < bdest) || (dbits > dbitsmax)) break;
-							if (*sbits & (128 >> z)) *dbits |= bitpos;
-						}
-					}
-				}
-			} 
-			else if ((bpp == 8) || (bpp == 24) || (bpp == 32)) {
-				// anything other than BW :
-				// This optimized version of rotation rotates image by smaller blocks. It is quite
-				// a bit faster than obvious algorithm, because it produces much less CPU cache misses.
-				// This optimization can be tuned by changing block size (RBLOCK). 96 is good value for current
-				// CPUs (tested on Athlon XP and Celeron D). Larger value (if CPU has enough cache) will increase
-				// speed somehow, but once you drop out of CPU's cache, things will slow down drastically.
-				// For older CPUs with less cache, lower value would yield better results.
-
-				const uint8_t *bsrc  = FreeImage_GetBits(src);  // source pixels
-				uint8_t *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-				// Calculate the number of bytes per pixel (1 for 8-bit, 3 for 24-bit or 4 for 32-bit)
-				const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-				// for all image blocks of RBLOCK*RBLOCK pixels
-
-				// x-segment
-				for (unsigned xs = 0; xs < dst_width; xs += RBLOCK) {
-					// y-segment
-					for (unsigned ys = 0; ys < dst_height; ys += RBLOCK) {
-						for (unsigned x = xs; x < MIN(dst_width, xs + RBLOCK); x++) {    // do rotation
-							x2 = dst_width - x - 1;
-							// point to src pixel at (ys, x2)
-							const uint8_t *src_bits = bsrc + (x2 * src_pitch) + (ys * bytespp);
-							// point to dst pixel at (x, ys)
-							uint8_t *dst_bits = bdest + (ys * dst_pitch) + (x * bytespp);
-							for (unsigned y = ys; y < MIN(dst_height, ys + RBLOCK); y++) {
-								// dst.SetPixel(x, y, src.GetPixel(y, x2));
-								AssignPixel(dst_bits, src_bits, bytespp);
-								src_bits += bytespp;
-								dst_bits += dst_pitch;
-							}
-						}
-					}
-				}
-			}
-			break;
-		case FIT_UINT16:
-		case FIT_RGB16:
-		case FIT_RGBA16:
-		case FIT_FLOAT:
-		case FIT_RGBF:
-		case FIT_RGBAF:
-		{
-			const uint8_t *bsrc  = FreeImage_GetBits(src);  // source pixels
-			uint8_t *bdest = FreeImage_GetBits(dst);  // destination pixels
-
-			// calculate the number of bytes per pixel
-			const unsigned bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			for (unsigned y = 0; y < dst_height; y++) {
-				const uint8_t *src_bits = bsrc + (src_height - 1) * src_pitch + y * bytespp;
-				uint8_t *dst_bits = bdest + (y * dst_pitch);
-				for (unsigned x = 0; x < dst_width; x++) {
-					AssignPixel(dst_bits, src_bits, bytespp);
-					src_bits -= src_pitch;
-					dst_bits += bytespp;
-				}
-			}
-		}
-		break;
-	}
+	RotateQuarterTurn(dst, src, QUARTER_TURN_CW);
 
 	return dst;
 }
@@ -23,8 +23,11 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include <atomic>
 #include <complex>
 #include <cstring>
+#include <utility>
+#include <vector>
 #include "../FreeImage/SimpleTools.h"
 
 // ----------------------------------------------------------
@@ -149,9 +152,6 @@ plane (R,G, and B). Otherwise, the LUT is applied to the specified channel only.
 */
 FIBOOL DLL_CALLCONV 
 FreeImage_AdjustCurve(FIBITMAP *src, uint8_t *LUT, FREE_IMAGE_COLOR_CHANNEL channel) {
-	unsigned x, y;
-	uint8_t *bits{};
-
 	if (!FreeImage_HasPixels(src) || !LUT || (FreeImage_GetImageType(src) != FIT_BITMAP))
 		return FALSE;
 
@@ -159,108 +159,23 @@ FreeImage_AdjustCurve(FIBITMAP *src, uint8_t *LUT, FREE_IMAGE_COLOR_CHANNEL chan
 	if ((bpp != 8) && (bpp != 24) && (bpp != 32))
 		return FALSE;
 
-	// apply the LUT
-	switch (bpp) {
-
-		case 8 :
-		{
-			// if the dib has a colormap, apply the LUT to it
-			// else, apply the LUT to pixel values
-
-			if (FreeImage_GetColorType(src) == FIC_PALETTE) {
-				FIRGBA8 *rgb = FreeImage_GetPalette(src);
-				for (unsigned pal = 0; pal < FreeImage_GetColorsUsed(src); pal++) {
-					rgb->red   = LUT[rgb->red];
-					rgb->green = LUT[rgb->green];
-					rgb->blue  = LUT[rgb->blue];
-					rgb++;
-				}
-			}
-			else {
-				for (y = 0; y < FreeImage_GetHeight(src); y++) {
-					bits =  FreeImage_GetScanLine(src, y);
-					for (x = 0; x < FreeImage_GetWidth(src); x++) {
-						bits[x] = LUT[ bits[x] ];
-					}
-				}
-			}
-
-			break;
-		}
-
-		case 24 :
-		case 32 :
-		{
-			const int bytespp = FreeImage_GetLine(src) / FreeImage_GetWidth(src);
-
-			switch (channel) {
-				case FICC_RGB :
-					for (y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for (x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_BLUE]	= LUT[ bits[FI_RGBA_BLUE] ];	// B
-							bits[FI_RGBA_GREEN] = LUT[ bits[FI_RGBA_GREEN] ];	// G
-							bits[FI_RGBA_RED]	= LUT[ bits[FI_RGBA_RED] ];		// R
-							
-							bits += bytespp;
-						}
-					}
-					break;
-
-				case FICC_BLUE :
-					for (y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for (x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_BLUE] = LUT[ bits[FI_RGBA_BLUE] ];		// B
-							
-							bits += bytespp;
-						}
-					}
-					break;
-
-				case FICC_GREEN :
-					for (y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for (x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_GREEN] = LUT[ bits[FI_RGBA_GREEN] ];	// G
-							
-							bits += bytespp;
-						}
-					}
-					break;
-
-				case FICC_RED :
-					for (y = 0; y < FreeImage_GetHeight(src); y++) {
-						bits =  FreeImage_GetScanLine(src, y);
-						for (x = 0; x < FreeImage_GetWidth(src); x++) {
-							bits[FI_RGBA_RED] = LUT[ bits[FI_RGBA_RED] ];		// R
-							
-							bits += bytespp;
-						}
-					}
-					break;
-					
-				case FICC_ALPHA :
-					if (32 == bpp) {
-						for (y = 0; y < FreeImage_GetHeight(src); y++) {
-							bits =  FreeImage_GetScanLine(src, y);
-							for (x = 0; x < FreeImage_GetWidth(src); x++) {
-								bits[FI_RGBA_ALPHA] = LUT[ bits[FI_RGBA_ALPHA] ];	// A
-								
-								bits += bytespp;
-							}
-						}
-					}
-					break;
+	// 8-bit images and palettes take the LUT on every color channel
+	if (bpp == 8) {
+		channel = FICC_RGB;
+	}
 
-				default:
-					break;
-			}
-			break;
-		}
+	// apply the LUT through a point operation pipeline, in row bands on the thread pool
+	FIPOINTOPS *ops = FreeImage_CreatePointOps();
+	if (!ops) {
+		return FALSE;
 	}
+	FIBOOL result = TRUE;
+	if (FreeImage_PointOpsAddCurve(ops, LUT, channel)) {
+		result = FreeImage_ApplyPointOps(src, ops);
+	}
+	FreeImage_DeletePointOps(ops);
 
-	return TRUE;
+	return result;
 }
 
 /** @brief Performs gamma correction on a 8, 24 or 32-bit image.
@@ -474,11 +389,53 @@ namespace
 			++mHist[i * mStride];
 		}
 
+		/// Builder of the same channel into private bins
+		HistogramBuilder Private(uint32_t* hist) const {
+			return HistogramBuilder(hist, 1u);
+		}
+
+		void Merge(const uint32_t* bins, uint32_t binsNumber) const
+		{
+			for (uint32_t i = 0; i < binsNumber; ++i) {
+				mHist[i * mStride] += bins[i];
+			}
+		}
+
 	private:
 		uint32_t* mHist;
 		uint32_t mStride;
 	};
 
+	template <typename PixelType_, typename IndexFunction_, size_t... I_, typename... Builders_>
+	void AddToHistogramsImpl(FIBITMAP* dib, uint32_t binsNumber, const IndexFunction_& indexFunction, std::index_sequence<I_...>, const Builders_&... builders)
+	{
+		if constexpr (sizeof...(Builders_) == 0) {
+			// nothing to count, but instantiated by InvokeWithBuilders
+			return;
+		}
+		else {
+			const std::vector<uint32_t> init(sizeof...(Builders_) * static_cast<size_t>(binsNumber), 0u);
+			BitmapReduceParallel<PixelType_>(dib, init, [&](std::vector<uint32_t>& bins, const PixelType_* row, unsigned width) {
+				const auto local = std::make_tuple(builders.Private(bins.data() + I_ * static_cast<size_t>(binsNumber))...);
+				for (unsigned x = 0; x < width; ++x) {
+					(..., std::get<I_>(local).Add(row[x], indexFunction));
+				}
+			}, [&](const std::vector<uint32_t>& bins) {
+				(..., builders.Merge(bins.data() + I_ * static_cast<size_t>(binsNumber), binsNumber));
+			});
+		}
+	}
+
+	/**
+	Adds all the pixels of dib to the histograms of builders. Bands of rows are counted
+	on the thread pool into private bins, which are added to the histograms when a band is done.
+	*/
+	template <typename PixelType_, typename IndexFunction_, typename... Builders_>
+	void AddToHistograms(FIBITMAP* dib, uint32_t binsNumber, const IndexFunction_& indexFunction, const Builders_&... builders)
+	{
+		AddToHistogramsImpl<PixelType_>(dib, binsNumber, indexFunction, std::index_sequence_for<Builders_...>{}, builders...);
+	}
+
 	template <typename PixelType_>
 	class HistogramFloat
 	{
@@ -519,9 +476,7 @@ namespace
 				return std::min(i, mBinsNumber - 1);
 			};
 
-			BitmapForEach<PixelType_>(mBitmap, [&](const PixelType_& p, uint32_t /*x*/, uint32_t /*y*/) {
-				(..., builders.Add(p, CalculateBinIndex));
-			});
+			AddToHistograms<PixelType_>(mBitmap, mBinsNumber, CalculateBinIndex, builders...);
 			return true;
 		}
 
@@ -567,9 +522,7 @@ namespace
 				return std::min(i, mBinsNumber - 1);
 			};
 
-			BitmapForEach<PixelType_>(mBitmap, [&](const PixelType_& p, uint32_t /*x*/, uint32_t /*y*/) {
-				(..., builders.Add(p, CalculateBinIndexSigned));
-			});
+			AddToHistograms<PixelType_>(mBitmap, mBinsNumber, CalculateBinIndexSigned, builders...);
 			return true;
 		}
 
@@ -612,9 +565,7 @@ namespace
 					return std::min(i, mBinsNumber - 1);
 				};
 
-				BitmapForEach<PixelType_>(mBitmap, [&](const PixelType_& p, uint32_t /*x*/, uint32_t /*y*/) {
-					(..., builders.Add(p, CalculateBinIndexWithoutScale));
-				});
+				AddToHistograms<PixelType_>(mBitmap, mBinsNumber, CalculateBinIndexWithoutScale, builders...);
 			}
 			else {
 				const auto CalculateBinIndexWithScale = [&](const ValueType& value) {
@@ -623,9 +574,7 @@ namespace
 					return std::min(i, mBinsNumber - 1);
 				};
 
-				BitmapForEach<PixelType_>(mBitmap, [&](const PixelType_& p, uint32_t /*x*/, uint32_t /*y*/) {
-					(..., builders.Add(p, CalculateBinIndexWithScale));
-				});
+				AddToHistograms<PixelType_>(mBitmap, mBinsNumber, CalculateBinIndexWithScale, builders...);
 			}
 			return true;
 		}
@@ -1123,6 +1072,139 @@ FreeImage_AdjustColors(FIBITMAP *dib, double brightness, double contrast, double
 	return FALSE;
 }
 
+namespace
+{
+
+	/**
+	Color mapping compiled for lookups: colors are packed into 32-bit keys and the first mapping of a key wins.
+	Up to kLinearKeys keys are compared all at once, so that the probe vectorizes;
+	larger mappings use an open addressing hash table with linear probing.
+	*/
+	class ColorMapping
+	{
+	public:
+		static constexpr unsigned kLinearKeys = 16;
+
+		explicit ColorMapping(const std::vector<std::pair<uint32_t, uint32_t>>& pairs)
+		{
+			unsigned bits = 4;
+			while ((1u << bits) < 2 * pairs.size()) {
+				++bits;
+			}
+			mShift = 32 - bits;
+			mMask = (1u << bits) - 1;
+			mSlots.assign(size_t(1) << bits, 0u);
+			for (const auto& pair : pairs) {
+				uint32_t slot = Hash(pair.first);
+				while (mSlots[slot] && mKeys[mSlots[slot] - 1] != pair.first) {
+					slot = (slot + 1) & mMask;
+				}
+				if (!mSlots[slot]) {
+					mKeys.push_back(pair.first);
+					mValues.push_back(pair.second);
+					mSlots[slot] = static_cast<uint32_t>(mKeys.size());
+				}
+			}
+
+			// small mappings: the padding repeats the first key and its value
+			mLinear = mKeys.size() <= kLinearKeys;
+			if (mLinear) {
+				for (unsigned k = 0; k < kLinearKeys; ++k) {
+					mLinearKeys[k] = k < mKeys.size() ? mKeys[k] : mKeys[0];
+				}
+				mValues.resize(kLinearKeys, mValues[0]);
+			}
+		}
+
+		FI_ALWAYS_INLINE bool Find(uint32_t key, uint32_t& value) const
+		{
+			uint32_t found = 0;
+			if (mLinear) {
+				for (unsigned k = 0; k < kLinearKeys; ++k) {
+					found = std::max(found, mLinearKeys[k] == key ? k + 1 : 0u);
+				}
+			}
+			else {
+				for (uint32_t slot = Hash(key); mSlots[slot]; slot = (slot + 1) & mMask) {
+					if (mKeys[mSlots[slot] - 1] == key) {
+						found = mSlots[slot];
+						break;
+					}
+				}
+			}
+			if (found) {
+				value = mValues[found - 1];
+			}
+			return found != 0;
+		}
+
+	private:
+		FI_ALWAYS_INLINE uint32_t Hash(uint32_t key) const {
+			return (key * 2654435761u) >> mShift;
+		}
+
+		std::vector<uint32_t> mKeys;
+		std::vector<uint32_t> mValues;
+		std::vector<uint32_t> mSlots;		// index + 1 in mKeys, 0 for an empty slot
+		uint32_t mShift = 0;
+		uint32_t mMask = 0;
+		bool mLinear = false;
+		uint32_t mLinearKeys[kLinearKeys]{};
+	};
+
+	/// Mapping pairs in lookup order: srccolors[j] -> dstcolors[j], then dstcolors[j] -> srccolors[j] with swap
+	template <typename PackFunction_>
+	std::vector<std::pair<uint32_t, uint32_t>> MakeMappingPairs(const FIRGBA8 *srccolors, const FIRGBA8 *dstcolors, unsigned count, FIBOOL swap, PackFunction_ pack)
+	{
+		std::vector<std::pair<uint32_t, uint32_t>> pairs;
+		pairs.reserve(swap ? 2 * count : count);
+		for (unsigned j = 0; j < count; j++) {
+			pairs.emplace_back(pack(srccolors[j]), pack(dstcolors[j]));
+			if (swap) {
+				pairs.emplace_back(pack(dstcolors[j]), pack(srccolors[j]));
+			}
+		}
+		return pairs;
+	}
+
+	/// Maps the Bytespp_ byte pixels of dib in row bands on the thread pool, returns the number of mapped pixels
+	template <unsigned Bytespp_, typename KeyFunction_, typename StoreFunction_>
+	unsigned MapPixels(FIBITMAP *dib, const ColorMapping& mapping, KeyFunction_ key_of, StoreFunction_ store)
+	{
+		const unsigned width = FreeImage_GetWidth(dib);
+		const unsigned height = FreeImage_GetHeight(dib);
+		const ptrdiff_t stride = FreeImage_GetScanLineStride(dib);
+		uint8_t *bits = FreeImage_GetScanLine(dib, 0);
+
+		std::atomic<unsigned> result{0};
+		const size_t grain_rows = std::max<size_t>(1, kTransformGrainPixels / std::max(width, 1U));
+		ThreadPool::Instance().parallelFor(0, height, grain_rows, [&](size_t first, size_t last) {
+			unsigned mapped = 0;
+			for (size_t y = first; y < last; ++y) {
+				uint8_t *pixel = bits + (ptrdiff_t)y * stride;
+				for (unsigned x = 0; x < width; ++x, pixel += Bytespp_) {
+					uint32_t value;
+					if (mapping.Find(key_of(pixel), value)) {
+						store(pixel, value);
+						++mapped;
+					}
+				}
+			}
+			result += mapped;
+		});
+		return result;
+	}
+
+	inline uint32_t PackRGB(const FIRGBA8& c) {
+		return c.blue | (c.green << 8) | (c.red << 16);
+	}
+
+	inline uint32_t PackRGBA(const FIRGBA8& c) {
+		return PackRGB(c) | (static_cast<uint32_t>(c.alpha) << 24);
+	}
+
+} // namespace
+
 /** @brief Applies color mapping for one or several colors on a 1-, 4- or 8-bit
  palletized or a 16-, 24- or 32-bit high color image.
 
@@ -1170,134 +1252,66 @@ FreeImage_ApplyColorMapping(FIBITMAP *dib, FIRGBA8 *srccolors, FIRGBA8 *dstcolor
 		return 0;
 	}
 
-	int bpp = FreeImage_GetBPP(dib);
+	// the mapping is compiled once, then every pixel (or palette entry) takes a single lookup
+	const int bpp = FreeImage_GetBPP(dib);
 	switch (bpp) {
 		case 1:
 		case 4:
 		case 8: {
+			const ColorMapping mapping(MakeMappingPairs(srccolors, dstcolors, count, swap, PackRGB));
 			unsigned size = FreeImage_GetColorsUsed(dib);
 			FIRGBA8 *pal = FreeImage_GetPalette(dib);
-			const FIRGBA8 *a, *b;
 			for (unsigned x = 0; x < size; x++) {
-				for (unsigned j = 0; j < count; j++) {
-					a = srccolors;
-					b = dstcolors;
-					for (int i = (swap ? 0 : 1); i < 2; i++) {
-						if ((pal[x].blue == a[j].blue)&&(pal[x].green == a[j].green) &&(pal[x].red== a[j].red)) {
-							pal[x].blue = b[j].blue;
-							pal[x].green = b[j].green;
-							pal[x].red = b[j].red;
-							result++;
-							j = count;
-							break;
-						}
-						a = dstcolors;
-						b = srccolors;
-					}
+				uint32_t value;
+				if (mapping.Find(PackRGB(pal[x]), value)) {
+					pal[x].blue = (uint8_t)value;
+					pal[x].green = (uint8_t)(value >> 8);
+					pal[x].red = (uint8_t)(value >> 16);
+					result++;
 				}
 			}
 			return result;
 		}
 		case 16: {
-			auto *src16 = (uint16_t *)malloc(sizeof(uint16_t) * count);
-			if (!src16) {
-				return 0;
-			}
-
-			auto *dst16 = (uint16_t *)malloc(sizeof(uint16_t) * count);
-			if (!dst16) {
-				free(src16);
-				return 0;
-			}
-
-			for (unsigned j = 0; j < count; j++) {
-				src16[j] = RGBQUAD_TO_WORD(dib, (srccolors + j));
-				dst16[j] = RGBQUAD_TO_WORD(dib, (dstcolors + j));
-			}
-
-			const unsigned height = FreeImage_GetHeight(dib);
-			const unsigned width = FreeImage_GetWidth(dib);
-			const uint16_t *a, *b;
-			for (unsigned y = 0; y < height; y++) {
-				uint16_t *bits = (uint16_t *)FreeImage_GetScanLine(dib, y);
-				for (unsigned x = 0; x < width; x++, bits++) {
-					for (unsigned j = 0; j < count; j++) {
-						a = src16;
-						b = dst16;
-						for (int i = (swap ? 0 : 1); i < 2; i++) {
-							if (*bits == a[j]) {
-								*bits = b[j];
-								result++;
-								j = count;
-								break;
-							}
-							a = dst16;
-							b = src16;
-						}
-					}
-				}
-			}
-			free(src16);
-			free(dst16);
-			return result;
+			const ColorMapping mapping(MakeMappingPairs(srccolors, dstcolors, count, swap, [dib](const FIRGBA8& c) {
+				return (uint32_t)RGBQUAD_TO_WORD(dib, &c);
+			}));
+			return MapPixels<2>(dib, mapping, [](const uint8_t *pixel) {
+				return (uint32_t)*(const uint16_t *)pixel;
+			}, [](uint8_t *pixel, uint32_t value) {
+				*(uint16_t *)pixel = (uint16_t)value;
+			});
 		}
 		case 24: {
-			const unsigned height = FreeImage_GetHeight(dib);
-			const unsigned width = FreeImage_GetWidth(dib);
-			const FIRGBA8 *a, *b;
-			for (unsigned y = 0; y < height; y++) {
-				uint8_t *bits = FreeImage_GetScanLine(dib, y);
-				for (unsigned x = 0; x < width; x++, bits += 3) {
-					for (unsigned j = 0; j < count; j++) {
-						a = srccolors;
-						b = dstcolors;
-						for (int i = (swap ? 0 : 1); i < 2; i++) {
-							if ((bits[FI_RGBA_BLUE] == a[j].blue) && (bits[FI_RGBA_GREEN] == a[j].green) &&(bits[FI_RGBA_RED] == a[j].red)) {
-								bits[FI_RGBA_BLUE] = b[j].blue;
-								bits[FI_RGBA_GREEN] = b[j].green;
-								bits[FI_RGBA_RED] = b[j].red;
-								result++;
-								j = count;
-								break;
-							}
-							a = dstcolors;
-							b = srccolors;
-						}
-					}
-				}
-			}
-			return result;
+			const ColorMapping mapping(MakeMappingPairs(srccolors, dstcolors, count, swap, PackRGB));
+			return MapPixels<3>(dib, mapping, [](const uint8_t *pixel) {
+				return pixel[FI_RGBA_BLUE] | (pixel[FI_RGBA_GREEN] << 8) | ((uint32_t)pixel[FI_RGBA_RED] << 16);
+			}, [](uint8_t *pixel, uint32_t value) {
+				pixel[FI_RGBA_BLUE] = (uint8_t)value;
+				pixel[FI_RGBA_GREEN] = (uint8_t)(value >> 8);
+				pixel[FI_RGBA_RED] = (uint8_t)(value >> 16);
+			});
 		}
 		case 32: {
-			const unsigned height = FreeImage_GetHeight(dib);
-			const unsigned width = FreeImage_GetWidth(dib);
-			const FIRGBA8 *a, *b;
-			for (unsigned y = 0; y < height; y++) {
-				uint8_t *bits = FreeImage_GetScanLine(dib, y);
-				for (unsigned x = 0; x < width; x++, bits += 4) {
-					for (unsigned j = 0; j < count; j++) {
-						a = srccolors;
-						b = dstcolors;
-						for (int i = (swap ? 0 : 1); i < 2; i++) {
-							if ((bits[FI_RGBA_BLUE] == a[j].blue) &&(bits[FI_RGBA_GREEN] == a[j].green) &&(bits[FI_RGBA_RED] == a[j].red)
-								&&((ignore_alpha) || (bits[FI_RGBA_ALPHA] == a[j].alpha))) {
-								bits[FI_RGBA_BLUE] = b[j].blue;
-								bits[FI_RGBA_GREEN] = b[j].green;
-								bits[FI_RGBA_RED] = b[j].red;
-								if (!ignore_alpha) {
-									bits[FI_RGBA_ALPHA] = b[j].alpha;
-								}
-								result++;
-								j = count;
-								break;
-							}
-							a = dstcolors;
-							b = srccolors;
-						}
-					}
-				}
+			if (ignore_alpha) {
+				const ColorMapping mapping(MakeMappingPairs(srccolors, dstcolors, count, swap, PackRGB));
+				return MapPixels<4>(dib, mapping, [](const uint8_t *pixel) {
+					return pixel[FI_RGBA_BLUE] | (pixel[FI_RGBA_GREEN] << 8) | ((uint32_t)pixel[FI_RGBA_RED] << 16);
+				}, [](uint8_t *pixel, uint32_t value) {
+					pixel[FI_RGBA_BLUE] = (uint8_t)value;
+					pixel[FI_RGBA_GREEN] = (uint8_t)(value >> 8);
+					pixel[FI_RGBA_RED] = (uint8_t)(value >> 16);
+				});
 			}
-			return result;
+			const ColorMapping mapping(MakeMappingPairs(srccolors, dstcolors, count, swap, PackRGBA));
+			return MapPixels<4>(dib, mapping, [](const uint8_t *pixel) {
+				return pixel[FI_RGBA_BLUE] | (pixel[FI_RGBA_GREEN] << 8) | ((uint32_t)pixel[FI_RGBA_RED] << 16) | ((uint32_t)pixel[FI_RGBA_ALPHA] << 24);
+			}, [](uint8_t *pixel, uint32_t value) {
+				pixel[FI_RGBA_BLUE] = (uint8_t)value;
+				pixel[FI_RGBA_GREEN] = (uint8_t)(value >> 8);
+				pixel[FI_RGBA_RED] = (uint8_t)(value >> 16);
+				pixel[FI_RGBA_ALPHA] = (uint8_t)(value >> 24);
+			});
 		}
 		default: {
 			return 0;
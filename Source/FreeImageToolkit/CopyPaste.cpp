@@ -25,6 +25,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "ThreadPool.h"
+#include "AlphaBlend.h"
 
 // ----------------------------------------------------------
 //   Helpers
@@ -68,9 +70,8 @@ Combine1(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 		return FALSE;
 	}
 
-	uint8_t *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib));
-	uint8_t *src_bits = FreeImage_GetBits(src_dib);	
-
+	uint8_t *dst_bits = FreeImage_GetScanLine(dst_dib, FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y);
+	uint8_t *src_bits = FreeImage_GetScanLine(src_dib, 0);
 	// combine images
 	for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
 		for (unsigned cols = 0; cols < FreeImage_GetWidth(src_dib); cols++) {
@@ -80,8 +81,8 @@ Combine1(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 			value ? dst_bits[(x + cols) >> 3] |= (0x80 >> ((x + cols) & 0x7)) : dst_bits[(x + cols) >> 3] &= (0xFF7F >> ((x + cols) & 0x7));
 		}
 
-		dst_bits += FreeImage_GetPitch(dst_dib);
-		src_bits += FreeImage_GetPitch(src_dib);
+		dst_bits += FreeImage_GetScanLineStride(dst_dib);
+		src_bits += FreeImage_GetScanLineStride(src_dib);
 	}
 
 	return TRUE;
@@ -136,9 +137,8 @@ Combine4(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 		}
 	}
 
-	uint8_t *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) *	FreeImage_GetPitch(dst_dib)) + (x >> 1);
-	const uint8_t *src_bits = FreeImage_GetBits(src_dib);    
-
+	uint8_t *dst_bits = FreeImage_GetScanLine(dst_dib, FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) + (x >> 1);
+	const uint8_t *src_bits = FreeImage_GetScanLine(src_dib, 0);
 	// combine images
 
 	// allocate space for our temporary row
@@ -179,8 +179,8 @@ Combine4(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 
 		memcpy(dst_bits, buffer, src_line);
 		
-		dst_bits += FreeImage_GetPitch(dst_dib);
-		src_bits += FreeImage_GetPitch(src_dib);
+		dst_bits += FreeImage_GetScanLineStride(dst_dib);
+		src_bits += FreeImage_GetScanLineStride(src_dib);
 	}
 
 	free(buffer);
@@ -205,16 +205,15 @@ Combine8(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 		return FALSE;
 	}
 
-	uint8_t *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x);
-	uint8_t *src_bits = FreeImage_GetBits(src_dib);	
-
+	uint8_t *dst_bits = FreeImage_GetScanLine(dst_dib, FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) + (x);
+	uint8_t *src_bits = FreeImage_GetScanLine(src_dib, 0);
 	if (alpha > 255) {
 		// combine images
 		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
 			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
 
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
+			dst_bits += FreeImage_GetScanLineStride(dst_dib);
+			src_bits += FreeImage_GetScanLineStride(src_dib);
 		}
 	} else {
 		// alpha blend images
@@ -223,8 +222,8 @@ Combine8(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 				dst_bits[cols] = (uint8_t)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
 			}
 
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
+			dst_bits += FreeImage_GetScanLineStride(dst_dib);
+			src_bits += FreeImage_GetScanLineStride(src_dib);
 		}
 	}
 
@@ -247,15 +246,14 @@ Combine16_555(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsi
 		return FALSE;
 	}
 
-	uint8_t *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x * 2);
-	uint8_t *src_bits = FreeImage_GetBits(src_dib);	
-
+	uint8_t *dst_bits = FreeImage_GetScanLine(dst_dib, FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) + (x * 2);
+	uint8_t *src_bits = FreeImage_GetScanLine(src_dib, 0);
 	if (alpha > 255) {
 		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
 			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
 
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
+			dst_bits += FreeImage_GetScanLineStride(dst_dib);
+			src_bits += FreeImage_GetScanLineStride(src_dib);
 		}
 	} else {
 		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
@@ -287,8 +285,8 @@ Combine16_555(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsi
 				*tmp1 = RGB555(color_s.red, color_s.green, color_s.blue);
 			}
 
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
+			dst_bits += FreeImage_GetScanLineStride(dst_dib);
+			src_bits += FreeImage_GetScanLineStride(src_dib);
 		}
 	}
 
@@ -307,15 +305,14 @@ Combine16_565(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsi
 		return FALSE;
 	}
 
-	uint8_t *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x * 2);
-	uint8_t *src_bits = FreeImage_GetBits(src_dib);	
-
+	uint8_t *dst_bits = FreeImage_GetScanLine(dst_dib, FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) + (x * 2);
+	uint8_t *src_bits = FreeImage_GetScanLine(src_dib, 0);
 	if (alpha > 255) {
 		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
 			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
 
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
+			dst_bits += FreeImage_GetScanLineStride(dst_dib);
+			src_bits += FreeImage_GetScanLineStride(src_dib);
 		}
 	} else {
 		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
@@ -347,14 +344,37 @@ Combine16_565(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsi
 				*tmp1 = RGB565(color_s.red, color_s.green, color_s.blue);
 			}
 
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
+			dst_bits += FreeImage_GetScanLineStride(dst_dib);
+			src_bits += FreeImage_GetScanLineStride(src_dib);
 		}
 	}
 	
 	return TRUE;
 }
 
+/**
+Blends the lines of src over dst_bits with a constant alpha, or copies them when alpha > 255.
+Bands of rows run on the library thread pool.
+*/
+static void
+CombineLines(uint8_t *dst_bits, int dst_stride, FIBITMAP *src_dib, unsigned alpha) {
+	const uint8_t *src_bits = FreeImage_GetScanLine(src_dib, 0);
+	const int src_stride = FreeImage_GetScanLineStride(src_dib);
+	const unsigned line = FreeImage_GetLine(src_dib);
+
+	ThreadPool::Instance().parallelFor(0, FreeImage_GetHeight(src_dib), AlphaBlendRowGrain(line), [&](size_t first, size_t last) {
+		for (size_t rows = first; rows < last; rows++) {
+			uint8_t *dst_line = dst_bits + (ptrdiff_t)rows * dst_stride;
+			const uint8_t *src_line = src_bits + (ptrdiff_t)rows * src_stride;
+			if (alpha > 255) {
+				memcpy(dst_line, src_line, line);
+			} else {
+				KernelDispatch<ConstantAlphaRow>::Run(dst_line, src_line, line, alpha);
+			}
+		}
+	});
+}
+
 // ----------------------------------------------------------
 //   24-bit
 // ----------------------------------------------------------
@@ -371,28 +391,10 @@ Combine24(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 		return FALSE;
 	}
 
-	uint8_t *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x * 3);
-	uint8_t *src_bits = FreeImage_GetBits(src_dib);	
-
-	if (alpha > 255) {
-		// combine images
-		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	} else {
-		// alpha blend images
-		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {							
-				dst_bits[cols] = (uint8_t)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
+	uint8_t *dst_bits = FreeImage_GetScanLine(dst_dib, FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) + (x * 3);
 
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	}
+	// combine or alpha blend images
+	CombineLines(dst_bits, FreeImage_GetScanLineStride(dst_dib), src_dib, alpha);
 
 	return TRUE;
 }
@@ -413,28 +415,10 @@ Combine32(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y, unsigned
 		return FALSE;
 	}
 
-	uint8_t *dst_bits = FreeImage_GetBits(dst_dib) + ((FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) * FreeImage_GetPitch(dst_dib)) + (x * 4);
-	uint8_t *src_bits = FreeImage_GetBits(src_dib);	
+	uint8_t *dst_bits = FreeImage_GetScanLine(dst_dib, FreeImage_GetHeight(dst_dib) - FreeImage_GetHeight(src_dib) - y) + (x * 4);
 
-	if (alpha > 255) {
-		// combine images
-		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			memcpy(dst_bits, src_bits, FreeImage_GetLine(src_dib));
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	} else {
-		// alpha blend images
-		for (unsigned rows = 0; rows < FreeImage_GetHeight(src_dib); rows++) {
-			for (unsigned cols = 0; cols < FreeImage_GetLine(src_dib); cols++) {
-				dst_bits[cols] = (uint8_t)(((src_bits[cols] - dst_bits[cols]) * alpha + (dst_bits[cols] << 8)) >> 8);
-			}
-
-			dst_bits += FreeImage_GetPitch(dst_dib);
-			src_bits += FreeImage_GetPitch(src_dib);
-		}
-	}
+	// combine or alpha blend images
+	CombineLines(dst_bits, FreeImage_GetScanLineStride(dst_dib), src_dib, alpha);
 
 	return TRUE;
 }
@@ -452,26 +436,25 @@ CombineSameType(FIBITMAP *dst_dib, FIBITMAP *src_dib, unsigned x, unsigned y) {
 
 	const unsigned src_width  = FreeImage_GetWidth(src_dib);
 	const unsigned src_height = FreeImage_GetHeight(src_dib);
-	const unsigned src_pitch  = FreeImage_GetPitch(src_dib);
+	const int src_stride      = FreeImage_GetScanLineStride(src_dib);
 	const unsigned src_line   = FreeImage_GetLine(src_dib);
 	const unsigned dst_width  = FreeImage_GetWidth(dst_dib);
 	const unsigned dst_height = FreeImage_GetHeight(dst_dib);
-	const unsigned dst_pitch  = FreeImage_GetPitch(dst_dib);
+	const int dst_stride      = FreeImage_GetScanLineStride(dst_dib);
 	
 	// check the size of src image
 	if ((x + src_width > dst_width) || (y + src_height > dst_height)) {
 		return FALSE;
 	}	
 
-	uint8_t *dst_bits = FreeImage_GetBits(dst_dib) + ((dst_height - src_height - y) * dst_pitch) + (x * (src_line / src_width));
-	const uint8_t *src_bits = FreeImage_GetBits(src_dib);	
-
+	uint8_t *dst_bits = FreeImage_GetScanLine(dst_dib, dst_height - src_height - y) + (x * (src_line / src_width));
+	const uint8_t *src_bits = FreeImage_GetScanLine(src_dib, 0);
 	// combine images	
 	for (unsigned rows = 0; rows < src_height; rows++) {
 		memcpy(dst_bits, src_bits, src_line);
 
-		dst_bits += dst_pitch;
-		src_bits += src_pitch;
+		dst_bits += dst_stride;
+		src_bits += src_stride;
 	}
 
 	return TRUE;
@@ -527,7 +510,7 @@ FreeImage_Copy(FIBITMAP *src, int left, int top, int right, int bottom) {
 	// get the dimensions
 	const int dst_line = FreeImage_GetLine(dst);
 	const int dst_pitch = FreeImage_GetPitch(dst);
-	const int src_pitch = FreeImage_GetPitch(src);
+	const int src_stride = FreeImage_GetScanLineStride(src);
 
 	// get the pointers to the bits and such
 
@@ -561,10 +544,10 @@ FreeImage_Copy(FIBITMAP *src, int left, int top, int right, int bottom) {
 	// copy the bits
 	if (bpp == 1) {
 		FIBOOL value;
-		unsigned y_src, y_dst;
+		int y_src, y_dst;
 
 		for (int y = 0; y < dst_height; y++) {
-			y_src = y * src_pitch;
+			y_src = y * src_stride;
 			y_dst = y * dst_pitch;
 			for (int x = 0; x < dst_width; x++) {
 				// get bit at (y, x) in src image
@@ -577,10 +560,10 @@ FreeImage_Copy(FIBITMAP *src, int left, int top, int right, int bottom) {
 
 	else if (bpp == 4) {
 		uint8_t shift, value;
-		unsigned y_src, y_dst;
+		int y_src, y_dst;
 
 		for (int y = 0; y < dst_height; y++) {
-			y_src = y * src_pitch;
+			y_src = y * src_stride;
 			y_dst = y * dst_pitch;
 			for (int x = 0; x < dst_width; x++) {
 				// get nibble at (y, x) in src image
@@ -596,7 +579,7 @@ FreeImage_Copy(FIBITMAP *src, int left, int top, int right, int bottom) {
 
 	else if (bpp >= 8) {
 		for (int y = 0; y < dst_height; y++) {
-			memcpy(dst_bits + (y * dst_pitch), src_bits + (y * src_pitch), dst_line);
+			memcpy(dst_bits + (y * dst_pitch), src_bits + (y * src_stride), dst_line);
 		}
 	}
 
@@ -772,7 +755,8 @@ FreeImage_Paste(FIBITMAP *dst, FIBITMAP *src, int left, int top, int alpha) {
 
  Since the memory block shared by the backing image and the view must start
  at a byte boundary, the value of parameter left must be a multiple of 8
- for 1-bit images and a multiple of 2 for 4-bit images.
+ for 1-bit images, a multiple of 4 for 2-bit images and a multiple of 2
+ for 4-bit images.
 
  @param dib The FreeImage bitmap on which to create the view.
  @param left The left position of the view's area.
@@ -803,8 +787,10 @@ FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right,
 		return nullptr;
 	}
 
+	// lowest address of the view: its bottom line, or its top line when the scanlines are stored top-down
 	const unsigned bpp = FreeImage_GetBPP(dib);
-	uint8_t *bits = FreeImage_GetScanLine(dib, height - bottom);
+	const FIBOOL top_down = FreeImage_IsTopDown(dib);
+	uint8_t *bits = FreeImage_GetScanLine(dib, top_down ? height - 1 - top : height - bottom);
 	switch (bpp) {
 		case 1:
 			if (left % 8 != 0) {
@@ -813,6 +799,13 @@ FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right,
 			}
 			bits += (left / 8);
 			break;
+		case 2:
+			if (left % 4 != 0) {
+				// view can only start at a byte boundary
+				return nullptr;
+			}
+			bits += (left / 4);
+			break;
 		case 4:
 			if (left % 2 != 0) {
 				// view can only start at a byte boundary
@@ -833,6 +826,13 @@ FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right,
 	if (!dst) {
 		return nullptr;
 	}
+	FreeImage_SetTopDown(dst, top_down);
+
+	// keep the pixels of dib alive as long as the view
+	if (!FreeImage_SharePixelsWithView(dst, dib)) {
+		FreeImage_Unload(dst);
+		return nullptr;
+	}
 
 	// copy some basic image properties needed for displaying and saving
 
@@ -859,3 +859,60 @@ FreeImage_CreateView(FIBITMAP *dib, unsigned left, unsigned top, unsigned right,
 
 	return dst;
 }
+
+/// Minimal amount of pixels of the tiles chosen by FreeImage_ForEachTile
+static const unsigned TILE_GRAIN_PIXELS = 64 * 1024;
+
+/**
+Calls proc for the tiles of dib on the library thread pool, see FreeImage.h.
+Every tile is a view created by the worker thread that processes it.
+*/
+FIBOOL DLL_CALLCONV
+FreeImage_ForEachTile(FIBITMAP *dib, unsigned tile_width, unsigned tile_height, FI_TileProc proc, void *user) {
+	if (!FreeImage_HasPixels(dib) || !proc) {
+		return FALSE;
+	}
+
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const unsigned bpp = FreeImage_GetBPP(dib);
+
+	if ((tile_width == 0) || (tile_width > width)) {
+		tile_width = width;
+	}
+	if (bpp < 8) {
+		// views start at a byte boundary
+		const unsigned align = 8 / bpp;
+		tile_width = MIN(width, (tile_width + align - 1) / align * align);
+	}
+
+	ThreadPool &pool = ThreadPool::Instance();
+	if (tile_height == 0) {
+		// about four tiles per thread in every column, large enough to pay for their view
+		const unsigned bands = 4 * (pool.getThreadCount() + 1);
+		tile_height = MAX((height + bands - 1) / bands, (TILE_GRAIN_PIXELS + tile_width - 1) / tile_width);
+	}
+	tile_height = MIN(tile_height, height);
+
+	const unsigned columns = (width + tile_width - 1) / tile_width;
+	const unsigned rows = (height + tile_height - 1) / tile_height;
+
+	std::atomic<bool> failed{};
+	pool.parallelFor(0, (size_t)columns * rows, 1, [&](size_t first, size_t last) {
+		for (size_t i = first; (i < last) && !failed; i++) {
+			FITILE tile;
+			tile.index = (unsigned)i;
+			tile.left = (unsigned)(i % columns) * tile_width;
+			tile.top = (unsigned)(i / columns) * tile_height;
+			tile.width = MIN(tile_width, width - tile.left);
+			tile.height = MIN(tile_height, height - tile.top);
+			tile.view = FreeImage_CreateView(dib, tile.left, tile.top, tile.left + tile.width, tile.top + tile.height);
+			if (!tile.view || !proc(&tile, user)) {
+				failed = true;
+			}
+			FreeImage_Unload(tile.view);
+		}
+	});
+
+	return !failed;
+}
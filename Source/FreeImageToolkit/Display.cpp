@@ -21,7 +21,119 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "AlphaBlend.h"
+#include <vector>
 
+// ----------------------------------------------------------
+
+namespace {
+
+/**
+Composites the rows of fg onto bk_color, onto the rows of bg or onto a checkerboard when both are NULL.
+Rows are processed in bands on the library thread pool. Palettized 8-bit rows are expanded to 32-bit first.
+*/
+template <typename Ty_>
+void CompositeRows(FIBITMAP *composite, FIBITMAP *fg, const Ty_ *bk_color, FIBITMAP *bg) {
+	const unsigned width = FreeImage_GetWidth(fg);
+	const unsigned height = FreeImage_GetHeight(fg);
+	const FIBOOL palettized = (FreeImage_GetBPP(fg) == 8);
+
+	// row addresses are taken once on the calling thread
+	uint8_t *cp_bits = FreeImage_GetScanLine(composite, 0);
+	const ptrdiff_t cp_stride = FreeImage_GetScanLineStride(composite);
+	const uint8_t *fg_bits = FreeImage_GetScanLine(fg, 0);
+	const ptrdiff_t fg_stride = FreeImage_GetScanLineStride(fg);
+	const uint8_t *bg_bits = bg ? FreeImage_GetScanLine(bg, 0) : nullptr;
+	const ptrdiff_t bg_stride = bg ? FreeImage_GetScanLineStride(bg) : 0;
+
+	const FIRGBA8 *pal = FreeImage_GetPalette(fg);
+	const FIBOOL transparent = FreeImage_IsTransparent(fg);
+	const uint8_t *trns = FreeImage_GetTransparencyTable(fg);
+
+	ThreadPool::Instance().parallelFor(0, height, AlphaBlendRowGrain(width), [&](size_t first, size_t last) {
+		std::vector<Ty_> fg_row(palettized ? 4 * width : 0);
+
+		// checkerboard of 8x8 squares, rows of the first and of the second row of squares
+		std::vector<Ty_> checker[2];
+		if (!bk_color && !bg) {
+			const Ty_ light = AlphaMath<Ty_>::FromColor(255);
+			const Ty_ dark = AlphaMath<Ty_>::FromColor(192);
+			for (int row = 0; row < 2; row++) {
+				checker[row].resize(3 * width);
+				for (unsigned x = 0; x < width; x++) {
+					const Ty_ c = ((row == 0) == ((x & 0x8) == 0)) ? light : dark;
+					checker[row][3 * x] = checker[row][3 * x + 1] = checker[row][3 * x + 2] = c;
+				}
+			}
+		}
+
+		for (size_t y = first; y < last; ++y) {
+			const Ty_ *fg_line = reinterpret_cast<const Ty_ *>(fg_bits + (ptrdiff_t)y * fg_stride);
+			Ty_ *cp_line = reinterpret_cast<Ty_ *>(cp_bits + (ptrdiff_t)y * cp_stride);
+
+			if constexpr (std::is_same_v<Ty_, uint8_t>) {
+				if (palettized) {
+					for (unsigned x = 0; x < width; x++) {
+						const uint8_t index = fg_line[x];
+						fg_row[4 * x + FI_RGBA_BLUE] = pal[index].blue;
+						fg_row[4 * x + FI_RGBA_GREEN] = pal[index].green;
+						fg_row[4 * x + FI_RGBA_RED] = pal[index].red;
+						fg_row[4 * x + FI_RGBA_ALPHA] = transparent ? trns[index] : 0xFF;
+					}
+					fg_line = fg_row.data();
+				}
+			}
+
+			if (bk_color) {
+				KernelDispatch<CompositeRow<Ty_, 0>>::Run(cp_line, fg_line, bk_color, width);
+			}
+			else {
+				const Ty_ *bg_line = bg ? reinterpret_cast<const Ty_ *>(bg_bits + (ptrdiff_t)y * bg_stride) : checker[(y >> 3) & 1].data();
+				KernelDispatch<CompositeRow<Ty_, 3>>::Run(cp_line, fg_line, bg_line, width);
+			}
+		}
+	});
+}
+
+/// Samples of a background color in the order of the composite's pixels
+template <typename Ty_>
+void GetBackgroundSamples(const FIRGBA8& color, Ty_ *samples) {
+	if constexpr (std::is_same_v<Ty_, uint8_t>) {
+		samples[FI_RGBA_RED] = color.red;
+		samples[FI_RGBA_GREEN] = color.green;
+		samples[FI_RGBA_BLUE] = color.blue;
+	}
+	else {
+		samples[0] = AlphaMath<Ty_>::FromColor(color.red);
+		samples[1] = AlphaMath<Ty_>::FromColor(color.green);
+		samples[2] = AlphaMath<Ty_>::FromColor(color.blue);
+	}
+}
+
+template <typename Ty_>
+void CompositeAs(FIBITMAP *composite, FIBITMAP *fg, const FIRGBA8 *bk_color, FIBITMAP *bg) {
+	Ty_ samples[3];
+	if (bk_color) {
+		GetBackgroundSamples(*bk_color, samples);
+	}
+	CompositeRows<Ty_>(composite, fg, bk_color ? samples : nullptr, bg);
+}
+
+/// Multiplies the color samples of every pixel of dib with its alpha, in bands of rows on the library thread pool
+template <typename Ty_>
+void PreMultiplyRows(FIBITMAP *dib) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	uint8_t *bits = FreeImage_GetScanLine(dib, 0);
+	const ptrdiff_t stride = FreeImage_GetScanLineStride(dib);
+
+	ThreadPool::Instance().parallelFor(0, FreeImage_GetHeight(dib), AlphaBlendRowGrain(width), [&](size_t first, size_t last) {
+		for (size_t y = first; y < last; ++y) {
+			KernelDispatch<PreMultiplyRow<Ty_>>::Run(reinterpret_cast<Ty_ *>(bits + (ptrdiff_t)y * stride), width);
+		}
+	});
+}
+
+} // namespace
 
 /**
 @brief Composite a foreground image against a background color or a background image.
@@ -29,7 +141,9 @@
 The equation for computing a composited sample value is:<br>
 output = alpha * foreground + (1-alpha) * background<br>
 where alpha and the input and output sample values are expressed as fractions in the range 0 to 1. 
-For colour images, the computation is done separately for R, G, and B samples.
+For colour images, the computation is done separately for R, G, and B samples.<br>
+8- and 32-bit FIT_BITMAP images are composited to 24-bit, FIT_RGBA16 images to FIT_RGB16 and FIT_RGBAF images to FIT_RGBF.
+A background image must have the size and type of the composite image.
 
 @param fg Foreground image
 @param useFileBkg If TRUE and a file background is present, use it as the background color
@@ -42,140 +156,72 @@ FIBITMAP * DLL_CALLCONV
 FreeImage_Composite(FIBITMAP *fg, FIBOOL useFileBkg, FIRGBA8 *appBkColor, FIBITMAP *bg) {
 	if (!FreeImage_HasPixels(fg)) return nullptr;
 
-	const int width  = FreeImage_GetWidth(fg);
-	const int height = FreeImage_GetHeight(fg);
-	const int bpp    = FreeImage_GetBPP(fg);
-
-	if ((bpp != 8) && (bpp != 32))
+	const unsigned width  = FreeImage_GetWidth(fg);
+	const unsigned height = FreeImage_GetHeight(fg);
+	const unsigned bpp    = FreeImage_GetBPP(fg);
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(fg);
+
+	// type and bit depth of the composite image, and of the background image
+	FREE_IMAGE_TYPE dst_type = FIT_UNKNOWN;
+	unsigned dst_bpp = 0;
+	switch (image_type) {
+		case FIT_BITMAP:
+			if ((bpp == 8) || (bpp == 32)) {
+				dst_type = FIT_BITMAP;
+				dst_bpp = 24;
+			}
+			break;
+		case FIT_RGBA16:
+			dst_type = FIT_RGB16;
+			dst_bpp = 48;
+			break;
+		case FIT_RGBAF:
+			dst_type = FIT_RGBF;
+			dst_bpp = 96;
+			break;
+		default:
+			break;
+	}
+	if (dst_type == FIT_UNKNOWN)
 		return nullptr;
 
 	if (bg) {
-		const int bg_width  = FreeImage_GetWidth(bg);
-		const int bg_height = FreeImage_GetHeight(bg);
-		const int bg_bpp    = FreeImage_GetBPP(bg);
-		if ((bg_width != width) || (bg_height != height) || (bg_bpp != 24))
+		if ((FreeImage_GetWidth(bg) != width) || (FreeImage_GetHeight(bg) != height) || (FreeImage_GetImageType(bg) != dst_type) || (FreeImage_GetBPP(bg) != dst_bpp))
 			return nullptr;
 	}
 
-	int bytespp = (bpp == 8) ? 1 : 4;
-
-	
-	int x, y, c;
-	uint8_t alpha = 0, not_alpha;
-	uint8_t index;
-	FIRGBA8 fgc;	// foreground color
-	FIRGBA8 bkc;	// background color
-
-	memset(&fgc, 0, sizeof(FIRGBA8));
+	// retrieve the background color from the foreground image,
+	// or use the application background color, or the background image, or a checkerboard
+	FIRGBA8 bkc;
 	memset(&bkc, 0, sizeof(FIRGBA8));
-
-	// allocate the composite image
-	FIBITMAP *composite = FreeImage_Allocate(width, height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
-	if (!composite) return nullptr;
-
-	// get the palette
-	const FIRGBA8 *pal = FreeImage_GetPalette(fg);
-
-	// retrieve the alpha table from the foreground image
-	FIBOOL bIsTransparent = FreeImage_IsTransparent(fg);
-	const uint8_t *trns = FreeImage_GetTransparencyTable(fg);
-
-	// retrieve the background color from the foreground image
 	FIBOOL bHasBkColor = FALSE;
 
 	if (useFileBkg && FreeImage_HasBackgroundColor(fg)) {
 		FreeImage_GetBackgroundColor(fg, &bkc);
 		bHasBkColor = TRUE;
-	} else {
-		// no file background color
-		// use application background color ?
-		if (appBkColor) {
-			memcpy(&bkc, appBkColor, sizeof(FIRGBA8));
-			bHasBkColor = TRUE;
-		}
-		// use background image ?
-		else if (bg) {
-			bHasBkColor = FALSE;
-		}
+	} else if (appBkColor) {
+		memcpy(&bkc, appBkColor, sizeof(FIRGBA8));
+		bHasBkColor = TRUE;
+	}
+	if (bHasBkColor) {
+		bg = nullptr;
 	}
 
-	for (y = 0; y < height; y++) {
-		// foreground
-		uint8_t *fg_bits = FreeImage_GetScanLine(fg, y);
-		// background
-		uint8_t *bg_bits = FreeImage_GetScanLine(bg, y);
-		// composite image
-		uint8_t *cp_bits = FreeImage_GetScanLine(composite, y);
-
-		for (x = 0; x < width; x++) {
-
-			// foreground color + alpha
-
-			if (bpp == 8) {
-				// get the foreground color
-				index = fg_bits[0];
-				memcpy(&fgc, &pal[index], sizeof(FIRGBA8));
-				// get the alpha
-				if (bIsTransparent) {
-					alpha = trns[index];
-				} else {
-					alpha = 255;
-				}
-			}
-			else if (bpp == 32) {
-				// get the foreground color
-				fgc.blue  = fg_bits[FI_RGBA_BLUE];
-				fgc.green = fg_bits[FI_RGBA_GREEN];
-				fgc.red   = fg_bits[FI_RGBA_RED];
-				// get the alpha
-				alpha = fg_bits[FI_RGBA_ALPHA];
-			}
-
-			// background color
-
-			if (!bHasBkColor) {
-				if (bg) {
-					// get the background color from the background image
-					bkc.blue  = bg_bits[FI_RGBA_BLUE];
-					bkc.green = bg_bits[FI_RGBA_GREEN];
-					bkc.red   = bg_bits[FI_RGBA_RED];
-				}
-				else {
-					// use a checkerboard pattern
-					c = (((y & 0x8) == 0) ^ ((x & 0x8) == 0)) * 192;
-					c = c ? c : 255;
-					bkc.blue  = (uint8_t)c;
-					bkc.green = (uint8_t)c;
-					bkc.red   = (uint8_t)c;
-				}
-			}
-
-			// composition
-
-			if (alpha == 0) {
-				// output = background
-				cp_bits[FI_RGBA_BLUE] = bkc.blue;
-				cp_bits[FI_RGBA_GREEN] = bkc.green;
-				cp_bits[FI_RGBA_RED] = bkc.red;
-			}
-			else if (alpha == 255) {
-				// output = foreground
-				cp_bits[FI_RGBA_BLUE] = fgc.blue;
-				cp_bits[FI_RGBA_GREEN] = fgc.green;
-				cp_bits[FI_RGBA_RED] = fgc.red;
-			}
-			else {
-				// output = alpha * foreground + (1-alpha) * background
-				not_alpha = (uint8_t)~alpha;
-				cp_bits[FI_RGBA_BLUE] = (uint8_t)((alpha * (uint16_t)fgc.blue  + not_alpha * (uint16_t)bkc.blue) >> 8);
-				cp_bits[FI_RGBA_GREEN] = (uint8_t)((alpha * (uint16_t)fgc.green + not_alpha * (uint16_t)bkc.green) >> 8);
-				cp_bits[FI_RGBA_RED] = (uint8_t)((alpha * (uint16_t)fgc.red   + not_alpha * (uint16_t)bkc.red) >> 8);
-			}
+	// allocate the composite image
+	FIBITMAP *composite = FreeImage_AllocateT(dst_type, width, height, dst_bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+	if (!composite) return nullptr;
 
-			fg_bits += bytespp;
-			bg_bits += 3;
-			cp_bits += 3;
-		}
+	const FIRGBA8 *bk_color = bHasBkColor ? &bkc : nullptr;
+	switch (image_type) {
+		case FIT_BITMAP:
+			CompositeAs<uint8_t>(composite, fg, bk_color, bg);
+			break;
+		case FIT_RGBA16:
+			CompositeAs<uint16_t>(composite, fg, bk_color, bg);
+			break;
+		default:
+			CompositeAs<float>(composite, fg, bk_color, bg);
+			break;
 	}
 
 	// copy metadata from src to dst
@@ -189,43 +235,30 @@ Pre-multiplies a 32-bit image's red-, green- and blue channels with it's alpha c
 for to be used with e.g. the Windows GDI function AlphaBlend(). 
 The transformation changes the red-, green- and blue channels according to the following equation:  
 channel(x, y) = channel(x, y) * alpha_channel(x, y) / 255  
+FIT_RGBA16 images are handled alike with 65535 as the maximal value, FIT_RGBAF images are multiplied with their alpha.
 @param dib Input/Output dib to be premultiplied
 @return Returns TRUE on success, FALSE otherwise (e.g. when the bitdepth of the source dib cannot be handled). 
 */
 FIBOOL DLL_CALLCONV 
 FreeImage_PreMultiplyWithAlpha(FIBITMAP *dib) {
 	if (!FreeImage_HasPixels(dib)) return FALSE;
-	
-	if ((FreeImage_GetBPP(dib) != 32) || (FreeImage_GetImageType(dib) != FIT_BITMAP)) {
-		return FALSE;
-	}
 
-	const int width = FreeImage_GetWidth(dib);
-	const int height = FreeImage_GetHeight(dib);
-
-	for (int y = 0; y < height; y++) {
-		uint8_t *bits = FreeImage_GetScanLine(dib, y);
-		for (int x = 0; x < width; x++, bits += 4) {
-			const uint8_t alpha = bits[FI_RGBA_ALPHA];
-			// slightly faster: care for two special cases
-			if (alpha == 0x00) {
-				// special case for alpha == 0x00
-				// color * 0x00 / 0xFF = 0x00
-				bits[FI_RGBA_BLUE] = 0x00;
-				bits[FI_RGBA_GREEN] = 0x00;
-				bits[FI_RGBA_RED] = 0x00;
-			} else if (alpha == 0xFF) {
-				// nothing to do for alpha == 0xFF
-				// color * 0xFF / 0xFF = color
-				continue;
-			} else {
-				bits[FI_RGBA_BLUE] = (uint8_t)( (alpha * (uint16_t)bits[FI_RGBA_BLUE] + 127) / 255 );
-				bits[FI_RGBA_GREEN] = (uint8_t)( (alpha * (uint16_t)bits[FI_RGBA_GREEN] + 127) / 255 );
-				bits[FI_RGBA_RED] = (uint8_t)( (alpha * (uint16_t)bits[FI_RGBA_RED] + 127) / 255 );
+	switch (FreeImage_GetImageType(dib)) {
+		case FIT_BITMAP:
+			if (FreeImage_GetBPP(dib) != 32) {
+				return FALSE;
 			}
-		}
+			PreMultiplyRows<uint8_t>(dib);
+			return TRUE;
+		case FIT_RGBA16:
+			PreMultiplyRows<uint16_t>(dib);
+			return TRUE;
+		case FIT_RGBAF:
+			PreMultiplyRows<float>(dib);
+			return TRUE;
+		default:
+			return FALSE;
 	}
-	return TRUE;
 }
 
 
@@ -255,6 +288,10 @@ FIBOOL FreeImage_DrawBitmap(FIBITMAP* dst, FIBITMAP* src, FREE_IMAGE_ALPHA_OPERA
 	const int32_t roiRight  = std::min(left + srcW, dstW);
 	const int32_t roiBottom = std::min(top + srcH, dstH);
 
+	if (roiRight <= roiLeft || roiBottom <= roiTop) {
+		return TRUE;
+	}
+
 	const int32_t offsetX = roiLeft - left;
 	const int32_t offsetY = roiTop - top;
 
@@ -263,25 +300,19 @@ FIBOOL FreeImage_DrawBitmap(FIBITMAP* dst, FIBITMAP* src, FREE_IMAGE_ALPHA_OPERA
 		return FALSE;
 	}
 
-	// Y axis is flipped in FI
-	for (int32_t y = roiBottom - roiTop; y > 0; --y) {
-		const auto srcLine = static_cast<const FIRGBA8*>(static_cast<const void*>(FreeImage_GetScanLine(src, srcH - y - offsetY))) + offsetX;
-		const auto dstLine = static_cast<FIRGBA8*>(static_cast<void*>(FreeImage_GetScanLine(dst, dstH - roiTop - y))) + roiLeft;
-		for (int32_t x = 0; x < roiRight - roiLeft; ++x) {
-			const uint8_t alpha = srcLine[x].alpha;
-			if (alpha == 255) {
-				dstLine[x].red   = srcLine[x].red;
-				dstLine[x].green = srcLine[x].green;
-				dstLine[x].blue  = srcLine[x].blue;
-			}
-			else if (alpha > 0) {
-				const uint8_t notAlpha = ~alpha;
-				dstLine[x].red   = static_cast<uint8_t>((alpha * srcLine[x].red   + notAlpha * dstLine[x].red)   / 255);
-				dstLine[x].green = static_cast<uint8_t>((alpha * srcLine[x].green + notAlpha * dstLine[x].green) / 255);
-				dstLine[x].blue  = static_cast<uint8_t>((alpha * srcLine[x].blue  + notAlpha * dstLine[x].blue)  / 255);
-			}
+	// Y axis is flipped in FI: rows are counted from the top of the region, scanlines from the bottom
+	const int32_t rows = roiBottom - roiTop;
+	const unsigned count = static_cast<unsigned>(roiRight - roiLeft);
+	const uint8_t *srcBits = FreeImage_GetScanLine(src, srcH - rows - offsetY) + 4 * offsetX;
+	const ptrdiff_t srcStride = FreeImage_GetScanLineStride(src);
+	uint8_t *dstBits = FreeImage_GetScanLine(dst, dstH - roiTop - rows) + 4 * roiLeft;
+	const ptrdiff_t dstStride = FreeImage_GetScanLineStride(dst);
+
+	ThreadPool::Instance().parallelFor(0, rows, AlphaBlendRowGrain(count), [&](size_t first, size_t last) {
+		for (size_t y = first; y < last; ++y) {
+			KernelDispatch<SrcAlphaRow>::Run(dstBits + (ptrdiff_t)y * dstStride, srcBits + (ptrdiff_t)y * srcStride, count);
 		}
-	}
+	});
 
 	return TRUE;
 }
@@ -23,6 +23,7 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "Transpose.h"
 
 /**
 Flip the image horizontally along the vertical axis.
@@ -51,16 +52,8 @@ FreeImage_FlipHorizontal(FIBITMAP *src) {
 
 		switch (FreeImage_GetBPP(src)) {
 			case 1 :
-			{
-				for (unsigned x = 0; x < width; x++) {
-					// get pixel at (x, y)
-					FIBOOL value = (new_bits[x >> 3] & (0x80 >> (x & 0x07))) != 0;
-					// set pixel at (new_x, y)
-					unsigned new_x = width - 1 - x;
-					value ? bits[new_x >> 3] |= (0x80 >> (new_x & 0x7)) : bits[new_x >> 3] &= (0xff7f >> (new_x & 0x7));
-				}
-			}
-			break;
+				MirrorBits(bits, new_bits, width);
+				break;
 
 			case 4 :
 			{
@@ -0,0 +1,474 @@
+// ==========================================================
+// Fused point operations
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "../FreeImage/SimpleTools.h"
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <vector>
+
+// ----------------------------------------------------------
+//   Notes
+//
+// A FIPOINTOPS records a sequence of point operations, each one restricted to some channels.
+// Nothing is computed until FreeImage_ApplyPointOps, which makes a single pass over the image:
+//  - 8-bit samples: the 256 entry LUT of every operation is the one of the standalone
+//    FreeImage_Adjust* function, and the LUTs are composed per channel, so that the result
+//    is identical to applying the operations one after the other
+//  - 16-bit samples: the operations work on samples normalized to [0, 1], clamped after each
+//    operation, and are tabulated into one 65536 entry LUT per channel for large images
+//  - float samples: the operations are applied one after the other to every row, while
+//    the row is in cache. Samples are not clamped, gamma leaves samples <= 0 unchanged
+// ----------------------------------------------------------
+
+namespace {
+
+enum PointOpChannels : unsigned {
+	kPointOpRed   = 1,
+	kPointOpGreen = 2,
+	kPointOpBlue  = 4,
+	kPointOpAlpha = 8,
+	kPointOpRGB   = kPointOpRed | kPointOpGreen | kPointOpBlue
+};
+
+enum class PointOpType {
+	eBrightness,
+	eContrast,
+	eGamma,
+	eCurve,
+	eInvert
+};
+
+struct PointOp {
+	PointOpType type;
+	unsigned channels;		// PointOpChannels mask
+	double value;			// brightness or contrast scale, gamma exponent
+	uint8_t lut[256];		// the operation on 8-bit samples
+};
+
+struct PointOpList {
+	std::vector<PointOp> ops;
+};
+
+inline PointOpList *
+GetOpList(const FIPOINTOPS *ops) {
+	return ops ? static_cast<PointOpList *>(ops->data) : nullptr;
+}
+
+/// Channel mask of a FREE_IMAGE_COLOR_CHANNEL, 0 when point operations don't apply to it
+unsigned
+ChannelMask(FREE_IMAGE_COLOR_CHANNEL channel) {
+	switch (channel) {
+		case FICC_RGB:
+			return kPointOpRGB;
+		case FICC_RED:
+			return kPointOpRed;
+		case FICC_GREEN:
+			return kPointOpGreen;
+		case FICC_BLUE:
+			return kPointOpBlue;
+		case FICC_ALPHA:
+			return kPointOpAlpha;
+		default:
+			return 0;
+	}
+}
+
+FIBOOL
+AddOp(FIPOINTOPS *ops, PointOpType type, FREE_IMAGE_COLOR_CHANNEL channel, double value, const uint8_t *curve) {
+	PointOpList *list = GetOpList(ops);
+	const unsigned mask = ChannelMask(channel);
+	if (!list || !mask) {
+		return FALSE;
+	}
+
+	PointOp op{};
+	op.type = type;
+	op.channels = mask;
+	op.value = value;
+
+	// same tables as FreeImage_AdjustBrightness, FreeImage_AdjustContrast and FreeImage_AdjustGamma
+	switch (type) {
+		case PointOpType::eBrightness:
+			for (int i = 0; i < 256; i++) {
+				const double v = MAX(0.0, MIN(i * value, 255.0));
+				op.lut[i] = (uint8_t)floor(v + 0.5);
+			}
+			break;
+		case PointOpType::eContrast:
+			for (int i = 0; i < 256; i++) {
+				const double v = MAX(0.0, MIN(128 + (i - 128) * value, 255.0));
+				op.lut[i] = (uint8_t)floor(v + 0.5);
+			}
+			break;
+		case PointOpType::eGamma: {
+			const double v = 255.0 * pow(255.0, -value);
+			for (int i = 0; i < 256; i++) {
+				const double color = MIN(pow((double)i, value) * v, 255.0);
+				op.lut[i] = (uint8_t)floor(color + 0.5);
+			}
+			break;
+		}
+		case PointOpType::eCurve:
+			memcpy(op.lut, curve, sizeof(op.lut));
+			break;
+		case PointOpType::eInvert:
+			for (int i = 0; i < 256; i++) {
+				op.lut[i] = (uint8_t)(255 - i);
+			}
+			break;
+	}
+
+	list->ops.push_back(op);
+	return TRUE;
+}
+
+/// The operations applied to a channel, all of them for single channel images
+std::vector<const PointOp *>
+ChannelChain(const PointOpList &list, unsigned channel_bit) {
+	std::vector<const PointOp *> chain;
+	for (const PointOp &op : list.ops) {
+		if (!channel_bit || (op.channels & channel_bit)) {
+			chain.push_back(&op);
+		}
+	}
+	return chain;
+}
+
+/// One operation on a sample normalized to [0, 1]
+template <typename Ty_>
+FI_ALWAYS_INLINE Ty_
+EvalOp(const PointOp &op, Ty_ v) {
+	switch (op.type) {
+		case PointOpType::eBrightness:
+			return v * static_cast<Ty_>(op.value);
+		case PointOpType::eContrast:
+			return static_cast<Ty_>(0.5) + (v - static_cast<Ty_>(0.5)) * static_cast<Ty_>(op.value);
+		case PointOpType::eGamma:
+			return v > 0 ? std::pow(v, static_cast<Ty_>(op.value)) : v;
+		case PointOpType::eCurve: {
+			const Ty_ t = std::clamp<Ty_>(v, 0, 1) * 255;
+			const unsigned i = static_cast<unsigned>(t);
+			const unsigned j = MIN(i + 1, 255U);
+			return (op.lut[i] + (t - i) * (op.lut[j] - op.lut[i])) / 255;
+		}
+		case PointOpType::eInvert:
+			return 1 - v;
+	}
+	return v;
+}
+
+/// A chain on a 16-bit sample, clamped after each operation
+uint16_t
+EvalChain16(const std::vector<const PointOp *> &chain, uint16_t sample) {
+	double v = sample / 65535.0;
+	for (const PointOp *op : chain) {
+		v = std::clamp(EvalOp(*op, v), 0.0, 1.0);
+	}
+	return static_cast<uint16_t>(v * 65535.0 + 0.5);
+}
+
+// ----------------------------------------------------------
+
+/// Applies one LUT per byte of the pixels of 8-, 24- and 32-bit rows
+template <unsigned Bytespp_>
+void
+ApplyLuts8(FIBITMAP *dib, const uint8_t (&luts)[4][256]) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const ptrdiff_t stride = FreeImage_GetScanLineStride(dib);
+	uint8_t *bits = FreeImage_GetScanLine(dib, 0);
+
+	const size_t grain_rows = MAX((size_t)1, (size_t)(kTransformGrainPixels / MAX(width, 1U)));
+	ThreadPool::Instance().parallelFor(0, height, grain_rows, [&](size_t first, size_t last) {
+		for (size_t y = first; y < last; ++y) {
+			uint8_t *pixel = bits + (ptrdiff_t)y * stride;
+			for (unsigned x = 0; x < width; ++x, pixel += Bytespp_) {
+				for (unsigned k = 0; k < Bytespp_; ++k) {
+					pixel[k] = luts[k][pixel[k]];
+				}
+			}
+		}
+	});
+}
+
+template <unsigned Channels_>
+void
+ApplyChains16(FIBITMAP *dib, const std::vector<const PointOp *> (&chains)[4]) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const ptrdiff_t stride = FreeImage_GetScanLineStride(dib);
+	uint8_t *bits = FreeImage_GetScanLine(dib, 0);
+
+	// large images read a 65536 entry table per channel, small ones evaluate the chains directly
+	const bool tabulate = (size_t)width * height >= 65536;
+	std::vector<uint16_t> luts[Channels_];
+	if (tabulate) {
+		for (unsigned c = 0; c < Channels_; ++c) {
+			if (!chains[c].empty()) {
+				luts[c].resize(65536);
+				uint16_t *lut = luts[c].data();
+				ThreadPool::Instance().parallelFor(0, 65536, 4096, [&](size_t first, size_t last) {
+					for (size_t i = first; i < last; ++i) {
+						lut[i] = EvalChain16(chains[c], (uint16_t)i);
+					}
+				});
+			}
+		}
+	}
+
+	const size_t grain_rows = MAX((size_t)1, (size_t)(kTransformGrainPixels / MAX(width, 1U)));
+	ThreadPool::Instance().parallelFor(0, height, grain_rows, [&](size_t first, size_t last) {
+		for (size_t y = first; y < last; ++y) {
+			uint16_t *row = (uint16_t *)(bits + (ptrdiff_t)y * stride);
+			for (unsigned c = 0; c < Channels_; ++c) {
+				if (chains[c].empty()) {
+					continue;
+				}
+				uint16_t *sample = row + c;
+				if (tabulate) {
+					const uint16_t *lut = luts[c].data();
+					for (unsigned x = 0; x < width; ++x, sample += Channels_) {
+						*sample = lut[*sample];
+					}
+				} else {
+					for (unsigned x = 0; x < width; ++x, sample += Channels_) {
+						*sample = EvalChain16(chains[c], *sample);
+					}
+				}
+			}
+		}
+	});
+}
+
+/// Applies one operation to every Channels_-th float of a row
+template <unsigned Channels_>
+struct FloatOpRow {
+	static FI_ALWAYS_INLINE void Run(float *samples, unsigned width, const PointOp *op) {
+		switch (op->type) {
+			case PointOpType::eBrightness: {
+				const float scale = (float)op->value;
+				FI_VECTORIZE_LOOP
+				for (size_t x = 0; x < width; ++x) {
+					samples[x * Channels_] *= scale;
+				}
+				break;
+			}
+			case PointOpType::eContrast: {
+				const float scale = (float)op->value;
+				FI_VECTORIZE_LOOP
+				for (size_t x = 0; x < width; ++x) {
+					samples[x * Channels_] = 0.5F + (samples[x * Channels_] - 0.5F) * scale;
+				}
+				break;
+			}
+			case PointOpType::eInvert:
+				FI_VECTORIZE_LOOP
+				for (size_t x = 0; x < width; ++x) {
+					samples[x * Channels_] = 1.0F - samples[x * Channels_];
+				}
+				break;
+			default:
+				for (size_t x = 0; x < width; ++x) {
+					samples[x * Channels_] = EvalOp(*op, samples[x * Channels_]);
+				}
+				break;
+		}
+	}
+};
+
+template <unsigned Channels_>
+void
+ApplyChainsFloat(FIBITMAP *dib, const std::vector<const PointOp *> (&chains)[4]) {
+	const unsigned width = FreeImage_GetWidth(dib);
+	const unsigned height = FreeImage_GetHeight(dib);
+	const ptrdiff_t stride = FreeImage_GetScanLineStride(dib);
+	uint8_t *bits = FreeImage_GetScanLine(dib, 0);
+
+	const size_t grain_rows = MAX((size_t)1, (size_t)(kTransformGrainPixels / MAX(width, 1U)));
+	ThreadPool::Instance().parallelFor(0, height, grain_rows, [&](size_t first, size_t last) {
+		for (size_t y = first; y < last; ++y) {
+			float *row = (float *)(bits + (ptrdiff_t)y * stride);
+			for (unsigned c = 0; c < Channels_; ++c) {
+				for (const PointOp *op : chains[c]) {
+					KernelDispatch<FloatOpRow<Channels_>>::Run(row + c, width, op);
+				}
+			}
+		}
+	});
+}
+
+} // namespace
+
+// ----------------------------------------------------------
+
+FIPOINTOPS * DLL_CALLCONV
+FreeImage_CreatePointOps() {
+	FIPOINTOPS *ops = (FIPOINTOPS *)malloc(sizeof(FIPOINTOPS));
+	if (ops) {
+		ops->data = new(std::nothrow) PointOpList;
+		if (!ops->data) {
+			free(ops);
+			return nullptr;
+		}
+	}
+	return ops;
+}
+
+void DLL_CALLCONV
+FreeImage_DeletePointOps(FIPOINTOPS *ops) {
+	if (ops) {
+		delete GetOpList(ops);
+		free(ops);
+	}
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_PointOpsAddBrightness(FIPOINTOPS *ops, double percentage, FREE_IMAGE_COLOR_CHANNEL channel) {
+	return AddOp(ops, PointOpType::eBrightness, channel, (100 + percentage) / 100, nullptr);
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_PointOpsAddContrast(FIPOINTOPS *ops, double percentage, FREE_IMAGE_COLOR_CHANNEL channel) {
+	return AddOp(ops, PointOpType::eContrast, channel, (100 + percentage) / 100, nullptr);
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_PointOpsAddGamma(FIPOINTOPS *ops, double gamma, FREE_IMAGE_COLOR_CHANNEL channel) {
+	if (gamma <= 0) {
+		return FALSE;
+	}
+	return AddOp(ops, PointOpType::eGamma, channel, 1 / gamma, nullptr);
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_PointOpsAddCurve(FIPOINTOPS *ops, const uint8_t *LUT, FREE_IMAGE_COLOR_CHANNEL channel) {
+	if (!LUT) {
+		return FALSE;
+	}
+	return AddOp(ops, PointOpType::eCurve, channel, 0, LUT);
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_PointOpsAddInvert(FIPOINTOPS *ops, FREE_IMAGE_COLOR_CHANNEL channel) {
+	return AddOp(ops, PointOpType::eInvert, channel, 0, nullptr);
+}
+
+FIBOOL DLL_CALLCONV
+FreeImage_ApplyPointOps(FIBITMAP *dib, const FIPOINTOPS *ops) {
+	const PointOpList *list = GetOpList(ops);
+	if (!FreeImage_HasPixels(dib) || !list) {
+		return FALSE;
+	}
+	if (list->ops.empty()) {
+		return TRUE;
+	}
+
+	const FREE_IMAGE_TYPE image_type = FreeImage_GetImageType(dib);
+	const unsigned bpp = FreeImage_GetBPP(dib);
+
+	if (image_type == FIT_BITMAP) {
+		if ((bpp != 1) && (bpp != 4) && (bpp != 8) && (bpp != 24) && (bpp != 32)) {
+			return FALSE;
+		}
+		const bool palette = (bpp <= 8) && (FreeImage_GetColorType(dib) == FIC_PALETTE || bpp < 8);
+
+		// compose the LUTs of every channel, in red, green, blue, alpha order
+		uint8_t luts[4][256];
+		for (unsigned c = 0; c < 4; ++c) {
+			for (unsigned i = 0; i < 256; ++i) {
+				luts[c][i] = (uint8_t)i;
+			}
+			const unsigned channel_bit = (bpp == 8 && !palette) ? 0 : (1U << c);
+			for (const PointOp *op : ChannelChain(*list, channel_bit)) {
+				for (unsigned i = 0; i < 256; ++i) {
+					luts[c][i] = op->lut[luts[c][i]];
+				}
+			}
+		}
+
+		if (palette) {
+			FIRGBA8 *pal = FreeImage_GetPalette(dib);
+			for (unsigned i = 0; i < FreeImage_GetColorsUsed(dib); i++) {
+				pal[i].red   = luts[0][pal[i].red];
+				pal[i].green = luts[1][pal[i].green];
+				pal[i].blue  = luts[2][pal[i].blue];
+			}
+			return TRUE;
+		}
+
+		// reorder the LUTs to the bytes of a pixel
+		uint8_t pixel_luts[4][256];
+		memcpy(pixel_luts[FI_RGBA_RED], luts[0], 256);
+		memcpy(pixel_luts[FI_RGBA_GREEN], luts[1], 256);
+		memcpy(pixel_luts[FI_RGBA_BLUE], luts[2], 256);
+		memcpy(pixel_luts[FI_RGBA_ALPHA], luts[3], 256);
+
+		switch (bpp) {
+			case 8:
+				ApplyLuts8<1>(dib, luts);
+				break;
+			case 24:
+				ApplyLuts8<3>(dib, pixel_luts);
+				break;
+			case 32:
+				ApplyLuts8<4>(dib, pixel_luts);
+				break;
+		}
+		return TRUE;
+	}
+
+	std::vector<const PointOp *> chains[4];
+	const auto BuildChains = [&](unsigned channels) {
+		for (unsigned c = 0; c < channels; ++c) {
+			chains[c] = ChannelChain(*list, channels == 1 ? 0 : (1U << c));
+		}
+	};
+
+	switch (image_type) {
+		case FIT_UINT16:
+			BuildChains(1);
+			ApplyChains16<1>(dib, chains);
+			break;
+		case FIT_RGB16:
+			BuildChains(3);
+			ApplyChains16<3>(dib, chains);
+			break;
+		case FIT_RGBA16:
+			BuildChains(4);
+			ApplyChains16<4>(dib, chains);
+			break;
+		case FIT_FLOAT:
+			BuildChains(1);
+			ApplyChainsFloat<1>(dib, chains);
+			break;
+		case FIT_RGBF:
+			BuildChains(3);
+			ApplyChainsFloat<3>(dib, chains);
+			break;
+		case FIT_RGBAF:
+			BuildChains(4);
+			ApplyChainsFloat<4>(dib, chains);
+			break;
+		default:
+			return FALSE;
+	}
+	return TRUE;
+}
@@ -21,6 +21,10 @@
 // ==========================================================
 
 #include "Resize.h"
+#include "../FreeImage/SimpleTools.h"
+
+#include <cstring>
+#include <vector>
 
 FIBITMAP * DLL_CALLCONV
 FreeImage_RescaleRect(FIBITMAP *src, int dst_width, int dst_height, int src_left, int src_top, int src_right, int src_bottom, FREE_IMAGE_FILTER filter, unsigned flags) {
@@ -93,6 +97,118 @@ FreeImage_Rescale(FIBITMAP *src, int dst_width, int dst_height, FREE_IMAGE_FILTE
 	return FreeImage_RescaleRect(src, dst_width, dst_height, 0, 0, FreeImage_GetWidth(src), FreeImage_GetHeight(src), filter, FI_RESCALE_DEFAULT);
 }
 
+// ----------------------------------------------------------
+//   1-bit area averaging
+// ----------------------------------------------------------
+
+/// Number of set bits of x
+static inline unsigned
+PopCount64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+	return (unsigned)__builtin_popcountll(x);
+#else
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (unsigned)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/// Number of set pixels in [x0, x1) of a 1-bit scanline, x0 < x1
+static inline unsigned
+CountBits(const uint8_t *bits, unsigned x0, unsigned x1) {
+	unsigned first = x0 >> 3;
+	const unsigned last = (x1 - 1) >> 3;
+	const unsigned head = 0xFFU >> (x0 & 7);
+	const unsigned tail = (0xFFU << (7 - ((x1 - 1) & 7))) & 0xFFU;
+
+	if (first == last) {
+		return PopCount64(bits[first] & head & tail);
+	}
+	unsigned count = PopCount64(bits[first] & head) + PopCount64(bits[last] & tail);
+	for (++first; first + 8 <= last; first += 8) {
+		uint64_t x;
+		memcpy(&x, bits + first, sizeof(x));
+		count += PopCount64(x);
+	}
+	for (; first < last; ++first) {
+		count += PopCount64(bits[first]);
+	}
+	return count;
+}
+
+/**
+Splits [0, src_size) into dst_size runs of source pixels: destination pixel i
+averages [begin[i], end[i]), which holds one source pixel at least.
+*/
+static void
+AreaRuns(unsigned src_size, unsigned dst_size, std::vector<unsigned>& begin, std::vector<unsigned>& end) {
+	begin.resize(dst_size);
+	end.resize(dst_size);
+	for (unsigned i = 0; i < dst_size; i++) {
+		begin[i] = (unsigned)((uint64_t)i * src_size / dst_size);
+		end[i] = std::max((unsigned)((uint64_t)(i + 1) * src_size / dst_size), begin[i] + 1);
+	}
+}
+
+FIBITMAP * DLL_CALLCONV
+FreeImage_RescaleBilevel(FIBITMAP *src, int dst_width, int dst_height) {
+	if (!FreeImage_HasPixels(src) || (FreeImage_GetImageType(src) != FIT_BITMAP) || (FreeImage_GetBPP(src) != 1) || (dst_width <= 0) || (dst_height <= 0)) {
+		return nullptr;
+	}
+
+	const unsigned src_width = FreeImage_GetWidth(src);
+	const unsigned src_height = FreeImage_GetHeight(src);
+
+	FIBITMAP *dst = FreeImage_Allocate(dst_width, dst_height, 8);
+	if (!dst) {
+		return nullptr;
+	}
+
+	// grey levels of the two palette entries
+	const FIRGBA8 *pal = FreeImage_GetPalette(src);
+	const uint64_t grey0 = GREY(pal[0].red, pal[0].green, pal[0].blue);
+	const uint64_t grey1 = GREY(pal[1].red, pal[1].green, pal[1].blue);
+
+	std::vector<unsigned> x_begin, x_end, y_begin, y_end;
+	AreaRuns(src_width, dst_width, x_begin, x_end);
+	AreaRuns(src_height, dst_height, y_begin, y_end);
+
+	const ptrdiff_t src_stride = FreeImage_GetScanLineStride(src);
+	const ptrdiff_t dst_stride = FreeImage_GetScanLineStride(dst);
+	const uint8_t *src_bits = FreeImage_GetScanLine(src, 0);
+	uint8_t *dst_bits = FreeImage_GetScanLine(dst, 0);
+
+	const size_t row_pixels = (size_t)src_width * std::max(1U, src_height / (unsigned)dst_height);
+	const size_t grain = std::max<size_t>(1, kTransformGrainPixels / row_pixels);
+
+	ThreadPool::Instance().parallelFor(0, dst_height, grain, [&](size_t first, size_t last) {
+		std::vector<uint64_t> counts(dst_width);
+		for (size_t y = first; y < last; y++) {
+			// count the set pixels of every block of source pixels
+			std::fill(counts.begin(), counts.end(), 0);
+			for (unsigned sy = y_begin[y]; sy < y_end[y]; sy++) {
+				const uint8_t *src_line = src_bits + (ptrdiff_t)sy * src_stride;
+				for (int x = 0; x < dst_width; x++) {
+					counts[x] += CountBits(src_line, x_begin[x], x_end[x]);
+				}
+			}
+
+			uint8_t *dst_line = dst_bits + (ptrdiff_t)y * dst_stride;
+			const uint64_t rows = y_end[y] - y_begin[y];
+			for (int x = 0; x < dst_width; x++) {
+				const uint64_t area = rows * (x_end[x] - x_begin[x]);
+				dst_line[x] = (uint8_t)((counts[x] * grey1 + (area - counts[x]) * grey0 + area / 2) / area);
+			}
+		}
+	});
+
+	// copy metadata from src to dst
+	FreeImage_CloneMetadata(dst, src);
+
+	return dst;
+}
+
 FIBITMAP * DLL_CALLCONV
 FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, FIBOOL convert) {
 	FIBITMAP *thumbnail{};
@@ -137,6 +253,13 @@ FreeImage_MakeThumbnail(FIBITMAP *dib, int max_pixel_size, FIBOOL convert) {
 		case FIT_RGBF:
 		case FIT_RGBAF:
 		{
+			const FREE_IMAGE_COLOR_TYPE color_type = FreeImage_GetColorType(dib);
+			if ((image_type == FIT_BITMAP) && (FreeImage_GetBPP(dib) == 1) && !FreeImage_IsTransparent(dib)
+				&& ((color_type == FIC_MINISBLACK) || (color_type == FIC_MINISWHITE))) {
+				// bilevel documents: average the pixels covered by each thumbnail pixel
+				thumbnail = FreeImage_RescaleBilevel(dib, new_width, new_height);
+				break;
+			}
 			FREE_IMAGE_FILTER filter = FILTER_BILINEAR;
 			thumbnail = FreeImage_Rescale(dib, new_width, new_height, filter);
 		}
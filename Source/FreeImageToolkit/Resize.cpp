@@ -1291,8 +1291,8 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			switch (FreeImage_GetBPP(src)) {
 				case 1:
 				{
-					const unsigned src_pitch = FreeImage_GetPitch(src);
-					const uint8_t * const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + (src_offset_x >> 3);
+					const ptrdiff_t src_pitch = FreeImage_GetScanLineStride(src);
+					const uint8_t * const src_base = FreeImage_GetScanLine(src, 0) + src_offset_y * src_pitch + (src_offset_x >> 3);
 
 					switch (FreeImage_GetBPP(dst)) {
 						case 8:
@@ -1482,8 +1482,8 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 
 				case 4:
 				{
-					const unsigned src_pitch = FreeImage_GetPitch(src);
-					const uint8_t *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + (src_offset_x >> 1);
+					const ptrdiff_t src_pitch = FreeImage_GetScanLineStride(src);
+					const uint8_t *const src_base = FreeImage_GetScanLine(src, 0) + src_offset_y * src_pitch + (src_offset_x >> 1);
 
 					switch (FreeImage_GetBPP(dst)) {
 						case 8:
@@ -1604,8 +1604,8 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 
 				case 8:
 				{
-					const unsigned src_pitch = FreeImage_GetPitch(src);
-					const uint8_t *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x;
+					const ptrdiff_t src_pitch = FreeImage_GetScanLineStride(src);
+					const uint8_t *const src_base = FreeImage_GetScanLine(src, 0) + src_offset_y * src_pitch + src_offset_x;
 
 					switch (FreeImage_GetBPP(dst)) {
 						case 8:
@@ -1780,8 +1780,8 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 				case 16:
 				{
 					// transparently convert the 16-bit non-transparent image to 24 bpp
-					const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(uint16_t);
-					const uint16_t *const src_base = (uint16_t *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x;
+					const ptrdiff_t src_pitch = FreeImage_GetScanLineStride(src) / (ptrdiff_t)sizeof(uint16_t);
+					const uint16_t *const src_base = (uint16_t *)FreeImage_GetScanLine(src, 0) + src_offset_y * src_pitch + src_offset_x;
 
 					if (IS_FORMAT_RGB565(src)) {
 						// image has 565 format
@@ -1852,8 +1852,8 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 				case 24:
 				{
 					// scale the 24-bit transparent image into a 24 bpp destination image
-					const unsigned src_pitch = FreeImage_GetPitch(src);
-					const uint8_t *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * 3;
+					const ptrdiff_t src_pitch = FreeImage_GetScanLineStride(src);
+					const uint8_t *const src_base = FreeImage_GetScanLine(src, 0) + src_offset_y * src_pitch + src_offset_x * 3;
 
 					for (unsigned x = 0; x < width; x++) {
 						// work on column x in dst
@@ -1891,8 +1891,8 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 				case 32:
 				{
 					// scale the 32-bit transparent image into a 32 bpp destination image
-					const unsigned src_pitch = FreeImage_GetPitch(src);
-					const uint8_t *const src_base = FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * 4;
+					const ptrdiff_t src_pitch = FreeImage_GetScanLineStride(src);
+					const uint8_t *const src_base = FreeImage_GetScanLine(src, 0) + src_offset_y * src_pitch + src_offset_x * 4;
 
 					for (unsigned x = 0; x < width; x++) {
 						// work on column x in dst
@@ -1940,8 +1940,8 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(uint16_t);
 			uint16_t *const dst_base = (uint16_t *)FreeImage_GetBits(dst);
 
-			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(uint16_t);
-			const uint16_t *const src_base = (uint16_t *)FreeImage_GetBits(src)	+ src_offset_y * src_pitch + src_offset_x * wordspp;
+			const ptrdiff_t src_pitch = FreeImage_GetScanLineStride(src) / (ptrdiff_t)sizeof(uint16_t);
+			const uint16_t *const src_base = (uint16_t *)FreeImage_GetScanLine(src, 0)	+ src_offset_y * src_pitch + src_offset_x * wordspp;
 
 			for (unsigned x = 0; x < width; x++) {
 				// work on column x in dst
@@ -1981,8 +1981,8 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(uint16_t);
 			uint16_t *const dst_base = (uint16_t *)FreeImage_GetBits(dst);
 
-			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(uint16_t);
-			const uint16_t *const src_base = (uint16_t *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * wordspp;
+			const ptrdiff_t src_pitch = FreeImage_GetScanLineStride(src) / (ptrdiff_t)sizeof(uint16_t);
+			const uint16_t *const src_base = (uint16_t *)FreeImage_GetScanLine(src, 0) + src_offset_y * src_pitch + src_offset_x * wordspp;
 
 			for (unsigned x = 0; x < width; x++) {
 				// work on column x in dst
@@ -2027,8 +2027,8 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(uint16_t);
 			uint16_t *const dst_base = (uint16_t *)FreeImage_GetBits(dst);
 
-			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(uint16_t);
-			const uint16_t *const src_base = (uint16_t *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * wordspp;
+			const ptrdiff_t src_pitch = FreeImage_GetScanLineStride(src) / (ptrdiff_t)sizeof(uint16_t);
+			const uint16_t *const src_base = (uint16_t *)FreeImage_GetScanLine(src, 0) + src_offset_y * src_pitch + src_offset_x * wordspp;
 
 			for (unsigned x = 0; x < width; x++) {
 				// work on column x in dst
@@ -2077,8 +2077,8 @@ void CResizeEngine::verticalFilter(FIBITMAP *const src, unsigned width, unsigned
 			const unsigned dst_pitch = FreeImage_GetPitch(dst) / sizeof(float);
 			float *const dst_base = (float *)FreeImage_GetBits(dst);
 
-			const unsigned src_pitch = FreeImage_GetPitch(src) / sizeof(float);
-			const float *const src_base = (float *)FreeImage_GetBits(src) + src_offset_y * src_pitch + src_offset_x * floatspp;
+			const ptrdiff_t src_pitch = FreeImage_GetScanLineStride(src) / (ptrdiff_t)sizeof(float);
+			const float *const src_base = (float *)FreeImage_GetScanLine(src, 0) + src_offset_y * src_pitch + src_offset_x * floatspp;
 
 			for (unsigned x = 0; x < width; x++) {
 				// work on column x in dst
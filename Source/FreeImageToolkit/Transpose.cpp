@@ -0,0 +1,478 @@
+// ==========================================================
+// Quarter turn rotation by tiled transposes
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#include "FreeImage.h"
+#include "Utilities.h"
+#include "CPUFeatures.h"
+#include "ThreadPool.h"
+#include "Transpose.h"
+
+#if defined(FI_SIMD_X86)
+#include <immintrin.h>
+#endif
+
+// ----------------------------------------------------------
+//   Notes
+//
+// A quarter turn is a transpose with one of the axes reversed, a transverse has both. The image is cut in
+// square blocks of kBlockPixels that stay in cache, and each block in tiles that are
+// transposed in registers. A tile kernel reads N rows of N contiguous source pixels
+// and writes dst_rows[j][k] = src_rows[k][j]; the reversed axis is handled by the
+// order of the row pointers. Bands of destination rows run on the thread pool.
+// ----------------------------------------------------------
+
+namespace {
+
+/// Side of the square blocks kept in cache while their tiles are transposed
+constexpr unsigned kBlockPixels = 64;
+
+/// Minimal amount of pixels handed to one task, small images run on the calling thread
+constexpr size_t kGrainPixels = 64 * 1024;
+
+/// Maps destination coordinates to source coordinates, rows being counted in memory order
+struct TurnMapping {
+	unsigned src_width;
+	unsigned src_height;
+	bool reverse_rows;		//! destination columns run through source rows from the last one
+	bool reverse_columns;	//! destination rows run through source columns from the right
+
+	/// A top-down source reverses its rows, a top-down destination reverses the source columns
+	TurnMapping(QuarterTurn turn, unsigned width, unsigned height, bool src_top_down, bool dst_top_down)
+		: src_width(width), src_height(height)
+		, reverse_rows(((turn == QUARTER_TURN_CW) || (turn == QUARTER_TURN_TRANSVERSE)) != src_top_down)
+		, reverse_columns(((turn == QUARTER_TURN_CCW) || (turn == QUARTER_TURN_TRANSVERSE)) != dst_top_down) {
+	}
+
+	/// Source row of destination column x
+	unsigned SrcRow(unsigned x) const {
+		return reverse_rows ? src_height - 1 - x : x;
+	}
+
+	/// Source column of destination row y
+	unsigned SrcColumn(unsigned y) const {
+		return reverse_columns ? src_width - 1 - y : y;
+	}
+
+	/// Destination row of source column c
+	unsigned DstRow(unsigned c) const {
+		return reverse_columns ? src_width - 1 - c : c;
+	}
+};
+
+// ----------------------------------------------------------
+//   Tile kernels
+// ----------------------------------------------------------
+
+/// Portable tile kernel, PixelSize_ bytes per pixel
+template <unsigned PixelSize_>
+struct ScalarTile {
+	static constexpr unsigned kSize = (PixelSize_ <= 4) ? 16 : 4;
+
+	static void Run(uint8_t *const *dst_rows, const uint8_t *const *src_rows) {
+		for (unsigned j = 0; j < kSize; j++) {
+			uint8_t *dst = dst_rows[j];
+			for (unsigned k = 0; k < kSize; k++) {
+				memcpy(dst + k * PixelSize_, src_rows[k] + j * PixelSize_, PixelSize_);
+			}
+		}
+	}
+};
+
+/// In-register tile kernel, specialized for the pixel sizes with a vector transpose
+template <unsigned PixelSize_>
+struct SimdTile : ScalarTile<PixelSize_> {
+};
+
+#if defined(FI_SIMD_X86)
+
+/// 8x8 tile of 8-bit pixels
+template <>
+struct SimdTile<1> {
+	static constexpr unsigned kSize = 8;
+
+	FI_TARGET("sse2") static void Run(uint8_t *const *dst_rows, const uint8_t *const *src_rows) {
+		const __m128i b0 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)src_rows[0]), _mm_loadl_epi64((const __m128i *)src_rows[1]));
+		const __m128i b1 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)src_rows[2]), _mm_loadl_epi64((const __m128i *)src_rows[3]));
+		const __m128i b2 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)src_rows[4]), _mm_loadl_epi64((const __m128i *)src_rows[5]));
+		const __m128i b3 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)src_rows[6]), _mm_loadl_epi64((const __m128i *)src_rows[7]));
+
+		const __m128i c0 = _mm_unpacklo_epi16(b0, b1);
+		const __m128i c1 = _mm_unpackhi_epi16(b0, b1);
+		const __m128i c2 = _mm_unpacklo_epi16(b2, b3);
+		const __m128i c3 = _mm_unpackhi_epi16(b2, b3);
+
+		// each register holds two output rows
+		const __m128i d[4] = {
+			_mm_unpacklo_epi32(c0, c2),
+			_mm_unpackhi_epi32(c0, c2),
+			_mm_unpacklo_epi32(c1, c3),
+			_mm_unpackhi_epi32(c1, c3)
+		};
+		for (unsigned i = 0; i < 4; i++) {
+			_mm_storel_epi64((__m128i *)dst_rows[2 * i], d[i]);
+			_mm_storel_epi64((__m128i *)dst_rows[2 * i + 1], _mm_unpackhi_epi64(d[i], d[i]));
+		}
+	}
+};
+
+/// 8x8 tile of 16-bit pixels
+template <>
+struct SimdTile<2> {
+	static constexpr unsigned kSize = 8;
+
+	FI_TARGET("sse2") static void Run(uint8_t *const *dst_rows, const uint8_t *const *src_rows) {
+		__m128i a[8];
+		for (unsigned k = 0; k < 8; k++) {
+			a[k] = _mm_loadu_si128((const __m128i *)src_rows[k]);
+		}
+
+		const __m128i b0 = _mm_unpacklo_epi16(a[0], a[1]);
+		const __m128i b1 = _mm_unpackhi_epi16(a[0], a[1]);
+		const __m128i b2 = _mm_unpacklo_epi16(a[2], a[3]);
+		const __m128i b3 = _mm_unpackhi_epi16(a[2], a[3]);
+		const __m128i b4 = _mm_unpacklo_epi16(a[4], a[5]);
+		const __m128i b5 = _mm_unpackhi_epi16(a[4], a[5]);
+		const __m128i b6 = _mm_unpacklo_epi16(a[6], a[7]);
+		const __m128i b7 = _mm_unpackhi_epi16(a[6], a[7]);
+
+		const __m128i c0 = _mm_unpacklo_epi32(b0, b2);
+		const __m128i c1 = _mm_unpackhi_epi32(b0, b2);
+		const __m128i c2 = _mm_unpacklo_epi32(b1, b3);
+		const __m128i c3 = _mm_unpackhi_epi32(b1, b3);
+		const __m128i c4 = _mm_unpacklo_epi32(b4, b6);
+		const __m128i c5 = _mm_unpackhi_epi32(b4, b6);
+		const __m128i c6 = _mm_unpacklo_epi32(b5, b7);
+		const __m128i c7 = _mm_unpackhi_epi32(b5, b7);
+
+		_mm_storeu_si128((__m128i *)dst_rows[0], _mm_unpacklo_epi64(c0, c4));
+		_mm_storeu_si128((__m128i *)dst_rows[1], _mm_unpackhi_epi64(c0, c4));
+		_mm_storeu_si128((__m128i *)dst_rows[2], _mm_unpacklo_epi64(c1, c5));
+		_mm_storeu_si128((__m128i *)dst_rows[3], _mm_unpackhi_epi64(c1, c5));
+		_mm_storeu_si128((__m128i *)dst_rows[4], _mm_unpacklo_epi64(c2, c6));
+		_mm_storeu_si128((__m128i *)dst_rows[5], _mm_unpackhi_epi64(c2, c6));
+		_mm_storeu_si128((__m128i *)dst_rows[6], _mm_unpacklo_epi64(c3, c7));
+		_mm_storeu_si128((__m128i *)dst_rows[7], _mm_unpackhi_epi64(c3, c7));
+	}
+};
+
+/// 4x4 tile of 32-bit pixels
+template <>
+struct SimdTile<4> {
+	static constexpr unsigned kSize = 4;
+
+	FI_TARGET("sse2") static void Run(uint8_t *const *dst_rows, const uint8_t *const *src_rows) {
+		const __m128i a0 = _mm_loadu_si128((const __m128i *)src_rows[0]);
+		const __m128i a1 = _mm_loadu_si128((const __m128i *)src_rows[1]);
+		const __m128i a2 = _mm_loadu_si128((const __m128i *)src_rows[2]);
+		const __m128i a3 = _mm_loadu_si128((const __m128i *)src_rows[3]);
+
+		const __m128i b0 = _mm_unpacklo_epi32(a0, a1);
+		const __m128i b1 = _mm_unpackhi_epi32(a0, a1);
+		const __m128i b2 = _mm_unpacklo_epi32(a2, a3);
+		const __m128i b3 = _mm_unpackhi_epi32(a2, a3);
+
+		_mm_storeu_si128((__m128i *)dst_rows[0], _mm_unpacklo_epi64(b0, b2));
+		_mm_storeu_si128((__m128i *)dst_rows[1], _mm_unpackhi_epi64(b0, b2));
+		_mm_storeu_si128((__m128i *)dst_rows[2], _mm_unpacklo_epi64(b1, b3));
+		_mm_storeu_si128((__m128i *)dst_rows[3], _mm_unpackhi_epi64(b1, b3));
+	}
+};
+
+/// 2x2 tile of 64-bit pixels
+template <>
+struct SimdTile<8> {
+	static constexpr unsigned kSize = 2;
+
+	FI_TARGET("sse2") static void Run(uint8_t *const *dst_rows, const uint8_t *const *src_rows) {
+		const __m128i a0 = _mm_loadu_si128((const __m128i *)src_rows[0]);
+		const __m128i a1 = _mm_loadu_si128((const __m128i *)src_rows[1]);
+
+		_mm_storeu_si128((__m128i *)dst_rows[0], _mm_unpacklo_epi64(a0, a1));
+		_mm_storeu_si128((__m128i *)dst_rows[1], _mm_unpackhi_epi64(a0, a1));
+	}
+};
+
+#endif // FI_SIMD_X86
+
+// ----------------------------------------------------------
+//   Byte aligned pixels
+// ----------------------------------------------------------
+
+template <unsigned PixelSize_, typename Tile_>
+void TransposeBlocks(FIBITMAP *dst, FIBITMAP *src, const TurnMapping& map) {
+	constexpr unsigned N = Tile_::kSize;
+
+	const unsigned dst_width = FreeImage_GetWidth(dst);
+	const unsigned dst_height = FreeImage_GetHeight(dst);
+	const size_t src_pitch = FreeImage_GetPitch(src);
+	const size_t dst_pitch = FreeImage_GetPitch(dst);
+	const uint8_t *src_bits = FreeImage_GetBits(src);
+	uint8_t *dst_bits = FreeImage_GetBits(dst);
+
+	// copies dst pixels [x_begin, x_end) of scanline y one by one
+	auto copy_pixels = [&](unsigned y, unsigned x_begin, unsigned x_end) {
+		const uint8_t *src_column = src_bits + (size_t)map.SrcColumn(y) * PixelSize_;
+		uint8_t *dst_pixel = dst_bits + y * dst_pitch + (size_t)x_begin * PixelSize_;
+		for (unsigned x = x_begin; x < x_end; x++) {
+			memcpy(dst_pixel, src_column + map.SrcRow(x) * src_pitch, PixelSize_);
+			dst_pixel += PixelSize_;
+		}
+	};
+
+	const size_t bands = (dst_height + kBlockPixels - 1) / kBlockPixels;
+	const size_t grain = std::max<size_t>(1, kGrainPixels / ((size_t)kBlockPixels * dst_width));
+
+	ThreadPool::Instance().parallelFor(0, bands, grain, [&](size_t first, size_t last) {
+		const uint8_t *src_rows[N];
+		uint8_t *dst_rows[N];
+		uint8_t *dst_lines[N];
+
+		const unsigned y_end = (unsigned)std::min<size_t>(dst_height, last * kBlockPixels);
+
+		for (unsigned ys = (unsigned)(first * kBlockPixels); ys < y_end; ys += kBlockPixels) {
+			const unsigned ye = MIN(y_end, ys + kBlockPixels);
+
+			for (unsigned xs = 0; xs < dst_width; xs += kBlockPixels) {
+				const unsigned xe = MIN(dst_width, xs + kBlockPixels);
+
+				unsigned y = ys;
+				for (; y + N <= ye; y += N) {
+					// the source columns of the tile, in increasing order
+					const unsigned column = MIN(map.SrcColumn(y), map.SrcColumn(y + N - 1));
+					for (unsigned j = 0; j < N; j++) {
+						dst_lines[j] = dst_bits + map.DstRow(column + j) * dst_pitch;
+					}
+
+					unsigned x = xs;
+					for (; x + N <= xe; x += N) {
+						for (unsigned k = 0; k < N; k++) {
+							src_rows[k] = src_bits + map.SrcRow(x + k) * src_pitch + (size_t)column * PixelSize_;
+							dst_rows[k] = dst_lines[k] + (size_t)x * PixelSize_;
+						}
+						Tile_::Run(dst_rows, src_rows);
+					}
+					if (x < xe) {
+						for (unsigned j = 0; j < N; j++) {
+							copy_pixels(y + j, x, xe);
+						}
+					}
+				}
+				for (; y < ye; y++) {
+					copy_pixels(y, xs, xe);
+				}
+			}
+		}
+	});
+}
+
+template <unsigned PixelSize_>
+void TransposePixels(FIBITMAP *dst, FIBITMAP *src, const TurnMapping& map) {
+#if defined(FI_SIMD_X86)
+	if (FreeImage_GetActiveCPUFeatures() & FI_CPU_SSE2) {
+		TransposeBlocks<PixelSize_, SimdTile<PixelSize_>>(dst, src, map);
+		return;
+	}
+#endif
+	TransposeBlocks<PixelSize_, ScalarTile<PixelSize_>>(dst, src, map);
+}
+
+// ----------------------------------------------------------
+//   1- and 4-bit pixels
+// ----------------------------------------------------------
+
+/**
+Transposes an 8x8 bit matrix held in a 64-bit word, most significant byte first and
+most significant bit first: bit (7 - k) of output byte j is bit (7 - j) of input byte k.
+(H.S. Warren, Hacker's Delight, 7-3)
+*/
+inline uint64_t
+TransposeBits8x8(uint64_t x) {
+	uint64_t t;
+	t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+	x = x ^ t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+	x = x ^ t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+	x = x ^ t ^ (t << 28);
+	return x;
+}
+
+void TransposeBits(FIBITMAP *dst, FIBITMAP *src, const TurnMapping& map) {
+	const unsigned dst_width = FreeImage_GetWidth(dst);
+	const size_t src_pitch = FreeImage_GetPitch(src);
+	const size_t dst_pitch = FreeImage_GetPitch(dst);
+	const uint8_t *src_bits = FreeImage_GetBits(src);
+	uint8_t *dst_bits = FreeImage_GetBits(dst);
+
+	// each source byte column gives 8 destination scanlines
+	const unsigned src_bytes = (map.src_width + 7) / 8;
+	const unsigned dst_bytes = (dst_width + 7) / 8;
+	const size_t grain = std::max<size_t>(1, kGrainPixels / (8 * (size_t)dst_width));
+
+	ThreadPool::Instance().parallelFor(0, src_bytes, grain, [&](size_t first, size_t last) {
+		for (unsigned is = 0; is < dst_bytes; is += kBlockPixels) {
+			const unsigned ie = MIN(dst_bytes, is + kBlockPixels);
+
+			for (size_t b = first; b < last; b++) {
+				for (unsigned i = is; i < ie; i++) {
+					// gather the 8 source scanlines of destination byte i, padding pixels are cleared
+					uint64_t x = 0;
+					for (unsigned k = 0; k < 8; k++) {
+						const unsigned column = 8 * i + k;
+						x = (x << 8) | ((column < dst_width) ? src_bits[map.SrcRow(column) * src_pitch + b] : 0);
+					}
+					x = TransposeBits8x8(x);
+
+					for (unsigned j = 0; j < 8; j++) {
+						const unsigned c = (unsigned)(8 * b + j);
+						if (c < map.src_width) {
+							dst_bits[map.DstRow(c) * dst_pitch + i] = (uint8_t)(x >> (56 - 8 * j));
+						}
+					}
+				}
+			}
+		}
+	});
+}
+
+void TransposeNibbles(FIBITMAP *dst, FIBITMAP *src, const TurnMapping& map) {
+	const unsigned dst_width = FreeImage_GetWidth(dst);
+	const unsigned dst_height = FreeImage_GetHeight(dst);
+	const size_t src_pitch = FreeImage_GetPitch(src);
+	const size_t dst_pitch = FreeImage_GetPitch(dst);
+	const uint8_t *src_bits = FreeImage_GetBits(src);
+	uint8_t *dst_bits = FreeImage_GetBits(dst);
+
+	const size_t grain = std::max<size_t>(1, kGrainPixels / dst_width);
+
+	ThreadPool::Instance().parallelFor(0, dst_height, grain, [&](size_t first, size_t last) {
+		for (size_t y = first; y < last; y++) {
+			const unsigned column = map.SrcColumn((unsigned)y);
+			const uint8_t *src_column = src_bits + column / 2;
+			const unsigned shift = (column & 1) ? 0 : 4;
+			uint8_t *dst_line = dst_bits + y * dst_pitch;
+
+			for (unsigned x = 0; x < dst_width; x += 2) {
+				uint8_t value = (uint8_t)(((src_column[map.SrcRow(x) * src_pitch] >> shift) & 0x0F) << 4);
+				if (x + 1 < dst_width) {
+					value |= (src_column[map.SrcRow(x + 1) * src_pitch] >> shift) & 0x0F;
+				}
+				dst_line[x / 2] = value;
+			}
+		}
+	});
+}
+
+/**
+Reverses the order of the 64 bits of x. Since the bytes are reversed as well, this
+mirrors 64 pixels of a 1-bit scanline loaded with memcpy, whatever the byte order.
+*/
+inline uint64_t
+ReverseBits64(uint64_t x) {
+	x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+	x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+	x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	x = ((x >> 8) & 0x00FF00FF00FF00FFULL) | ((x & 0x00FF00FF00FF00FFULL) << 8);
+	x = ((x >> 16) & 0x0000FFFF0000FFFFULL) | ((x & 0x0000FFFF0000FFFFULL) << 16);
+	return (x >> 32) | (x << 32);
+}
+
+} // namespace
+
+// ==========================================================
+
+FIBOOL
+RotateQuarterTurn(FIBITMAP *dst, FIBITMAP *src, QuarterTurn turn) {
+	if (!FreeImage_HasPixels(src) || !FreeImage_HasPixels(dst)) {
+		return FALSE;
+	}
+
+	const unsigned bpp = FreeImage_GetBPP(src);
+	const unsigned src_width = FreeImage_GetWidth(src);
+	const unsigned src_height = FreeImage_GetHeight(src);
+
+	if ((FreeImage_GetImageType(dst) != FreeImage_GetImageType(src)) || (FreeImage_GetBPP(dst) != bpp) ||
+		(FreeImage_GetWidth(dst) != src_height) || (FreeImage_GetHeight(dst) != src_width)) {
+		return FALSE;
+	}
+
+	const TurnMapping map(turn, src_width, src_height, FreeImage_IsTopDown(src) != FALSE, FreeImage_IsTopDown(dst) != FALSE);
+
+	switch (bpp) {
+		case 1:
+			TransposeBits(dst, src, map);
+			break;
+		case 4:
+			TransposeNibbles(dst, src, map);
+			break;
+		case 8:
+			TransposePixels<1>(dst, src, map);
+			break;
+		case 16:
+			TransposePixels<2>(dst, src, map);
+			break;
+		case 24:
+			TransposePixels<3>(dst, src, map);
+			break;
+		case 32:
+			TransposePixels<4>(dst, src, map);
+			break;
+		case 48:
+			TransposePixels<6>(dst, src, map);
+			break;
+		case 64:
+			TransposePixels<8>(dst, src, map);
+			break;
+		case 96:
+			TransposePixels<12>(dst, src, map);
+			break;
+		case 128:
+			TransposePixels<16>(dst, src, map);
+			break;
+		default:
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+void
+MirrorBits(uint8_t *dst, const uint8_t *src, unsigned width) {
+	const unsigned line = (width + 7) / 8;
+	const unsigned pad = 8 * line - width;
+
+	// reverse the whole line, 64 pixels at a time
+	unsigned j = 0;
+	for (; j + 8 <= line; j += 8) {
+		uint64_t x;
+		memcpy(&x, src + line - j - 8, sizeof(x));
+		x = ReverseBits64(x);
+		memcpy(dst + j, &x, sizeof(x));
+	}
+	for (; j < line; j++) {
+		dst[j] = (uint8_t)(ReverseBits64(src[line - 1 - j]) >> 56);
+	}
+
+	// the padding bits of the last source byte came first: shift them out
+	if (pad) {
+		for (unsigned i = 0; i + 1 < line; i++) {
+			dst[i] = (uint8_t)((dst[i] << pad) | (dst[i + 1] >> (8 - pad)));
+		}
+		dst[line - 1] = (uint8_t)(dst[line - 1] << pad);
+	}
+}
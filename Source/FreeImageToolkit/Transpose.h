@@ -0,0 +1,47 @@
+// ==========================================================
+// Quarter turn rotation by tiled transposes
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef FREEIMAGE_TRANSPOSE_H
+#define FREEIMAGE_TRANSPOSE_H
+
+#include "FreeImage.h"
+
+/// Direction of a quarter turn, in scanline coordinates (scanline 0 is the bottom line)
+enum QuarterTurn {
+	QUARTER_TURN_CCW,		//! dst(x, y) = src(y', x) with y' = src_width - 1 - y
+	QUARTER_TURN_CW,		//! dst(x, y) = src(y, x') with x' = src_height - 1 - x
+	QUARTER_TURN_TRANSPOSE,	//! dst(x, y) = src(y, x)
+	QUARTER_TURN_TRANSVERSE	//! dst(x, y) = src(y', x') with both axes reversed
+};
+
+/**
+Rotates src by a quarter turn into dst, or mirrors it along one of its diagonals.
+dst must have the type and bit depth of src, with width and height swapped.
+Every image type is handled, as well as 1-, 4- and 16-bit FIT_BITMAP images.
+The palette, transparency and metadata are left to the caller.
+@return Returns TRUE if successful, FALSE if the layouts do not match
+*/
+FIBOOL RotateQuarterTurn(FIBITMAP *dst, FIBITMAP *src, QuarterTurn turn);
+
+/**
+Mirrors a scanline of 'width' 1-bit pixels, 64 pixels at a time.
+src and dst must not overlap, the padding bits of the last byte of dst are cleared.
+*/
+void MirrorBits(uint8_t *dst, const uint8_t *src, unsigned width);
+
+#endif // FREEIMAGE_TRANSPOSE_H
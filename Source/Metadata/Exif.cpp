@@ -887,6 +887,54 @@ jpeg_read_exif_profile(FIBITMAP *dib, const uint8_t *data, unsigned length, bool
 // Exif JPEG helper routines
 // ==========================================================
 
+/**
+Read the Orientation tag of a JPEG_APP1 marker (Exif profile), without decoding the other tags
+@param data Pointer to the APP1 marker
+@param length APP1 marker length
+@param orientation Returned Orientation tag value
+@return Returns TRUE if the 0th IFD has an Orientation tag, FALSE otherwise
+*/
+FIBOOL
+jpeg_read_exif_orientation(const uint8_t *data, unsigned length, uint16_t *orientation) {
+    // marker identifying string for Exif = "Exif\0\0"
+    uint8_t exif_signature[6] = { 0x45, 0x78, 0x69, 0x66, 0x00, 0x00 };
+	uint8_t lsb_first[4] = { 0x49, 0x49, 0x2A, 0x00 };		// Classic TIFF signature - little-endian order
+	uint8_t msb_first[4] = { 0x4D, 0x4D, 0x00, 0x2A };		// Classic TIFF signature - big-endian order
+
+	if ((length < sizeof(exif_signature) + 8) || (memcmp(exif_signature, data, sizeof(exif_signature)) != 0)) {
+		return FALSE;
+	}
+	const uint8_t *tiffp = data + sizeof(exif_signature);
+	const uint32_t dwLength = length - sizeof(exif_signature);
+
+	FIBOOL bBigEndian;
+	if (memcmp(tiffp, lsb_first, sizeof(lsb_first)) == 0) {
+		bBigEndian = FALSE;
+	} else if (memcmp(tiffp, msb_first, sizeof(msb_first)) == 0) {
+		bBigEndian = TRUE;
+	} else {
+		return FALSE;
+	}
+
+	// walk the entries of the 0th IFD
+	const uint32_t dwOffsetIfd0 = ReadUint32(bBigEndian, tiffp + 4);
+	if ((dwOffsetIfd0 > dwLength) || (dwLength - dwOffsetIfd0 < 2)) {
+		return FALSE;
+	}
+	const uint16_t nde = ReadUint16(bBigEndian, tiffp + dwOffsetIfd0);
+	const uint8_t *entry = tiffp + dwOffsetIfd0 + 2;
+	const unsigned entries = MIN((unsigned)nde, (dwLength - dwOffsetIfd0 - 2) / 12);
+
+	for (unsigned i = 0; i < entries; i++, entry += 12) {
+		if ((ReadUint16(bBigEndian, entry) == TAG_ORIENTATION) && (ReadUint16(bBigEndian, entry + 2) == FIDT_SHORT)) {
+			*orientation = ReadUint16(bBigEndian, entry + 8);
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
 /**
 Read JPEG_APP1 marker (Exif profile)
 @param dib Input FIBITMAP
@@ -479,6 +479,7 @@ extern "C" {
 // --------------------------------------------------------------------------
 FIBOOL jpeg_read_exif_profile(FIBITMAP *dib, const uint8_t *dataptr, unsigned datalen, bool optional_signature = false);
 FIBOOL jpeg_read_exif_profile_raw(FIBITMAP *dib, const uint8_t *profile, unsigned length, bool optional_signature = false);
+FIBOOL jpeg_read_exif_orientation(const uint8_t *data, unsigned length, uint16_t *orientation);
 FIBOOL jpegxr_read_exif_profile(FIBITMAP *dib, const uint8_t *profile, unsigned length, unsigned file_offset);
 FIBOOL jpegxr_read_exif_gps_profile(FIBITMAP *dib, const uint8_t *profile, unsigned length, unsigned file_offset);
 
@@ -1462,7 +1462,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			}
 #endif
 		} 
-		else if (FreeImage_GetPitch(dib) == dst_pitch) {
+		else if ((FreeImage_GetPitch(dib) == dst_pitch) && !FreeImage_IsTopDown(dib)) {
 			return (io->write_proc(FreeImage_GetBits(dib), dst_height * dst_pitch, 1, handle) != 1) ? FALSE : TRUE;
 		}
 		else {
@@ -302,6 +302,19 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 			THROW (Iex::InputExc, "Unsupported color model: " << exr_color_model);
 		}
 
+		// decode RGB images straight into FIT_RGBAF when FreeImage_LoadAs* requests it,
+		// the missing alpha channel is filled by the frame buffer
+
+		bool bFillAlpha = false;
+		{
+			FREE_IMAGE_TYPE target_type = FIT_UNKNOWN;
+			unsigned target_bpp = 0;
+			if ((image_type == FIT_RGBF) && !bUseRgbaInterface && FreeImage_GetLoadTarget(&target_type, &target_bpp) && (target_type == FIT_RGBAF)) {
+				image_type = FIT_RGBAF;
+				bFillAlpha = true;
+			}
+		}
+
 		// allocate a new dib
 		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_AllocateHeaderT(header_only, image_type, width, height, 0), &FreeImage_Unload);
 		if (!dib) THROW (Iex::NullExc, FI_MSG_ERROR_MEMORY);
@@ -347,7 +360,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		// --------------------------------------------------------------
 
 		uint8_t *bits = FreeImage_GetBits(dib.get());			// pointer to our pixel buffer
-		const size_t bytespp = sizeof(float) * components;	// size of our pixel in bytes
+		const size_t bytespp = sizeof(float) * (bFillAlpha ? 4 : components);	// size of our pixel in bytes
 		const unsigned pitch = FreeImage_GetPitch(dib.get());		// size of our yStride in bytes
 
 		Imf::PixelType pixelType = Imf::FLOAT;	// load as float data type;
@@ -418,11 +431,33 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 						1, 1,								// x/y sampling
 						0.0));								// fillValue
 				}
+				if (bFillAlpha) {
+					frameBuffer.insert (
+						"A",								// name
+						Imf::Slice (pixelType,				// type
+						(char*)(bits + 3 * sizeof(float) + offset), // base
+						bytespp,							// xStride
+						pitch,								// yStride
+						1, 1,								// x/y sampling
+						1.0));								// fillValue
+				}
 			}
 
 			// read the file
 			file.setFrameBuffer(frameBuffer);
 			file.readPixels(dataWindow.min.y, dataWindow.max.y);
+
+			if (bFillAlpha) {
+				// same pixels as FreeImage_ConvertToRGBAF
+				for (int y = 0; y < height; y++) {
+					FIRGBAF *pixel = (FIRGBAF*)(bits + y * pitch);
+					for (int x = 0; x < width; x++) {
+						pixel[x].red   = CLAMP(pixel[x].red, 0.0F, 1.0F);
+						pixel[x].green = CLAMP(pixel[x].green, 0.0F, 1.0F);
+						pixel[x].blue  = CLAMP(pixel[x].blue, 0.0F, 1.0F);
+					}
+				}
+			}
 		}
 
 		// lastly, flip dib lines
@@ -678,8 +713,8 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			bytespp = sizeof(half) * components;
 			pitch = width * sizeof(half) * components;
 		} else if (pixelType == Imf::FLOAT) {
-			// invert dib scanlines
-			bIsFlipped = FreeImage_FlipVertical(dib);
+			// invert dib scanlines, unless they are already stored top-down
+			bIsFlipped = FreeImage_IsTopDown(dib) ? FALSE : FreeImage_FlipVertical(dib);
 		
 			bits = FreeImage_GetBits(dib);
 			bytespc = sizeof(float);
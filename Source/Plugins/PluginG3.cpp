@@ -25,6 +25,10 @@
 #include "FreeImage.h"
 #include "Utilities.h"
 
+#include <cstring>
+#include <new>
+#include <vector>
+
 // ==========================================================
 // Plugin Interface
 // ==========================================================
@@ -99,8 +103,14 @@ G3ReadFile(FreeImageIO *io, fi_handle handle, uint8_t *tif_rawdata, tmsize_t tif
 // Internal functions
 // ==========================================================
 
+/**
+Decodes the raw fax data into packed 1-bit rows, stored top to bottom in 'lines'.
+The decoder fills the runs of a row with whole bytes and words, directly at the end of 'lines';
+bad rows are replaced by the previous good row, stretched rows are stored twice.
+@return Returns the number of rows, -1 on error
+*/
 static int 
-copyFaxFile(FreeImageIO *io, fi_handle handle, TIFF* tifin, uint32_t xsize, int stretch, FIMEMORY *memory) {
+copyFaxFile(FreeImageIO *io, fi_handle handle, TIFF* tifin, uint32_t xsize, int stretch, std::vector<uint8_t>& lines) {
 	uint32_t row;
 	uint16_t badrun;
 	uint16_t	badfaxrun;
@@ -109,14 +119,7 @@ copyFaxFile(FreeImageIO *io, fi_handle handle, TIFF* tifin, uint32_t xsize, int
 
 	try {
 
-		const uint32_t linesize = TIFFhowmany8(xsize);
-		std::unique_ptr<void, decltype(&_TIFFfree)> safeRowbuf(_TIFFmalloc(linesize), &_TIFFfree);
-		std::unique_ptr<void, decltype(&_TIFFfree)> safeRefbuf(_TIFFmalloc(linesize), &_TIFFfree);
-		if (!safeRowbuf || !safeRefbuf) {
-			throw FI_MSG_ERROR_MEMORY;
-		}
-		auto *rowbuf = static_cast<uint8_t*>(safeRowbuf.get());
-		auto *refbuf = static_cast<uint8_t*>(safeRefbuf.get());
+		const size_t linesize = TIFFhowmany8(xsize);
 
 		tifin->tif_rawdatasize = G3GetFileSize(io, handle);
 		tifin->tif_rawdata = (tidata_t) _TIFFmalloc(tifin->tif_rawdatasize);
@@ -137,28 +140,37 @@ copyFaxFile(FreeImageIO *io, fi_handle handle, TIFF* tifin, uint32_t xsize, int
 		badfaxlines = 0;
 		badfaxrun = 0;
 
-		_TIFFmemset(refbuf, 0, linesize);
+		lines.clear();
+
+		size_t ref = SIZE_MAX;	// offset of the previous good line
 		row = 0;
 		badrun = 0;		// current run of bad lines 
 		while (tifin->tif_rawcc > 0) {
-			ok = (*tifin->tif_decoderow)(tifin, rowbuf, linesize, 0);
-			if (!ok) {
+			const size_t offset = lines.size();
+			lines.resize(offset + linesize);
+			ok = (*tifin->tif_decoderow)(tifin, lines.data() + offset, (tmsize_t)linesize, 0);
+			if (ok <= 0) {
+				// the fax decoders return -1, not 0, on a bad row
 				badfaxlines++;
 				badrun++;
 				// regenerate line from previous good line 
-				_TIFFmemcpy(rowbuf, refbuf, linesize);
+				if (ref != SIZE_MAX) {
+					memcpy(lines.data() + offset, lines.data() + ref, linesize);
+				} else {
+					memset(lines.data() + offset, 0, linesize);
+				}
 			} else {
 				if (badrun > badfaxrun)
 					badfaxrun = badrun;
 				badrun = 0;
-				_TIFFmemcpy(refbuf, rowbuf, linesize);
+				ref = offset;
 			}
 			tifin->tif_row++;
-
-			FreeImage_WriteMemory(rowbuf, linesize, 1, memory);
 			row++;
+
 			if (stretch) {
-				FreeImage_WriteMemory(rowbuf, linesize, 1, memory);
+				lines.resize(offset + 2 * linesize);
+				memcpy(lines.data() + offset + linesize, lines.data() + offset, linesize);
 				row++;
 			}
 		}
@@ -180,6 +192,11 @@ copyFaxFile(FreeImageIO *io, fi_handle handle, TIFF* tifin, uint32_t xsize, int
 		tifin->tif_rawdata = nullptr;
 		FreeImage_OutputMessageProc(s_format_id, message);
 
+		return -1;
+	} catch(const std::bad_alloc&) {
+		tifin->tif_rawdata = nullptr;
+		FreeImage_OutputMessageProc(s_format_id, FI_MSG_ERROR_MEMORY);
+
 		return -1;
 	}
 
@@ -305,11 +322,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		}
 		*/
 
-		// open a temporary memory buffer to save decoded scanlines
-		FIMEMORY *memory = FreeImage_OpenMemory();
-		if (!memory) throw FI_MSG_ERROR_MEMORY;
-		std::unique_ptr<FIMEMORY, decltype(&FreeImage_CloseMemory)> safeMemory(memory, &FreeImage_CloseMemory);
-
 		// wrap the raw fax file
 		TIFF *faxTIFF = TIFFClientOpen("(FakeInput)", "w",
 			// TIFFClientOpen() fails if we don't set existing value here 
@@ -349,11 +361,13 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		}
 
 		// decode the raw fax data
-		rows = copyFaxFile(io, handle, faxTIFF, xsize, stretch, memory);
+		std::vector<uint8_t> lines;
+		rows = copyFaxFile(io, handle, faxTIFF, xsize, stretch, lines);
 		if (rows <= 0) throw "Error when decoding raw fax file : check the decoder options";
 
 		// allocate the output dib
 		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(FreeImage_Allocate(xsize, rows, 1), &FreeImage_Unload);
+		if (!dib) throw FI_MSG_ERROR_DIB_MEMORY;
 		const uint32_t linesize = TIFFhowmany8(xsize);
 
 		// fill the bitmap structure ...
@@ -370,11 +384,10 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 		FreeImage_SetDotsPerMeterX(dib.get(), (unsigned)(resX/0.0254000 + 0.5));
 		FreeImage_SetDotsPerMeterY(dib.get(), (unsigned)(resY/0.0254000 + 0.5));
 
-		// read the decoded scanline and fill the bitmap data
-		FreeImage_SeekMemory(memory, 0, SEEK_SET);
+		// copy the decoded scanlines into the bitmap data
 		for (int k = 0; k < rows; k++) {
 			uint8_t *bits = FreeImage_GetScanLine(dib.get(), rows - 1 - k);
-			FreeImage_ReadMemory(bits, linesize, 1, memory);
+			memcpy(bits, lines.data() + (size_t)k * linesize, linesize);
 		}
 
 		return dib.release();
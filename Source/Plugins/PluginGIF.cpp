@@ -31,6 +31,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
+#include "../FreeImage/Plugin.h"
 #include "../Metadata/FreeImageTag.h"
 
 // ==========================================================
@@ -1373,6 +1375,46 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	return TRUE;
 }
 
+// ----------------------------------------------------------
+//   Page codec
+// ----------------------------------------------------------
+
+static FIBOOL
+EncodePage(FIBITMAP *dib, int page, int flags, FIMEMORY *stream) {
+	// pages do not depend on each other, the first one only adds the screen descriptor
+	FreeImageIO io;
+	SetMemoryIO(&io);
+	GIFinfo info;
+	return Save(&io, dib, (fi_handle)stream, page, flags, &info);
+}
+
+static void *
+BeginPages(FreeImageIO *io, fi_handle handle, int /*page_count*/, int /*flags*/) {
+	return Open(io, handle, FALSE);
+}
+
+static FIBOOL
+AppendPage(FreeImageIO *io, fi_handle handle, FIMEMORY *stream, void * /*state*/) {
+	uint8_t *data{};
+	uint32_t size{};
+	if (!FreeImage_AcquireMemory(stream, &data, &size)) {
+		return FALSE;
+	}
+	return (size == 0 || io->write_proc(data, size, 1, handle) == 1) ? TRUE : FALSE;
+}
+
+static FIBOOL
+EndPages(FreeImageIO *io, fi_handle handle, FIBOOL success, void *state) {
+	Close(io, handle, state);
+	return success;
+}
+
+const PluginPageCodec*
+GetPageCodecGIF() {
+	static const PluginPageCodec codec = { true, EncodePage, BeginPages, AppendPage, EndPages };
+	return &codec;
+}
+
 // ==========================================================
 //   Init
 // ==========================================================
@@ -467,9 +467,8 @@ public:
                 throw std::runtime_error("PluginHeif[Save]: Error in heif_image_get_plane().");
             }
 
-            const uint8_t* imgData = yato::pointer_cast<const uint8_t*>(FreeImage_GetBits(dib));
-            const auto imgStride = FreeImage_GetPitch(dib);
-            imgData += (imgHeight - 1) * imgStride;
+            const uint8_t* imgData = yato::pointer_cast<const uint8_t*>(FreeImage_GetScanLine(dib, imgHeight - 1));
+            const auto imgStride = FreeImage_GetScanLineStride(dib);
             for (int y = 0; y < imgHeight; ++y) {
                 std::memcpy(heifData, imgData, imgWidth * bpp / 8);
                 imgData  -= imgStride;
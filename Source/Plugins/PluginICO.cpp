@@ -22,6 +22,8 @@
 
 #include "FreeImage.h"
 #include "Utilities.h"
+#include "FreeImageIO.h"
+#include "../FreeImage/Plugin.h"
 
 // ----------------------------------------------------------
 //   Constants + headers
@@ -529,8 +531,15 @@ SaveStandardIcon(FreeImageIO *io, FIBITMAP *dib, fi_handle handle) {
 #if defined(FREEIMAGE_BIGENDIAN) || FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB
 	{
 #endif
-		uint8_t *xor_mask = FreeImage_GetBits(dib);
-		io->write_proc(xor_mask, size_xor, 1, handle);
+		if (FreeImage_IsTopDown(dib)) {
+			// the XOR mask is stored bottom-up
+			for (int y = 0; y < height; y++) {
+				io->write_proc(FreeImage_GetScanLine(dib, y), pitch, 1, handle);
+			}
+		} else {
+			uint8_t *xor_mask = FreeImage_GetBits(dib);
+			io->write_proc(xor_mask, size_xor, 1, handle);
+		}
 #if defined(FREEIMAGE_BIGENDIAN) || FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB
 	}
 #endif
@@ -642,6 +651,39 @@ SaveStandardIcon(FreeImageIO *io, FIBITMAP *dib, fi_handle handle) {
 	return TRUE;
 }
 
+/**
+Fills the size and format members of the ICONDIRENTRY describing dib.
+Takes into account Vista icons whose size is 256x256.
+*/
+static void
+FillIconDirEntry(ICONDIRENTRY *entry, FIBITMAP *dib) {
+	const auto *bmih = FreeImage_GetInfoHeader(dib);
+	entry->bWidth		= (bmih->biWidth > 255)  ? 0 : (uint8_t)bmih->biWidth;
+	entry->bHeight		= (bmih->biHeight > 255) ? 0 : (uint8_t)bmih->biHeight;
+	entry->bReserved	= 0;
+	entry->wPlanes		= bmih->biPlanes;
+	entry->wBitCount	= bmih->biBitCount;
+	if ( (entry->wPlanes * entry->wBitCount) >= 8 ) {
+		entry->bColorCount = 0;
+	} else {
+		entry->bColorCount = (uint8_t)(1 << (entry->wPlanes * entry->wBitCount));
+	}
+}
+
+/**
+Writes the image bits of an icon described by entry: a PNG stream for Vista icons, a standard icon otherwise.
+*/
+static FIBOOL
+SaveIconImage(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, const ICONDIRENTRY& entry) {
+	if ((entry.bWidth == 0) && (entry.bHeight == 0)) {
+		// Vista icon support
+		return FreeImage_SaveToHandle(FIF_PNG, dib, io, handle, PNG_DEFAULT);
+	}
+	// standard icon support
+	// see http://msdn.microsoft.com/en-us/library/ms997538.aspx
+	return SaveStandardIcon(io, dib, handle);
+}
+
 static FIBOOL DLL_CALLCONV
 Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void *data) {
 	ICONHEADER *icon_header{};
@@ -709,18 +751,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 			icon_dib = vPages[k].get();
 
 			// convert internal format to ICONDIRENTRY
-			// take into account Vista icons whose size is 256x256
-			const auto *bmih = FreeImage_GetInfoHeader(icon_dib);
-			icon_list[k].bWidth			= (bmih->biWidth > 255)  ? 0 : (uint8_t)bmih->biWidth;
-			icon_list[k].bHeight		= (bmih->biHeight > 255) ? 0 : (uint8_t)bmih->biHeight;
-			icon_list[k].bReserved		= 0;
-			icon_list[k].wPlanes		= bmih->biPlanes;
-			icon_list[k].wBitCount		= bmih->biBitCount;
-			if ( (icon_list[k].wPlanes * icon_list[k].wBitCount) >= 8 ) {
-				icon_list[k].bColorCount = 0;
-			} else {
-				icon_list[k].bColorCount = (uint8_t)(1 << (icon_list[k].wPlanes * icon_list[k].wBitCount));
-			}
+			FillIconDirEntry(&icon_list[k], icon_dib);
 			// initial guess (correct only for standard icons)
 			icon_list[k].dwBytesInRes	= CalculateImageSize(icon_dib);
 			icon_list[k].dwImageOffset = CalculateImageOffset(vPages, k);
@@ -737,15 +768,7 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		for (k = 0; k < icon_header->idCount; k++) {
 			icon_dib = vPages[k].get();
 			
-			if ((icon_list[k].bWidth == 0) && (icon_list[k].bHeight == 0)) {
-				// Vista icon support
-				FreeImage_SaveToHandle(FIF_PNG, icon_dib, io, handle, PNG_DEFAULT);
-			}
-			else {
-				// standard icon support
-				// see http://msdn.microsoft.com/en-us/library/ms997538.aspx
-				SaveStandardIcon(io, icon_dib, handle);
-			}
+			SaveIconImage(io, icon_dib, handle, icon_list[k]);
 
 			// update ICONDIRENTRY members			
 			uint32_t dwBytesInRes = (uint32_t)io->tell_proc(handle) - dwImageOffset;
@@ -771,6 +794,131 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	}
 }
 
+// ----------------------------------------------------------
+//   Page codec
+// ----------------------------------------------------------
+
+/** Directory of the icons appended by AppendPage */
+struct ICONWRITER {
+	long start;                         // position of the ICONHEADER
+	long directory_start;               // position of the first ICONDIRENTRY
+	std::vector<ICONDIRENTRY> entries;  // entries of the icons written so far
+	uint16_t count;                     // number of reserved entries
+};
+
+/**
+Encodes an icon as its ICONDIRENTRY followed by the image bits.
+The entry gets its final offset when the icon is appended.
+*/
+static FIBOOL
+EncodePage(FIBITMAP *dib, int /*page*/, int /*flags*/, FIMEMORY *stream) {
+	if (!dib) {
+		return FALSE;
+	}
+
+	// check format limits
+	unsigned w = FreeImage_GetWidth(dib);
+	unsigned h = FreeImage_GetHeight(dib);
+	if ((w < 16) || (w > 256) || (h < 16) || (h > 256) || (w != h)) {
+		FreeImage_OutputMessageProc(s_format_id, "Unsupported icon size: width x height = %d x %d", w, h);
+		return FALSE;
+	}
+
+	// convert internal format to ICONDIRENTRY
+	ICONDIRENTRY entry{};
+	FillIconDirEntry(&entry, dib);
+
+	FreeImageIO io;
+	SetMemoryIO(&io);
+	auto handle = (fi_handle)stream;
+	io.write_proc(&entry, sizeof(ICONDIRENTRY), 1, handle);
+
+	const FIBOOL bSuccess = SaveIconImage(&io, dib, handle, entry);
+
+	entry.dwBytesInRes = (uint32_t)io.tell_proc(handle) - sizeof(ICONDIRENTRY);
+	io.seek_proc(handle, 0, SEEK_SET);
+	io.write_proc(&entry, sizeof(ICONDIRENTRY), 1, handle);
+
+	return bSuccess;
+}
+
+static void *
+BeginPages(FreeImageIO *io, fi_handle handle, int page_count, int /*flags*/) {
+	if ((page_count < 0) || (page_count > 0xFFFF)) {
+		return nullptr;
+	}
+
+	auto *writer = new(std::nothrow) ICONWRITER;
+	if (!writer) {
+		return nullptr;
+	}
+	writer->count = (uint16_t)page_count;
+	writer->entries.reserve(writer->count);
+
+	// write the header
+	ICONHEADER icon_header = { 0, 1, writer->count };
+	writer->start = io->tell_proc(handle);
+#ifdef FREEIMAGE_BIGENDIAN
+	SwapIconHeader(&icon_header);
+#endif
+	io->write_proc(&icon_header, sizeof(ICONHEADER), 1, handle);
+
+	// make a room for icon dir entries, until the icons are written
+	writer->directory_start = io->tell_proc(handle);
+	const ICONDIRENTRY empty{};
+	for (unsigned k = 0; k < writer->count; k++) {
+		io->write_proc((void *)&empty, sizeof(ICONDIRENTRY), 1, handle);
+	}
+
+	return writer;
+}
+
+static FIBOOL
+AppendPage(FreeImageIO *io, fi_handle handle, FIMEMORY *stream, void *state) {
+	auto *writer = (ICONWRITER *)state;
+
+	uint8_t *data{};
+	uint32_t size{};
+	if (!FreeImage_AcquireMemory(stream, &data, &size) || (size < sizeof(ICONDIRENTRY)) || (writer->entries.size() >= writer->count)) {
+		return FALSE;
+	}
+
+	ICONDIRENTRY entry;
+	memcpy(&entry, data, sizeof(ICONDIRENTRY));
+	entry.dwImageOffset = (uint32_t)(io->tell_proc(handle) - writer->start);
+	writer->entries.push_back(entry);
+
+	const uint32_t image_size = size - sizeof(ICONDIRENTRY);
+	return (image_size == 0 || io->write_proc(data + sizeof(ICONDIRENTRY), image_size, 1, handle) == 1) ? TRUE : FALSE;
+}
+
+static FIBOOL
+EndPages(FreeImageIO *io, fi_handle handle, FIBOOL success, void *state) {
+	std::unique_ptr<ICONWRITER> writer((ICONWRITER *)state);
+	if (!success || (writer->entries.size() != writer->count)) {
+		return FALSE;
+	}
+
+	// update the icon descriptions
+	if (writer->count > 0) {
+		const long current_pos = io->tell_proc(handle);
+		io->seek_proc(handle, writer->directory_start, SEEK_SET);
+#ifdef FREEIMAGE_BIGENDIAN
+		SwapIconDirEntries(writer->entries.data(), writer->count);
+#endif
+		io->write_proc(writer->entries.data(), sizeof(ICONDIRENTRY) * writer->count, 1, handle);
+		io->seek_proc(handle, current_pos, SEEK_SET);
+	}
+
+	return TRUE;
+}
+
+const PluginPageCodec*
+GetPageCodecICO() {
+	static const PluginPageCodec codec = { true, EncodePage, BeginPages, AppendPage, EndPages };
+	return &codec;
+}
+
 // ==========================================================
 //   Init
 // ==========================================================
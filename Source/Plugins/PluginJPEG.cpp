@@ -46,6 +46,7 @@ extern "C" {
 #include "Utilities.h"
 
 #include "../Metadata/FreeImageTag.h"
+#include "../FreeImageToolkit/Transpose.h"
 
 
 // ==========================================================
@@ -1074,6 +1075,154 @@ store_size_info(FIBITMAP *dib, JDIMENSION width, JDIMENSION height) {
 	}
 }
 
+// ------------------------------------------------------------
+//   Exif orientation applied while decoding
+// ------------------------------------------------------------
+
+/**
+Read the Exif orientation of the JPEG stream.
+As with read_markers, a later Exif marker overrides an earlier one.
+@return Returns the Orientation tag value, or 1 ("top, left side") when none is found
+*/
+static uint16_t
+read_exif_orientation(j_decompress_ptr cinfo) {
+	uint16_t orientation = 1;
+
+	for (jpeg_saved_marker_ptr marker = cinfo->marker_list; marker; marker = marker->next) {
+		if (marker->marker == EXIF_MARKER) {
+			uint16_t value = 0;
+			if (jpeg_read_exif_orientation(marker->data, marker->data_length, &value)) {
+				orientation = value;
+			}
+		}
+	}
+
+	return orientation;
+}
+
+/**
+Places the decoded scanlines of a JPEG image in a bitmap already oriented by its Exif
+orientation, so that the result is the one of RotateExif applied to the decoded image.
+Flips are done while writing each scanline, quarter turns and transposes decode strips
+of scanlines that are then transposed into their column band of the bitmap.
+*/
+class ExifOrientedRows {
+public:
+	/// Rows per strip for orientations 5 to 8
+	static constexpr unsigned kStripRows = 16;
+
+	/// Dimensions of the bitmap holding a decoded image of width x height pixels
+	static void OrientedSize(uint16_t orientation, unsigned width, unsigned height, unsigned *dib_width, unsigned *dib_height) {
+		const bool bSwap = (orientation >= 5) && (orientation <= 8);
+		*dib_width = bSwap ? height : width;
+		*dib_height = bSwap ? width : height;
+	}
+
+	ExifOrientedRows(FIBITMAP *dib, unsigned width, unsigned height, uint16_t orientation)
+		: m_dib(dib), m_width(width), m_height(height), m_orientation(orientation)
+		, m_bytespp(FreeImage_GetBPP(dib) / 8), m_row(0), m_strip(nullptr, &FreeImage_Unload) {
+		if ((m_orientation < 1) || (m_orientation > 8)) {
+			m_orientation = 1;
+		}
+		if (m_orientation >= 5) {
+			m_strip.reset(FreeImage_Allocate(m_width, kStripRows, FreeImage_GetBPP(dib)));
+		}
+	}
+
+	/// Returns FALSE if the strip buffer could not be allocated
+	FIBOOL IsValid() const {
+		return (m_orientation < 5) || m_strip;
+	}
+
+	/// Buffer receiving the next decoded row
+	uint8_t* Row() const {
+		switch (m_orientation) {
+			case 1:
+			case 2:
+				return FreeImage_GetScanLine(m_dib, m_height - m_row - 1);
+			case 3:
+			case 4:
+				return FreeImage_GetScanLine(m_dib, m_row);
+			default:
+				// strip rows are stored top-down from the last scanline of the strip
+				return FreeImage_GetScanLine(m_strip.get(), kStripRows - 1 - (m_row % kStripRows));
+		}
+	}
+
+	/// Places the row filled through Row(), returns FALSE on a memory error
+	FIBOOL Commit() {
+		if ((m_orientation == 2) || (m_orientation == 3)) {
+			Mirror(Row());
+		}
+		m_row++;
+		if ((m_orientation >= 5) && ((m_row % kStripRows == 0) || (m_row == m_height))) {
+			return FlushStrip();
+		}
+		return TRUE;
+	}
+
+private:
+	void Mirror(uint8_t *line) const {
+		if (m_width < 2) {
+			return;
+		}
+		uint8_t *left = line;
+		uint8_t *right = line + (size_t)(m_width - 1) * m_bytespp;
+		for (; left < right; left += m_bytespp, right -= m_bytespp) {
+			std::swap_ranges(left, left + m_bytespp, right);
+		}
+	}
+
+	/// Transposes the decoded rows [first, m_row) into their column band of the bitmap
+	FIBOOL FlushStrip() {
+		const unsigned rows = ((m_row - 1) % kStripRows) + 1;
+		const unsigned first = m_row - rows;
+		const unsigned bpp = FreeImage_GetBPP(m_dib);
+
+		// in scanline coordinates, the bitmap column x of orientations 5 and 8 holds
+		// the decoded row x, the one of orientations 6 and 7 holds the decoded row (height - 1 - x)
+		QuarterTurn turn = QUARTER_TURN_TRANSPOSE;
+		unsigned column = m_height - m_row;
+		switch (m_orientation) {
+			case 5:		// "left side, top"
+				turn = QUARTER_TURN_TRANSVERSE;
+				column = first;
+				break;
+			case 6:		// "right side, top"
+				turn = QUARTER_TURN_CCW;
+				break;
+			case 7:		// "right side, bottom"
+				turn = QUARTER_TURN_TRANSPOSE;
+				break;
+			case 8:		// "left side, bottom"
+				turn = QUARTER_TURN_CW;
+				column = first;
+				break;
+		}
+
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> src(FreeImage_AllocateHeaderForBits(
+			FreeImage_GetScanLine(m_strip.get(), kStripRows - rows), FreeImage_GetPitch(m_strip.get()),
+			FIT_BITMAP, m_width, rows, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK), &FreeImage_Unload);
+		std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dst(FreeImage_AllocateHeaderForBits(
+			FreeImage_GetBits(m_dib) + (size_t)column * m_bytespp, FreeImage_GetPitch(m_dib),
+			FIT_BITMAP, rows, m_width, bpp, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK), &FreeImage_Unload);
+		if (!src || !dst) {
+			return FALSE;
+		}
+		FreeImage_SetTopDown(dst.get(), FreeImage_IsTopDown(m_dib));
+
+		return RotateQuarterTurn(dst.get(), src.get(), turn);
+	}
+
+	FIBITMAP *m_dib;
+	unsigned m_width;		//! width of the decoded image
+	unsigned m_height;		//! height of the decoded image
+	uint16_t m_orientation;
+	unsigned m_bytespp;
+	unsigned m_row;			//! number of decoded rows
+	std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> m_strip;
+};
+
 // ==========================================================
 // Plugin Implementation
 // ==========================================================
@@ -1216,27 +1365,65 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				cinfo.out_color_space = JCS_GRAYSCALE;
 			}
 
+			// decode straight into the layout requested by FreeImage_LoadAs*, when the codec can do it
+			// (the extended color spaces give the same pixels as FreeImage_ConvertTo24Bits / FreeImage_ConvertTo32Bits)
+
+			FIBOOL bTargetLayout = FALSE;
+#ifdef JCS_EXTENSIONS
+			{
+				FREE_IMAGE_TYPE target_type = FIT_UNKNOWN;
+				unsigned target_bpp = 0;
+				if (FreeImage_GetLoadTarget(&target_type, &target_bpp) && (target_type == FIT_BITMAP) && ((flags & JPEG_GREYSCALE) != JPEG_GREYSCALE)) {
+					const FIBOOL bColor = (cinfo.out_color_space == JCS_RGB) ? TRUE : FALSE;
+					const FIBOOL bGrey = (cinfo.out_color_space == JCS_GRAYSCALE) ? TRUE : FALSE;
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+					if ((target_bpp == 32) && (bColor || bGrey)) {
+						cinfo.out_color_space = JCS_EXT_BGRA;
+						bTargetLayout = TRUE;
+					} else if ((target_bpp == 24) && (bColor || bGrey)) {
+						cinfo.out_color_space = JCS_EXT_BGR;
+						bTargetLayout = TRUE;
+					}
+#else
+					if ((target_bpp == 32) && (bColor || bGrey)) {
+						cinfo.out_color_space = JCS_EXT_RGBA;
+						bTargetLayout = TRUE;
+					} else if ((target_bpp == 24) && bGrey) {
+						cinfo.out_color_space = JCS_RGB;
+						bTargetLayout = TRUE;
+					}
+#endif
+				}
+			}
+#endif // JCS_EXTENSIONS
+
 			// step 5a: start decompressor and calculate output width and height
 
 			jpeg_start_decompress(&cinfo);
 
 			// step 5b: allocate dib and init header
+			// (with JPEG_EXIFROTATE, the dib is allocated with its oriented size and the scanlines are placed while decoding)
+
+			const uint16_t orientation = (!header_only && ((flags & JPEG_EXIFROTATE) == JPEG_EXIFROTATE)) ? read_exif_orientation(&cinfo) : 1;
+			unsigned dib_width = 0, dib_height = 0;
+			ExifOrientedRows::OrientedSize(orientation, cinfo.output_width, cinfo.output_height, &dib_width, &dib_height);
+
 			std::unique_ptr<FIBITMAP, decltype(&FreeImage_Unload)> dib(nullptr, &FreeImage_Unload);
 			if ((cinfo.output_components == 4) && (cinfo.out_color_space == JCS_CMYK)) {
 				// CMYK image
 				if ((flags & JPEG_CMYK) == JPEG_CMYK) {
 					// load as CMYK
-					dib.reset(FreeImage_AllocateHeader(header_only, cinfo.output_width, cinfo.output_height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+					dib.reset(FreeImage_AllocateHeader(header_only, dib_width, dib_height, 32, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
 					if (!dib) throw FI_MSG_ERROR_DIB_MEMORY;
 					FreeImage_GetICCProfile(dib.get())->flags |= FIICC_COLOR_IS_CMYK;
 				} else {
 					// load as CMYK and convert to RGB
-					dib.reset(FreeImage_AllocateHeader(header_only, cinfo.output_width, cinfo.output_height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+					dib.reset(FreeImage_AllocateHeader(header_only, dib_width, dib_height, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
 					if (!dib) throw FI_MSG_ERROR_DIB_MEMORY;
 				}
 			} else {
 				// RGB or greyscale image
-				dib.reset(FreeImage_AllocateHeader(header_only, cinfo.output_width, cinfo.output_height, 8 * cinfo.output_components, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
+				dib.reset(FreeImage_AllocateHeader(header_only, dib_width, dib_height, 8 * cinfo.output_components, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK));
 				if (!dib) throw FI_MSG_ERROR_DIB_MEMORY;
 
 				if (cinfo.output_components == 1) {
@@ -1250,6 +1437,10 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 					}
 				}
 			}
+			if ((flags & FIF_LOAD_TOPDOWN) == FIF_LOAD_TOPDOWN) {
+				// libjpeg decodes the scanlines top-down: store them in this order
+				FreeImage_SetTopDown(dib.get(), TRUE);
+			}
 			if (scale_denom != 1) {
 				// store original size info if a scaling was requested
 				store_size_info(dib.get(), cinfo.image_width, cinfo.image_height);
@@ -1282,6 +1473,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			// step 7a: while (scan lines remain to be read) jpeg_read_scanlines(...);
 
+			ExifOrientedRows rows(dib.get(), cinfo.output_width, cinfo.output_height, orientation);
+			if (!rows.IsValid()) {
+				throw FI_MSG_ERROR_DIB_MEMORY;
+			}
+
 			if ((cinfo.out_color_space == JCS_CMYK) && ((flags & JPEG_CMYK) != JPEG_CMYK)) {
 				// convert from CMYK to RGB
 
@@ -1295,7 +1491,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 				while (cinfo.output_scanline < cinfo.output_height) {
 					JSAMPROW src = buffer[0];
-					JSAMPROW dst = FreeImage_GetScanLine(dib.get(), cinfo.output_height - cinfo.output_scanline - 1);
+					JSAMPROW dst = rows.Row();
 
 					jpeg_read_scanlines(&cinfo, buffer, 1);
 
@@ -1307,6 +1503,10 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 						src += 4;
 						dst += 3;
 					}
+
+					if (!rows.Commit()) {
+						throw FI_MSG_ERROR_DIB_MEMORY;
+					}
 				}
 				
 				// if original image is CMYK but is converted to RGB, remove ICC profile from Exif-TIFF metadata
@@ -1325,7 +1525,7 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 				while (cinfo.output_scanline < cinfo.output_height) {
 					JSAMPROW src = buffer[0];
-					JSAMPROW dst = FreeImage_GetScanLine(dib.get(), cinfo.output_height - cinfo.output_scanline - 1);
+					JSAMPROW dst = rows.Row();
 
 					jpeg_read_scanlines(&cinfo, buffer, 1);
 
@@ -1338,15 +1538,23 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 						src += 4;
 						dst += 4;
 					}
+
+					if (!rows.Commit()) {
+						throw FI_MSG_ERROR_DIB_MEMORY;
+					}
 				}
 
 			} else {
 				// normal case (RGB or greyscale image)
 
 				while (cinfo.output_scanline < cinfo.output_height) {
-					JSAMPROW dst = FreeImage_GetScanLine(dib.get(), cinfo.output_height - cinfo.output_scanline - 1);
+					JSAMPROW dst = rows.Row();
 
 					jpeg_read_scanlines(&cinfo, &dst, 1);
+
+					if (!rows.Commit()) {
+						throw FI_MSG_ERROR_DIB_MEMORY;
+					}
 				}
 
 				// step 7b: swap red and blue components (see LibJPEG/jmorecfg.h: #define RGB_RED, ...)
@@ -1354,7 +1562,9 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				// LibJPEG "as is".
 
 #if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
-				SwapRedBlue32(dib.get());
+				if (!bTargetLayout) {
+					SwapRedBlue32(dib.get());
+				}
 #endif
 			}
 
@@ -1366,13 +1576,6 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 
 			jpeg_destroy_decompress(&cinfo);
 
-			// check for automatic Exif rotation
-			if (!header_only && ((flags & JPEG_EXIFROTATE) == JPEG_EXIFROTATE)) {
-				auto *tmp(dib.release());
-				RotateExif(&tmp);
-				dib.reset(tmp);
-			}
-
 			// everything went well. return the loaded dib
 
 			return dib.release();
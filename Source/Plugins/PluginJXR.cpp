@@ -1395,8 +1395,8 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		// write metadata & pixels
 		// -----------------------
 
-		// dib coordinates are upside-down relative to usual conventions
-		bIsFlipped = FreeImage_FlipVertical(dib);
+		// dib coordinates are upside-down relative to usual conventions, unless the scanlines are stored top-down
+		bIsFlipped = FreeImage_IsTopDown(dib) ? FALSE : FreeImage_FlipVertical(dib);
 
 		// get a pointer to dst pixel data
 		uint8_t *dib_bits = FreeImage_GetBits(dib);
@@ -1409,7 +1409,10 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 		JXR_CHECK(error_code);
 
 		// recover dib coordinates
-		FreeImage_FlipVertical(dib);
+		if (bIsFlipped) {
+			FreeImage_FlipVertical(dib);
+			bIsFlipped = FALSE;
+		}
 
 		// free the encoder
 		pEncoder->Release(&pEncoder);
@@ -306,6 +306,118 @@ SupportsNoPixels() {
 
 // --------------------------------------------------------------------------
 
+/**
+Configure the decoder so that decoded pixels already have the layout requested through FreeImage_LoadAs*.
+Only the cases where libpng gives the same pixels as a plain load followed by the matching
+FreeImage_ConvertTo* call are handled here; the loader converts everything else.
+@param png_ptr PNG handle
+@param info_ptr PNG info handle
+@param flags Decoder flags
+@param output_image_type Returned FreeImage converted image type
+@return Returns TRUE if the decoder was configured, returns FALSE to use the default configuration
+*/
+static FIBOOL
+ConfigureTarget(png_structp png_ptr, png_infop info_ptr, int flags, FREE_IMAGE_TYPE *output_image_type) {
+	FREE_IMAGE_TYPE target_type = FIT_UNKNOWN;
+	unsigned target_bpp = 0;
+
+	if (!FreeImage_GetLoadTarget(&target_type, &target_bpp)) {
+		return FALSE;
+	}
+
+	// gamma correction is applied before the channel transformations, skip it
+	if (png_get_valid(png_ptr, info_ptr, PNG_INFO_gAMA) && ((flags & PNG_IGNOREGAMMA) != PNG_IGNOREGAMMA)) {
+		return FALSE;
+	}
+
+	const int color_type = png_get_color_type(png_ptr, info_ptr);
+	const int bit_depth = png_get_bit_depth(png_ptr, info_ptr);
+	const FIBOOL bIsTransparent = png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS) == PNG_INFO_tRNS ? TRUE : FALSE;
+	const FIBOOL bHasAlpha = (color_type & PNG_COLOR_MASK_ALPHA) ? TRUE : FALSE;
+
+	if ((target_type == FIT_BITMAP) && ((target_bpp == 24) || (target_bpp == 32))) {
+		switch (color_type) {
+			case PNG_COLOR_TYPE_PALETTE:
+				png_set_palette_to_rgb(png_ptr);
+				break;
+
+			case PNG_COLOR_TYPE_GRAY:
+				// 16-bit greyscale loads as FIT_UINT16, low bit depth transparent colors are not expanded alike
+				if ((bit_depth == 16) || (bIsTransparent && (target_bpp == 32))) {
+					return FALSE;
+				}
+				if (bit_depth < 8) {
+					png_set_expand_gray_1_2_4_to_8(png_ptr);
+				}
+				png_set_gray_to_rgb(png_ptr);
+				break;
+
+			case PNG_COLOR_TYPE_GRAY_ALPHA:
+				if (bit_depth == 16) {
+					return FALSE;
+				}
+				png_set_gray_to_rgb(png_ptr);
+				break;
+
+			case PNG_COLOR_TYPE_RGB:
+			case PNG_COLOR_TYPE_RGB_ALPHA:
+				break;
+
+			default:
+				return FALSE;
+		}
+
+		// FreeImage_ConvertTo24Bits and FreeImage_ConvertTo32Bits keep the high byte of 16-bit samples
+		if (bit_depth == 16) {
+			png_set_strip_16(png_ptr);
+		}
+
+		if (target_bpp == 32) {
+			if (bIsTransparent && !bHasAlpha) {
+				png_set_tRNS_to_alpha(png_ptr);
+			} else if (!bHasAlpha) {
+				png_set_filler(png_ptr, 0xFF, PNG_FILLER_AFTER);
+			}
+		} else if (bHasAlpha || bIsTransparent) {
+			// the palette expansion adds the tRNS alpha on its own
+			png_set_strip_alpha(png_ptr);
+		}
+
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_BGR
+		png_set_bgr(png_ptr);
+#endif
+	} else if ((target_type == FIT_RGB16) || (target_type == FIT_RGBA16)) {
+		if (bit_depth != 16) {
+			return FALSE;
+		}
+		if ((color_type == PNG_COLOR_TYPE_GRAY) || (color_type == PNG_COLOR_TYPE_GRAY_ALPHA)) {
+			png_set_gray_to_rgb(png_ptr);
+		}
+
+		if (target_type == FIT_RGBA16) {
+			if (bIsTransparent && !bHasAlpha) {
+				png_set_tRNS_to_alpha(png_ptr);
+			} else if (!bHasAlpha) {
+				png_set_filler(png_ptr, 0xFFFF, PNG_FILLER_AFTER);
+			}
+		} else if (bHasAlpha || bIsTransparent) {
+			png_set_strip_alpha(png_ptr);
+		}
+
+#ifndef FREEIMAGE_BIGENDIAN
+		png_set_swap(png_ptr);
+#endif
+	} else {
+		return FALSE;
+	}
+
+	png_read_update_info(png_ptr, info_ptr);
+
+	*output_image_type = target_type;
+
+	return TRUE;
+}
+
 /**
 Configure the decoder so that decoded pixels are compatible with a FREE_IMAGE_TYPE format. 
 Set conversion instructions as needed. 
@@ -318,6 +430,11 @@ Set conversion instructions as needed.
 */
 static FIBOOL 
 ConfigureDecoder(png_structp png_ptr, png_infop info_ptr, int flags, FREE_IMAGE_TYPE *output_image_type) {
+	// decode straight into the layout requested by FreeImage_LoadAs*, when possible
+	if (ConfigureTarget(png_ptr, info_ptr, flags, output_image_type)) {
+		return TRUE;
+	}
+
 	// get original image info
 	const int color_type = png_get_color_type(png_ptr, info_ptr);
 	const int bit_depth = png_get_bit_depth(png_ptr, info_ptr);
@@ -622,6 +739,11 @@ Load(FreeImageIO *io, fi_handle handle, int page, int flags, void *data) {
 				throw FI_MSG_ERROR_DIB_MEMORY;
 			}
 
+			if ((flags & FIF_LOAD_TOPDOWN) == FIF_LOAD_TOPDOWN) {
+				// PNG rows are stored top-down: keep this order in memory
+				FreeImage_SetTopDown(dib.get(), TRUE);
+			}
+
 			// store the transparency table
 
 			if (png_get_valid(png_ptr.get(), info_ptr.get(), PNG_INFO_tRNS)) {
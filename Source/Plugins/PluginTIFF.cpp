@@ -47,6 +47,7 @@
 #include "half.h"
 
 #include "FreeImageIO.h"
+#include "../FreeImage/Plugin.h"
 #include "PSDParser.h"
 
 // --------------------------------------------------------------------------
@@ -2575,6 +2576,363 @@ Save(FreeImageIO *io, FIBITMAP *dib, fi_handle handle, int page, int flags, void
 	return bResult;
 }
 
+// ----------------------------------------------------------
+//   Page codec
+// ----------------------------------------------------------
+
+// Every page is encoded as a classic TIFF file of its own. Appending a page moves its
+// IFDs and data behind the pages written before it: the file offsets it holds are
+// rebased, and its first IFD is linked to the last IFD of the previous page.
+
+/** Pages appended so far */
+struct TIFFPAGEWRITER {
+	long start;				// position of the TIFF header
+	long next_ifd_link;		// position of the 'next IFD' offset to link the next page to, -1 before the first page
+	uint8_t byte_order[2];	// byte order of the file, set by the first page
+};
+
+/** Page being appended */
+struct TIFFPAGEREBASE {
+	uint8_t *data;					// the page, encoded as a TIFF file
+	uint32_t size;					// size of the page
+	uint64_t delta;					// distance the page moves by
+	bool big_endian;				// byte order of the page
+	std::set<uint32_t> visited;		// IFDs already rebased
+	std::vector<uint8_t> tail;		// LONG arrays replacing SHORT strip or tile offsets, written after the page
+};
+
+static uint16_t
+ReadTIFFShort(const uint8_t *p, bool big_endian) {
+	return big_endian ? (uint16_t)((p[0] << 8) | p[1]) : (uint16_t)((p[1] << 8) | p[0]);
+}
+
+static uint32_t
+ReadTIFFLong(const uint8_t *p, bool big_endian) {
+	return big_endian
+		? ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3]
+		: ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | (uint32_t)p[0];
+}
+
+static uint64_t
+ReadTIFFLong8(const uint8_t *p, bool big_endian) {
+	const uint64_t first = ReadTIFFLong(p, big_endian);
+	const uint64_t second = ReadTIFFLong(p + 4, big_endian);
+	return big_endian ? (first << 32) | second : (second << 32) | first;
+}
+
+static void
+WriteTIFFShort(uint8_t *p, uint16_t value, bool big_endian) {
+	p[big_endian ? 1 : 0] = (uint8_t)value;
+	p[big_endian ? 0 : 1] = (uint8_t)(value >> 8);
+}
+
+static void
+WriteTIFFLong(uint8_t *p, uint32_t value, bool big_endian) {
+	for (int i = 0; i < 4; i++) {
+		p[big_endian ? 3 - i : i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+static void
+WriteTIFFLong8(uint8_t *p, uint64_t value, bool big_endian) {
+	for (int i = 0; i < 8; i++) {
+		p[big_endian ? 7 - i : i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+/** Size of a value of a TIFF field type, 0 for unknown types */
+static unsigned
+TIFFFieldTypeSize(uint16_t type) {
+	switch (type) {
+		case TIFF_BYTE:
+		case TIFF_ASCII:
+		case TIFF_SBYTE:
+		case TIFF_UNDEFINED:
+			return 1;
+		case TIFF_SHORT:
+		case TIFF_SSHORT:
+			return 2;
+		case TIFF_LONG:
+		case TIFF_SLONG:
+		case TIFF_FLOAT:
+		case TIFF_IFD:
+			return 4;
+		case TIFF_RATIONAL:
+		case TIFF_SRATIONAL:
+		case TIFF_DOUBLE:
+		case TIFF_LONG8:
+		case TIFF_SLONG8:
+		case TIFF_IFD8:
+			return 8;
+		default:
+			return 0;
+	}
+}
+
+/** Adds 'delta' to the 32-bit file offset stored at 'p', fails if the result does not fit in 32 bits */
+static bool
+RebaseTIFFOffset(uint8_t *p, uint64_t delta, bool big_endian) {
+	const uint64_t offset = ReadTIFFLong(p, big_endian) + delta;
+	if (offset > 0xFFFFFFFF) {
+		return false;
+	}
+	WriteTIFFLong(p, (uint32_t)offset, big_endian);
+	return true;
+}
+
+/** Adds 'delta' to the 64-bit file offset stored at 'p', fails if the result does not fit in 32 bits */
+static bool
+RebaseTIFFOffset8(uint8_t *p, uint64_t delta, bool big_endian) {
+	const uint64_t offset = ReadTIFFLong8(p, big_endian);
+	if ((offset > 0xFFFFFFFF) || (offset + delta > 0xFFFFFFFF)) {
+		return false;
+	}
+	WriteTIFFLong8(p, offset + delta, big_endian);
+	return true;
+}
+
+/**
+Turns the SHORT strip or tile offsets of an IFD entry into rebased LONG offsets, which may not fit
+in 16 bits once the page has moved. More than one offset does not fit in the entry: the LONG array
+is then added to the tail of the page.
+@param value The SHORT offsets, in the entry or in the page
+*/
+static bool
+WidenTIFFShortOffsets(TIFFPAGEREBASE& page, uint8_t *entry, const uint8_t *value, uint32_t count) {
+	if (count == 1) {
+		const uint32_t offset = ReadTIFFShort(value, page.big_endian);
+		WriteTIFFShort(entry + 2, TIFF_LONG, page.big_endian);
+		WriteTIFFLong(entry + 8, offset, page.big_endian);
+		return RebaseTIFFOffset(entry + 8, page.delta, page.big_endian);
+	}
+
+	// the tail starts on a word boundary after the page, and only holds 4-byte values
+	const uint64_t position = (uint64_t)page.size + (page.size & 1) + page.tail.size();
+	if (position + page.delta + 4 * (uint64_t)count > 0xFFFFFFFF) {
+		return false;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		uint8_t offset[4];
+		WriteTIFFLong(offset, ReadTIFFShort(value + 2 * i, page.big_endian), page.big_endian);
+		if (!RebaseTIFFOffset(offset, page.delta, page.big_endian)) {
+			return false;
+		}
+		page.tail.insert(page.tail.end(), offset, offset + 4);
+	}
+	WriteTIFFShort(entry + 2, TIFF_LONG, page.big_endian);
+	WriteTIFFLong(entry + 8, (uint32_t)(position + page.delta), page.big_endian);
+	return true;
+}
+
+/**
+Rebases the file offsets held by the IFD chain starting at 'ifd', including its sub-IFDs
+@param last_link Receives the position of the 'next IFD' offset of the last IFD in the chain, may be NULL
+*/
+static bool
+RebaseTIFFChain(TIFFPAGEREBASE& page, uint32_t ifd, int depth, uint32_t *last_link) {
+	if (depth > 8) {
+		return false;
+	}
+
+	uint8_t *data = page.data;
+	const bool big_endian = page.big_endian;
+
+	while (ifd != 0) {
+		if (!page.visited.insert(ifd).second || ((uint64_t)ifd + 2 > page.size)) {
+			// IFD loop or truncated IFD
+			return false;
+		}
+		const uint16_t entry_count = ReadTIFFShort(data + ifd, big_endian);
+		const uint64_t link = (uint64_t)ifd + 2 + 12 * (uint64_t)entry_count;
+		if (link + 4 > page.size) {
+			return false;
+		}
+
+		for (uint16_t k = 0; k < entry_count; k++) {
+			uint8_t *entry = data + ifd + 2 + 12 * k;
+			const uint16_t tag = ReadTIFFShort(entry, big_endian);
+			const uint16_t type = ReadTIFFShort(entry + 2, big_endian);
+			const uint32_t count = ReadTIFFLong(entry + 4, big_endian);
+			const unsigned type_size = TIFFFieldTypeSize(type);
+			if (type_size == 0) {
+				return false;
+			}
+
+			// values larger than 4 bytes are stored at an offset
+			uint8_t *value = entry + 8;
+			const uint64_t value_size = (uint64_t)type_size * count;
+			if (value_size > 4) {
+				const uint32_t value_offset = ReadTIFFLong(entry + 8, big_endian);
+				if ((uint64_t)value_offset + value_size > page.size) {
+					return false;
+				}
+				value = data + value_offset;
+				if (!RebaseTIFFOffset(entry + 8, page.delta, big_endian)) {
+					return false;
+				}
+			}
+
+			const bool is_data_offset = (tag == TIFFTAG_STRIPOFFSETS) || (tag == TIFFTAG_TILEOFFSETS);
+			const bool is_ifd_offset = (type == TIFF_IFD) || (type == TIFF_IFD8) || (tag == TIFFTAG_SUBIFD) || (tag == TIFFTAG_EXIFIFD)
+				|| (tag == TIFFTAG_GPSIFD) || (tag == TIFFTAG_INTEROPERABILITYIFD);
+			if (!is_data_offset && !is_ifd_offset) {
+				continue;
+			}
+
+			if (is_data_offset && (type == TIFF_SHORT)) {
+				if (!WidenTIFFShortOffsets(page, entry, value, count)) {
+					return false;
+				}
+				continue;
+			}
+
+			const bool is_long8 = (type == TIFF_LONG8) || (type == TIFF_IFD8);
+			if (!is_long8 && (type != TIFF_LONG) && (type != TIFF_IFD)) {
+				return false;
+			}
+			for (uint32_t i = 0; i < count; i++) {
+				uint8_t *offset = value + type_size * i;
+				if (is_ifd_offset) {
+					const uint64_t sub_ifd = is_long8 ? ReadTIFFLong8(offset, big_endian) : ReadTIFFLong(offset, big_endian);
+					if (sub_ifd == 0) {
+						continue;
+					}
+					if ((sub_ifd > 0xFFFFFFFF) || !RebaseTIFFChain(page, (uint32_t)sub_ifd, depth + 1, nullptr)) {
+						return false;
+					}
+				}
+				if (!(is_long8 ? RebaseTIFFOffset8(offset, page.delta, big_endian) : RebaseTIFFOffset(offset, page.delta, big_endian))) {
+					return false;
+				}
+			}
+		}
+
+		if (last_link) {
+			*last_link = (uint32_t)link;
+		}
+		ifd = ReadTIFFLong(data + link, big_endian);
+		if ((ifd != 0) && !RebaseTIFFOffset(data + (uint32_t)link, page.delta, big_endian)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static FIBOOL
+EncodePage(FIBITMAP *dib, int page, int flags, FIMEMORY *stream) {
+	FreeImageIO io;
+	SetMemoryIO(&io);
+
+	void *data = Open(&io, (fi_handle)stream, FALSE);
+	if (!data) {
+		return FALSE;
+	}
+	const FIBOOL bResult = Save(&io, dib, (fi_handle)stream, page, flags, data);
+	Close(&io, (fi_handle)stream, data);
+
+	return bResult;
+}
+
+static void *
+BeginPages(FreeImageIO *io, fi_handle handle, int /*page_count*/, int /*flags*/) {
+	auto *writer = new(std::nothrow) TIFFPAGEWRITER;
+	if (!writer) {
+		return nullptr;
+	}
+	writer->start = io->tell_proc(handle);
+	writer->next_ifd_link = -1;
+	return writer;
+}
+
+static FIBOOL
+AppendPage(FreeImageIO *io, fi_handle handle, FIMEMORY *stream, void *state) {
+	auto *writer = (TIFFPAGEWRITER *)state;
+
+	uint8_t *data{};
+	uint32_t size{};
+	if (!FreeImage_AcquireMemory(stream, &data, &size) || (size < 8)) {
+		return FALSE;
+	}
+
+	// pages are classic TIFF files
+	const bool big_endian = (data[0] == 'M');
+	if ((data[0] != data[1]) || ((data[0] != 'I') && (data[0] != 'M')) || (ReadTIFFShort(data + 2, big_endian) != 42)) {
+		return FALSE;
+	}
+
+	if (writer->next_ifd_link < 0) {
+		// the header of the first page starts the file, its first IFD is linked below
+		const uint8_t header[8] = { data[0], data[1], data[2], data[3], 0, 0, 0, 0 };
+		if (io->write_proc((void *)header, 8, 1, handle) != 1) {
+			return FALSE;
+		}
+		memcpy(writer->byte_order, data, 2);
+		writer->next_ifd_link = writer->start + 4;
+	}
+	else if (memcmp(writer->byte_order, data, 2) != 0) {
+		return FALSE;
+	}
+
+	// IFDs begin on a word boundary
+	long position = io->tell_proc(handle) - writer->start;
+	if (position & 1) {
+		const uint8_t padding = 0;
+		io->write_proc((void *)&padding, 1, 1, handle);
+		position++;
+	}
+
+	// everything behind the page header moves from offset 8 to 'position'
+	TIFFPAGEREBASE page;
+	page.data = data;
+	page.size = size;
+	page.delta = (uint64_t)position - 8;
+	page.big_endian = big_endian;
+	const uint64_t delta = page.delta;
+	const uint32_t first_ifd = ReadTIFFLong(data + 4, big_endian);
+	uint32_t last_link = 0;
+	if ((first_ifd == 0) || ((uint64_t)first_ifd + delta > 0xFFFFFFFF) || !RebaseTIFFChain(page, first_ifd, 0, &last_link)) {
+		FreeImage_OutputMessageProc(s_format_id, "Failed to append page: file offsets out of range");
+		return FALSE;
+	}
+	if (io->write_proc(data + 8, size - 8, 1, handle) != 1) {
+		return FALSE;
+	}
+	if (!page.tail.empty()) {
+		const uint8_t padding = 0;
+		if ((size & 1) && (io->write_proc((void *)&padding, 1, 1, handle) != 1)) {
+			return FALSE;
+		}
+		if (io->write_proc(page.tail.data(), (unsigned)page.tail.size(), 1, handle) != 1) {
+			return FALSE;
+		}
+	}
+
+	// link the page to the previous one
+	uint8_t link[4];
+	WriteTIFFLong(link, (uint32_t)(first_ifd + delta), big_endian);
+	const long end = io->tell_proc(handle);
+	io->seek_proc(handle, writer->next_ifd_link, SEEK_SET);
+	io->write_proc(link, 4, 1, handle);
+	io->seek_proc(handle, end, SEEK_SET);
+
+	writer->next_ifd_link = writer->start + (long)(last_link + delta);
+
+	return TRUE;
+}
+
+static FIBOOL
+EndPages(FreeImageIO * /*io*/, fi_handle /*handle*/, FIBOOL success, void *state) {
+	std::unique_ptr<TIFFPAGEWRITER> writer((TIFFPAGEWRITER *)state);
+	return (success && (writer->next_ifd_link >= 0)) ? TRUE : FALSE;
+}
+
+const PluginPageCodec*
+GetPageCodecTIFF() {
+	static const PluginPageCodec codec = { true, EncodePage, BeginPages, AppendPage, EndPages };
+	return &codec;
+}
+
 // ==========================================================
 //   Init
 // ==========================================================
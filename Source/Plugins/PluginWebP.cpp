@@ -479,8 +479,8 @@ EncodeImage(FIMEMORY *hmem, FIBITMAP *dib, int flags) {
 
 		// --- Perform encoding ---
 		
-		// Invert dib scanlines
-		bIsFlipped = FreeImage_FlipVertical(dib);
+		// Invert dib scanlines, unless they are already stored top-down
+		bIsFlipped = FreeImage_IsTopDown(dib) ? FALSE : FreeImage_FlipVertical(dib);
 
 
 		// convert dib buffer to output stream
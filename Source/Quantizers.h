@@ -50,11 +50,9 @@ typedef struct tagBox {
 protected:
     float *gm2;
 	int32_t *wt, *mr, *mg, *mb;
-	uint16_t *Qadd;
 
 	// DIB data
 	unsigned width, height;
-	unsigned pitch;
 	FIBITMAP *m_dib;
 
 protected:
@@ -0,0 +1,129 @@
+// ==========================================================
+// Internal worker thread pool
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+#ifndef FREEIMAGE_THREADPOOL_H
+#define FREEIMAGE_THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// ----------------------------------------------------------
+
+/**
+Fixed size pool of worker threads shared by the whole library.
+Tasks are run in submission order; a task must not block on another task
+that was queued after it.
+*/
+class ThreadPool {
+public :
+	explicit ThreadPool(unsigned threads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/// Returns the library-wide pool, created on first use with one thread per hardware thread
+	static ThreadPool& Instance();
+
+	/// Returns TRUE when called from one of the pool's worker threads
+	static bool isWorkerThread();
+
+	unsigned getThreadCount() const {
+		return (unsigned)m_threads.size();
+	}
+
+	/// Queues a task and returns a future for its result
+	template <typename Fn>
+	auto submit(Fn&& fn) -> std::future<std::invoke_result_t<std::decay_t<Fn>>> {
+		using Result = std::invoke_result_t<std::decay_t<Fn>>;
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+		std::future<Result> result = task->get_future();
+		enqueue([task]() { (*task)(); });
+		return result;
+	}
+
+	/**
+	Calls fn(first, last) over consecutive sub-ranges of [begin, end) of at least 'grain' items,
+	on the pool threads and on the calling thread, and returns once the whole range is done.
+	Runs inline when the range is too small or when called from a worker thread.
+	fn must not throw.
+	*/
+	template <typename Fn>
+	void parallelFor(size_t begin, size_t end, size_t grain, Fn&& fn) {
+		if (end <= begin) {
+			return;
+		}
+		grain = std::max<size_t>(grain, 1);
+		const size_t chunks = std::min<size_t>((end - begin + grain - 1) / grain, 4 * ((size_t)m_threads.size() + 1));
+		if ((chunks < 2) || isWorkerThread()) {
+			fn(begin, end);
+			return;
+		}
+
+		struct State {
+			std::atomic<size_t> next{};
+			std::atomic<size_t> done{};
+			std::mutex mutex;
+			std::condition_variable condition;
+		};
+		auto state = std::make_shared<State>();
+		const size_t count = end - begin;
+
+		// helpers only touch fn after claiming a chunk, the caller waits for every claimed chunk
+		auto work = [state, chunks, begin, count, &fn]() {
+			for (size_t i = state->next++; i < chunks; i = state->next++) {
+				fn(begin + count * i / chunks, begin + count * (i + 1) / chunks);
+				if (++state->done == chunks) {
+					std::lock_guard<std::mutex> lock(state->mutex);
+					state->condition.notify_all();
+				}
+			}
+		};
+
+		const size_t helpers = std::min<size_t>(chunks - 1, m_threads.size());
+		for (size_t i = 0; i < helpers; i++) {
+			enqueue(work);
+		}
+		work();
+
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->condition.wait(lock, [&state, chunks]() { return state->done == chunks; });
+	}
+
+private :
+	void enqueue(std::function<void()> task);
+	void run();
+
+private :
+	std::vector<std::thread> m_threads;
+	std::deque<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_stop{};
+};
+
+#endif // FREEIMAGE_THREADPOOL_H
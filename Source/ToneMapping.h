@@ -26,13 +26,8 @@
 extern "C" {
 #endif
 
-FIBOOL ConvertInPlaceRGBFToYxy(FIBITMAP *dib);
-FIBOOL ConvertInPlaceYxyToRGBF(FIBITMAP *dib);
 FIBITMAP* ConvertRGBFToY(FIBITMAP *src);
 
-FIBOOL LuminanceFromYxy(FIBITMAP *dib, float *maxLum, float *minLum, float *worldLum);
-FIBOOL LuminanceFromY(FIBITMAP *dib, float *maxLum, float *minLum, float *Lav, float *Llav);
-
 void NormalizeY(FIBITMAP *Y, float minPrct, float maxPrct);
 
 FIBITMAP* ClampConvertRGBFTo24(FIBITMAP *src);
@@ -41,5 +36,109 @@ FIBITMAP* ClampConvertRGBFTo24(FIBITMAP *src);
 }
 #endif
 
+#ifdef __cplusplus
+
+#include "CPUFeatures.h"
+#include <cstdint>
+#include <cstring>
+
+// ----------------------------------------------------------
+//   Global operators
+//
+// The global operators (Drago03, Reinhard05) work in float, in row bands on the
+// thread pool, with kernels compiled for every instruction set by KernelDispatch.
+// log, exp and pow are replaced by FastLog2 and FastExp2, which are branch free
+// and vectorize. FastLog2 is within 3e-7 of log2 (absolute below 1, relative above),
+// FastExp2 within 3e-7 of exp2 (relative): for positive samples, the 8-bit results of
+// the operators differ by 1 at most from the double precision formulas, with two exceptions:
+// - the REC709 gamma curve of Drago03 jumps at its start threshold unless gamma is 2 or 2.2
+//   (by about 9 levels at gamma 1.5); a value that falls on the other side of the threshold
+//   in float than in double takes the other branch
+// - negative channels are clamped to 0, where the previous code wrapped them around,
+//   so these pixels can differ by up to 255 levels
+//
+// A float select followed by float arithmetic keeps a branch in the loop when
+// floating point exceptions are honored (GCC default), so the kernels select with
+// MaskFloat or compare the bits of the values as integers.
+// ----------------------------------------------------------
+
+/// log(2)
+static const float TMO_LN2 = 0.693147181F;
+
+/// x if condition is true, +0 otherwise
+static FI_ALWAYS_INLINE float
+MaskFloat(bool condition, float x) {
+	int32_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	bits &= -(int32_t)condition;
+	memcpy(&x, &bits, sizeof(x));
+	return x;
+}
+
+/**
+Base 2 logarithm. Zero, negative and denormal values give log2(FLT_MIN) = -126.
+x = m * 2^e with m in [0.75, 1.5), log2(m) is summed from the series of atanh((m - 1) / (m + 1)).
+*/
+static FI_ALWAYS_INLINE float
+FastLog2(float x) {
+	int32_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	bits = (bits > 0x00800000) ? bits : 0x00800000;	// FLT_MIN
+	const int32_t high = ((bits & 0x007FFFFF) >= 0x00400000) ? 1 : 0;	// mantissa >= 1.5
+	const float e = (float)(((bits >> 23) & 0xFF) - 127 + high);
+	bits = (bits & 0x007FFFFF) | ((127 - high) << 23);
+	float m;
+	memcpy(&m, &bits, sizeof(m));
+	const float t = (m - 1) / (m + 1);
+	const float t2 = t * t;
+	return e + t * (2.88539008F + t2 * (0.961796694F + t2 * (0.577078016F + t2 * 0.412198583F)));
+}
+
+/**
+Base 2 exponential, x is clamped to [-126, 126].
+x = i + f with f in [-0.5, 0.5], 2^f is a Taylor polynomial.
+*/
+static FI_ALWAYS_INLINE float
+FastExp2(float x) {
+	int32_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	const int32_t magnitude = bits & 0x7FFFFFFF;
+	bits = (bits & INT32_MIN) | ((magnitude < 0x42FC0000) ? magnitude : 0x42FC0000);	// |x| <= 126
+	memcpy(&x, &bits, sizeof(x));
+	const int32_t i = (int32_t)(x + ((x < 0) ? -0.5F : 0.5F));
+	const float f = x - (float)i;
+	const float p = 1.0F + f * (0.693147181F + f * (0.240226507F + f * (0.0555041087F + f * (0.00961812911F + f * (0.00133335581F + f * 0.000154035304F)))));
+	bits = (i + 127) << 23;
+	float scale;
+	memcpy(&scale, &bits, sizeof(scale));
+	return p * scale;
+}
+
+/// x^y for x >= 0, non positive x behave as FLT_MIN
+static FI_ALWAYS_INLINE float
+FastPow(float x, float y) {
+	return FastExp2(y * FastLog2(x));
+}
+
+/// Luminance statistics of a RGBF image, luminance L = LUMA_REC709(r, g, b) clamped to 0
+struct LuminanceStats {
+	float maxLum;	//! maximum luminance
+	float minLum;	//! minimum luminance
+	float Lav;		//! average luminance
+	float Llav;		//! log average luminance exp(mean(log(2.3e-5 + L))), a.k.a. world adaptation luminance
+	float Cav[3];	//! red, green and blue averages, when requested
+};
+
+/**
+Gathers the luminance statistics of a RGBF image in one parallel pass
+@param dib Source RGBF image
+@param stats Receives the statistics
+@param channels TRUE to average the channels as well
+@return Returns TRUE if successful, returns FALSE otherwise
+*/
+FIBOOL GetLuminanceStats(FIBITMAP *dib, LuminanceStats *stats, FIBOOL channels);
+
+#endif // __cplusplus
+
 #endif // FREEIMAGE_TONE_MAPPING_H
 
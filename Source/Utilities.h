@@ -69,6 +69,41 @@
 void* FreeImage_Aligned_Malloc(size_t amount, size_t alignment);
 void FreeImage_Aligned_Free(void* mem);
 
+// In-place layout changes
+// defined in BitmapAccess.cpp
+
+/**
+Returns the pixels and pitch a bitmap would have after FreeImage_SetInternalLayout(dib, type, bpp),
+or NULL when that layout doesn't fit in the bitmap's current allocation.
+*/
+uint8_t* FreeImage_GetInternalLayoutBits(FIBITMAP *dib, FREE_IMAGE_TYPE type, unsigned bpp, unsigned *pitch);
+
+/**
+Switches the header of a bitmap to another image type and bit depth, keeping its allocation.
+Pixels are not moved, and a greyscale palette is written for 8-bit layouts.
+*/
+void FreeImage_SetInternalLayout(FIBITMAP *dib, FREE_IMAGE_TYPE type, unsigned bpp);
+
+// Shared pixels
+// defined in BitmapAccess.cpp
+
+/**
+Lets a view allocated with FreeImage_AllocateHeaderForBits on the pixels of dib keep these pixels alive.
+The pixels of a bitmap wrapping a user provided buffer are left to the lifetime of that buffer.
+@return Returns FALSE on a memory error
+*/
+FIBOOL FreeImage_SharePixelsWithView(FIBITMAP *view, FIBITMAP *dib);
+
+// Output layout requested from the plugins
+// defined in Plugin.cpp
+
+/**
+Returns TRUE and the requested image type and bit depth while FreeImage_LoadAs* runs a plugin on this thread.
+Plugins may decode straight into that layout when the pixels are the same as a load followed by the
+matching FreeImage_ConvertTo* call; the loader converts whatever else they return.
+*/
+FIBOOL FreeImage_GetLoadTarget(FREE_IMAGE_TYPE *type, unsigned *bpp);
+
 
 
 // ==========================================================
@@ -244,6 +279,35 @@ CalculateScanLine(uint8_t *bits, const unsigned pitch, const int scanline) {
 	return bits ? (bits + ((size_t)pitch * scanline)) : nullptr;
 }
 
+// Function taken from "Ordered Dithering, Stephen Hawley, Graphics Gems, Academic Press, 1990"
+// This function is used to generate a Bayer dithering matrice whose dimension are 2^size by 2^size
+// It is used by FreeImage_Dither and FreeImage_ApplyPalette
+//
+inline int
+dithervalue(int x, int y, int size) {
+	int d = 0;
+	/*
+	 * calculate the dither value at a particular
+	 * (x, y) over the size of the matrix.
+	 */
+	while (size-->0)	{
+		/* Think of d as the density. At every iteration,
+		 * d is shifted left one and a new bit is put in the
+		 * low bit based on x and y. If x is odd and y is even,
+		 * or x is even and y is odd, a bit is put in. This
+		 * generates the checkerboard seen in dithering.
+		 * This quantity is shifted left again and the low bit of
+		 * y is added in.
+		 * This whole thing interleaves a checkerboard bit pattern
+		 * and y's bits, which is the value you want.
+		 */
+		d = (d <<1 | ((x&1) ^ (y&1)))<<1 | (y&1);
+		x >>= 1;
+		y >>= 1;
+	}
+	return d;
+}
+
 // ----------------------------------------------------------
 
 /**
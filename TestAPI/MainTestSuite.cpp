@@ -104,6 +104,9 @@ int main(int argc, char *argv[]) {
 	// test memory IO
 	testMemIO("sample.png");
 
+	// test loading into a requested layout
+	testLoadAs();
+
 	// test multipage functions
 	testMultiPage("sample.png");
 
@@ -133,11 +136,28 @@ int main(int argc, char *argv[]) {
 
 	// other tests
 	testConvertToFloat();
+	testConvertToType();
 	testConvertToColor();
+	testConvertYuvPlanes();
+	testConvertInPlace();
+	testConvertLine();
 	testFindMinMax();
+	testRotateQuarterTurns();
+	testBilevel();
+	testAlphaBlending();
+	testTopDown();
+	testSharedPixels();
+	testForEachTile();
 	testTmoClamp();
 	testTmoLinear();
+	testTmoGlobal();
 	testHistogram();
+	testStatistics();
+	testPointOps();
+	testColorMapping();
+	testColorQuantize();
+	testApplyPalette();
+	testHalftoning();
 
 	return 0;
 }
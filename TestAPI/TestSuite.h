@@ -64,6 +64,7 @@ void testExifRaw();
 // ==========================================================
 
 void testMemIO(const char *lpszPathName);
+void testLoadAs();
 
 // Multipage test suite
 // ==========================================================
@@ -93,16 +94,33 @@ void testThumbnail(const char *lpszPathName, int flags);
 void testWrappedBuffer(const char *lpszPathName, int flags);
 
 void testCreateView(const char *lpszPathName, int flags);
+void testTopDown();
+void testSharedPixels();
+void testForEachTile();
 
 // Other tests
 // ==========================================================
 
 void testConvertToFloat();
+void testConvertToType();
 void testConvertToColor();
+void testConvertYuvPlanes();
+void testConvertInPlace();
+void testConvertLine();
 void testFindMinMax();
+void testRotateQuarterTurns();
+void testBilevel();
+void testAlphaBlending();
 void testTmoClamp();
 void testTmoLinear();
+void testTmoGlobal();
 void testHistogram();
+void testStatistics();
+void testPointOps();
+void testColorMapping();
+void testColorQuantize();
+void testApplyPalette();
+void testHalftoning();
 void testHeif(FREE_IMAGE_FORMAT fif, const char* src_path, const char* dst_path);
 
 #endif // TEST_FREEIMAGE_API_H
@@ -21,6 +21,7 @@
 
 
 #include "TestSuite.h"
+#include <cstring>
 
 // Local test functions
 // ----------------------------------------------------------
@@ -109,6 +110,60 @@ void testRGBAChannels(FREE_IMAGE_TYPE image_type, unsigned width, unsigned heigh
 	FreeImage_Unload(src);
 }
 
+void testSplitMergeChannels(FREE_IMAGE_TYPE image_type, unsigned bpp, unsigned width, unsigned height) {
+	// create a test image with a distinct value in every byte
+	FIBITMAP *src = FreeImage_AllocateT(image_type, width, height, bpp);
+	assert(src != NULL);
+	const unsigned line = FreeImage_GetLine(src);
+	for(unsigned y = 0; y < height; y++) {
+		uint8_t *bits = FreeImage_GetScanLine(src, y);
+		for(unsigned x = 0; x < line; x++) {
+			bits[x] = (uint8_t)(x * 7 + y * 13);
+		}
+	}
+
+	FIBITMAP *planes[4] = { NULL, NULL, NULL, NULL };
+	const unsigned count = FreeImage_SplitChannels(src, planes);
+	assert(count == FreeImage_GetChannelsNumber(src));
+
+	// the planes match FreeImage_GetChannel
+	if((image_type != FIT_COMPLEX) && (image_type != FIT_COMPLEXF) && (image_type != FIT_RGB32) && (image_type != FIT_RGBA32)) {
+		const FREE_IMAGE_COLOR_CHANNEL channels[4] = { FICC_RED, FICC_GREEN, FICC_BLUE, FICC_ALPHA };
+		for(unsigned c = 0; c < count; c++) {
+			FIBITMAP *channel = FreeImage_GetChannel(src, channels[c]);
+			assert(channel != NULL);
+			const unsigned plane_line = FreeImage_GetWidth(channel) * FreeImage_GetBPP(channel) / 8;
+			for(unsigned y = 0; y < height; y++) {
+				assert(memcmp(FreeImage_GetScanLine(channel, y), FreeImage_GetScanLine(planes[c], y), plane_line) == 0);
+			}
+			FreeImage_Unload(channel);
+		}
+	}
+
+	// merging the planes gives back the image
+	FIBITMAP *dst = FreeImage_MergeChannels(planes, count, image_type);
+	assert(dst != NULL);
+	assert(FreeImage_GetBPP(dst) == bpp);
+	const unsigned pixels_line = width * bpp / 8;
+	for(unsigned y = 0; y < height; y++) {
+		assert(memcmp(FreeImage_GetScanLine(src, y), FreeImage_GetScanLine(dst, y), pixels_line) == 0);
+	}
+	FreeImage_Unload(dst);
+
+	// planes of different sizes are rejected
+	FIBITMAP *small = FreeImage_AllocateT(FreeImage_GetImageType(planes[0]), width / 2, height, FreeImage_GetBPP(planes[0]));
+	FIBITMAP *first = planes[0];
+	planes[0] = small;
+	assert(FreeImage_MergeChannels(planes, count, image_type) == NULL);
+	planes[0] = first;
+	FreeImage_Unload(small);
+
+	for(unsigned c = 0; c < count; c++) {
+		FreeImage_Unload(planes[c]);
+	}
+	FreeImage_Unload(src);
+}
+
 // Main test functions
 // ----------------------------------------------------------
 
@@ -124,4 +179,14 @@ void testImageChannels(unsigned width, unsigned height) {
 
 	testRGBAChannels(FIT_RGBF, width, height, FALSE);
 	testRGBAChannels(FIT_RGBAF, width, height, TRUE);
+
+	testSplitMergeChannels(FIT_BITMAP, 24, width + 3, height);
+	testSplitMergeChannels(FIT_BITMAP, 32, width + 3, height);
+	testSplitMergeChannels(FIT_RGB16, 48, width + 1, height);
+	testSplitMergeChannels(FIT_RGBA16, 64, width + 1, height);
+	testSplitMergeChannels(FIT_RGBA32, 128, width, height);
+	testSplitMergeChannels(FIT_RGBF, 96, width + 1, height);
+	testSplitMergeChannels(FIT_RGBAF, 128, width + 1, height);
+	testSplitMergeChannels(FIT_COMPLEXF, 64, width + 1, height);
+	testSplitMergeChannels(FIT_COMPLEX, 128, width + 1, height);
 }
@@ -24,6 +24,8 @@
 #include <memory>
 #include <limits>
 #include <vector>
+#include <cmath>
+#include <cstring>
 
 /**
 Test FreeImage_GetHistogram
@@ -161,3 +163,778 @@ void testHistogram()
 	assert(hist[31] == 0);
 }
 
+namespace
+{
+	bool closeTo(double value, double expected)
+	{
+		return std::fabs(value - expected) <= 1e-9 * std::max(1.0, std::fabs(expected));
+	}
+}
+
+/**
+Test FreeImage_GetStatistics against plain loops, on images large enough to be split in bands
+*/
+void testStatistics()
+{
+	const unsigned width = 509;
+	const unsigned height = 397;
+	const double n = static_cast<double>(width) * height;
+	uint32_t seed = 12345;
+	const auto Next = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	};
+
+	// 32-bit images: channels are listed red, green, blue, alpha whatever the color order
+	{
+		static const unsigned order[4] = { FI_RGBA_RED, FI_RGBA_GREEN, FI_RGBA_BLUE, FI_RGBA_ALPHA };
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bmp(FreeImage_Allocate(width, height, 32), &::FreeImage_Unload);
+		std::vector<uint32_t> refHist(4 * 256);
+		double refSum[4]{}, refSq[4]{};
+		unsigned refMin[4] = { 255, 255, 255, 255 }, refMax[4]{};
+		uint64_t transparent = 0, opaque = 0;
+		for (unsigned y = 0; y < height; ++y) {
+			uint8_t* bits = FreeImage_GetScanLine(bmp.get(), y);
+			for (unsigned x = 0; x < width; ++x, bits += 4) {
+				for (unsigned c = 0; c < 4; ++c) {
+					// a third of the alpha values are 0 or 255
+					uint8_t v = static_cast<uint8_t>(Next());
+					if (c == 3 && x % 3 == 0) {
+						v = (v & 1) ? 255 : 0;
+					}
+					bits[order[c]] = v;
+					++refHist[c * 256 + v];
+					refSum[c] += v;
+					refSq[c] += static_cast<double>(v) * v;
+					refMin[c] = std::min<unsigned>(refMin[c], v);
+					refMax[c] = std::max<unsigned>(refMax[c], v);
+				}
+				transparent += bits[FI_RGBA_ALPHA] == 0 ? 1 : 0;
+				opaque += bits[FI_RGBA_ALPHA] == 255 ? 1 : 0;
+			}
+		}
+
+		FISTATISTICS stats{};
+		std::vector<uint32_t> hist(4 * 256);
+		bool success = FreeImage_GetStatistics(bmp.get(), &stats, hist.data());
+		assert(success);
+		assert(stats.channels == 4);
+		assert(stats.pixels == static_cast<uint64_t>(width) * height);
+		assert(stats.transparent == transparent);
+		assert(stats.opaque == opaque);
+		assert(stats.histogram_min == 0.0 && stats.histogram_max == 255.0);
+		assert(hist == refHist);
+		for (unsigned c = 0; c < 4; ++c) {
+			const double mean = refSum[c] / n;
+			assert(stats.channel[c].min == refMin[c]);
+			assert(stats.channel[c].max == refMax[c]);
+			assert(closeTo(stats.channel[c].mean, mean));
+			assert(closeTo(stats.channel[c].variance, refSq[c] / n - mean * mean));
+		}
+
+		// without histograms
+		FISTATISTICS stats2{};
+		success = FreeImage_GetStatistics(bmp.get(), &stats2);
+		assert(success);
+		assert(stats2.channel[2].mean == stats.channel[2].mean);
+		assert(stats2.histogram_min == 0.0 && stats2.histogram_max == 0.0);
+	}
+
+	// 16-bit greyscale image into 16 bins, compared with FreeImage_MakeHistogram
+	{
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bmp(FreeImage_AllocateT(FIT_UINT16, width, height), &::FreeImage_Unload);
+		std::vector<uint32_t> refHist(16);
+		double refSum = 0.0;
+		for (unsigned y = 0; y < height; ++y) {
+			uint16_t* bits = reinterpret_cast<uint16_t*>(FreeImage_GetScanLine(bmp.get(), y));
+			for (unsigned x = 0; x < width; ++x) {
+				bits[x] = static_cast<uint16_t>(Next());
+				++refHist[bits[x] >> 12];
+				refSum += bits[x];
+			}
+		}
+
+		FISTATISTICS stats{};
+		std::vector<uint32_t> hist(16);
+		bool success = FreeImage_GetStatistics(bmp.get(), &stats, hist.data(), 16);
+		assert(success);
+		assert(stats.channels == 1);
+		assert(stats.opaque == stats.pixels && stats.transparent == 0);
+		assert(hist == refHist);
+		assert(closeTo(stats.channel[0].mean, refSum / n));
+
+		uint16_t histMin{}, histMax{};
+		std::vector<uint32_t> made(16);
+		success = FreeImage_MakeHistogram(bmp.get(), 16, &histMin, &histMax, made.data());
+		assert(success);
+		assert(made == refHist);
+	}
+
+	// float RGB image far from 0: histograms over the data bounds and over a given range
+	{
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bmp(FreeImage_AllocateT(FIT_RGBF, width, height), &::FreeImage_Unload);
+		double refSum[3]{}, refMin = 1e30, refMax = -1e30;
+		for (unsigned y = 0; y < height; ++y) {
+			FIRGBF* bits = reinterpret_cast<FIRGBF*>(FreeImage_GetScanLine(bmp.get(), y));
+			for (unsigned x = 0; x < width; ++x) {
+				bits[x].red   = 1000.0f + (Next() % 1000) / 100.0f;
+				bits[x].green = 1000.0f + (Next() % 1000) / 100.0f;
+				bits[x].blue  = 1000.0f + (Next() % 1000) / 100.0f;
+				const float* v = &bits[x].red;
+				for (unsigned c = 0; c < 3; ++c) {
+					refSum[c] += v[c];
+					refMin = std::min<double>(refMin, v[c]);
+					refMax = std::max<double>(refMax, v[c]);
+				}
+			}
+		}
+		double refSq[3]{};
+		for (unsigned y = 0; y < height; ++y) {
+			const FIRGBF* bits = reinterpret_cast<const FIRGBF*>(FreeImage_GetScanLine(bmp.get(), y));
+			for (unsigned x = 0; x < width; ++x) {
+				const float* v = &bits[x].red;
+				for (unsigned c = 0; c < 3; ++c) {
+					const double d = v[c] - refSum[c] / n;
+					refSq[c] += d * d;
+				}
+			}
+		}
+
+		FISTATISTICS stats{};
+		std::vector<uint32_t> hist(3 * 10);
+		bool success = FreeImage_GetStatistics(bmp.get(), &stats, hist.data(), 10);
+		assert(success);
+		assert(stats.channels == 3);
+		assert(stats.histogram_min == refMin && stats.histogram_max == refMax);
+		for (unsigned c = 0; c < 3; ++c) {
+			assert(closeTo(stats.channel[c].mean, refSum[c] / n));
+			assert(std::fabs(stats.channel[c].variance - refSq[c] / n) < 1e-6);
+			uint32_t count = 0;
+			for (unsigned i = 0; i < 10; ++i) {
+				count += hist[c * 10 + i];
+			}
+			assert(count == width * height);
+		}
+
+		// the bands are merged in a fixed order, so float sums repeat exactly
+		for (int run = 0; run < 8; ++run) {
+			FISTATISTICS again{};
+			success = FreeImage_GetStatistics(bmp.get(), &again);
+			assert(success);
+			for (unsigned c = 0; c < 3; ++c) {
+				assert(again.channel[c].mean == stats.channel[c].mean);
+				assert(again.channel[c].variance == stats.channel[c].variance);
+			}
+		}
+
+		// every sample is above the given range and lands in the last bin
+		success = FreeImage_GetStatistics(bmp.get(), &stats, hist.data(), 10, 0.0, 1.0);
+		assert(success);
+		assert(stats.histogram_min == 0.0 && stats.histogram_max == 1.0);
+		assert(hist[9] == width * height && hist[19] == width * height && hist[29] == width * height);
+	}
+
+	// FreeImage_FindMinMaxValue of signed samples
+	{
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bmp(FreeImage_AllocateT(FIT_INT16, width, height), &::FreeImage_Unload);
+		for (unsigned y = 0; y < height; ++y) {
+			int16_t* bits = reinterpret_cast<int16_t*>(FreeImage_GetScanLine(bmp.get(), y));
+			for (unsigned x = 0; x < width; ++x) {
+				bits[x] = static_cast<int16_t>(static_cast<int>(Next() % 2001) - 1000);
+			}
+		}
+		reinterpret_cast<int16_t*>(FreeImage_GetScanLine(bmp.get(), height / 2))[7] = -1234;
+		reinterpret_cast<int16_t*>(FreeImage_GetScanLine(bmp.get(), height - 1))[width - 1] = 4321;
+
+		int16_t minVal{}, maxVal{};
+		bool success = FreeImage_FindMinMaxValue(bmp.get(), &minVal, &maxVal);
+		assert(success);
+		assert(minVal == -1234 && maxVal == 4321);
+
+		FISTATISTICS stats{};
+		success = FreeImage_GetStatistics(bmp.get(), &stats);
+		assert(success);
+		assert(stats.channel[0].min == -1234 && stats.channel[0].max == 4321);
+	}
+
+	// NaN samples are skipped, the first one included
+	{
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bmp(FreeImage_AllocateT(FIT_FLOAT, width, height), &::FreeImage_Unload);
+		double refSum = 0.0, refSq = 0.0, valid = 0.0;
+		float refMin = 1e30f, refMax = -1e30f;
+		for (unsigned y = 0; y < height; ++y) {
+			float* bits = reinterpret_cast<float*>(FreeImage_GetScanLine(bmp.get(), y));
+			for (unsigned x = 0; x < width; ++x) {
+				if ((x + y) % 7 == 0) {
+					bits[x] = std::numeric_limits<float>::quiet_NaN();
+					continue;
+				}
+				bits[x] = (Next() % 1000) / 10.0f - 20.0f;
+				refSum += bits[x];
+				refSq += static_cast<double>(bits[x]) * bits[x];
+				refMin = std::min(refMin, bits[x]);
+				refMax = std::max(refMax, bits[x]);
+				valid += 1.0;
+			}
+		}
+
+		FISTATISTICS stats{};
+		std::vector<uint32_t> hist(8);
+		bool success = FreeImage_GetStatistics(bmp.get(), &stats, hist.data(), 8);
+		assert(success);
+		const double mean = refSum / valid;
+		assert(stats.channel[0].min == refMin && stats.channel[0].max == refMax);
+		assert(closeTo(stats.channel[0].mean, mean));
+		assert(std::fabs(stats.channel[0].variance - (refSq / valid - mean * mean)) < 1e-6);
+		uint32_t count = 0;
+		for (uint32_t bin : hist) {
+			count += bin;
+		}
+		assert(count == static_cast<uint32_t>(valid));
+	}
+
+	// types without statistics
+	{
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bmp(FreeImage_Allocate(16, 16, 1), &::FreeImage_Unload);
+		FISTATISTICS stats{};
+		bool success = FreeImage_GetStatistics(bmp.get(), &stats);
+		assert(!success);
+	}
+}
+
+/**
+Test FreeImage_ApplyPointOps against the separate adjustment functions and the plain formulas
+*/
+void testPointOps()
+{
+	using UniqueBitmap = std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>;
+	uint32_t seed = 4321;
+	const auto Next = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	};
+
+	uint8_t curve[256];
+	for (unsigned i = 0; i < 256; ++i) {
+		curve[i] = static_cast<uint8_t>(i < 128 ? 2 * i : 255 - (i - 128) / 2);
+	}
+
+	std::unique_ptr<FIPOINTOPS, decltype(&::FreeImage_DeletePointOps)> ops(FreeImage_CreatePointOps(), &::FreeImage_DeletePointOps);
+	assert(ops);
+	bool success = FreeImage_PointOpsAddContrast(ops.get(), 15.0);
+	assert(success);
+	success = FreeImage_PointOpsAddBrightness(ops.get(), -20.0);
+	assert(success);
+	success = FreeImage_PointOpsAddGamma(ops.get(), 1.8);
+	assert(success);
+	success = FreeImage_PointOpsAddCurve(ops.get(), curve, FICC_GREEN);
+	assert(success);
+	success = FreeImage_PointOpsAddInvert(ops.get());
+	assert(success);
+	success = FreeImage_PointOpsAddGamma(ops.get(), 0.0);
+	assert(!success);
+	success = FreeImage_PointOpsAddInvert(ops.get(), FICC_BLACK);
+	assert(!success);
+
+	// 8-bit samples: identical to the successive calls
+	{
+		UniqueBitmap bmp(FreeImage_Allocate(301, 257, 24), &::FreeImage_Unload);
+		for (unsigned y = 0; y < 257; ++y) {
+			uint8_t* bits = FreeImage_GetScanLine(bmp.get(), y);
+			for (unsigned x = 0; x < 301 * 3; ++x) {
+				bits[x] = static_cast<uint8_t>(Next());
+			}
+		}
+		UniqueBitmap ref(FreeImage_Clone(bmp.get()), &::FreeImage_Unload);
+		FreeImage_AdjustContrast(ref.get(), 15.0);
+		FreeImage_AdjustBrightness(ref.get(), -20.0);
+		FreeImage_AdjustGamma(ref.get(), 1.8);
+		FreeImage_AdjustCurve(ref.get(), curve, FICC_GREEN);
+		FreeImage_Invert(ref.get());
+
+		success = FreeImage_ApplyPointOps(bmp.get(), ops.get());
+		assert(success);
+		for (unsigned y = 0; y < 257; ++y) {
+			assert(memcmp(FreeImage_GetScanLine(bmp.get(), y), FreeImage_GetScanLine(ref.get(), y), 301 * 3) == 0);
+		}
+	}
+
+	// alpha only
+	{
+		std::unique_ptr<FIPOINTOPS, decltype(&::FreeImage_DeletePointOps)> alpha(FreeImage_CreatePointOps(), &::FreeImage_DeletePointOps);
+		success = FreeImage_PointOpsAddInvert(alpha.get(), FICC_ALPHA);
+		assert(success);
+		UniqueBitmap bmp(FreeImage_Allocate(5, 3, 32), &::FreeImage_Unload);
+		FIRGBA8* pixel = reinterpret_cast<FIRGBA8*>(FreeImage_GetScanLine(bmp.get(), 1));
+		pixel->red = 10;
+		pixel->green = 20;
+		pixel->blue = 30;
+		pixel->alpha = 40;
+		success = FreeImage_ApplyPointOps(bmp.get(), alpha.get());
+		assert(success);
+		assert(pixel->red == 10 && pixel->green == 20 && pixel->blue == 30 && pixel->alpha == 215);
+	}
+
+	// 16-bit samples, evaluated directly on small images and through tables on large ones
+	{
+		std::unique_ptr<FIPOINTOPS, decltype(&::FreeImage_DeletePointOps)> bright(FreeImage_CreatePointOps(), &::FreeImage_DeletePointOps);
+		success = FreeImage_PointOpsAddBrightness(bright.get(), 50.0, FICC_RED);
+		assert(success);
+		success = FreeImage_PointOpsAddInvert(bright.get(), FICC_BLUE);
+		assert(success);
+		const unsigned widths[] = { 7, 301 };
+		for (unsigned width : widths) {
+			UniqueBitmap bmp(FreeImage_AllocateT(FIT_RGB16, width, 257), &::FreeImage_Unload);
+			for (unsigned y = 0; y < 257; ++y) {
+				uint16_t* bits = reinterpret_cast<uint16_t*>(FreeImage_GetScanLine(bmp.get(), y));
+				for (unsigned x = 0; x < width * 3; ++x) {
+					bits[x] = static_cast<uint16_t>(Next());
+				}
+			}
+			UniqueBitmap ref(FreeImage_Clone(bmp.get()), &::FreeImage_Unload);
+			success = FreeImage_ApplyPointOps(bmp.get(), bright.get());
+			assert(success);
+			for (unsigned y = 0; y < 257; ++y) {
+				const FIRGB16* src = reinterpret_cast<const FIRGB16*>(FreeImage_GetScanLine(ref.get(), y));
+				const FIRGB16* dst = reinterpret_cast<const FIRGB16*>(FreeImage_GetScanLine(bmp.get(), y));
+				for (unsigned x = 0; x < width; ++x) {
+					const double red = std::min(1.0, src[x].red / 65535.0 * 1.5);
+					assert(dst[x].red == static_cast<uint16_t>(red * 65535.0 + 0.5));
+					assert(dst[x].green == src[x].green);
+					assert(dst[x].blue == 65535 - src[x].blue);
+				}
+			}
+		}
+	}
+
+	// float samples are not clamped
+	{
+		std::unique_ptr<FIPOINTOPS, decltype(&::FreeImage_DeletePointOps)> contrast(FreeImage_CreatePointOps(), &::FreeImage_DeletePointOps);
+		success = FreeImage_PointOpsAddContrast(contrast.get(), 100.0);
+		assert(success);
+		success = FreeImage_PointOpsAddInvert(contrast.get());
+		assert(success);
+		UniqueBitmap bmp(FreeImage_AllocateT(FIT_RGBAF, 33, 9), &::FreeImage_Unload);
+		for (unsigned y = 0; y < 9; ++y) {
+			FIRGBAF* bits = reinterpret_cast<FIRGBAF*>(FreeImage_GetScanLine(bmp.get(), y));
+			for (unsigned x = 0; x < 33; ++x) {
+				bits[x].red = x * 0.1f;
+				bits[x].green = y * 0.2f;
+				bits[x].blue = -1.0f;
+				bits[x].alpha = 0.25f;
+			}
+		}
+		success = FreeImage_ApplyPointOps(bmp.get(), contrast.get());
+		assert(success);
+		for (unsigned y = 0; y < 9; ++y) {
+			const FIRGBAF* bits = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(bmp.get(), y));
+			for (unsigned x = 0; x < 33; ++x) {
+				assert(std::fabs(bits[x].red - (1.0f - (0.5f + (x * 0.1f - 0.5f) * 2.0f))) < 1e-5f);
+				assert(std::fabs(bits[x].green - (1.0f - (0.5f + (y * 0.2f - 0.5f) * 2.0f))) < 1e-5f);
+				assert(bits[x].blue == 3.5f);
+				assert(bits[x].alpha == 0.25f);
+			}
+		}
+	}
+}
+
+namespace
+{
+	/// FreeImage_ApplyColorMapping of one 32-bit pixel, as a linear search
+	bool mapPixel(uint8_t* pixel, const FIRGBA8* src, const FIRGBA8* dst, unsigned count, bool ignoreAlpha, bool swap)
+	{
+		for (unsigned j = 0; j < count; ++j) {
+			for (int i = 0; i < (swap ? 2 : 1); ++i) {
+				const FIRGBA8& a = i ? dst[j] : src[j];
+				const FIRGBA8& b = i ? src[j] : dst[j];
+				if (pixel[FI_RGBA_BLUE] == a.blue && pixel[FI_RGBA_GREEN] == a.green && pixel[FI_RGBA_RED] == a.red && (ignoreAlpha || pixel[FI_RGBA_ALPHA] == a.alpha)) {
+					pixel[FI_RGBA_BLUE] = b.blue;
+					pixel[FI_RGBA_GREEN] = b.green;
+					pixel[FI_RGBA_RED] = b.red;
+					if (!ignoreAlpha) {
+						pixel[FI_RGBA_ALPHA] = b.alpha;
+					}
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+}
+
+/**
+Test FreeImage_ApplyColorMapping with small and large mappings against a linear search
+*/
+void testColorMapping()
+{
+	using UniqueBitmap = std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>;
+	uint32_t seed = 777;
+	const auto Next = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	};
+	const auto RandomColor = [&Next]() {
+		// few values per channel, so that pixels hit the mappings
+		FIRGBA8 c;
+		c.red = static_cast<uint8_t>(Next() % 7);
+		c.green = static_cast<uint8_t>(Next() % 7);
+		c.blue = static_cast<uint8_t>(Next() % 7);
+		c.alpha = static_cast<uint8_t>(Next() % 2 ? 255 : 0);
+		return c;
+	};
+
+	const unsigned width = 203, height = 151;
+	UniqueBitmap bmp(FreeImage_Allocate(width, height, 32), &::FreeImage_Unload);
+	for (unsigned y = 0; y < height; ++y) {
+		FIRGBA8* bits = reinterpret_cast<FIRGBA8*>(FreeImage_GetScanLine(bmp.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			bits[x] = RandomColor();
+		}
+	}
+
+	// 200 entries with repeated colors, and 3 entries
+	const unsigned counts[] = { 200, 3 };
+	for (unsigned count : counts) {
+		std::vector<FIRGBA8> src(count), dst(count);
+		for (unsigned j = 0; j < count; ++j) {
+			src[j] = RandomColor();
+			dst[j] = RandomColor();
+		}
+		for (int mode = 0; mode < 4; ++mode) {
+			const bool ignoreAlpha = (mode & 1) != 0;
+			const bool swap = (mode & 2) != 0;
+			UniqueBitmap ref(FreeImage_Clone(bmp.get()), &::FreeImage_Unload);
+			unsigned refCount = 0;
+			for (unsigned y = 0; y < height; ++y) {
+				uint8_t* bits = FreeImage_GetScanLine(ref.get(), y);
+				for (unsigned x = 0; x < width; ++x, bits += 4) {
+					refCount += mapPixel(bits, src.data(), dst.data(), count, ignoreAlpha, swap) ? 1 : 0;
+				}
+			}
+
+			UniqueBitmap img(FreeImage_Clone(bmp.get()), &::FreeImage_Unload);
+			const unsigned mapped = FreeImage_ApplyColorMapping(img.get(), src.data(), dst.data(), count, ignoreAlpha, swap);
+			assert(mapped == refCount);
+			assert(mapped > 0);
+			for (unsigned y = 0; y < height; ++y) {
+				assert(memcmp(FreeImage_GetScanLine(img.get(), y), FreeImage_GetScanLine(ref.get(), y), width * 4) == 0);
+			}
+		}
+	}
+
+	// 24-bit FreeImage_SwapColors
+	{
+		UniqueBitmap rgb(FreeImage_Allocate(3, 1, 24), &::FreeImage_Unload);
+		uint8_t* bits = FreeImage_GetScanLine(rgb.get(), 0);
+		FIRGBA8 a{}, b{};
+		a.red = 10;
+		b.blue = 20;
+		bits[FI_RGBA_RED] = 10;
+		bits[3 + FI_RGBA_BLUE] = 20;
+		bits[6 + FI_RGBA_GREEN] = 30;
+		const unsigned swapped = FreeImage_SwapColors(rgb.get(), &a, &b, TRUE);
+		assert(swapped == 2);
+		assert(bits[FI_RGBA_RED] == 0 && bits[FI_RGBA_BLUE] == 20);
+		assert(bits[3 + FI_RGBA_RED] == 10 && bits[3 + FI_RGBA_BLUE] == 0);
+		assert(bits[6 + FI_RGBA_GREEN] == 30);
+	}
+}
+
+/**
+Test FreeImage_ColorQuantizeEx with the Wu quantizer on an image with a few colors, large enough
+to be counted in several bands: every pixel must be mapped to its own color
+*/
+void testColorQuantize()
+{
+	using UniqueBitmap = std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>;
+	const uint8_t levels[] = { 16, 96, 200 };
+
+	const unsigned bpps[] = { 24, 32 };
+	for (unsigned bpp : bpps) {
+		const unsigned width = 1024, height = 611, bytespp = bpp / 8;
+		UniqueBitmap bmp(FreeImage_Allocate(width, height, bpp), &::FreeImage_Unload);
+		for (unsigned y = 0; y < height; ++y) {
+			uint8_t* bits = FreeImage_GetScanLine(bmp.get(), y);
+			for (unsigned x = 0; x < width; ++x, bits += bytespp) {
+				const unsigned c = (x / 64 + y / 32) % 27;
+				bits[FI_RGBA_RED] = levels[c % 3];
+				bits[FI_RGBA_GREEN] = levels[(c / 3) % 3];
+				bits[FI_RGBA_BLUE] = levels[c / 9];
+				if (bpp == 32) {
+					bits[FI_RGBA_ALPHA] = 255;
+				}
+			}
+		}
+
+		UniqueBitmap dst(FreeImage_ColorQuantizeEx(bmp.get(), FIQ_WUQUANT), &::FreeImage_Unload);
+		assert(dst);
+		assert(FreeImage_GetBPP(dst.get()) == 8);
+		const FIRGBA8* pal = FreeImage_GetPalette(dst.get());
+		for (unsigned y = 0; y < height; ++y) {
+			const uint8_t* src = FreeImage_GetScanLine(bmp.get(), y);
+			const uint8_t* index = FreeImage_GetScanLine(dst.get(), y);
+			for (unsigned x = 0; x < width; ++x, src += bytespp) {
+				const FIRGBA8& color = pal[index[x]];
+				assert(color.red == src[FI_RGBA_RED] && color.green == src[FI_RGBA_GREEN] && color.blue == src[FI_RGBA_BLUE]);
+			}
+		}
+	}
+}
+
+/**
+Test FreeImage_ApplyPalette against a linear nearest color search, and its dithering modes
+*/
+void testApplyPalette()
+{
+	using UniqueBitmap = std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>;
+	uint32_t seed = 4242;
+	const auto Next = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	};
+
+	const unsigned count = 50;
+	FIRGBA8 palette[count];
+	for (unsigned i = 0; i < count; ++i) {
+		palette[i].red = static_cast<uint8_t>(Next());
+		palette[i].green = static_cast<uint8_t>(Next());
+		palette[i].blue = static_cast<uint8_t>(Next());
+		palette[i].alpha = 255;
+	}
+	// a duplicate entry maps to the first one
+	palette[count - 1] = palette[3];
+
+	const unsigned width = 301, height = 207;
+	UniqueBitmap bmp(FreeImage_Allocate(width, height, 24), &::FreeImage_Unload);
+	for (unsigned y = 0; y < height; ++y) {
+		uint8_t* bits = FreeImage_GetScanLine(bmp.get(), y);
+		for (unsigned x = 0; x < width * 3; ++x) {
+			bits[x] = static_cast<uint8_t>(Next());
+		}
+	}
+	// palette colors map to themselves
+	uint8_t* first = FreeImage_GetScanLine(bmp.get(), 0);
+	for (unsigned i = 0; i < count; ++i) {
+		first[3 * i + FI_RGBA_RED] = palette[i].red;
+		first[3 * i + FI_RGBA_GREEN] = palette[i].green;
+		first[3 * i + FI_RGBA_BLUE] = palette[i].blue;
+	}
+
+	// twice, the second call using the cached inverse map
+	for (int pass = 0; pass < 2; ++pass) {
+		UniqueBitmap dst(FreeImage_ApplyPalette(bmp.get(), palette, count), &::FreeImage_Unload);
+		assert(dst);
+		assert(FreeImage_GetBPP(dst.get()) == 8);
+		assert(memcmp(FreeImage_GetPalette(dst.get()), palette, sizeof(palette)) == 0);
+		for (unsigned y = 0; y < height; ++y) {
+			const uint8_t* bits = FreeImage_GetScanLine(bmp.get(), y);
+			const uint8_t* index = FreeImage_GetScanLine(dst.get(), y);
+			for (unsigned x = 0; x < width; ++x, bits += 3) {
+				unsigned best = 0;
+				int bestDist = std::numeric_limits<int>::max();
+				for (unsigned i = 0; i < count; ++i) {
+					const int dr = bits[FI_RGBA_RED] - palette[i].red;
+					const int dg = bits[FI_RGBA_GREEN] - palette[i].green;
+					const int db = bits[FI_RGBA_BLUE] - palette[i].blue;
+					const int dist = dr * dr + dg * dg + db * db;
+					if (dist < bestDist) {
+						bestDist = dist;
+						best = i;
+					}
+				}
+				assert(index[x] == best);
+			}
+		}
+		assert(FreeImage_GetScanLine(dst.get(), 0)[count - 1] == 3);
+	}
+
+	// dithering a mid grey onto black and white mixes them
+	FIRGBA8 bw[2] = {};
+	bw[1].red = bw[1].green = bw[1].blue = 255;
+	const FREE_IMAGE_DITHER algorithms[] = { FID_FS, FID_BAYER4x4, FID_BAYER8x8, FID_BAYER16x16 };
+	for (FREE_IMAGE_DITHER algorithm : algorithms) {
+		UniqueBitmap grey(FreeImage_Allocate(64, 64, 32), &::FreeImage_Unload);
+		for (unsigned y = 0; y < 64; ++y) {
+			memset(FreeImage_GetScanLine(grey.get(), y), 128, 64 * 4);
+		}
+		UniqueBitmap dst(FreeImage_ApplyPalette(grey.get(), bw, 2, TRUE, algorithm), &::FreeImage_Unload);
+		assert(dst);
+		unsigned white = 0;
+		for (unsigned y = 0; y < 64; ++y) {
+			const uint8_t* index = FreeImage_GetScanLine(dst.get(), y);
+			for (unsigned x = 0; x < 64; ++x) {
+				white += index[x];
+			}
+		}
+		assert(white > 64 * 64 * 4 / 10 && white < 64 * 64 * 6 / 10);
+
+	}
+
+	// error diffusion of a palette color has no error to diffuse
+	{
+		UniqueBitmap flat(FreeImage_Allocate(16, 16, 24), &::FreeImage_Unload);
+		for (unsigned y = 0; y < 16; ++y) {
+			uint8_t* bits = FreeImage_GetScanLine(flat.get(), y);
+			for (unsigned x = 0; x < 16; ++x, bits += 3) {
+				bits[FI_RGBA_RED] = palette[7].red;
+				bits[FI_RGBA_GREEN] = palette[7].green;
+				bits[FI_RGBA_BLUE] = palette[7].blue;
+			}
+		}
+		UniqueBitmap mapped(FreeImage_ApplyPalette(flat.get(), palette, count, TRUE, FID_FS), &::FreeImage_Unload);
+		assert(mapped);
+		for (unsigned y = 0; y < 16; ++y) {
+			const uint8_t* index = FreeImage_GetScanLine(mapped.get(), y);
+			for (unsigned x = 0; x < 16; ++x) {
+				assert(index[x] == 7);
+			}
+		}
+	}
+
+	// clustered dot dithering targets bilevel output
+	assert(FreeImage_ApplyPalette(bmp.get(), palette, count, TRUE, FID_CLUSTER6x6) == NULL);
+}
+
+namespace
+{
+	/**
+	Serial Floyd & Steinberg error diffusion of an 8-bit image, as FreeImage_Dither did before it ran as a wavefront.
+	Returns the 0 / 255 levels of every pixel, row by row.
+	*/
+	std::vector<uint8_t> floydSteinbergReference(FIBITMAP* dib)
+	{
+		const int width = static_cast<int>(FreeImage_GetWidth(dib));
+		const int height = static_cast<int>(FreeImage_GetHeight(dib));
+		std::vector<uint8_t> out(static_cast<size_t>(width) * height);
+		std::vector<int> lerr(width), cerr(width);
+		const auto Src = [&](int x, int y) {
+			return static_cast<int>(FreeImage_GetScanLine(dib, y)[x]);
+		};
+		const auto Out = [&](int x, int y) -> uint8_t& {
+			return out[static_cast<size_t>(y) * width + x];
+		};
+		// the library's int LCG, computed without signed overflow
+		uint32_t seed = 0;
+		const auto Threshold = [&seed]() {
+			seed = 1103515245u * seed + 12345u;
+			return 127 + (static_cast<int32_t>(seed) >> 12) % 129 - 64;
+		};
+		const auto InitErr = [](int x, int y) {
+			return x - (y ? 255 : 0) + (127 - x) / 2;
+		};
+
+		// left and right borders, top border
+		const int columns[2] = { 0, width - 1 };
+		for (int x : columns) {
+			int error = 0;
+			for (int y = 0; y < height; ++y) {
+				const int pixel = Src(x, y) + error;
+				const int p = (pixel > Threshold()) ? 255 : 0;
+				error = pixel - p;
+				Out(x, y) = static_cast<uint8_t>(p);
+			}
+		}
+		int error = 0;
+		for (int x = 0; x < width; ++x) {
+			const int pixel = Src(x, 0) + error;
+			const int p = (pixel > Threshold()) ? 255 : 0;
+			error = pixel - p;
+			Out(x, 0) = static_cast<uint8_t>(p);
+			lerr[x] = InitErr(Src(x, 0), p);
+		}
+
+		// interior
+		for (int y = 1; y < height; ++y) {
+			cerr[0] = InitErr(Src(0, y), Out(0, y));
+			for (int x = 1; x < width - 1; ++x) {
+				const int pixel = Src(x, y) + (lerr[x - 1] + 5 * lerr[x] + 3 * lerr[x + 1] + 7 * cerr[x - 1]) / 16;
+				Out(x, y) = (pixel > 127) ? 255 : 0;
+				cerr[x] = pixel - Out(x, y);
+			}
+			cerr[width - 1] = InitErr(Src(width - 1, y), Out(width - 1, y));
+			std::swap(lerr, cerr);
+		}
+		return out;
+	}
+}
+
+/**
+Test FreeImage_Threshold and FreeImage_Dither against per-pixel references
+*/
+void testHalftoning()
+{
+	using UniqueBitmap = std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>;
+	const unsigned width = 613, height = 97;
+	UniqueBitmap grey(FreeImage_Allocate(width, height, 8), &::FreeImage_Unload);
+	FIRGBA8* pal = FreeImage_GetPalette(grey.get());
+	for (unsigned i = 0; i < 256; ++i) {
+		pal[i].red = pal[i].green = pal[i].blue = static_cast<uint8_t>(i);
+	}
+	for (unsigned y = 0; y < height; ++y) {
+		uint8_t* bits = FreeImage_GetScanLine(grey.get(), y);
+		for (unsigned x = 0; x < width; ++x) {
+			bits[x] = static_cast<uint8_t>((x * 255) / width + (y % 7));
+		}
+	}
+	const auto Bit = [](FIBITMAP* dib, unsigned x, unsigned y) {
+		return (FreeImage_GetScanLine(dib, y)[x >> 3] >> (7 - (x & 7))) & 1;
+	};
+
+	const unsigned levels[] = { 0, 1, 128, 255 };
+	for (unsigned T : levels) {
+		UniqueBitmap bw(FreeImage_Threshold(grey.get(), static_cast<uint8_t>(T)), &::FreeImage_Unload);
+		assert(bw && FreeImage_GetBPP(bw.get()) == 1);
+		for (unsigned y = 0; y < height; ++y) {
+			const uint8_t* bits = FreeImage_GetScanLine(grey.get(), y);
+			for (unsigned x = 0; x < width; ++x) {
+				assert(Bit(bw.get(), x, y) == (bits[x] >= T ? 1 : 0));
+			}
+			// padding bits stay clear
+			assert((FreeImage_GetScanLine(bw.get(), y)[width >> 3] & (0xFF >> (width & 7))) == 0);
+		}
+	}
+
+	// Bayer 4x4: white above 255 * (d + 0.5) / 16, d being the Bayer value of (y % 4, x % 4)
+	const int bayer4[16] = { 0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5 };
+	{
+		UniqueBitmap bw(FreeImage_Dither(grey.get(), FID_BAYER4x4), &::FreeImage_Unload);
+		assert(bw && FreeImage_GetBPP(bw.get()) == 1);
+		for (unsigned y = 0; y < height; ++y) {
+			const uint8_t* bits = FreeImage_GetScanLine(grey.get(), y);
+			for (unsigned x = 0; x < width; ++x) {
+				const int m = static_cast<uint8_t>(255 * ((bayer4[4 * (x % 4) + (y % 4)] + 0.5) / 16));
+				assert(Bit(bw.get(), x, y) == (bits[x] > m ? 1 : 0));
+			}
+		}
+	}
+
+	// error diffusion keeps the mean level and is reproducible
+	{
+		UniqueBitmap a(FreeImage_Dither(grey.get(), FID_FS), &::FreeImage_Unload);
+		UniqueBitmap b(FreeImage_Dither(grey.get(), FID_FS), &::FreeImage_Unload);
+		assert(a && b);
+		uint64_t white = 0, sum = 0;
+		for (unsigned y = 0; y < height; ++y) {
+			assert(memcmp(FreeImage_GetScanLine(a.get(), y), FreeImage_GetScanLine(b.get(), y), FreeImage_GetLine(a.get())) == 0);
+			const uint8_t* bits = FreeImage_GetScanLine(grey.get(), y);
+			for (unsigned x = 0; x < width; ++x) {
+				white += Bit(a.get(), x, y);
+				sum += bits[x];
+			}
+		}
+		const double expected = static_cast<double>(sum) / 255;
+		assert(std::fabs(static_cast<double>(white) - expected) < 0.02 * width * height);
+	}
+
+	// the wavefront gives the same pixels as the serial diffusion
+	{
+		UniqueBitmap bw(FreeImage_Dither(grey.get(), FID_FS), &::FreeImage_Unload);
+		assert(bw);
+		const std::vector<uint8_t> expected = floydSteinbergReference(grey.get());
+		for (unsigned y = 0; y < height; ++y) {
+			for (unsigned x = 0; x < width; ++x) {
+				assert(Bit(bw.get(), x, y) == (expected[y * width + x] ? 1 : 0));
+			}
+		}
+	}
+}
@@ -2,7 +2,7 @@
 // FreeImage 3 Test Script
 //
 // Design and implementation by
-// - Herv Drolon (drolon@infonie.fr)
+// - Herv� Drolon (drolon@infonie.fr)
 //
 // This file is part of FreeImage 3
 //
@@ -23,6 +23,8 @@
 #include "TestSuite.h"
 #include <memory>
 #include <limits>
+#include <vector>
+#include <string.h>
 
 /**
 Test FreeImage_ConvertToColor
@@ -112,3 +114,346 @@ void testConvertToColor()
 	}
 }
 
+
+
+namespace {
+
+	struct YuvFrame
+	{
+		FREE_IMAGE_YUV_LAYOUT layout;
+		unsigned width;
+		unsigned height;
+		std::vector<uint8_t> buffers[3];
+		FIYUVPLANES planes{};
+
+		YuvFrame(FREE_IMAGE_YUV_LAYOUT layout_, unsigned width_, unsigned height_)
+			: layout(layout_), width(width_), height(height_)
+		{
+			const unsigned c_width = (width + 1) / 2;
+			const unsigned c_height = (height + 1) / 2;
+			switch (layout) {
+			case FIYUV_I420:
+				Plane(0, width, height);
+				Plane(1, c_width, c_height);
+				Plane(2, c_width, c_height);
+				break;
+			case FIYUV_NV12:
+				Plane(0, width, height);
+				Plane(1, 2 * c_width, c_height);
+				break;
+			case FIYUV_YUY2:
+				Plane(0, 4 * c_width, height);
+				break;
+			case FIYUV_P010:
+				Plane(0, 2 * width, height);
+				Plane(1, 4 * c_width, c_height);
+				break;
+			}
+		}
+
+		void Plane(unsigned index, unsigned row_bytes, unsigned rows)
+		{
+			// padded rows, as video frames usually have
+			planes.pitch[index] = row_bytes + 16;
+			buffers[index].assign(static_cast<size_t>(planes.pitch[index]) * rows, 0);
+			planes.data[index] = buffers[index].data();
+		}
+
+		bool operator==(const YuvFrame& other) const
+		{
+			return (buffers[0] == other.buffers[0]) && (buffers[1] == other.buffers[1]) && (buffers[2] == other.buffers[2]);
+		}
+	};
+
+	/// Image with a constant color in each 2x2 block, so chroma subsampling loses nothing
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> MakeBlockImage(FREE_IMAGE_TYPE type, unsigned width, unsigned height)
+	{
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(FreeImage_AllocateT(type, width, height, 24), &::FreeImage_Unload);
+		assert(dib != nullptr);
+		for (unsigned y = 0; y < height; ++y) {
+			// blocks are aligned to the top-down frame rows
+			const unsigned block_y = (height - 1 - y) / 2;
+			for (unsigned x = 0; x < width; ++x) {
+				const unsigned seed = (x / 2) * 7919 + block_y * 104729;
+				const unsigned r = (seed * 37) % 256, g = (seed * 91 + 11) % 256, b = (seed * 53 + 101) % 256;
+				if (type == FIT_RGB16) {
+					FIRGB16* pixel = reinterpret_cast<FIRGB16*>(FreeImage_GetScanLine(dib.get(), y)) + x;
+					pixel->red = static_cast<uint16_t>(r * 257);
+					pixel->green = static_cast<uint16_t>(g * 257);
+					pixel->blue = static_cast<uint16_t>(b * 257);
+				}
+				else {
+					uint8_t* pixel = FreeImage_GetScanLine(dib.get(), y) + 3 * x;
+					pixel[FI_RGBA_RED] = static_cast<uint8_t>(r);
+					pixel[FI_RGBA_GREEN] = static_cast<uint8_t>(g);
+					pixel[FI_RGBA_BLUE] = static_cast<uint8_t>(b);
+				}
+			}
+		}
+		return dib;
+	}
+
+	int MaxDifference(FIBITMAP* a, FIBITMAP* b)
+	{
+		const unsigned samples = 3 * FreeImage_GetWidth(a);
+		const bool wide = FreeImage_GetImageType(a) == FIT_RGB16;
+		int result = 0;
+		for (unsigned y = 0; y < FreeImage_GetHeight(a); ++y) {
+			for (unsigned i = 0; i < samples; ++i) {
+				const int va = wide ? reinterpret_cast<const uint16_t*>(FreeImage_GetScanLine(a, y))[i] : FreeImage_GetScanLine(a, y)[i];
+				const int vb = wide ? reinterpret_cast<const uint16_t*>(FreeImage_GetScanLine(b, y))[i] : FreeImage_GetScanLine(b, y)[i];
+				result = std::max(result, std::abs(va - vb));
+			}
+		}
+		return result;
+	}
+
+} // namespace
+
+/**
+Test FreeImage_ConvertToYUVPlanes and FreeImage_ConvertFromYUVPlanes
+*/
+void testConvertYuvPlanes()
+{
+	const unsigned width = 301, height = 77;
+	const FREE_IMAGE_YUV_LAYOUT layouts[] = { FIYUV_I420, FIYUV_NV12, FIYUV_YUY2, FIYUV_P010 };
+	const FREE_IMAGE_CVT_COLOR_PARAM standards[] = { FICPARAM_YUV_STANDARD_JPEG, FICPARAM_YUV_STANDARD_BT601, FICPARAM_YUV_STANDARD_BT709, FICPARAM_YUV_STANDARD_BT2020 };
+
+	for (const auto layout : layouts) {
+		const FREE_IMAGE_TYPE type = (layout == FIYUV_P010) ? FIT_RGB16 : FIT_BITMAP;
+		auto src = MakeBlockImage(type, width, height);
+
+		for (const auto standard : standards) {
+			YuvFrame frame(layout, width, height);
+			bool success = FreeImage_ConvertToYUVPlanes(src.get(), &frame.planes, layout, standard);
+			assert(success);
+
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dst(FreeImage_ConvertFromYUVPlanes(&frame.planes, layout, width, height, standard), &::FreeImage_Unload);
+			assert(dst != nullptr);
+			assert(FreeImage_GetImageType(dst.get()) == type);
+			// quantization of the video range, and of 10 bits for P010
+			assert(MaxDifference(src.get(), dst.get()) <= ((layout == FIYUV_P010) ? 3 * 64 : 3));
+
+			// the kernels give the same samples for every instruction set
+			FreeImage_SetCPUFeatureMask(0);
+			YuvFrame scalar_frame(layout, width, height);
+			success = FreeImage_ConvertToYUVPlanes(src.get(), &scalar_frame.planes, layout, standard);
+			assert(success);
+			assert(scalar_frame == frame);
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> scalar_dst(FreeImage_ConvertFromYUVPlanes(&frame.planes, layout, width, height, standard), &::FreeImage_Unload);
+			assert(MaxDifference(scalar_dst.get(), dst.get()) == 0);
+			FreeImage_SetCPUFeatureMask(~0U);
+		}
+	}
+
+	{
+		// white and black in the video range
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(FreeImage_Allocate(4, 2, 24), &::FreeImage_Unload);
+		assert(dib != nullptr);
+		memset(FreeImage_GetScanLine(dib.get(), 0), 0, 12);
+		memset(FreeImage_GetScanLine(dib.get(), 1), 255, 12);
+
+		YuvFrame frame(FIYUV_I420, 4, 2);
+		bool success = FreeImage_ConvertToYUVPlanes(dib.get(), &frame.planes, FIYUV_I420, FICPARAM_YUV_STANDARD_BT709);
+		assert(success);
+		assert(frame.planes.data[0][0] == 235);
+		assert(frame.planes.data[0][frame.planes.pitch[0]] == 16);
+		assert(frame.planes.data[1][0] == 128);
+		assert(frame.planes.data[2][0] == 128);
+	}
+
+	{
+		// wrong image types and missing planes are rejected
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dib(FreeImage_Allocate(4, 4, 8), &::FreeImage_Unload);
+		YuvFrame frame(FIYUV_I420, 4, 4);
+		bool success = FreeImage_ConvertToYUVPlanes(dib.get(), &frame.planes, FIYUV_I420, FICPARAM_YUV_STANDARD_BT601);
+		assert(!success);
+		frame.planes.data[2] = nullptr;
+		FIBITMAP *rgb = FreeImage_ConvertFromYUVPlanes(&frame.planes, FIYUV_I420, 4, 4, FICPARAM_YUV_STANDARD_BT601);
+		assert(rgb == nullptr);
+	}
+
+	{
+		// interleaved YUV bitmaps with a video standard, 16-bit samples
+		auto src = MakeBlockImage(FIT_RGB16, 33, 9);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> yuv(FreeImage_ConvertToColor(src.get(), FIC_YUV, FICPARAM_YUV_STANDARD_BT2020), &::FreeImage_Unload);
+		assert(yuv != nullptr);
+		assert(FreeImage_GetColorType(yuv.get()) == FIC_YUV);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rgb(FreeImage_ConvertToColor(yuv.get(), FIC_RGB, FICPARAM_YUV_STANDARD_BT2020), &::FreeImage_Unload);
+		assert(rgb != nullptr);
+		// 12 fractional bits keep 16-bit samples within a 10-bit step
+		assert(MaxDifference(src.get(), rgb.get()) <= 64);
+	}
+}
+
+namespace {
+
+	using BitmapPtr = std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>;
+
+	/// Image filled with pseudo random samples, floating point samples are in [-0.5, 1.5]
+	BitmapPtr MakeNoiseImage(FREE_IMAGE_TYPE type, unsigned width, unsigned height, unsigned bpp = 0)
+	{
+		BitmapPtr dib(FreeImage_AllocateT(type, width, height, bpp), &::FreeImage_Unload);
+		assert(dib != nullptr);
+		uint32_t seed = 12345;
+		for (unsigned y = 0; y < height; ++y) {
+			uint8_t* line = FreeImage_GetScanLine(dib.get(), y);
+			if ((type == FIT_FLOAT) || (type == FIT_RGBF) || (type == FIT_RGBAF)) {
+				float* samples = reinterpret_cast<float*>(line);
+				for (unsigned i = 0; i < FreeImage_GetLine(dib.get()) / sizeof(float); ++i) {
+					seed = seed * 1664525 + 1013904223;
+					samples[i] = static_cast<float>(seed >> 8) / static_cast<float>(1 << 24) * 2.0F - 0.5F;
+				}
+			}
+			else if (type == FIT_DOUBLE) {
+				double* samples = reinterpret_cast<double*>(line);
+				for (unsigned i = 0; i < width; ++i) {
+					seed = seed * 1664525 + 1013904223;
+					samples[i] = static_cast<double>(seed) / 4294967296.0;
+				}
+			}
+			else {
+				for (unsigned i = 0; i < FreeImage_GetLine(dib.get()); ++i) {
+					seed = seed * 1664525 + 1013904223;
+					line[i] = static_cast<uint8_t>(seed >> 24);
+				}
+			}
+		}
+		return dib;
+	}
+
+	/// Converts a copy of src in place and checks it matches the allocating conversion
+	void CheckInPlace(FIBITMAP* src, FREE_IMAGE_INPLACE_CONVERSION target, FIBITMAP* expected)
+	{
+		assert(expected != nullptr);
+		BitmapPtr dib(FreeImage_Clone(src), &::FreeImage_Unload);
+		bool success = FreeImage_ConvertInPlace(dib.get(), target);
+		assert(success);
+
+		assert(FreeImage_GetImageType(dib.get()) == FreeImage_GetImageType(expected));
+		assert(FreeImage_GetBPP(dib.get()) == FreeImage_GetBPP(expected));
+		assert(FreeImage_GetColorType(dib.get()) == FreeImage_GetColorType(expected));
+		assert(FreeImage_GetPitch(dib.get()) == FreeImage_GetPitch(expected));
+		assert(FreeImage_GetDotsPerMeterX(dib.get()) == FreeImage_GetDotsPerMeterX(src));
+		for (unsigned y = 0; y < FreeImage_GetHeight(dib.get()); ++y) {
+			assert(memcmp(FreeImage_GetScanLine(dib.get(), y), FreeImage_GetScanLine(expected, y), FreeImage_GetLine(expected)) == 0);
+		}
+
+		// the bitmap is still a regular bitmap
+		BitmapPtr clone(FreeImage_Clone(dib.get()), &::FreeImage_Unload);
+		assert(clone != nullptr);
+		FreeImage_Unload(expected);
+	}
+
+} // namespace
+
+/**
+Test FreeImage_ConvertInPlace
+*/
+void testConvertInPlace()
+{
+	// narrow images exercise the rows held back in front of the palette, large ones the parallel rounds
+	const unsigned sizes[][2] = { { 7, 400 }, { 301, 77 }, { 1031, 517 } };
+
+	for (const auto& size : sizes) {
+		const unsigned width = size[0], height = size[1];
+
+		auto dib32 = MakeNoiseImage(FIT_BITMAP, width, height, 32);
+		FreeImage_SetDotsPerMeterX(dib32.get(), 1234);
+		CheckInPlace(dib32.get(), FIINPLACE_DROP_ALPHA, FreeImage_ConvertTo24Bits(dib32.get()));
+		CheckInPlace(dib32.get(), FIINPLACE_GREYSCALE, FreeImage_ConvertToGreyscale(dib32.get()));
+
+		auto dib24 = MakeNoiseImage(FIT_BITMAP, width, height, 24);
+		FreeImage_SetDotsPerMeterX(dib24.get(), 1234);
+		CheckInPlace(dib24.get(), FIINPLACE_GREYSCALE, FreeImage_ConvertToGreyscale(dib24.get()));
+		{
+			BitmapPtr swapped(FreeImage_Clone(dib24.get()), &::FreeImage_Unload);
+			bool success = SwapRedBlue32(swapped.get());
+			assert(success);
+			CheckInPlace(dib24.get(), FIINPLACE_SWAP_RED_BLUE, FreeImage_Clone(swapped.get()));
+		}
+
+		auto rgba16 = MakeNoiseImage(FIT_RGBA16, width, height);
+		CheckInPlace(rgba16.get(), FIINPLACE_DROP_ALPHA, FreeImage_ConvertToRGB16(rgba16.get()));
+		CheckInPlace(rgba16.get(), FIINPLACE_GREYSCALE, FreeImage_ConvertToUINT16(rgba16.get()));
+		CheckInPlace(rgba16.get(), FIINPLACE_FLOAT, FreeImage_ConvertToFloat(rgba16.get()));
+
+		auto rgb16 = MakeNoiseImage(FIT_RGB16, width, height);
+		CheckInPlace(rgb16.get(), FIINPLACE_GREYSCALE, FreeImage_ConvertToUINT16(rgb16.get()));
+
+		auto rgbaf = MakeNoiseImage(FIT_RGBAF, width, height);
+		CheckInPlace(rgbaf.get(), FIINPLACE_DROP_ALPHA, FreeImage_ConvertToRGBF(rgbaf.get()));
+		CheckInPlace(rgbaf.get(), FIINPLACE_FLOAT, FreeImage_ConvertToFloat(rgbaf.get()));
+
+		auto rgbf = MakeNoiseImage(FIT_RGBF, width, height);
+		CheckInPlace(rgbf.get(), FIINPLACE_FLOAT, FreeImage_ConvertToFloat(rgbf.get()));
+
+		auto uint32 = MakeNoiseImage(FIT_UINT32, width, height);
+		CheckInPlace(uint32.get(), FIINPLACE_FLOAT, FreeImage_ConvertToFloat(uint32.get()));
+
+		auto dbl = MakeNoiseImage(FIT_DOUBLE, width, height);
+		CheckInPlace(dbl.get(), FIINPLACE_FLOAT, FreeImage_ConvertToFloat(dbl.get()));
+	}
+
+	{
+		// FIT_FLOAT images are left unchanged, out of range values included
+		auto dib = MakeNoiseImage(FIT_FLOAT, 33, 9);
+		float* first = reinterpret_cast<float*>(FreeImage_GetScanLine(dib.get(), 0));
+		first[0] = -2.0F;
+		first[1] = 3.5F;
+		CheckInPlace(dib.get(), FIINPLACE_FLOAT, FreeImage_ConvertToFloat(dib.get()));
+	}
+
+	{
+		// rows keep their pitch when the pixels shrink within the padding
+		auto dib = MakeNoiseImage(FIT_BITMAP, 1, 3, 32);
+		CheckInPlace(dib.get(), FIINPLACE_DROP_ALPHA, FreeImage_ConvertTo24Bits(dib.get()));
+	}
+
+	{
+		// an 8-bit palette doesn't fit in a tiny image
+		auto dib = MakeNoiseImage(FIT_BITMAP, 2, 2, 24);
+		bool success = FreeImage_ConvertInPlace(dib.get(), FIINPLACE_GREYSCALE);
+		assert(!success);
+		assert(FreeImage_GetBPP(dib.get()) == 24);
+	}
+
+	{
+		// conversions that would grow the pixels are rejected and leave the image untouched
+		auto dib8 = MakeNoiseImage(FIT_BITMAP, 16, 16, 8);
+		bool success = FreeImage_ConvertInPlace(dib8.get(), FIINPLACE_DROP_ALPHA);
+		assert(!success);
+		success = FreeImage_ConvertInPlace(dib8.get(), FIINPLACE_FLOAT);
+		assert(!success);
+		auto uint16 = MakeNoiseImage(FIT_UINT16, 16, 16);
+		success = FreeImage_ConvertInPlace(uint16.get(), FIINPLACE_FLOAT);
+		assert(!success);
+		assert(FreeImage_GetImageType(uint16.get()) == FIT_UINT16);
+		success = FreeImage_ConvertInPlace(nullptr, FIINPLACE_FLOAT);
+		assert(!success);
+	}
+
+	{
+		// user provided buffers keep their pitch, and have no room for a palette
+		const unsigned width = 37, height = 11, pitch = 4 * width + 12;
+		std::vector<uint8_t> buffer(pitch * height);
+		for (size_t i = 0; i < buffer.size(); ++i) {
+			buffer[i] = static_cast<uint8_t>(i * 7);
+		}
+		BitmapPtr wrapped(FreeImage_AllocateHeaderForBits(buffer.data(), pitch, FIT_BITMAP, width, height, 32, 0, 0, 0), &::FreeImage_Unload);
+		assert(wrapped != nullptr);
+		BitmapPtr expected(FreeImage_ConvertTo24Bits(wrapped.get()), &::FreeImage_Unload);
+
+		bool success = FreeImage_ConvertInPlace(wrapped.get(), FIINPLACE_GREYSCALE);
+		assert(!success);
+		assert(FreeImage_GetBPP(wrapped.get()) == 32);
+		success = FreeImage_ConvertInPlace(wrapped.get(), FIINPLACE_DROP_ALPHA);
+		assert(success);
+		assert(FreeImage_GetBPP(wrapped.get()) == 24);
+		assert(FreeImage_GetBits(wrapped.get()) == buffer.data());
+		assert(FreeImage_GetPitch(wrapped.get()) == pitch);
+		for (unsigned y = 0; y < height; ++y) {
+			assert(memcmp(FreeImage_GetScanLine(wrapped.get(), y), FreeImage_GetScanLine(expected.get(), y), 3 * width) == 0);
+		}
+	}
+}
@@ -23,6 +23,7 @@
 #include "TestSuite.h"
 #include <memory>
 #include <limits>
+#include <string.h>
 
 /**
 Test FreeImage_ConvertToFloat
@@ -98,5 +99,150 @@ void testConvertToFloat()
 		assert(res_ptr[2] == 10000.0f);
 		assert(res_ptr[3] == 65535.0f);
 	}
+
+	{
+		// large enough to be split into bands on several threads
+		const unsigned width = 1031, height = 517;
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bmp_uint16(FreeImage_AllocateT(FIT_UINT16, width, height, 16), &::FreeImage_Unload);
+		assert(bmp_uint16 != nullptr);
+
+		for (unsigned y = 0; y < height; y++) {
+			uint16_t* line = reinterpret_cast<uint16_t*>(FreeImage_GetScanLine(bmp_uint16.get(), y));
+			for (unsigned x = 0; x < width; x++) {
+				line[x] = static_cast<uint16_t>(x * 61 + y * 127);
+			}
+		}
+
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> res(FreeImage_ConvertToFloat(bmp_uint16.get(), FALSE), &::FreeImage_Unload);
+		assert(res != nullptr);
+
+		for (unsigned y = 0; y < height; y++) {
+			const float* line = reinterpret_cast<const float*>(FreeImage_GetScanLine(res.get(), y));
+			for (unsigned x = 0; x < width; x++) {
+				assert(line[x] == static_cast<float>(static_cast<uint16_t>(x * 61 + y * 127)));
+			}
+		}
+	}
 }
 
+
+/**
+Test FreeImage_ConvertToType between the scientific types
+*/
+void testConvertToType()
+{
+	// large enough to be split into bands on several threads
+	const unsigned width = 1031, height = 263;
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bmp_uint16(FreeImage_AllocateT(FIT_UINT16, width, height), &::FreeImage_Unload);
+	assert(bmp_uint16 != nullptr);
+	for (unsigned y = 0; y < height; y++) {
+		uint16_t* line = reinterpret_cast<uint16_t*>(FreeImage_GetScanLine(bmp_uint16.get(), y));
+		for (unsigned x = 0; x < width; x++) {
+			line[x] = static_cast<uint16_t>(1000 + (x * 37 + y * 11) % 3000);
+		}
+	}
+
+	{
+		// linear scaling of [1000, 3999] to [0, 255]
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> res(FreeImage_ConvertToType(bmp_uint16.get(), FIT_BITMAP, TRUE), &::FreeImage_Unload);
+		assert(res != nullptr);
+		assert(FreeImage_GetBPP(res.get()) == 8);
+		// the min value is searched from 255, as it always was
+		const double scale = 255.0 / (3999 - 255);
+		for (unsigned y = 0; y < height; y++) {
+			const uint16_t* src_line = reinterpret_cast<const uint16_t*>(FreeImage_GetScanLine(bmp_uint16.get(), y));
+			const uint8_t* line = FreeImage_GetScanLine(res.get(), y);
+			for (unsigned x = 0; x < width; x++) {
+				assert(line[x] == static_cast<uint8_t>(scale * (src_line[x] - 255) + 0.5));
+			}
+		}
+	}
+
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bmp_float(FreeImage_ConvertToType(bmp_uint16.get(), FIT_FLOAT, TRUE), &::FreeImage_Unload);
+	assert(bmp_float != nullptr);
+
+	{
+		// float to uint16 is the inverse of the scaled conversion to float
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> res(FreeImage_ConvertToType(bmp_float.get(), FIT_UINT16, TRUE), &::FreeImage_Unload);
+		assert(res != nullptr);
+		for (unsigned y = 0; y < height; y++) {
+			assert(memcmp(FreeImage_GetScanLine(res.get(), y), FreeImage_GetScanLine(bmp_uint16.get(), y), width * sizeof(uint16_t)) == 0);
+		}
+
+		float* line = reinterpret_cast<float*>(FreeImage_GetScanLine(bmp_float.get(), 0));
+		const float saved[4] = { line[0], line[1], line[2], line[3] };
+		line[0] = -3.0f;
+		line[1] = 70000.4f;
+		line[2] = 12.5f;
+		line[3] = std::numeric_limits<float>::quiet_NaN();
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rounded(FreeImage_ConvertToType(bmp_float.get(), FIT_UINT16, FALSE), &::FreeImage_Unload);
+		assert(rounded != nullptr);
+		const uint16_t* rounded_line = reinterpret_cast<const uint16_t*>(FreeImage_GetScanLine(rounded.get(), 0));
+		assert(rounded_line[0] == 0);
+		assert(rounded_line[1] == 65535);
+		assert(rounded_line[2] == 13);
+		assert(rounded_line[3] == 0);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> scaled(FreeImage_ConvertToType(bmp_float.get(), FIT_UINT16, TRUE), &::FreeImage_Unload);
+		assert(scaled != nullptr);
+		assert(reinterpret_cast<const uint16_t*>(FreeImage_GetScanLine(scaled.get(), 0))[3] == 0);
+		line[0] = saved[0];
+		line[1] = saved[1];
+		line[2] = saved[2];
+		line[3] = saved[3];
+	}
+
+	{
+		// every instruction set gives the same bytes
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> res(FreeImage_ConvertToType(bmp_float.get(), FIT_BITMAP, TRUE), &::FreeImage_Unload);
+		FreeImage_SetCPUFeatureMask(0);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> scalar(FreeImage_ConvertToType(bmp_float.get(), FIT_BITMAP, TRUE), &::FreeImage_Unload);
+		FreeImage_SetCPUFeatureMask(~0U);
+		assert(res != nullptr && scalar != nullptr);
+		for (unsigned y = 0; y < height; y++) {
+			assert(memcmp(FreeImage_GetScanLine(res.get(), y), FreeImage_GetScanLine(scalar.get(), y), width) == 0);
+		}
+	}
+
+	{
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bmp_int16(FreeImage_AllocateT(FIT_INT16, width, height), &::FreeImage_Unload);
+		assert(bmp_int16 != nullptr);
+		for (unsigned y = 0; y < height; y++) {
+			int16_t* line = reinterpret_cast<int16_t*>(FreeImage_GetScanLine(bmp_int16.get(), y));
+			for (unsigned x = 0; x < width; x++) {
+				line[x] = static_cast<int16_t>(static_cast<int>(x * 61 + y * 127) - 20000);
+			}
+		}
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> res(FreeImage_ConvertToType(bmp_int16.get(), FIT_FLOAT, TRUE), &::FreeImage_Unload);
+		assert(res != nullptr);
+		for (unsigned y = 0; y < height; y++) {
+			const int16_t* src_line = reinterpret_cast<const int16_t*>(FreeImage_GetScanLine(bmp_int16.get(), y));
+			const float* line = reinterpret_cast<const float*>(FreeImage_GetScanLine(res.get(), y));
+			for (unsigned x = 0; x < width; x++) {
+				assert(line[x] == static_cast<float>(src_line[x]));
+			}
+		}
+	}
+
+	{
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> bmp_rgb16(FreeImage_AllocateT(FIT_RGB16, width, height), &::FreeImage_Unload);
+		assert(bmp_rgb16 != nullptr);
+		for (unsigned y = 0; y < height; y++) {
+			FIRGB16* line = reinterpret_cast<FIRGB16*>(FreeImage_GetScanLine(bmp_rgb16.get(), y));
+			for (unsigned x = 0; x < width; x++) {
+				line[x] = FIRGB16{ static_cast<uint16_t>(x * 63), static_cast<uint16_t>(y * 249), static_cast<uint16_t>(x * y) };
+			}
+		}
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> res(FreeImage_ConvertToType(bmp_rgb16.get(), FIT_RGBF, TRUE), &::FreeImage_Unload);
+		assert(res != nullptr);
+		for (unsigned y = 0; y < height; y++) {
+			const FIRGB16* src_line = reinterpret_cast<const FIRGB16*>(FreeImage_GetScanLine(bmp_rgb16.get(), y));
+			const FIRGBF* line = reinterpret_cast<const FIRGBF*>(FreeImage_GetScanLine(res.get(), y));
+			for (unsigned x = 0; x < width; x++) {
+				assert(line[x].red == src_line[x].red / 65535.0F);
+				assert(line[x].green == src_line[x].green / 65535.0F);
+				assert(line[x].blue == src_line[x].blue / 65535.0F);
+			}
+		}
+	}
+}
@@ -0,0 +1,138 @@
+// ==========================================================
+// FreeImage 3 Test Script
+//
+// This file is part of FreeImage 3
+//
+// COVERED CODE IS PROVIDED UNDER THIS LICENSE ON AN "AS IS" BASIS, WITHOUT WARRANTY
+// OF ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING, WITHOUT LIMITATION, WARRANTIES
+// THAT THE COVERED CODE IS FREE OF DEFECTS, MERCHANTABLE, FIT FOR A PARTICULAR PURPOSE
+// OR NON-INFRINGING. THE ENTIRE RISK AS TO THE QUALITY AND PERFORMANCE OF THE COVERED
+// CODE IS WITH YOU. SHOULD ANY COVERED CODE PROVE DEFECTIVE IN ANY RESPECT, YOU (NOT
+// THE INITIAL DEVELOPER OR ANY OTHER CONTRIBUTOR) ASSUME THE COST OF ANY NECESSARY
+// SERVICING, REPAIR OR CORRECTION. THIS DISCLAIMER OF WARRANTY CONSTITUTES AN ESSENTIAL
+// PART OF THIS LICENSE. NO USE OF ANY COVERED CODE IS AUTHORIZED HEREUNDER EXCEPT UNDER
+// THIS DISCLAIMER.
+//
+// Use at your own risk!
+// ==========================================================
+
+
+#include "TestSuite.h"
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <string.h>
+#include <vector>
+
+typedef std::function<void(uint8_t *target, uint8_t *source, int width)> LineConverter;
+
+/**
+Runs a line converter with the vectorized kernels and with the scalar code only,
+over random lines of every width up to max_width, and compares the outputs.
+The destination is over-allocated to catch writes past the end of the line.
+*/
+static void
+compareLineConverter(const LineConverter& convert, unsigned src_bits, unsigned dst_bits, int max_width, std::mt19937& rng) {
+	const unsigned all_features = FreeImage_GetCPUFeatures();
+	const size_t guard = 64;
+
+	for (int width = 1; width <= max_width; width++) {
+		std::vector<uint8_t> source((width * src_bits + 7) / 8 + guard);
+		for (auto& value : source) {
+			value = (uint8_t)rng();
+		}
+		const size_t dst_size = (width * dst_bits + 7) / 8;
+		std::vector<uint8_t> scalar(dst_size + guard, 0xA5);
+		std::vector<uint8_t> vector(dst_size + guard, 0xA5);
+
+		FreeImage_SetCPUFeatureMask(0);
+		convert(scalar.data(), source.data(), width);
+
+		// every instruction set level the dispatcher can pick
+		const unsigned levels[] = { FI_CPU_SSE2, FI_CPU_SSE2 | FI_CPU_SSSE3, all_features };
+		for (unsigned level : levels) {
+			std::fill(vector.begin(), vector.end(), 0xA5);
+			FreeImage_SetCPUFeatureMask(level);
+			convert(vector.data(), source.data(), width);
+
+			assert(memcmp(scalar.data(), vector.data(), scalar.size()) == 0);
+			for (size_t i = dst_size; i < vector.size(); i++) {
+				assert(vector[i] == 0xA5);
+			}
+		}
+		FreeImage_SetCPUFeatureMask(all_features);
+	}
+}
+
+/**
+Test the FreeImage_ConvertLine* functions for bit-exactness of the vectorized kernels
+*/
+void testConvertLine() {
+	std::mt19937 rng(1234);
+	const int max_width = 133;
+
+	FIRGBA8 palette[256];
+	for (int i = 0; i < 256; i++) {
+		palette[i].red = (uint8_t)rng();
+		palette[i].green = (uint8_t)rng();
+		palette[i].blue = (uint8_t)rng();
+		palette[i].alpha = (uint8_t)rng();
+	}
+
+	compareLineConverter([](uint8_t *t, uint8_t *s, int w) { FreeImage_ConvertLine1To8(t, s, w); }, 1, 8, max_width, rng);
+	compareLineConverter([&](uint8_t *t, uint8_t *s, int w) { FreeImage_ConvertLine8To24(t, s, w, palette); }, 8, 24, max_width, rng);
+	compareLineConverter([&](uint8_t *t, uint8_t *s, int w) { FreeImage_ConvertLine8To32(t, s, w, palette); }, 8, 32, max_width, rng);
+	compareLineConverter([](uint8_t *t, uint8_t *s, int w) { FreeImage_ConvertLine16To24_555(t, s, w); }, 16, 24, max_width, rng);
+	compareLineConverter([](uint8_t *t, uint8_t *s, int w) { FreeImage_ConvertLine16To24_565(t, s, w); }, 16, 24, max_width, rng);
+	compareLineConverter([](uint8_t *t, uint8_t *s, int w) { FreeImage_ConvertLine16To32_555(t, s, w); }, 16, 32, max_width, rng);
+	compareLineConverter([](uint8_t *t, uint8_t *s, int w) { FreeImage_ConvertLine16To32_565(t, s, w); }, 16, 32, max_width, rng);
+	compareLineConverter([](uint8_t *t, uint8_t *s, int w) { FreeImage_ConvertLine24To32(t, s, w); }, 24, 32, max_width, rng);
+	compareLineConverter([](uint8_t *t, uint8_t *s, int w) { FreeImage_ConvertLine32To24(t, s, w); }, 32, 24, max_width, rng);
+
+	// palette channels land at the FI_RGBA_* positions of the pixels, whatever the color order
+
+	FIRGBA8 ramp[256];
+	for (int i = 0; i < 256; i++) {
+		ramp[i].red = (uint8_t)i;
+		ramp[i].green = (uint8_t)(255 - i);
+		ramp[i].blue = (uint8_t)(i ^ 0x5A);
+		ramp[i].alpha = 0;
+	}
+	std::vector<uint8_t> indices(max_width);
+	for (int x = 0; x < max_width; x++) {
+		indices[x] = (uint8_t)rng();
+	}
+	std::vector<uint8_t> line24(3 * max_width), line32(4 * max_width);
+	FreeImage_ConvertLine8To24(line24.data(), indices.data(), max_width, ramp);
+	FreeImage_ConvertLine8To32(line32.data(), indices.data(), max_width, ramp);
+	for (int x = 0; x < max_width; x++) {
+		const FIRGBA8& entry = ramp[indices[x]];
+		assert(line24[3 * x + FI_RGBA_RED] == entry.red);
+		assert(line24[3 * x + FI_RGBA_GREEN] == entry.green);
+		assert(line24[3 * x + FI_RGBA_BLUE] == entry.blue);
+		assert(line32[4 * x + FI_RGBA_RED] == entry.red);
+		assert(line32[4 * x + FI_RGBA_GREEN] == entry.green);
+		assert(line32[4 * x + FI_RGBA_BLUE] == entry.blue);
+		assert(line32[4 * x + FI_RGBA_ALPHA] == 0xFF);
+	}
+
+	// full range of the 16-bit formats
+
+	std::vector<uint8_t> words(2 * 65536);
+	for (unsigned i = 0; i < 65536; i++) {
+		words[2 * i] = (uint8_t)(i & 0xFF);
+		words[2 * i + 1] = (uint8_t)(i >> 8);
+	}
+	std::vector<uint8_t> scalar(4 * 65536), vector(4 * 65536);
+	const unsigned all_features = FreeImage_GetCPUFeatures();
+	FreeImage_SetCPUFeatureMask(0);
+	FreeImage_ConvertLine16To32_565(scalar.data(), words.data(), 65536);
+	FreeImage_SetCPUFeatureMask(all_features);
+	FreeImage_ConvertLine16To32_565(vector.data(), words.data(), 65536);
+	assert(scalar == vector);
+	FreeImage_SetCPUFeatureMask(0);
+	FreeImage_ConvertLine16To32_555(scalar.data(), words.data(), 65536);
+	FreeImage_SetCPUFeatureMask(all_features);
+	FreeImage_ConvertLine16To32_555(vector.data(), words.data(), 65536);
+	assert(scalar == vector);
+}
@@ -21,6 +21,7 @@
 
 
 #include "TestSuite.h"
+#include <string.h>
 
 // Local test functions
 // ----------------------------------------------------------
@@ -194,6 +195,128 @@ void testJPEGSameFile(const char *src_file) {
 	assert(bResult);
 }
 
+/**
+Set a minimal Exif profile with an Orientation tag, written as is by the JPEG plugin
+*/
+static void setExifOrientation(FIBITMAP *dib, uint16_t orientation) {
+	uint8_t profile[] = {
+		'E', 'x', 'i', 'f', 0, 0,
+		'I', 'I', 0x2A, 0x00, 0x08, 0x00, 0x00, 0x00,	// TIFF header, 0th IFD at offset 8
+		0x01, 0x00,										// 1 entry
+		0x12, 0x01, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00,	// Orientation, SHORT, count 1
+		(uint8_t)(orientation & 0xFF), (uint8_t)(orientation >> 8), 0x00, 0x00,
+		0x00, 0x00, 0x00, 0x00							// no next IFD
+	};
+
+	FITAG *tag = FreeImage_CreateTag();
+	FreeImage_SetTagKey(tag, "ExifRaw");
+	FreeImage_SetTagLength(tag, (uint32_t)sizeof(profile));
+	FreeImage_SetTagCount(tag, (uint32_t)sizeof(profile));
+	FreeImage_SetTagType(tag, FIDT_BYTE);
+	FreeImage_SetTagValue(tag, profile);
+	FreeImage_SetMetadata(FIMD_EXIF_RAW, dib, FreeImage_GetTagKey(tag), tag);
+	FreeImage_DeleteTag(tag);
+}
+
+/**
+Reference Exif orientation: the decoded image rotated and flipped by the toolkit
+*/
+static FIBITMAP* orientImage(FIBITMAP *dib, uint16_t orientation) {
+	FIBITMAP *dst = NULL;
+	switch (orientation) {
+		case 2:
+			dst = FreeImage_Clone(dib);
+			FreeImage_FlipHorizontal(dst);
+			break;
+		case 3:
+			dst = FreeImage_Rotate(dib, 180);
+			break;
+		case 4:
+			dst = FreeImage_Clone(dib);
+			FreeImage_FlipVertical(dst);
+			break;
+		case 5:
+			dst = FreeImage_Rotate(dib, 90);
+			FreeImage_FlipVertical(dst);
+			break;
+		case 6:
+			dst = FreeImage_Rotate(dib, -90);
+			break;
+		case 7:
+			dst = FreeImage_Rotate(dib, -90);
+			FreeImage_FlipVertical(dst);
+			break;
+		case 8:
+			dst = FreeImage_Rotate(dib, 90);
+			break;
+		default:
+			dst = FreeImage_Clone(dib);
+			break;
+	}
+	return dst;
+}
+
+static FIBOOL samePixels(FIBITMAP *dib1, FIBITMAP *dib2) {
+	const unsigned width = FreeImage_GetWidth(dib1);
+	const unsigned height = FreeImage_GetHeight(dib1);
+	if ((width != FreeImage_GetWidth(dib2)) || (height != FreeImage_GetHeight(dib2)) || (FreeImage_GetBPP(dib1) != FreeImage_GetBPP(dib2))) {
+		return FALSE;
+	}
+	const unsigned line = FreeImage_GetLine(dib1);
+	for (unsigned y = 0; y < height; y++) {
+		if (memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), line) != 0) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+void testJPEGExifRotate(unsigned bpp) {
+	// odd sizes, so that the decoded rows do not fill whole strips
+	const unsigned width = 45;
+	const unsigned height = 37;
+
+	FIBITMAP *src = FreeImage_Allocate(width, height, bpp);
+	assert(src != NULL);
+	if (bpp == 8) {
+		FIRGBA8 *pal = FreeImage_GetPalette(src);
+		for (int i = 0; i < 256; i++) {
+			pal[i].red = pal[i].green = pal[i].blue = (uint8_t)i;
+		}
+	}
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *bits = FreeImage_GetScanLine(src, y);
+		for (unsigned x = 0; x < FreeImage_GetLine(src); x++) {
+			bits[x] = (uint8_t)((x * 7 + y * 13) ^ (x * y));
+		}
+	}
+
+	for (uint16_t orientation = 1; orientation <= 8; orientation++) {
+		setExifOrientation(src, orientation);
+
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		FIBOOL bResult = FreeImage_SaveToMemory(FIF_JPEG, src, hmem, JPEG_QUALITYSUPERB);
+		assert(bResult);
+
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *decoded = FreeImage_LoadFromMemory(FIF_JPEG, hmem, 0);
+		assert(decoded != NULL);
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *rotated = FreeImage_LoadFromMemory(FIF_JPEG, hmem, JPEG_EXIFROTATE);
+		assert(rotated != NULL);
+
+		FIBITMAP *expected = orientImage(decoded, orientation);
+		assert(samePixels(rotated, expected));
+
+		FreeImage_Unload(expected);
+		FreeImage_Unload(rotated);
+		FreeImage_Unload(decoded);
+		FreeImage_CloseMemory(hmem);
+	}
+
+	FreeImage_Unload(src);
+}
+
 // Main test function
 // ----------------------------------------------------------
 
@@ -213,4 +336,8 @@ void testJPEG() {
 
 	// using the same file for src & dst is allowed
 	testJPEGSameFile(src_file);
+
+	// Exif orientation applied while decoding
+	testJPEGExifRotate(8);
+	testJPEGExifRotate(24);
 }
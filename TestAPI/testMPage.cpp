@@ -21,6 +21,7 @@
 
 
 #include "TestSuite.h"
+#include <string.h>
 
 void  
 testBuildMPage(const char *src_filename, const char *dst_filename, FREE_IMAGE_FORMAT dst_fif, unsigned bpp) {
@@ -91,6 +92,291 @@ void testMPageCache(const char *src_filename, const char *dst_filename) {
 	FreeImage_CloseMultiBitmap(out, 0); 
 }
 
+void testMPageCacheBudget(const char *dst_filename) {
+	const int page_count = 24;
+	const unsigned size = 128;
+	const uint64_t budget = 64 * 1024;
+
+	FIMULTIBITMAP *out = FreeImage_OpenMultiBitmap(FIF_GIF, dst_filename, TRUE, FALSE, FALSE);
+	assert(out != NULL);
+	FreeImage_SetPageCacheBudget(out, budget);
+
+	for(int i = 0; i < page_count; i++) {
+		FIBITMAP *dib = FreeImage_Allocate(size, size, 8);
+		assert(dib != NULL);
+		FIRGBA8 *pal = FreeImage_GetPalette(dib);
+		for(int j = 0; j < 256; j++) {
+			pal[j].red = pal[j].green = pal[j].blue = (uint8_t)j;
+		}
+		for(unsigned y = 0; y < size; y++) {
+			uint8_t *bits = FreeImage_GetScanLine(dib, y);
+			for(unsigned x = 0; x < size; x++) {
+				bits[x] = (uint8_t)((x * 7 + y * 13 + i * 31) & 0xFF);
+			}
+		}
+		FreeImage_AppendPage(out, dib);
+		FreeImage_Unload(dib);
+	}
+	assert(FreeImage_GetPageCount(out) == page_count);
+
+	FIPAGECACHESTATS stats;
+	FreeImage_GetPageCacheStats(out, &stats);
+	assert(stats.spills > 0);
+	assert(stats.memory_bytes <= budget);
+	assert(stats.spilled_bytes > 0);
+
+	FreeImage_CloseMultiBitmap(out, 0);
+
+	// check the pages written from the cache
+
+	FIMULTIBITMAP *src = FreeImage_OpenMultiBitmap(FIF_GIF, dst_filename, FALSE, TRUE, TRUE);
+	assert(src != NULL);
+	assert(FreeImage_GetPageCount(src) == page_count);
+	for(int i = 0; i < page_count; i += 5) {
+		FIBITMAP *dib = FreeImage_LockPage(src, i);
+		assert(dib != NULL);
+		assert(FreeImage_GetWidth(dib) == size && FreeImage_GetHeight(dib) == size);
+		const uint8_t *bits = FreeImage_GetScanLine(dib, 3);
+		FIRGBA8 *pal = FreeImage_GetPalette(dib);
+		assert(pal[bits[5]].red == (uint8_t)((5 * 7 + 3 * 13 + i * 31) & 0xFF));
+		FreeImage_UnlockPage(src, dib, FALSE);
+	}
+	FreeImage_CloseMultiBitmap(src, 0);
+}
+
+void testMPageCacheSpool(const char *dst_filename) {
+	const unsigned width = 67, height = 33;
+
+	FIMULTIBITMAP *out = FreeImage_OpenMultiBitmap(FIF_GIF, dst_filename, TRUE, FALSE, TRUE);
+	assert(out != NULL);
+	FreeImage_SetPageCacheCompression(out, TRUE);
+
+	FIBITMAP *dib = FreeImage_Allocate(width, height, 8);
+	assert(dib != NULL);
+	FIRGBA8 *pal = FreeImage_GetPalette(dib);
+	for(int j = 0; j < 256; j++) {
+		pal[j].red = pal[j].green = pal[j].blue = (uint8_t)j;
+	}
+	for(unsigned y = 0; y < height; y++) {
+		uint8_t *bits = FreeImage_GetScanLine(dib, y);
+		for(unsigned x = 0; x < width; x++) {
+			bits[x] = (uint8_t)(x + y * 5);
+		}
+	}
+	FreeImage_SetDotsPerMeterX(dib, 2835);
+	FITAG *tag = FreeImage_CreateTag();
+	const char *comment = "spooled page";
+	FreeImage_SetTagKey(tag, "Comment");
+	FreeImage_SetTagType(tag, FIDT_ASCII);
+	FreeImage_SetTagCount(tag, (uint32_t)strlen(comment) + 1);
+	FreeImage_SetTagLength(tag, (uint32_t)strlen(comment) + 1);
+	FreeImage_SetTagValue(tag, comment);
+	FreeImage_SetMetadata(FIMD_COMMENTS, dib, "Comment", tag);
+	FreeImage_DeleteTag(tag);
+
+	FreeImage_AppendPage(out, dib);
+	FreeImage_Unload(dib);
+
+	// an appended page is read back from the cache, not from the (empty) file
+
+	FIBITMAP *page = FreeImage_LockPage(out, 0);
+	assert(page != NULL);
+	assert(FreeImage_GetWidth(page) == width && FreeImage_GetHeight(page) == height && FreeImage_GetBPP(page) == 8);
+	assert(FreeImage_GetDotsPerMeterX(page) == 2835);
+	assert(FreeImage_GetPalette(page)[200].green == 200);
+	bool success = FreeImage_GetMetadata(FIMD_COMMENTS, page, "Comment", &tag);
+	assert(success);
+	assert(strcmp((const char *)FreeImage_GetTagValue(tag), comment) == 0);
+	assert(FreeImage_GetScanLine(page, 7)[11] == (uint8_t)(11 + 7 * 5));
+
+	// a modified page keeps its modification while the bitmap is open
+
+	FreeImage_GetScanLine(page, 7)[11] = 0xAB;
+	FreeImage_UnlockPage(out, page, TRUE);
+
+	page = FreeImage_LockPage(out, 0);
+	assert(page != NULL);
+	assert(FreeImage_GetScanLine(page, 7)[11] == 0xAB);
+	FreeImage_UnlockPage(out, page, FALSE);
+
+	FreeImage_CloseMultiBitmap(out, 0);
+}
+
+void testMPagePrefetch(const char *src_filename) {
+	FIMULTIBITMAP *ref = FreeImage_OpenMultiBitmap(FIF_GIF, src_filename, FALSE, TRUE, TRUE);
+	assert(ref != NULL);
+	FIMULTIBITMAP *src = FreeImage_OpenMultiBitmap(FIF_GIF, src_filename, FALSE, TRUE, TRUE);
+	assert(src != NULL);
+	bool success = FreeImage_SetPagePrefetch(src, 3);
+	assert(success);
+
+	const int page_count = FreeImage_GetPageCount(src);
+	for(int i = 0; i < page_count; i++) {
+		FIBITMAP *expected = FreeImage_LockPage(ref, i);
+		FIBITMAP *dib = FreeImage_LockPage(src, i);
+		assert(expected != NULL && dib != NULL);
+		for(unsigned y = 0; y < FreeImage_GetHeight(dib); y++) {
+			assert(memcmp(FreeImage_GetScanLine(expected, y), FreeImage_GetScanLine(dib, y), FreeImage_GetLine(dib)) == 0);
+		}
+		FreeImage_UnlockPage(src, dib, FALSE);
+		FreeImage_UnlockPage(ref, expected, FALSE);
+	}
+
+	FIPAGEPREFETCHSTATS stats;
+	FreeImage_GetPagePrefetchStats(src, &stats);
+	assert(stats.hits + stats.misses == (uint64_t)page_count);
+
+	// jump backwards: the read-ahead window moves along, unused pages are discarded
+
+	FIBITMAP *dib = FreeImage_LockPage(src, 1);
+	assert(dib != NULL);
+	FreeImage_UnlockPage(src, dib, FALSE);
+
+	FreeImage_CloseMultiBitmap(src, 0);
+	FreeImage_CloseMultiBitmap(ref, 0);
+}
+
+static unsigned DLL_CALLCONV
+fileReadProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return (unsigned)fread(buffer, size, count, (FILE *)handle);
+}
+
+static unsigned DLL_CALLCONV
+fileWriteProc(void *buffer, unsigned size, unsigned count, fi_handle handle) {
+	return (unsigned)fwrite(buffer, size, count, (FILE *)handle);
+}
+
+static int DLL_CALLCONV
+fileSeekProc(fi_handle handle, long offset, int origin) {
+	return fseek((FILE *)handle, offset, origin);
+}
+
+static long DLL_CALLCONV
+fileTellProc(fi_handle handle) {
+	return ftell((FILE *)handle);
+}
+
+static void assertSamePixels(FIBITMAP *expected, FIBITMAP *actual) {
+	assert(expected != NULL && actual != NULL);
+	assert(FreeImage_GetWidth(actual) == FreeImage_GetWidth(expected));
+	assert(FreeImage_GetHeight(actual) == FreeImage_GetHeight(expected));
+	assert(FreeImage_GetBPP(actual) == FreeImage_GetBPP(expected));
+	for (unsigned y = 0; y < FreeImage_GetHeight(expected); y++) {
+		assert(memcmp(FreeImage_GetScanLine(actual, y), FreeImage_GetScanLine(expected, y), FreeImage_GetLine(expected)) == 0);
+	}
+}
+
+static void assertSamePages(FIMULTIBITMAP *expected, FIMULTIBITMAP *actual) {
+	const int page_count = FreeImage_GetPageCount(expected);
+	assert(FreeImage_GetPageCount(actual) == page_count);
+
+	for (int page = 0; page < page_count; page++) {
+		FIBITMAP *expected_dib = FreeImage_LockPage(expected, page);
+		FIBITMAP *actual_dib = FreeImage_LockPage(actual, page);
+		assertSamePixels(expected_dib, actual_dib);
+		FreeImage_UnlockPage(actual, actual_dib, FALSE);
+		FreeImage_UnlockPage(expected, expected_dib, FALSE);
+	}
+}
+
+/**
+Compares every page of 'actual' with the same page of 'src' saved on its own by the serial
+plugin Save, once both are decoded.
+*/
+static void assertSameAsSerialSave(FREE_IMAGE_FORMAT fif, FIMULTIBITMAP *src, FIMULTIBITMAP *actual) {
+	const int page_count = FreeImage_GetPageCount(src);
+	assert(FreeImage_GetPageCount(actual) == page_count);
+
+	for (int page = 0; page < page_count; page++) {
+		FIBITMAP *src_dib = FreeImage_LockPage(src, page);
+		assert(src_dib != NULL);
+		FIMEMORY *serial = FreeImage_OpenMemory();
+		bool success = FreeImage_SaveToMemory(fif, src_dib, serial, 0);
+		assert(success);
+		FreeImage_UnlockPage(src, src_dib, FALSE);
+
+		FreeImage_SeekMemory(serial, 0, SEEK_SET);
+		FIBITMAP *expected_dib = FreeImage_LoadFromMemory(fif, serial, 0);
+		FIBITMAP *actual_dib = FreeImage_LockPage(actual, page);
+		assertSamePixels(expected_dib, actual_dib);
+		FreeImage_UnlockPage(actual, actual_dib, FALSE);
+		FreeImage_Unload(expected_dib);
+		FreeImage_CloseMemory(serial);
+	}
+}
+
+void testMPageParallelSave(FREE_IMAGE_FORMAT fif, const char *src_filename) {
+	// pages of a bitmap opened from a file are decoded and encoded on worker threads
+
+	FIMULTIBITMAP *src = FreeImage_OpenMultiBitmap(fif, src_filename, FALSE, TRUE, TRUE);
+	assert(src != NULL);
+	FIMEMORY *parallel = FreeImage_OpenMemory();
+	bool success = FreeImage_SaveMultiBitmapToMemory(fif, src, parallel, 0);
+	assert(success);
+
+	// the pages survive the round trip, and decode as the pages of a serial save
+
+	FIMULTIBITMAP *dst = FreeImage_LoadMultiBitmapFromMemory(fif, parallel, 0);
+	assert(dst != NULL);
+	assertSamePages(src, dst);
+	assertSameAsSerialSave(fif, src, dst);
+	FreeImage_CloseMultiBitmap(dst, 0);
+	FreeImage_CloseMultiBitmap(src, 0);
+
+	// a user handle cannot be reopened by the workers, its pages are decoded by the writer
+
+	FreeImageIO io;
+	io.read_proc  = fileReadProc;
+	io.write_proc = fileWriteProc;
+	io.seek_proc  = fileSeekProc;
+	io.tell_proc  = fileTellProc;
+
+	FILE *file = fopen(src_filename, "rb");
+	assert(file != NULL);
+	src = FreeImage_OpenMultiBitmapFromHandle(fif, &io, (fi_handle)file, 0);
+	assert(src != NULL);
+	FIMEMORY *from_handle = FreeImage_OpenMemory();
+	success = FreeImage_SaveMultiBitmapToMemory(fif, src, from_handle, 0);
+	assert(success);
+	FreeImage_CloseMultiBitmap(src, 0);
+	fclose(file);
+
+	uint8_t *parallel_data = NULL, *from_handle_data = NULL;
+	uint32_t parallel_size = 0, from_handle_size = 0;
+	FreeImage_AcquireMemory(parallel, &parallel_data, &parallel_size);
+	FreeImage_AcquireMemory(from_handle, &from_handle_data, &from_handle_size);
+	assert(parallel_size == from_handle_size);
+	assert(memcmp(parallel_data, from_handle_data, from_handle_size) == 0);
+
+	// mix pages of the source with a modified page from the cache
+
+	src = FreeImage_LoadMultiBitmapFromMemory(fif, parallel, 0);
+	assert(src != NULL);
+	const int page_count = FreeImage_GetPageCount(src);
+	const int page = page_count / 2;
+	FIBITMAP *dib = FreeImage_LockPage(src, page);
+	assert(dib != NULL);
+	FreeImage_GetScanLine(dib, 0)[0] = 0xCD;
+	FreeImage_UnlockPage(src, dib, TRUE);
+	FIMEMORY *modified = FreeImage_OpenMemory();
+	success = FreeImage_SaveMultiBitmapToMemory(fif, src, modified, 0);
+	assert(success);
+	FreeImage_CloseMultiBitmap(src, 0);
+
+	src = FreeImage_LoadMultiBitmapFromMemory(fif, modified, 0);
+	assert(src != NULL);
+	assert(FreeImage_GetPageCount(src) == page_count);
+	dib = FreeImage_LockPage(src, page);
+	assert(dib != NULL);
+	assert(FreeImage_GetScanLine(dib, 0)[0] == 0xCD);
+	FreeImage_UnlockPage(src, dib, FALSE);
+	FreeImage_CloseMultiBitmap(src, 0);
+
+	FreeImage_CloseMemory(modified);
+	FreeImage_CloseMemory(from_handle);
+	FreeImage_CloseMemory(parallel);
+}
+
 // --------------------------------------------------------------------------
 
 FIBOOL testCloneMultiPage(FREE_IMAGE_FORMAT fif, const char *input, const char *output, int output_flag) {
@@ -190,4 +476,14 @@ void testMultiPage(const char *lpszPathName) {
 
 	// test multipage cache
 	testMPageCache(lpszPathName, "mpages.tif");
+
+	// test multipage cache spilling
+	testMPageCacheBudget("mpages.gif");
+	testMPageCacheSpool("mpages_spool.gif");
+	testMPagePrefetch("mpages.gif");
+	testMPageParallelSave(FIF_GIF, "mpages.gif");
+	testMPageParallelSave(FIF_ICO, "sample.ico");
+#if FREEIMAGE_WITH_LIBTIFF
+	testMPageParallelSave(FIF_TIFF, "mpages.tif");
+#endif
 }
@@ -22,6 +22,8 @@
 
 #include "TestSuite.h"
 
+#include <string.h>
+
 void testSaveMemIO(const char *lpszPathName) {
 	FIMEMORY *hmem = NULL; 
 
@@ -139,6 +141,188 @@ void testAcquireMemIO(const char *lpszPathName) {
 
 }
 
+// ----------------------------------------------------------
+
+static FIBITMAP* MakeLoadAsImage(FREE_IMAGE_TYPE type, unsigned width, unsigned height, unsigned bpp) {
+	FIBITMAP *dib = FreeImage_AllocateT(type, width, height, bpp);
+	assert(dib != NULL);
+
+	uint32_t seed = 4321;
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *line = FreeImage_GetScanLine(dib, y);
+		for (unsigned i = 0; i < FreeImage_GetLine(dib); i++) {
+			seed = seed * 1664525 + 1013904223;
+			line[i] = (uint8_t)(seed >> 24);
+		}
+	}
+	if (bpp <= 8) {
+		// greyscale palette, so that the PNG is saved as a greyscale image
+		FIRGBA8 *palette = FreeImage_GetPalette(dib);
+		const unsigned colors = FreeImage_GetColorsUsed(dib);
+		for (unsigned i = 0; i < colors; i++) {
+			palette[i].red = palette[i].green = palette[i].blue = (uint8_t)((i * 255) / (colors - 1));
+		}
+	}
+	return dib;
+}
+
+static void CheckLoadAs(FREE_IMAGE_FORMAT fif, FIBITMAP *src, FREE_IMAGE_TYPE type, unsigned bpp, FIBITMAP *expected) {
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	bool success = FreeImage_SaveToMemory(fif, src, hmem, 0);
+	assert(success);
+
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(fif, hmem, 0);
+	assert(loaded != NULL);
+
+	if (!expected) {
+		switch (type) {
+			case FIT_BITMAP:
+				expected = (bpp == 8) ? FreeImage_ConvertToGreyscale(loaded) : (bpp == 24) ? FreeImage_ConvertTo24Bits(loaded) : FreeImage_ConvertTo32Bits(loaded);
+				break;
+			case FIT_RGB16:
+				expected = FreeImage_ConvertToRGB16(loaded);
+				break;
+			case FIT_RGBA16:
+				expected = FreeImage_ConvertToRGBA16(loaded);
+				break;
+			default:
+				expected = FreeImage_ConvertToType(loaded, type, TRUE);
+				break;
+		}
+	}
+	assert(expected != NULL);
+
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *check = FreeImage_LoadAsFromMemory(fif, hmem, type, bpp, 0);
+	assert(check != NULL);
+	assert(FreeImage_GetImageType(check) == FreeImage_GetImageType(expected));
+	assert(FreeImage_GetBPP(check) == FreeImage_GetBPP(expected));
+	assert(FreeImage_GetWidth(check) == FreeImage_GetWidth(expected));
+	assert(FreeImage_GetHeight(check) == FreeImage_GetHeight(expected));
+	for (unsigned y = 0; y < FreeImage_GetHeight(check); y++) {
+		assert(memcmp(FreeImage_GetScanLine(check, y), FreeImage_GetScanLine(expected, y), FreeImage_GetLine(check)) == 0);
+	}
+
+	// header only loading reports the requested layout
+	if (FreeImage_FIFSupportsNoPixels(fif)) {
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *header = FreeImage_LoadAsFromMemory(fif, hmem, type, bpp, FIF_LOAD_NOPIXELS);
+		assert(header != NULL);
+		assert(!FreeImage_HasPixels(header));
+		assert(FreeImage_GetImageType(header) == FreeImage_GetImageType(expected));
+		assert(FreeImage_GetBPP(header) == FreeImage_GetBPP(expected));
+		FreeImage_Unload(header);
+	}
+
+	FreeImage_Unload(check);
+	FreeImage_Unload(expected);
+	FreeImage_Unload(loaded);
+	FreeImage_CloseMemory(hmem);
+}
+
+void testLoadAs() {
+	printf("testLoadAs ...\n");
+
+	const unsigned width = 203;
+	const unsigned height = 67;
+
+	// greyscale, palettized and transparent 8-bit images
+	FIBITMAP *grey4 = MakeLoadAsImage(FIT_BITMAP, width, height, 4);
+	FIBITMAP *grey8 = MakeLoadAsImage(FIT_BITMAP, width, height, 8);
+	FIBITMAP *palette8 = MakeLoadAsImage(FIT_BITMAP, width, height, 8);
+	FIRGBA8 *palette = FreeImage_GetPalette(palette8);
+	for (unsigned i = 0; i < 256; i++) {
+		palette[i].red = (uint8_t)(i * 7);
+		palette[i].green = (uint8_t)(255 - i);
+		palette[i].blue = (uint8_t)(i * 3);
+	}
+	FIBITMAP *transparent8 = FreeImage_Clone(palette8);
+	uint8_t table[100];
+	for (unsigned i = 0; i < 100; i++) {
+		table[i] = (uint8_t)(i * 2);
+	}
+	FreeImage_SetTransparencyTable(transparent8, table, 100);
+
+	FIBITMAP *images8[] = { grey4, grey8, palette8, transparent8 };
+	for (FIBITMAP *dib : images8) {
+		CheckLoadAs(FIF_PNG, dib, FIT_BITMAP, 32, NULL);
+		CheckLoadAs(FIF_PNG, dib, FIT_BITMAP, 24, NULL);
+		CheckLoadAs(FIF_PNG, dib, FIT_BITMAP, 8, NULL);
+	}
+
+	// RGB and RGBA images
+	FIBITMAP *rgb24 = MakeLoadAsImage(FIT_BITMAP, width, height, 24);
+	FIBITMAP *rgba32 = MakeLoadAsImage(FIT_BITMAP, width, height, 32);
+	FIBITMAP *images24[] = { rgb24, rgba32 };
+	for (FIBITMAP *dib : images24) {
+		CheckLoadAs(FIF_PNG, dib, FIT_BITMAP, 32, NULL);
+		CheckLoadAs(FIF_PNG, dib, FIT_BITMAP, 24, NULL);
+		CheckLoadAs(FIF_PNG, dib, FIT_BITMAP, 8, NULL);
+		CheckLoadAs(FIF_PNG, dib, FIT_FLOAT, 0, NULL);
+	}
+
+	// 16-bit images
+	FIBITMAP *uint16 = MakeLoadAsImage(FIT_UINT16, width, height, 16);
+	FIBITMAP *rgb16 = MakeLoadAsImage(FIT_RGB16, width, height, 48);
+	FIBITMAP *rgba16 = MakeLoadAsImage(FIT_RGBA16, width, height, 64);
+	FIBITMAP *images16[] = { uint16, rgb16, rgba16 };
+	for (FIBITMAP *dib : images16) {
+		CheckLoadAs(FIF_PNG, dib, FIT_RGBA16, 0, NULL);
+		CheckLoadAs(FIF_PNG, dib, FIT_RGB16, 48, NULL);
+		if (dib != uint16) {
+			CheckLoadAs(FIF_PNG, dib, FIT_BITMAP, 32, NULL);
+			CheckLoadAs(FIF_PNG, dib, FIT_BITMAP, 24, NULL);
+			CheckLoadAs(FIF_PNG, dib, FIT_UINT16, 0, NULL);
+		}
+	}
+
+	// plugins without a direct path are converted after loading
+	CheckLoadAs(FIF_GIF, palette8, FIT_BITMAP, 32, NULL);
+	CheckLoadAs(FIF_GIF, grey8, FIT_BITMAP, 24, NULL);
+
+	// invalid targets
+	{
+		FIMEMORY *hmem = FreeImage_OpenMemory();
+		bool success = FreeImage_SaveToMemory(FIF_PNG, rgb24, hmem, 0);
+		assert(success);
+		FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+		FIBITMAP *dib = FreeImage_LoadAsFromMemory(FIF_PNG, hmem, FIT_BITMAP, 16, 0);
+		assert(dib == NULL);
+		dib = FreeImage_LoadAsFromMemory(FIF_PNG, hmem, FIT_UNKNOWN, 0, 0);
+		assert(dib == NULL);
+		dib = FreeImage_LoadAsFromMemory(FIF_PNG, hmem, FIT_RGB16, 64, 0);
+		assert(dib == NULL);
+		FreeImage_CloseMemory(hmem);
+	}
+
+#if FREEIMAGE_WITH_LIBJPEG
+	// the requested layout is not applied to the images the plugin loads itself, such as the Exif thumbnail
+	{
+		FIBITMAP *dib = FreeImage_Load(FIF_JPEG, "exif.jpg", 0);
+		assert(dib != NULL);
+		FIBITMAP *check = FreeImage_LoadAs(FIF_JPEG, "exif.jpg", FIT_BITMAP, 32, 0);
+		assert(check != NULL);
+		assert(FreeImage_GetBPP(check) == 32);
+
+		FIBITMAP *thumbnail = FreeImage_GetThumbnail(dib);
+		FIBITMAP *check_thumbnail = FreeImage_GetThumbnail(check);
+		assert((thumbnail != NULL) && (check_thumbnail != NULL));
+		assert(FreeImage_GetBPP(thumbnail) != 32);
+		assert(FreeImage_GetImageType(check_thumbnail) == FreeImage_GetImageType(thumbnail));
+		assert(FreeImage_GetBPP(check_thumbnail) == FreeImage_GetBPP(thumbnail));
+
+		FreeImage_Unload(check);
+		FreeImage_Unload(dib);
+	}
+#endif
+
+	FIBITMAP *all[] = { grey4, grey8, palette8, transparent8, rgb24, rgba32, uint16, rgb16, rgba16 };
+	for (FIBITMAP *dib : all) {
+		FreeImage_Unload(dib);
+	}
+}
+
 void testMemIO(const char *lpszPathName) {
 	printf("testMemIO ...\n");
 	testSaveMemIO(lpszPathName);
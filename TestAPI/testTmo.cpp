@@ -21,8 +21,10 @@
 
 
 #include "TestSuite.h"
+#include <algorithm>
 #include <cmath>
 #include <memory>
+#include <vector>
 
 
 void testTmoClamp()
@@ -299,4 +301,165 @@ void testTmoLinear()
 }
 
 
+namespace {
 
+	// Pad approximation of log(x + 1) used by Drago03
+	double PadeLogRef(double x)
+	{
+		if (x < 1) {
+			return x * (6 + x) / (6 + 4 * x);
+		}
+		if (x < 2) {
+			return x * (6 + 0.7662 * x) / (5.9897 + 3.7658 * x);
+		}
+		return std::log(x + 1);
+	}
+
+	uint8_t ToByteRef(double v)
+	{
+		return static_cast<uint8_t>(255 * std::clamp(v, 0.0, 1.0) + 0.5);
+	}
+
+	void CheckRGB8(FIBITMAP* res, const std::vector<uint8_t>& expected)
+	{
+		assert(res != nullptr);
+		assert(FreeImage_GetBPP(res) == 24);
+		const unsigned width = FreeImage_GetWidth(res);
+		const unsigned height = FreeImage_GetHeight(res);
+		for (unsigned y = 0; y < height; ++y) {
+			const auto line = reinterpret_cast<const FIRGB8*>(FreeImage_GetScanLine(res, y));
+			for (unsigned x = 0; x < width; ++x) {
+				const uint8_t* e = &expected[3 * (y * width + x)];
+				assert(std::abs(line[x].red - e[0]) <= 1);
+				assert(std::abs(line[x].green - e[1]) <= 1);
+				assert(std::abs(line[x].blue - e[2]) <= 1);
+			}
+		}
+	}
+
+} // namespace
+
+
+void testTmoGlobal()
+{
+	// Drago03 and Reinhard05 compute in float with fast log / exp, within 1 level of the double precision formulas
+	// for positive samples and, with Drago03, no gamma correction or a gamma whose REC709 curve is continuous (2 or 2.2)
+
+	const unsigned width = 37;
+	const unsigned height = 23;
+	std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_AllocateT(FIT_RGBF, width, height), &::FreeImage_Unload);
+	assert(src != nullptr);
+
+	std::vector<double> rgb, lum;
+	for (unsigned y = 0; y < height; ++y) {
+		const auto line = reinterpret_cast<FIRGBF*>(FreeImage_GetScanLine(src.get(), y));
+		for (unsigned x = 0; x < width; ++x) {
+			const float base = std::pow(10.0f, -2.0f + 4.0f * x / width);
+			line[x].red = base * (0.3f + 0.03f * (y % 7));
+			line[x].green = base * (0.5f + 0.02f * ((x + y) % 11));
+			line[x].blue = base * (0.2f + 0.05f * ((x * y) % 5));
+			rgb.insert(rgb.end(), { line[x].red, line[x].green, line[x].blue });
+			lum.push_back(0.2126 * line[x].red + 0.7152 * line[x].green + 0.0722 * line[x].blue);
+		}
+	}
+	const size_t size = lum.size();
+
+	double maxLum = 0, minLum = 1e20, sumLum = 0, logSum = 0;
+	double channelSum[3] = {};
+	for (size_t i = 0; i < size; ++i) {
+		maxLum = std::max(maxLum, lum[i]);
+		minLum = std::min(minLum, lum[i]);
+		sumLum += lum[i];
+		logSum += std::log(2.3e-5 + lum[i]);
+		for (unsigned c = 0; c < 3; ++c) {
+			channelSum[c] += rgb[3 * i + c];
+		}
+	}
+	const double Lav = sumLum / size;
+	const double Llav = std::exp(logSum / size);
+
+	const auto drago03 = [&](double gamma) {
+		const double Lmax = maxLum / Llav;
+		const double divider = std::log10(Lmax + 1);
+		const double biasP = std::log(0.85) / std::log(0.5);
+
+		// REC709 gamma correction, continuous at its start threshold for gamma 2.2
+		const double fgamma = (0.45 / gamma) * 2;
+		double start = 0.018, slope = 4.5;
+		if (gamma >= 2.1) {
+			start = 0.018 / ((gamma - 2) * 7.5);
+			slope = 4.5 * ((gamma - 2) * 7.5);
+		}
+		else if (gamma <= 1.9) {
+			start = 0.018 * ((2 - gamma) * 7.5);
+			slope = 4.5 / ((2 - gamma) * 7.5);
+		}
+
+		std::vector<uint8_t> expected;
+		for (size_t i = 0; i < size; ++i) {
+			const double Yw = lum[i] / Llav;
+			const double interpol = std::log(2 + std::pow(Yw / Lmax, biasP) * 8);
+			const double mapped = PadeLogRef(Yw) / interpol / divider;
+			for (unsigned c = 0; c < 3; ++c) {
+				double v = rgb[3 * i + c] * mapped / lum[i];
+				if (gamma != 1) {
+					v = (v <= start) ? v * slope : 1.099 * std::pow(v, fgamma) - 0.099;
+				}
+				expected.push_back(ToByteRef(v));
+			}
+		}
+		return expected;
+	};
+
+	{
+		// Drago03 without gamma correction: the color is scaled with the mapped luminance
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> res(FreeImage_TmoDrago03(src.get(), 1.0, 0), &::FreeImage_Unload);
+		CheckRGB8(res.get(), drago03(1.0));
+	}
+
+	{
+		// Drago03 with the default gamma correction
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> res(FreeImage_TmoDrago03(src.get(), 2.2, 0), &::FreeImage_Unload);
+		CheckRGB8(res.get(), drago03(2.2));
+	}
+
+	const auto reinhard05 = [&](double f, double m, double a, double c) {
+		if (m == 0) {
+			double k = (std::log(maxLum) - Llav) / (std::log(maxLum) - std::log(minLum));
+			if (k < 0) {
+				k = (std::log(maxLum) - std::log(Llav)) / (std::log(maxLum) - std::log(minLum));
+			}
+			m = (k < 0) ? 0.3 : 0.3 + 0.7 * std::pow(k, 1.4);
+		}
+		f = std::exp(-f);
+
+		std::vector<double> mapped;
+		for (size_t i = 0; i < size; ++i) {
+			for (unsigned ch = 0; ch < 3; ++ch) {
+				const double color = rgb[3 * i + ch];
+				const double Ig = c * channelSum[ch] / size + (1 - c) * Lav;
+				const double Il = c * color + (1 - c) * lum[i];
+				const double Ia = a * Il + (1 - a) * Ig;
+				mapped.push_back(color / (color + std::pow(f * Ia, m)));
+			}
+		}
+		const auto [mn, mx] = std::minmax_element(mapped.begin(), mapped.end());
+		const double offset = *mn, range = *mx - *mn;
+
+		std::vector<uint8_t> expected;
+		for (double v : mapped) {
+			expected.push_back(ToByteRef((v - offset) / range));
+		}
+		return expected;
+	};
+
+	{
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> res(FreeImage_TmoReinhard05(src.get(), 0, 0), &::FreeImage_Unload);
+		CheckRGB8(res.get(), reinhard05(0, 0, 1, 0));
+	}
+
+	{
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> res(FreeImage_TmoReinhard05Ex(src.get(), 1.5, 0.6, 0.5, 0.5), &::FreeImage_Unload);
+		CheckRGB8(res.get(), reinhard05(1.5, 0.6, 0.5, 0.5));
+	}
+}
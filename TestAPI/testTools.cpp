@@ -21,7 +21,9 @@
 
 
 #include "TestSuite.h"
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <memory>
 
 
@@ -308,3 +310,401 @@ void testFindMinMax()
 	}
 }
 
+
+// ----------------------------------------------------------
+
+namespace {
+
+	/// Pixel value of a 1-bit scanline
+	unsigned GetBit(const uint8_t* line, unsigned x)
+	{
+		return (line[x >> 3] >> (7 - (x & 7))) & 1;
+	}
+
+	void CheckQuarterTurn(FREE_IMAGE_TYPE type, unsigned bpp, unsigned width, unsigned height, double angle)
+	{
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_AllocateT(type, width, height, bpp), &::FreeImage_Unload);
+		assert(src != nullptr);
+		uint32_t seed = width * 31 + height;
+		for (unsigned y = 0; y < height; ++y) {
+			uint8_t* line = FreeImage_GetScanLine(src.get(), y);
+			for (unsigned i = 0; i < FreeImage_GetLine(src.get()); ++i) {
+				seed = seed * 1664525 + 1013904223;
+				line[i] = static_cast<uint8_t>(seed >> 24);
+			}
+		}
+
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> dst(FreeImage_Rotate(src.get(), angle), &::FreeImage_Unload);
+		assert(dst != nullptr);
+		assert(FreeImage_GetImageType(dst.get()) == type);
+		assert(FreeImage_GetBPP(dst.get()) == bpp);
+		assert(FreeImage_GetWidth(dst.get()) == height);
+		assert(FreeImage_GetHeight(dst.get()) == width);
+
+		// scanlines are stored bottom-up, so a counter clockwise angle turns the buffer clockwise
+		const bool clockwise = (angle == 90);
+		const unsigned bytespp = bpp / 8;
+		for (unsigned y = 0; y < width; ++y) {
+			const uint8_t* dst_line = FreeImage_GetScanLine(dst.get(), y);
+			for (unsigned x = 0; x < height; ++x) {
+				const unsigned src_y = clockwise ? height - 1 - x : x;
+				const unsigned src_x = clockwise ? y : width - 1 - y;
+				const uint8_t* src_line = FreeImage_GetScanLine(src.get(), src_y);
+				if (bpp == 1) {
+					assert(GetBit(dst_line, x) == GetBit(src_line, src_x));
+				}
+				else {
+					assert(memcmp(dst_line + x * bytespp, src_line + src_x * bytespp, bytespp) == 0);
+				}
+			}
+		}
+	}
+
+} // namespace
+
+void testRotateQuarterTurns()
+{
+	struct Layout {
+		FREE_IMAGE_TYPE type;
+		unsigned bpp;
+	};
+	const Layout layouts[] = {
+		{ FIT_BITMAP, 1 }, { FIT_BITMAP, 8 }, { FIT_BITMAP, 24 }, { FIT_BITMAP, 32 },
+		{ FIT_UINT16, 16 }, { FIT_RGB16, 48 }, { FIT_RGBA16, 64 },
+		{ FIT_FLOAT, 32 }, { FIT_RGBF, 96 }, { FIT_RGBAF, 128 }
+	};
+	const unsigned sizes[][2] = { { 1, 1 }, { 7, 5 }, { 9, 17 }, { 67, 131 }, { 531, 347 } };
+
+	for (const auto& layout : layouts) {
+		for (const auto& size : sizes) {
+			CheckQuarterTurn(layout.type, layout.bpp, size[0], size[1], 90);
+			CheckQuarterTurn(layout.type, layout.bpp, size[0], size[1], 270);
+		}
+	}
+}
+
+void testBilevel()
+{
+	const unsigned sizes[][2] = { { 1, 1 }, { 7, 5 }, { 64, 3 }, { 65, 9 }, { 131, 67 }, { 531, 347 } };
+
+	for (const auto& size : sizes) {
+		const unsigned width = size[0];
+		const unsigned height = size[1];
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> src(FreeImage_Allocate(width, height, 1), &::FreeImage_Unload);
+		assert(src != nullptr);
+		uint32_t seed = width * 31 + height;
+		for (unsigned y = 0; y < height; ++y) {
+			uint8_t* line = FreeImage_GetScanLine(src.get(), y);
+			for (unsigned i = 0; i < FreeImage_GetLine(src.get()); ++i) {
+				seed = seed * 1664525 + 1013904223;
+				line[i] = static_cast<uint8_t>(seed >> 24);
+			}
+		}
+
+		// horizontal flip and 180 degree rotation
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> flipped(FreeImage_Clone(src.get()), &::FreeImage_Unload);
+		bool success = FreeImage_FlipHorizontal(flipped.get());
+		assert(success);
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> rotated(FreeImage_Rotate(src.get(), 180), &::FreeImage_Unload);
+		assert(rotated != nullptr);
+		for (unsigned y = 0; y < height; ++y) {
+			const uint8_t* src_line = FreeImage_GetScanLine(src.get(), y);
+			const uint8_t* flipped_line = FreeImage_GetScanLine(flipped.get(), y);
+			const uint8_t* rotated_line = FreeImage_GetScanLine(rotated.get(), height - 1 - y);
+			for (unsigned x = 0; x < width; ++x) {
+				assert(GetBit(flipped_line, width - 1 - x) == GetBit(src_line, x));
+				assert(GetBit(rotated_line, width - 1 - x) == GetBit(src_line, x));
+			}
+		}
+
+		// area averaging, down and up, with a black on white palette
+		FIRGBA8* pal = FreeImage_GetPalette(src.get());
+		pal[0].red = pal[0].green = pal[0].blue = 255;
+		pal[1].red = pal[1].green = pal[1].blue = 0;
+		const unsigned dst_sizes[][2] = { { 1, 1 }, { (width + 2) / 3, (height + 1) / 2 }, { width / 2 + 1, height }, { 2 * width + 1, height + 3 } };
+		for (const auto& dst_size : dst_sizes) {
+			const unsigned dst_width = dst_size[0];
+			const unsigned dst_height = dst_size[1];
+			std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> grey(FreeImage_RescaleBilevel(src.get(), dst_width, dst_height), &::FreeImage_Unload);
+			assert(grey != nullptr);
+			assert(FreeImage_GetBPP(grey.get()) == 8);
+			assert(FreeImage_GetColorType(grey.get()) == FIC_MINISBLACK);
+			for (unsigned y = 0; y < dst_height; ++y) {
+				const unsigned y0 = y * height / dst_height;
+				const unsigned y1 = std::max((y + 1) * height / dst_height, y0 + 1);
+				const uint8_t* grey_line = FreeImage_GetScanLine(grey.get(), y);
+				for (unsigned x = 0; x < dst_width; ++x) {
+					const unsigned x0 = x * width / dst_width;
+					const unsigned x1 = std::max((x + 1) * width / dst_width, x0 + 1);
+					unsigned ones = 0;
+					for (unsigned sy = y0; sy < y1; ++sy) {
+						for (unsigned sx = x0; sx < x1; ++sx) {
+							ones += GetBit(FreeImage_GetScanLine(src.get(), sy), sx);
+						}
+					}
+					const unsigned area = (x1 - x0) * (y1 - y0);
+					assert(grey_line[x] == (255 * (area - ones) + area / 2) / area);
+				}
+			}
+		}
+	}
+
+	// thumbnails of bilevel images are averaged to grey
+	{
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> page(FreeImage_Allocate(1700, 2200, 1), &::FreeImage_Unload);
+		assert(page != nullptr);
+		FIRGBA8* pal = FreeImage_GetPalette(page.get());
+		pal[1].red = pal[1].green = pal[1].blue = 255;
+		for (unsigned y = 0; y < 2200; ++y) {
+			// vertical stripes of one black and one white pixel
+			memset(FreeImage_GetScanLine(page.get(), y), 0x55, FreeImage_GetLine(page.get()));
+		}
+		std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)> thumbnail(FreeImage_MakeThumbnail(page.get(), 110), &::FreeImage_Unload);
+		assert(thumbnail != nullptr);
+		assert(FreeImage_GetBPP(thumbnail.get()) == 8);
+		assert(FreeImage_GetWidth(thumbnail.get()) == 85);
+		assert(FreeImage_GetHeight(thumbnail.get()) == 110);
+		for (unsigned y = 0; y < 110; ++y) {
+			const uint8_t* line = FreeImage_GetScanLine(thumbnail.get(), y);
+			for (unsigned x = 0; x < 85; ++x) {
+				assert(line[x] == 128);
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------
+
+namespace {
+
+	using UniqueBitmap = std::unique_ptr<FIBITMAP, decltype(&::FreeImage_Unload)>;
+
+	UniqueBitmap createRandomImage(FREE_IMAGE_TYPE type, unsigned width, unsigned height, unsigned bpp, uint32_t seed)
+	{
+		UniqueBitmap dib(FreeImage_AllocateT(type, width, height, bpp), &::FreeImage_Unload);
+		assert(dib != nullptr);
+		for (unsigned y = 0; y < height; ++y) {
+			uint8_t* line = FreeImage_GetScanLine(dib.get(), y);
+			for (unsigned i = 0; i < FreeImage_GetLine(dib.get()); ++i) {
+				seed = seed * 1664525 + 1013904223;
+				line[i] = static_cast<uint8_t>(seed >> 24);
+			}
+		}
+		if (type == FIT_RGBAF) {
+			// samples in [0, 1]
+			for (unsigned y = 0; y < height; ++y) {
+				FIRGBAF* line = reinterpret_cast<FIRGBAF*>(FreeImage_GetScanLine(dib.get(), y));
+				for (unsigned x = 0; x < width; ++x) {
+					seed = seed * 1664525 + 1013904223;
+					line[x].red = (seed >> 24) / 255.0F;
+					line[x].green = ((seed >> 16) & 0xFF) / 255.0F;
+					line[x].blue = ((seed >> 8) & 0xFF) / 255.0F;
+					line[x].alpha = (x % 3 == 0) ? 0.0F : ((x % 3 == 1) ? 1.0F : 0.25F);
+				}
+			}
+		}
+		else if (bpp == 32) {
+			// exercise the fully transparent and opaque pixels too
+			for (unsigned y = 0; y < height; ++y) {
+				uint8_t* line = FreeImage_GetScanLine(dib.get(), y);
+				for (unsigned x = 0; x < width; x += 5) {
+					line[4 * x + FI_RGBA_ALPHA] = (x % 2) ? 0xFF : 0x00;
+				}
+			}
+		}
+		return dib;
+	}
+
+	unsigned blend8(unsigned f, unsigned b, unsigned a)
+	{
+		return (a * f + (255 - a) * b + 127) / 255;
+	}
+
+} // namespace
+
+void testAlphaBlending()
+{
+	const unsigned width = 37;
+	const unsigned height = 23;
+
+	// premultiplication
+	{
+		UniqueBitmap dib = createRandomImage(FIT_BITMAP, width, height, 32, 1);
+		UniqueBitmap ref(FreeImage_Clone(dib.get()), &::FreeImage_Unload);
+		bool success = FreeImage_PreMultiplyWithAlpha(dib.get());
+		assert(success);
+		for (unsigned y = 0; y < height; ++y) {
+			const uint8_t* line = FreeImage_GetScanLine(dib.get(), y);
+			const uint8_t* src = FreeImage_GetScanLine(ref.get(), y);
+			for (unsigned x = 0; x < width; ++x) {
+				const unsigned a = src[4 * x + FI_RGBA_ALPHA];
+				assert(line[4 * x + FI_RGBA_ALPHA] == a);
+				for (unsigned c = 0; c < 3; ++c) {
+					assert(line[4 * x + c] == (src[4 * x + c] * a + 127) / 255);
+				}
+			}
+		}
+	}
+	{
+		UniqueBitmap dib = createRandomImage(FIT_RGBA16, width, height, 64, 2);
+		UniqueBitmap ref(FreeImage_Clone(dib.get()), &::FreeImage_Unload);
+		bool success = FreeImage_PreMultiplyWithAlpha(dib.get());
+		assert(success);
+		for (unsigned y = 0; y < height; ++y) {
+			const FIRGBA16* line = reinterpret_cast<const FIRGBA16*>(FreeImage_GetScanLine(dib.get(), y));
+			const FIRGBA16* src = reinterpret_cast<const FIRGBA16*>(FreeImage_GetScanLine(ref.get(), y));
+			for (unsigned x = 0; x < width; ++x) {
+				const uint64_t a = src[x].alpha;
+				assert(line[x].alpha == a);
+				assert(line[x].red == (src[x].red * a + 32767) / 65535);
+				assert(line[x].green == (src[x].green * a + 32767) / 65535);
+				assert(line[x].blue == (src[x].blue * a + 32767) / 65535);
+			}
+		}
+	}
+	{
+		UniqueBitmap dib = createRandomImage(FIT_RGBAF, width, height, 128, 3);
+		UniqueBitmap ref(FreeImage_Clone(dib.get()), &::FreeImage_Unload);
+		bool success = FreeImage_PreMultiplyWithAlpha(dib.get());
+		assert(success);
+		const FIRGBAF* line = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(dib.get(), 4));
+		const FIRGBAF* src = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(ref.get(), 4));
+		for (unsigned x = 0; x < width; ++x) {
+			assert(line[x].red == src[x].red * src[x].alpha);
+			assert(line[x].blue == src[x].blue * src[x].alpha);
+		}
+		UniqueBitmap grey(FreeImage_AllocateT(FIT_FLOAT, width, height), &::FreeImage_Unload);
+		success = FreeImage_PreMultiplyWithAlpha(grey.get());
+		assert(!success);
+	}
+
+	// compositing onto a color, a background image and a checkerboard
+	{
+		UniqueBitmap fg = createRandomImage(FIT_BITMAP, width, height, 32, 4);
+		UniqueBitmap bg = createRandomImage(FIT_BITMAP, width, height, 24, 5);
+		FIRGBA8 color = { 10, 20, 30, 0 };
+
+		UniqueBitmap on_color(FreeImage_Composite(fg.get(), FALSE, &color), &::FreeImage_Unload);
+		UniqueBitmap on_image(FreeImage_Composite(fg.get(), FALSE, nullptr, bg.get()), &::FreeImage_Unload);
+		UniqueBitmap on_checker(FreeImage_Composite(fg.get()), &::FreeImage_Unload);
+		assert(on_color && on_image && on_checker);
+		assert(FreeImage_GetBPP(on_color.get()) == 24);
+
+		uint8_t bk[3];
+		bk[FI_RGBA_RED] = color.red;
+		bk[FI_RGBA_GREEN] = color.green;
+		bk[FI_RGBA_BLUE] = color.blue;
+		for (unsigned y = 0; y < height; ++y) {
+			const uint8_t* f = FreeImage_GetScanLine(fg.get(), y);
+			const uint8_t* b = FreeImage_GetScanLine(bg.get(), y);
+			const uint8_t* c1 = FreeImage_GetScanLine(on_color.get(), y);
+			const uint8_t* c2 = FreeImage_GetScanLine(on_image.get(), y);
+			const uint8_t* c3 = FreeImage_GetScanLine(on_checker.get(), y);
+			for (unsigned x = 0; x < width; ++x) {
+				const unsigned a = f[4 * x + FI_RGBA_ALPHA];
+				const unsigned checker = (((y & 0x8) == 0) ^ ((x & 0x8) == 0)) ? 192 : 255;
+				for (unsigned c = 0; c < 3; ++c) {
+					assert(c1[3 * x + c] == blend8(f[4 * x + c], bk[c], a));
+					assert(c2[3 * x + c] == blend8(f[4 * x + c], b[3 * x + c], a));
+					assert(c3[3 * x + c] == blend8(f[4 * x + c], checker, a));
+				}
+			}
+		}
+
+		// the background image must match the composite image
+		UniqueBitmap bad(FreeImage_Composite(fg.get(), FALSE, nullptr, fg.get()), &::FreeImage_Unload);
+		assert(!bad);
+	}
+	{
+		// palettized foreground with a transparency table
+		UniqueBitmap fg = createRandomImage(FIT_BITMAP, width, height, 8, 6);
+		FIRGBA8* pal = FreeImage_GetPalette(fg.get());
+		uint8_t trns[256];
+		for (unsigned i = 0; i < 256; ++i) {
+			pal[i].red = (uint8_t)i;
+			pal[i].green = (uint8_t)(255 - i);
+			pal[i].blue = (uint8_t)(i * 7);
+			trns[i] = (uint8_t)(i * 3);
+		}
+		FreeImage_SetTransparencyTable(fg.get(), trns, 256);
+		FIRGBA8 color = { 200, 100, 50, 0 };
+		UniqueBitmap composite(FreeImage_Composite(fg.get(), FALSE, &color), &::FreeImage_Unload);
+		assert(composite);
+		const uint8_t* f = FreeImage_GetScanLine(fg.get(), 7);
+		const uint8_t* c = FreeImage_GetScanLine(composite.get(), 7);
+		for (unsigned x = 0; x < width; ++x) {
+			const FIRGBA8& p = pal[f[x]];
+			assert(c[3 * x + FI_RGBA_RED] == blend8(p.red, color.red, trns[f[x]]));
+			assert(c[3 * x + FI_RGBA_GREEN] == blend8(p.green, color.green, trns[f[x]]));
+			assert(c[3 * x + FI_RGBA_BLUE] == blend8(p.blue, color.blue, trns[f[x]]));
+		}
+	}
+	{
+		UniqueBitmap fg = createRandomImage(FIT_RGBA16, width, height, 64, 7);
+		FIRGBA8 color = { 1, 2, 3, 0 };
+		UniqueBitmap composite(FreeImage_Composite(fg.get(), FALSE, &color), &::FreeImage_Unload);
+		assert(composite && (FreeImage_GetImageType(composite.get()) == FIT_RGB16));
+		const FIRGBA16* f = reinterpret_cast<const FIRGBA16*>(FreeImage_GetScanLine(fg.get(), 3));
+		const FIRGB16* c = reinterpret_cast<const FIRGB16*>(FreeImage_GetScanLine(composite.get(), 3));
+		for (unsigned x = 0; x < width; ++x) {
+			const uint64_t a = f[x].alpha;
+			assert(c[x].red == (a * f[x].red + (65535 - a) * 257 * color.red + 32767) / 65535);
+			assert(c[x].blue == (a * f[x].blue + (65535 - a) * 257 * color.blue + 32767) / 65535);
+		}
+	}
+	{
+		UniqueBitmap fg = createRandomImage(FIT_RGBAF, width, height, 128, 8);
+		UniqueBitmap bg(FreeImage_AllocateT(FIT_RGBF, width, height), &::FreeImage_Unload);
+		const FIRGBF grey = { 0.5F, 0.5F, 0.5F };
+		bool success = FreeImage_Fill(bg.get(), &grey, sizeof(grey));
+		assert(success);
+		UniqueBitmap composite(FreeImage_Composite(fg.get(), FALSE, nullptr, bg.get()), &::FreeImage_Unload);
+		assert(composite && (FreeImage_GetImageType(composite.get()) == FIT_RGBF));
+		const FIRGBAF* f = reinterpret_cast<const FIRGBAF*>(FreeImage_GetScanLine(fg.get(), 5));
+		const FIRGBF* c = reinterpret_cast<const FIRGBF*>(FreeImage_GetScanLine(composite.get(), 5));
+		for (unsigned x = 0; x < width; ++x) {
+			assert(std::fabs(c[x].green - (f[x].alpha * f[x].green + (1 - f[x].alpha) * 0.5F)) < 1e-6F);
+		}
+	}
+
+	// pasting with a constant alpha and drawing with the source alpha
+	{
+		UniqueBitmap dst = createRandomImage(FIT_BITMAP, width, height, 32, 9);
+		UniqueBitmap src = createRandomImage(FIT_BITMAP, 20, 10, 32, 10);
+		UniqueBitmap ref(FreeImage_Clone(dst.get()), &::FreeImage_Unload);
+		bool success = FreeImage_Paste(dst.get(), src.get(), 5, 4, 100);
+		assert(success);
+		for (unsigned y = 0; y < 10; ++y) {
+			const uint8_t* s = FreeImage_GetScanLine(src.get(), y);
+			const uint8_t* d = FreeImage_GetScanLine(dst.get(), height - 4 - 10 + y) + 4 * 5;
+			const uint8_t* r = FreeImage_GetScanLine(ref.get(), height - 4 - 10 + y) + 4 * 5;
+			for (unsigned i = 0; i < 4 * 20; ++i) {
+				assert(d[i] == (uint8_t)(((s[i] - r[i]) * 100 + (r[i] << 8)) >> 8));
+			}
+		}
+
+		UniqueBitmap drawn(FreeImage_Clone(ref.get()), &::FreeImage_Unload);
+		success = FreeImage_DrawBitmap(drawn.get(), src.get(), FIAO_SrcAlpha, 30, -3);
+		assert(success);
+		for (unsigned y = 0; y < height; ++y) {
+			const uint8_t* d = FreeImage_GetScanLine(drawn.get(), y);
+			const uint8_t* r = FreeImage_GetScanLine(ref.get(), y);
+			const unsigned top = height - 1 - y;
+			for (unsigned x = 0; x < width; ++x) {
+				const bool inside = (x >= 30) && (top < 7);
+				for (unsigned c = 0; c < 4; ++c) {
+					unsigned expected = r[4 * x + c];
+					if (inside && (c != FI_RGBA_ALPHA)) {
+						const uint8_t* s = FreeImage_GetScanLine(src.get(), 10 - 1 - (top + 3)) + 4 * (x - 30);
+						const unsigned a = s[FI_RGBA_ALPHA];
+						expected = (a * s[c] + (255 - a) * expected) / 255;
+					}
+					assert(d[4 * x + c] == expected);
+				}
+			}
+		}
+		// regions outside of dst are skipped
+		success = FreeImage_DrawBitmap(drawn.get(), src.get(), FIAO_SrcAlpha, width, 0);
+		assert(success);
+	}
+}
@@ -21,6 +21,9 @@
 
 
 #include "TestSuite.h"
+#include "FreeImage.hpp"
+#include <string.h>
+#include <stdexcept>
 
 // Local test functions
 // ----------------------------------------------------------
@@ -161,3 +164,375 @@ void testCreateView(const char *lpszPathName, int flags) {
 
 	FreeImage_Unload(dib);
 }
+
+// ----------------------------------------------------------
+
+/** Returns TRUE if both images hold the same pixels, scanline by scanline */
+static FIBOOL isSameImage(FIBITMAP *dib1, FIBITMAP *dib2) {
+	if ((FreeImage_GetImageType(dib1) != FreeImage_GetImageType(dib2)) || (FreeImage_GetBPP(dib1) != FreeImage_GetBPP(dib2))) {
+		return FALSE;
+	}
+	if ((FreeImage_GetWidth(dib1) != FreeImage_GetWidth(dib2)) || (FreeImage_GetHeight(dib1) != FreeImage_GetHeight(dib2))) {
+		return FALSE;
+	}
+	for (unsigned y = 0; y < FreeImage_GetHeight(dib1); y++) {
+		if (memcmp(FreeImage_GetScanLine(dib1, y), FreeImage_GetScanLine(dib2, y), FreeImage_GetLine(dib1)) != 0) {
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/** Checks that process(td) == process(bu), td and bu holding the same pixels in opposite scanline orders */
+static void checkSameResult(FIBITMAP *td, FIBITMAP *bu, FIBITMAP* (*process)(FIBITMAP *dib)) {
+	FIBITMAP *dst1 = process(td);
+	FIBITMAP *dst2 = process(bu);
+	assert(dst1 && dst2);
+	assert(isSameImage(dst1, dst2));
+	FreeImage_Unload(dst1);
+	FreeImage_Unload(dst2);
+}
+
+static FIBITMAP* copySection(FIBITMAP *dib) {
+	return FreeImage_Copy(dib, 5, 3, 30, 19);
+}
+
+static FIBITMAP* createViewSection(FIBITMAP *dib) {
+	// views are unloaded with their parent: return a copy
+	FIBITMAP *view = FreeImage_CreateView(dib, 7, 2, 33, 21);
+	FIBITMAP *dst = FreeImage_Clone(view);
+	FreeImage_Unload(view);
+	return dst;
+}
+
+static FIBITMAP* rotate90(FIBITMAP *dib) {
+	return FreeImage_Rotate(dib, 90);
+}
+
+static FIBITMAP* rescale(FIBITMAP *dib) {
+	return FreeImage_Rescale(dib, 50, 17, FILTER_BILINEAR);
+}
+
+static FIBITMAP* pasteInto(FIBITMAP *dib) {
+	FIBITMAP *dst = FreeImage_Allocate(60, 40, FreeImage_GetBPP(dib));
+	if (dst) {
+		FreeImage_Paste(dst, dib, 11, 9, 256);
+	}
+	return dst;
+}
+
+void testTopDown() {
+	const unsigned width = 37;
+	const unsigned height = 23;
+
+	// bottom-up reference image
+	FIBITMAP *bu = FreeImage_Allocate(width, height, 24);
+	assert(bu != NULL);
+	assert(!FreeImage_IsTopDown(bu));
+	uint32_t seed = 12345;
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *line = FreeImage_GetScanLine(bu, y);
+		for (unsigned i = 0; i < FreeImage_GetLine(bu); i++) {
+			seed = seed * 1664525 + 1013904223;
+			line[i] = (uint8_t)(seed >> 24);
+		}
+	}
+
+	// same image, scanlines stored top-down
+	FIBITMAP *td = FreeImage_Clone(bu);
+	assert(td != NULL);
+	FreeImage_FlipVertical(td);
+	bool success = FreeImage_SetTopDown(td, TRUE);
+	assert(success);
+	assert(FreeImage_IsTopDown(td));
+	assert(isSameImage(td, bu));
+
+	const unsigned pitch = FreeImage_GetPitch(td);
+	assert(FreeImage_GetScanLineStride(bu) == (int)pitch);
+	assert(FreeImage_GetScanLineStride(td) == -(int)pitch);
+	assert(FreeImage_GetScanLine(td, height - 1) == FreeImage_GetBits(td));
+	assert(FreeImage_GetScanLine(td, 0) == FreeImage_GetBits(td) + (height - 1) * pitch);
+
+	// the clone keeps the scanline order
+	FIBITMAP *clone = FreeImage_Clone(td);
+	assert(clone != NULL);
+	assert(FreeImage_IsTopDown(clone));
+	assert(isSameImage(clone, bu));
+	FreeImage_Unload(clone);
+
+	// processing gives the same result whatever the scanline order
+	checkSameResult(td, bu, copySection);
+	checkSameResult(td, bu, createViewSection);
+	checkSameResult(td, bu, rotate90);
+	checkSameResult(td, bu, rescale);
+	checkSameResult(td, bu, pasteInto);
+	checkSameResult(td, bu, FreeImage_ConvertTo32Bits);
+	checkSameResult(td, bu, FreeImage_ConvertToGreyscale);
+	checkSameResult(td, bu, FreeImage_ConvertToRGBF);
+
+	// raw buffers in top-down order are wrapped as is
+	uint8_t *raw = (uint8_t*)malloc(height * pitch);
+	assert(raw != NULL);
+	FreeImage_ConvertToRawBits(raw, td, pitch, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, TRUE);
+	for (unsigned y = 0; y < height; y++) {
+		assert(memcmp(raw + y * pitch, FreeImage_GetScanLine(bu, height - 1 - y), FreeImage_GetLine(bu)) == 0);
+	}
+	FIBITMAP *wrapper = FreeImage_ConvertFromRawBitsEx(FALSE, raw, FIT_BITMAP, width, height, pitch, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, TRUE);
+	assert(wrapper != NULL);
+	assert(FreeImage_GetBits(wrapper) == raw);
+	assert(isSameImage(wrapper, bu));
+	FreeImage_Unload(wrapper);
+	FIBITMAP *copy = FreeImage_ConvertFromRawBits(raw, width, height, pitch, 24, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, TRUE);
+	assert(copy != NULL);
+	assert(isSameImage(copy, bu));
+	FreeImage_Unload(copy);
+	free(raw);
+
+	// savers write the image as seen through FreeImage_GetScanLine
+	FIMEMORY *hmem = FreeImage_OpenMemory();
+	success = FreeImage_SaveToMemory(FIF_BMP, td, hmem, 0);
+	assert(success);
+	FreeImage_SeekMemory(hmem, 0, SEEK_SET);
+	FIBITMAP *loaded = FreeImage_LoadFromMemory(FIF_BMP, hmem, 0);
+	assert(loaded != NULL);
+	assert(isSameImage(loaded, bu));
+	FreeImage_Unload(loaded);
+	FreeImage_CloseMemory(hmem);
+
+	FreeImage_Unload(td);
+	FreeImage_Unload(bu);
+}
+
+void testSharedPixels() {
+	const unsigned width = 41;
+	const unsigned height = 29;
+
+	FIBITMAP *src = FreeImage_Allocate(width, height, 8);
+	assert(src != NULL);
+	uint32_t seed = 4321;
+	for (unsigned y = 0; y < height; y++) {
+		uint8_t *line = FreeImage_GetScanLine(src, y);
+		for (unsigned i = 0; i < FreeImage_GetLine(src); i++) {
+			seed = seed * 1664525 + 1013904223;
+			line[i] = (uint8_t)(seed >> 24);
+		}
+	}
+	// deep copy of src
+	FIBITMAP *golden = FreeImage_Copy(src, 0, 0, width, height);
+	assert(golden != NULL);
+
+	// pointers to the header and the pixels of the source stay valid after a clone ...
+	FIRGBA8 *palette = FreeImage_GetPalette(src);
+	FIBITMAPINFOHEADER *info = FreeImage_GetInfoHeader(src);
+	uint8_t *bits = FreeImage_GetBits(src);
+
+	FIBITMAP *clone = FreeImage_Clone(src);
+	assert(clone != NULL);
+	assert(isSameImage(clone, golden));
+	assert(FreeImage_GetPalette(src) == palette);
+	assert(FreeImage_GetInfoHeader(src) == info);
+	assert(FreeImage_GetBits(src) == bits);
+
+	// ... and writes through them leave the clone untouched
+	palette[5].red = 200;
+	info->biXPelsPerMeter = 1234;
+	bits[0] = (uint8_t)~bits[0];
+	assert(FreeImage_GetPalette(src)[5].red == 200);
+	assert(FreeImage_GetDotsPerMeterX(src) == 1234);
+	assert(FreeImage_GetPalette(clone)[5].red == 5);
+	assert(FreeImage_GetDotsPerMeterX(clone) != 1234);
+	assert(isSameImage(clone, golden));
+	FreeImage_Unload(clone);
+	assert(FreeImage_GetPalette(src)[5].red == 200);
+	bits[0] = (uint8_t)~bits[0];
+	palette[5].red = 5;
+
+	FIRGBA8 color = { 1, 2, 3, 0xFF };
+	FIRGBA8 value;
+	bool success;
+
+	// views write into their parent and keep its pixels alive
+	FIBITMAP *parent = FreeImage_ConvertTo24Bits(golden);
+	assert(parent != NULL);
+	FIBITMAP *view = FreeImage_CreateView(parent, 8, 4, 24, 20);
+	assert(view != NULL);
+	success = FreeImage_SetPixelColor(view, 1, 2, &color);
+	assert(success);
+	success = FreeImage_GetPixelColor(parent, 8 + 1, height - 20 + 2, &value);
+	assert(success);
+	assert((value.red == color.red) && (value.green == color.green) && (value.blue == color.blue));
+
+	// a viewed bitmap is cloned with a copy of its pixels
+	clone = FreeImage_Clone(parent);
+	assert(clone != NULL);
+	assert(FreeImage_GetBits(clone) != FreeImage_GetBits(parent));
+	assert(isSameImage(clone, parent));
+	FIBITMAP *snapshot = FreeImage_Copy(parent, 0, 0, width, height);
+	assert(snapshot != NULL);
+
+	// views of views share the same pixels
+	FIBITMAP *subview = FreeImage_CreateView(view, 2, 2, 10, 10);
+	assert(subview != NULL);
+
+	FIBITMAP *expected = FreeImage_Copy(parent, 8, 4, 24, 20);
+	assert(expected != NULL);
+	FreeImage_Unload(parent);
+	assert(isSameImage(view, expected));
+	success = FreeImage_SetPixelColor(view, 2, 8, &color) && FreeImage_SetPixelColor(expected, 2, 8, &color);
+	assert(success);
+	assert(isSameImage(view, expected));
+	FIBITMAP *subexpected = FreeImage_Copy(expected, 2, 2, 10, 10);
+	assert(subexpected != NULL);
+	FreeImage_Unload(view);
+	assert(isSameImage(subview, subexpected));
+	FreeImage_Unload(subexpected);
+	FreeImage_Unload(subview);
+	FreeImage_Unload(expected);
+
+	// the clone of the parent does not see the writes through the views
+	assert(isSameImage(clone, snapshot));
+	FreeImage_Unload(snapshot);
+	FreeImage_Unload(clone);
+
+	// views of user provided buffers rely on the lifetime of the buffer
+	FIBITMAP *wrapper = FreeImage_ConvertFromRawBitsEx(FALSE, bits, FIT_BITMAP, width, height, FreeImage_GetPitch(src), 8, 0, 0, 0, FALSE);
+	assert(wrapper != NULL);
+	view = FreeImage_CreateView(wrapper, 0, 0, 10, 10);
+	assert(view != NULL);
+	FreeImage_Unload(wrapper);
+	assert(FreeImage_GetBits(view) == bits + (size_t)FreeImage_GetPitch(src) * (height - 10));
+	FreeImage_Unload(view);
+
+	assert(isSameImage(src, golden));
+	FreeImage_Unload(golden);
+	FreeImage_Unload(src);
+}
+
+// ----------------------------------------------------------
+
+struct TileTestData {
+	unsigned tile_width;
+	unsigned tile_height;
+	unsigned columns;
+	int stop_index;
+};
+
+static FIBOOL DLL_CALLCONV
+addTileIndex(const FITILE *tile, void *user) {
+	const TileTestData *data = (const TileTestData *)user;
+	if ((int)tile->index == data->stop_index) {
+		return FALSE;
+	}
+	assert(tile->left == (tile->index % data->columns) * data->tile_width);
+	assert(tile->top == (tile->index / data->columns) * data->tile_height);
+	assert(FreeImage_GetWidth(tile->view) == tile->width);
+	assert(FreeImage_GetHeight(tile->view) == tile->height);
+	for (unsigned y = 0; y < tile->height; y++) {
+		uint16_t *line = (uint16_t *)FreeImage_GetScanLine(tile->view, y);
+		for (unsigned x = 0; x < tile->width; x++) {
+			line[x] += (uint16_t)(tile->index + 1);
+		}
+	}
+	return TRUE;
+}
+
+static FIBOOL DLL_CALLCONV
+checkByteAligned(const FITILE *tile, void *) {
+	return ((tile->left % 8) == 0) && (FreeImage_GetWidth(tile->view) == tile->width);
+}
+
+void testForEachTile() {
+	const unsigned width = 103;
+	const unsigned height = 71;
+
+	FIBITMAP *dib = FreeImage_AllocateT(FIT_UINT16, width, height);
+	assert(dib != NULL);
+	const uint16_t zero = 0;
+	bool success = FreeImage_Fill(dib, &zero, sizeof(zero));
+	assert(success);
+	FIBITMAP *clone = FreeImage_Clone(dib);
+
+	// every pixel belongs to exactly one tile
+	TileTestData data = { 16, 10, (width + 15) / 16, -1 };
+	success = FreeImage_ForEachTile(dib, data.tile_width, data.tile_height, addTileIndex, &data);
+	assert(success);
+	for (unsigned y = 0; y < height; y++) {
+		const uint16_t *line = (const uint16_t *)FreeImage_GetScanLine(dib, height - 1 - y);
+		for (unsigned x = 0; x < width; x++) {
+			assert(line[x] == (y / data.tile_height) * data.columns + x / data.tile_width + 1);
+		}
+	}
+	// a clone made before is not affected
+	const uint16_t *clone_line = (const uint16_t *)FreeImage_GetScanLine(clone, 0);
+	for (unsigned x = 0; x < width; x++) {
+		assert(clone_line[x] == 0);
+	}
+	FreeImage_Unload(clone);
+
+	// row bands of the full width
+	success = FreeImage_Fill(dib, &zero, sizeof(zero));
+	assert(success);
+	data.tile_width = width;
+	data.tile_height = 7;
+	data.columns = 1;
+	success = FreeImage_ForEachTile(dib, 0, data.tile_height, addTileIndex, &data);
+	assert(success);
+	assert(((const uint16_t *)FreeImage_GetScanLine(dib, 0))[width - 1] == (height - 1) / 7 + 1);
+
+	// a callback returning FALSE stops the processing
+	data.stop_index = 3;
+	success = FreeImage_ForEachTile(dib, 0, data.tile_height, addTileIndex, &data);
+	assert(!success);
+	FreeImage_Unload(dib);
+
+	// tiles of 1-bit bitmaps start at a byte boundary
+	dib = FreeImage_Allocate(width, height, 1);
+	assert(dib != NULL);
+	success = FreeImage_ForEachTile(dib, 3, 5, checkByteAligned);
+	assert(success);
+	FreeImage_Unload(dib);
+
+	// typed tiles of the C++ API
+	fi::Bitmap bitmap(fi::ImageType::eFloat, 64, 48, 32);
+	success = fi::ForEachBand<float>(bitmap, [](fi::Tile<float>& tile) {
+		for (uint32_t y = 0; y < tile.GetHeight(); y++) {
+			float *line = tile.GetScanLine(y);
+			const uint32_t row = tile.GetTop() + tile.GetHeight() - 1 - y;
+			for (uint32_t x = 0; x < tile.GetWidth(); x++) {
+				line[x] = (float)(row * 1000 + tile.GetLeft() + x);
+			}
+		}
+	});
+	assert(success);
+	for (uint32_t y = 0; y < bitmap.GetHeight(); y++) {
+		const float *line = static_cast<const fi::Bitmap&>(bitmap).GetScanLineAs<float>(bitmap.GetHeight() - 1 - y);
+		for (uint32_t x = 0; x < bitmap.GetWidth(); x++) {
+			assert(line[x] == (float)(y * 1000 + x));
+		}
+	}
+	success = fi::ForEachTile<float>(bitmap, 8, 8, [](fi::Tile<float>& tile) {
+		return tile.GetIndex() != 5;
+	});
+	assert(!success);
+
+	bool thrown = false;
+	try {
+		fi::ForEachTile<float>(bitmap, 8, 8, [](fi::Tile<float>&) {
+			throw std::runtime_error("tile");
+		});
+	}
+	catch (const std::runtime_error&) {
+		thrown = true;
+	}
+	assert(thrown);
+
+	// the pixel type must match the bitmap
+	thrown = false;
+	try {
+		fi::ForEachBand<FIRGBF>(bitmap, [](fi::Tile<FIRGBF>&) {});
+	}
+	catch (const fi::ImageError&) {
+		thrown = true;
+	}
+	assert(thrown);
+}